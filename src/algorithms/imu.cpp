@@ -0,0 +1,111 @@
+/* File imu.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Example of integrating the gyroscopes of many inertial measurement units (IMUs)
+ * \author Nikos Kazazakis
+ */
+
+// Program description:
+// Simulates many gyroscopes, each spinning around its own axis with a
+// wobble (coning), integrates all of them with every scheme, and reports the
+// accuracy of each scheme against the single sensor version, then the
+// throughput (sensor steps/second) for 1, 2, 4, ... up to all available
+// OpenMP threads.
+//
+// Usage: imuIntegration [numSensors] [numSamples] [repetitions]
+
+#include "Quaternion.h"
+#include "Integration.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <omp.h>
+
+using namespace Quaternions;
+
+int main(int argc, char *argv[])
+{
+	// Parse the (optional) command line arguments
+	const std::size_t numSensors = argc>1 ? std::strtoul(argv[1],nullptr,10) : 100000;
+	const std::size_t numSamples = argc>2 ? std::strtoul(argv[2],nullptr,10) : 200;
+	const int repetitions = argc>3 ? std::atoi(argv[3]) : 5;
+	const double dt=0.005; // A 200Hz gyroscope
+
+	// Simulate the rates
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-2.0,2.0);
+	GyroSamples rates(numSensors,numSamples);
+	for (std::size_t sensor=0;sensor<numSensors;++sensor){
+		const Vector3 spin{distribution(generator),distribution(generator),distribution(generator)};
+		const Vector3 wobble{distribution(generator),distribution(generator),distribution(generator)};
+		for (std::size_t sample=0;sample<numSamples;++sample){
+			const double c=std::cos(10.0*sample*dt), s=std::sin(10.0*sample*dt);
+			rates.set(sample,sensor,Vector3{spin.x+c*wobble.x,spin.y+s*wobble.y,spin.z+c*s*wobble.z});
+		}
+	}
+	const QuaternionBatch initial(std::vector<Quaternion>(numSensors,Quaternion(1,0,0,0)));
+	QuaternionBatch orientations;
+
+	// Sanity check: compare against the single sensor version, and report
+	// how far apart the schemes end up
+	const IntegrationScheme schemes[]={integrateFirstOrder,integrateMagnus,integrateRK4};
+	const char *names[]={"first order","Magnus","RK4"};
+	std::vector<Quaternion> final[3];
+	for (int scheme=0;scheme<3;++scheme){
+		orientations=initial;
+		integrate(rates,dt,schemes[scheme],orientations);
+		std::vector<Vector3> sensorRates(numSamples);
+		for (std::size_t sensor=0;sensor<numSensors && sensor<100;++sensor){
+			for (std::size_t sample=0;sample<numSamples;++sample){
+				sensorRates[sample]=rates.get(sample,sensor);
+			}
+			const Quaternion reference=integrate(initial.get(sensor),sensorRates.data(),numSamples,dt,schemes[scheme]);
+			if ((orientations.get(sensor)-reference).norm()>1e-12){
+				cout<<"Integration mismatch at sensor "<<sensor<<endl;
+				return 1;
+			}
+		}
+		final[scheme].resize(numSensors);
+		for (std::size_t sensor=0;sensor<numSensors;++sensor){
+			final[scheme][sensor]=orientations.get(sensor);
+		}
+	}
+	for (int scheme=0;scheme<2;++scheme){
+		double worst=0.0;
+		for (std::size_t sensor=0;sensor<numSensors;++sensor){
+			const Quaternion &p=final[scheme][sensor], &q=final[2][sensor];
+			worst=std::max(worst,std::min((p-q).norm(),(p+q).norm()));
+		}
+		cout<<"Largest difference between "<<names[scheme]<<" and RK4: "<<worst<<endl;
+	}
+
+	cout<<"Integrating "<<numSensors<<" sensors, "<<numSamples<<" samples, "<<repetitions<<" repetitions"<<endl;
+	cout<<"scheme\tthreads\tsteps/s"<<endl;
+
+	// Time the batch integration for an increasing number of threads
+	const int maxThreads=omp_get_max_threads();
+	for (int scheme=0;scheme<3;++scheme){
+		for (int threads=1;;threads=std::min(2*threads,maxThreads)){
+			omp_set_num_threads(threads);
+			orientations=initial;
+			integrate(rates,dt,schemes[scheme],orientations); // Warm up (page faults, thread pool start up)
+
+			auto start=std::chrono::steady_clock::now();
+			for (int r=0;r<repetitions;++r){
+				orientations=initial;
+				integrate(rates,dt,schemes[scheme],orientations);
+			}
+			std::chrono::duration<double> elapsed=std::chrono::steady_clock::now()-start;
+
+			cout<<names[scheme]<<"\t"<<threads<<"\t"<<(double)(numSensors)*(numSamples-1)*repetitions/elapsed.count()<<endl;
+			if (threads==maxThreads){
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -1,19 +1,78 @@
 /* File main.cpp
- * 
+ *
  * Copyright (c) Nikos Kazazakis 2016
  * \brief Example of performing quaternion calcluations using the Quaternion class
  * \author Nikos Kazazakis
  */
 
-// Program description: 
-// Sample program to test quaternion rotations (next revision)
+// Program description:
+// Rotates a large random point cloud with the batch rotation kernel using
+// 1, 2, 4, ... up to all available OpenMP threads, and reports the throughput
+// (points/second) for each thread count.
+//
+// Usage: rotations [numPoints] [repetitions]
 
 #include "Quaternion.h"
+#include "Rotation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <omp.h>
 
 using namespace Quaternions;
 
-int main()
+int main(int argc, char *argv[])
 {
+	// Parse the (optional) command line arguments
+	const std::size_t numPoints = argc>1 ? std::strtoul(argv[1],nullptr,10) : 10000000;
+	const int repetitions = argc>2 ? std::atoi(argv[2]) : 10;
+
+	// Build a random point cloud
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	PointCloud points(numPoints), rotated;
+	for (std::size_t n=0;n<numPoints;++n){
+		points.set(n,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+	}
+
+	// Rotation of 90 degrees around the z axis
+	const double halfAngle=std::acos(-1.0)/4.0;
+	Quaternion q = Quaternion(std::cos(halfAngle),0,0,std::sin(halfAngle));
+
+	// Sanity check: compare against the textbook p'=q*p*q^{-1}
+	rotate(q,points,rotated);
+	for (std::size_t n=0;n<numPoints && n<1000;++n){
+		const Vector3 p=points.get(n);
+		Quaternion reference = q*Quaternion(0,p.x,p.y,p.z)*q.conjugate();
+		const Vector3 r=rotated.get(n);
+		if (std::abs(r.x-reference.i())>1e-12 || std::abs(r.y-reference.j())>1e-12 || std::abs(r.z-reference.k())>1e-12){
+			cout<<"Rotation mismatch at point "<<n<<endl;
+			return 1;
+		}
+	}
+
+	cout<<"Rotating "<<numPoints<<" points, "<<repetitions<<" repetitions"<<endl;
+	cout<<"threads\tpoints/s"<<endl;
+
+	// Time the batch rotation for an increasing number of threads
+	const int maxThreads=omp_get_max_threads();
+	for (int threads=1;;threads=std::min(2*threads,maxThreads)){
+		omp_set_num_threads(threads);
+		rotate(q,points,rotated); // Warm up (page faults, thread pool start up)
+
+		auto start=std::chrono::steady_clock::now();
+		for (int r=0;r<repetitions;++r){
+			rotate(q,points,rotated);
+		}
+		std::chrono::duration<double> elapsed=std::chrono::steady_clock::now()-start;
+
+		cout<<threads<<"\t"<<(double)(numPoints)*repetitions/elapsed.count()<<endl;
+		if (threads==maxThreads){
+			break;
+		}
+	}
 
 	return 0;
 }
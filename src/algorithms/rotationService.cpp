@@ -0,0 +1,141 @@
+/* File rotationService.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Load generator for the asynchronous rotation executor
+ * \author Nikos Kazazakis
+ */
+
+// Program description:
+// Simulates a service where many threads each rotate small point clouds.
+// Every producer thread keeps a few jobs in flight (it waits for its oldest
+// job before it submits a new one once it has 16 outstanding), and the
+// executor batches the jobs of all producers. For several batch limits and
+// windows, reports the throughput (jobs/second and points/second), the
+// average batch, and the median and 99th percentile latency from submit to
+// completion. The first line is the baseline where every producer rotates
+// its own jobs, one at a time, on its own thread.
+//
+// Usage: rotationService [numProducers] [jobsPerProducer] [pointsPerJob] [numWorkers]
+
+#include "Quaternion.h"
+#include "Rotation.h"
+#include "RotationExecutor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+#include <omp.h>
+
+using namespace Quaternions;
+
+// The recurring orientations: headings 1 degree apart
+static Quaternion heading(std::size_t n)
+{
+	const double angle=double(n%360)*std::acos(-1.0)/180.0;
+	return Quaternion(std::cos(angle/2),0,0,std::sin(angle/2));
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse the (optional) command line arguments
+	const std::size_t numProducers = argc>1 ? std::strtoul(argv[1],nullptr,10) : 4;
+	const std::size_t jobsPerProducer = argc>2 ? std::strtoul(argv[2],nullptr,10) : 20000;
+	const std::size_t pointsPerJob = argc>3 ? std::strtoul(argv[3],nullptr,10) : 256;
+	const std::size_t numWorkers = argc>4 ? std::strtoul(argv[4],nullptr,10) : RotationExecutorOptions().workers;
+	const std::size_t inFlight=16;
+
+	// One random cloud, which every job rotates (by its own heading)
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	PointCloud points(pointsPerJob);
+	for (std::size_t n=0;n<pointsPerJob;++n){
+		points.set(n,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+	}
+
+	// Sanity check: the executor gives what the batch rotation gives
+	{
+		RotationExecutor executor;
+		for (std::size_t n=0;n<100;++n){
+			PointCloud expected;
+			rotate(heading(n),points,expected);
+			const PointCloud rotated=executor.submit(heading(n),points).get();
+			const std::size_t bytes=pointsPerJob*sizeof(double);
+			if (std::memcmp(rotated.x(),expected.x(),bytes)!=0 || std::memcmp(rotated.y(),expected.y(),bytes)!=0
+					|| std::memcmp(rotated.z(),expected.z(),bytes)!=0){
+				cout<<"Rotation mismatch at job "<<n<<endl;
+				return 1;
+			}
+		}
+	}
+
+	cout<<numProducers<<" producers, "<<jobsPerProducer<<" jobs each, "<<pointsPerJob<<" points per job, "
+			<<numWorkers<<" workers"<<endl;
+	cout<<"maxJobs\twindow(us)\tjobs/s\tpoints/s\tjobs/batch\tp50(us)\tp99(us)\tmaxDepth"<<endl;
+	const double jobs=double(numProducers*jobsPerProducer);
+
+	// Baseline: every producer rotates its own jobs
+	{
+		auto start=std::chrono::steady_clock::now();
+		std::vector<std::thread> producers;
+		for (std::size_t p=0;p<numProducers;++p){
+			producers.emplace_back([&,p]{
+				omp_set_num_threads(1); // Only this thread's setting
+				PointCloud rotated;
+				for (std::size_t n=0;n<jobsPerProducer;++n){
+					rotate(heading(p+n),points,rotated);
+				}
+			});
+		}
+		for (auto &producer : producers){
+			producer.join();
+		}
+		std::chrono::duration<double> elapsed=std::chrono::steady_clock::now()-start;
+		cout<<"inline\t-\t"<<jobs/elapsed.count()<<"\t"<<jobs*pointsPerJob/elapsed.count()<<"\t-\t-\t-\t-"<<endl;
+	}
+
+	// The executor, with increasing batch limits, then with batching windows
+	struct Configuration {std::size_t maxJobs; long window;};
+	const Configuration configurations[]={{1,0},{4,0},{16,0},{64,0},{256,0},{64,50},{256,200}};
+	for (const Configuration &configuration : configurations){
+		RotationExecutorOptions options;
+		options.workers=numWorkers;
+		options.maxBatchJobs=configuration.maxJobs;
+		options.batchWindow=std::chrono::microseconds(configuration.window);
+		RotationExecutor executor(options);
+
+		auto start=std::chrono::steady_clock::now();
+		std::vector<std::thread> producers;
+		for (std::size_t p=0;p<numProducers;++p){
+			producers.emplace_back([&,p]{
+				std::deque<std::future<PointCloud> > pending;
+				for (std::size_t n=0;n<jobsPerProducer;++n){
+					if (pending.size()==inFlight){
+						pending.front().get();
+						pending.pop_front();
+					}
+					pending.push_back(executor.submit(heading(p+n),points));
+				}
+				for (auto &result : pending){
+					result.get();
+				}
+			});
+		}
+		for (auto &producer : producers){
+			producer.join();
+		}
+		std::chrono::duration<double> elapsed=std::chrono::steady_clock::now()-start;
+
+		const RotationExecutorStats stats=executor.stats();
+		cout<<configuration.maxJobs<<"\t"<<configuration.window<<"\t"<<jobs/elapsed.count()<<"\t"
+				<<jobs*pointsPerJob/elapsed.count()<<"\t"<<stats.meanBatchJobs()<<"\t"
+				<<stats.latencyPercentile(0.5)/1000.0<<"\t"<<stats.latencyPercentile(0.99)/1000.0<<"\t"
+				<<stats.maxQueueDepth<<endl;
+	}
+
+	return 0;
+}
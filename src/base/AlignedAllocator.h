@@ -0,0 +1,68 @@
+/* File AlignedAllocator.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief STL allocator returning over-aligned memory, for SIMD-friendly containers
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_ALIGNED_ALLOCATOR // Define macro headers so that this file is only included once
+#define QUATERNION_ALIGNED_ALLOCATOR
+
+// Include STL headers
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace Quaternions{
+
+// Alignment used by all the bulk containers: one cache line, which is also
+// the widest vector register we target (AVX-512)
+const std::size_t kBatchAlignment=64;
+
+/**
+ * AlignedAllocator is a minimal C++11 allocator that returns memory aligned
+ * to Alignment bytes. Use it with std::vector so that the first element of
+ * every array starts on a cache line and vector loads never split.
+ */
+template <typename T, std::size_t Alignment=kBatchAlignment>
+class AlignedAllocator
+{
+public :
+	typedef T value_type;
+
+	// Allocators must be rebindable to other types (e.g. by std::vector in debug mode)
+	template <typename U>
+	struct rebind{ typedef AlignedAllocator<U,Alignment> other; };
+
+	AlignedAllocator() noexcept {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U,Alignment> &) noexcept {}
+
+	T *allocate(std::size_t n)
+	{
+		// Note: std::aligned_alloc is C++17, so use the POSIX version (the
+		// project only builds on Linux anyway)
+		void *memory=nullptr;
+		if (posix_memalign(&memory,Alignment,n==0 ? Alignment : n*sizeof(T))!=0){
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T *memory, std::size_t) noexcept {std::free(memory);}
+};
+
+// All aligned allocators are interchangeable (they are stateless)
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T,Alignment> &, const AlignedAllocator<U,Alignment> &) {return true;}
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T,Alignment> &, const AlignedAllocator<U,Alignment> &) {return false;}
+
+// Convenience alias for an aligned vector
+template <typename T>
+using AlignedVector=std::vector<T,AlignedAllocator<T> >;
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,109 @@
+/* File ArenaAllocator.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the bump arenas and the per-thread arena and counters
+ * \author Nikos Kazazakis
+ */
+
+#include "ArenaAllocator.h"
+
+// Other includes
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+using namespace Quaternions;
+
+const std::size_t QuaternionArena::kDefaultBlockSize;
+
+// Every thread starts on the heap, with zero counters
+/* Note: thread_local variables are created on first use by each thread, so
+ * OpenMP workers get their own copies */
+static thread_local QuaternionArena *threadArena=nullptr;
+static thread_local AllocationCounters threadCounters={0,0,0,0};
+
+// === Arena ===
+QuaternionArena::QuaternionArena(std::size_t blockSize) :
+	blockSize_(blockSize)
+{
+	assert(blockSize>0);
+}
+
+QuaternionArena::~QuaternionArena()
+{
+	for (auto &block : blocks_){
+		std::free(block.memory);
+	}
+}
+
+void QuaternionArena::reset()
+{
+	activeBlock_=0;
+	current_=0;
+	end_=0;
+	if (!blocks_.empty()){
+		current_=reinterpret_cast<std::uintptr_t>(blocks_[0].memory);
+		end_=current_+blocks_[0].size;
+	}
+	bytesUsed_=0;
+}
+
+void *QuaternionArena::allocateFromNewBlock(std::size_t size, std::size_t alignment)
+{
+	// Enough for the request even at the worst alignment
+	const std::size_t needed=size+alignment-1;
+
+	// Reuse the blocks kept by reset(), skipping any that are too small
+	if (!blocks_.empty()){
+		while (activeBlock_+1<blocks_.size()){
+			const Block &block=blocks_[++activeBlock_];
+			if (block.size>=needed){
+				current_=reinterpret_cast<std::uintptr_t>(block.memory);
+				end_=current_+block.size;
+				return allocate(size,alignment);
+			}
+		}
+	}
+
+	// Out of blocks: get a new one from the heap
+	Block block;
+	block.size=std::max(blockSize_,needed);
+	block.memory=static_cast<char*>(std::malloc(block.size));
+	if (!block.memory){
+		throw std::bad_alloc();
+	}
+	blocks_.push_back(block);
+	activeBlock_=blocks_.size()-1;
+	current_=reinterpret_cast<std::uintptr_t>(block.memory);
+	end_=current_+block.size;
+	return allocate(size,alignment);
+}
+
+// === Per-thread state ===
+QuaternionArena *Quaternions::currentArena()
+{
+	return threadArena;
+}
+
+ArenaScope::ArenaScope(QuaternionArena &arena) :
+	previous_(threadArena)
+{
+	threadArena=&arena;
+}
+
+ArenaScope::~ArenaScope()
+{
+	threadArena=previous_;
+}
+
+AllocationCounters &Quaternions::allocationCounters()
+{
+	return threadCounters;
+}
+
+void Quaternions::resetAllocationCounters()
+{
+	threadCounters=AllocationCounters{0,0,0,0};
+}
+
+// End of file
@@ -0,0 +1,202 @@
+/* File ArenaAllocator.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Thread-local bump (monotonic) arenas and the STL allocator that draws from them
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_ARENA_ALLOCATOR // Define macro headers so that this file is only included once
+#define QUATERNION_ARENA_ALLOCATOR
+
+// Include project headers
+#include "Instrumentation.h"
+
+// Include STL headers
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/* Note: every SparseQuaternion element is a std::map node, so a single
+ * Hamilton product costs 4 node allocations for its result, and every
+ * operator returns a fresh object. With several threads doing this, the
+ * general purpose allocator (malloc) and its locks become the bottleneck.
+ *
+ * An arena is a big block of memory that we hand out from front to back,
+ * bumping a pointer: an allocation is an add and a compare, and there is no
+ * locking because every thread uses its own arena. Individual deallocations
+ * do nothing; the whole arena is released at once with reset(), which keeps
+ * the blocks for the next round of temporaries.
+ *
+ * Usage:
+ *     QuaternionArena arena;
+ *     for (...){
+ *         ArenaScope scope(arena); // Quaternions built here use the arena
+ *         SparseQuaternion q=q1*q2*q3;
+ *         result=q.dense();        // Copy out whatever must survive
+ *     }                            // q is destroyed, then the scope ends
+ *     arena.reset();               // Release all the temporaries at once
+ *
+ * CAUTION: objects allocated from an arena must not outlive its reset() or
+ * its destruction. Keep results in dense Quaternions, or in SparseQuaternions
+ * constructed outside the scope.
+ */
+
+namespace Quaternions{
+
+/**
+ * QuaternionArena is a monotonic buffer: a list of blocks handed out with a
+ * bump pointer. It is NOT thread-safe; use one arena per thread.
+ */
+class QuaternionArena
+{
+public :
+	// Blocks are blockSize bytes, larger requests get a block of their own
+	explicit QuaternionArena(std::size_t blockSize=kDefaultBlockSize);
+	~QuaternionArena();
+
+	// Arenas own their blocks: no copies
+	QuaternionArena(const QuaternionArena &)=delete;
+	QuaternionArena &operator=(const QuaternionArena &)=delete;
+
+	// Get size bytes aligned to alignment (a power of 2)
+	void *allocate(std::size_t size, std::size_t alignment)
+	{
+		// Fast path: there is room in the current block
+		const std::uintptr_t start=(current_+alignment-1) & ~std::uintptr_t(alignment-1);
+		if (start+size<=end_){
+			current_=start+size;
+			bytesUsed_+=size;
+			return reinterpret_cast<void*>(start);
+		}
+		return allocateFromNewBlock(size,alignment);
+	}
+
+	// Release everything allocated so far. The blocks are kept for reuse
+	void reset();
+
+	// Bytes handed out since the last reset
+	std::size_t bytesUsed() const {return bytesUsed_;}
+
+	// Number of blocks held (a measure of the memory reserved)
+	std::size_t blockCount() const {return blocks_.size();}
+
+	static const std::size_t kDefaultBlockSize=64*1024;
+
+private:
+	// Slow path: move on to the next block (allocating it if needed)
+	void *allocateFromNewBlock(std::size_t size, std::size_t alignment);
+
+	struct Block{
+		char *memory;
+		std::size_t size;
+	};
+
+	std::vector<Block> blocks_;
+	std::size_t activeBlock_=0; // Index of the block we are bumping through
+	std::uintptr_t current_=0;  // Next free byte of the active block
+	std::uintptr_t end_=0;      // One past the last byte of the active block
+	std::size_t blockSize_;
+	std::size_t bytesUsed_=0;
+}; // End of QuaternionArena class
+
+// The arena of the calling thread, or nullptr if it uses the heap
+QuaternionArena *currentArena();
+
+/**
+ * ArenaScope makes an arena the current arena of the calling thread for its
+ * lifetime, and restores the previous one when it is destroyed, so scopes
+ * can be nested.
+ */
+class ArenaScope
+{
+public :
+	explicit ArenaScope(QuaternionArena &arena);
+	~ArenaScope();
+
+	ArenaScope(const ArenaScope &)=delete;
+	ArenaScope &operator=(const ArenaScope &)=delete;
+
+private:
+	QuaternionArena *previous_;
+};
+
+// === Allocation counters ===
+// Per-thread totals of the allocations made through ArenaAllocator. Take
+// the difference around an operation to get its allocations
+struct AllocationCounters
+{
+	std::uint64_t allocations;      // Total allocations (heap and arena)
+	std::uint64_t arenaAllocations; // Allocations served by an arena
+	std::uint64_t deallocations;    // Heap deallocations (arena ones are free)
+	std::uint64_t bytes;            // Total bytes requested
+};
+
+// The counters of the calling thread
+AllocationCounters &allocationCounters();
+
+// Zero the counters of the calling thread
+void resetAllocationCounters();
+
+/**
+ * ArenaAllocator is a stateful C++11 allocator. It captures the current arena
+ * of the thread that constructs it; the container keeps that allocator (and
+ * that arena) for its whole life. With no current arena it uses the heap.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public :
+	typedef T value_type;
+
+	// Allocators must be rebindable to other types (std::map allocates nodes, not pairs)
+	template <typename U>
+	struct rebind{ typedef ArenaAllocator<U> other; };
+
+	ArenaAllocator() noexcept : arena_(currentArena()) {}
+	explicit ArenaAllocator(QuaternionArena *arena) noexcept : arena_(arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &allocator) noexcept : arena_(allocator.arena()) {}
+
+	T *allocate(std::size_t n)
+	{
+		QUATERNION_COUNT(opAllocation);
+		AllocationCounters &counters=allocationCounters();
+		++counters.allocations;
+		counters.bytes+=n*sizeof(T);
+		if (arena_){
+			++counters.arenaAllocations;
+			return static_cast<T*>(arena_->allocate(n*sizeof(T),alignof(T)));
+		}
+		return static_cast<T*>(::operator new(n*sizeof(T)));
+	}
+
+	void deallocate(T *memory, std::size_t) noexcept
+	{
+		if (!arena_){ // Arena memory is released in bulk by reset()
+			++allocationCounters().deallocations;
+			::operator delete(memory);
+		}
+	}
+
+	QuaternionArena *arena() const {return arena_;}
+
+	// Copies of a container use the current arena, not the arena of the original
+	ArenaAllocator select_on_container_copy_construction() const {return ArenaAllocator();}
+
+private:
+	QuaternionArena *arena_;
+};
+
+// Two allocators are interchangeable if they draw from the same arena (or both from the heap)
+/* Note: containers with different arenas copy and move element by element,
+ * so assigning across arenas is safe but does allocate
+ */
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a1, const ArenaAllocator<U> &a2) {return a1.arena()==a2.arena();}
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a1, const ArenaAllocator<U> &a2) {return !(a1==a2);}
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,205 @@
+/* File Comparison.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the batch comparison and angular distance kernels
+ * \author Nikos Kazazakis
+ */
+
+#include "Comparison.h"
+
+// Other includes
+#include <cassert>
+
+using namespace Quaternions;
+
+namespace{
+
+// Whether a and b are within bound (absolute and relative) or limit (ulps)
+/* Note: everything here returns int and combines with & rather than &&, so
+ * that the loops that call it have no branches and vectorize. Type is a
+ * template parameter, so the ifs are resolved at compile time.
+ */
+template <typename T, ToleranceType Type>
+inline int close(T a, T b, T bound, typename std::make_unsigned<typename ComparisonDetail::UlpTraits<T>::Bits>::type limit)
+{
+	if (Type==toleranceUlps){
+		typedef typename std::make_unsigned<typename ComparisonDetail::UlpTraits<T>::Bits>::type Unsigned;
+		// Note: -limit<=x-y<=limit as a single unsigned comparison: x-y+limit
+		// wraps around to a huge value when x-y is below -limit
+		const Unsigned shifted=Unsigned(ComparisonDetail::orderedBits(a))-Unsigned(ComparisonDetail::orderedBits(b))+limit;
+		return (a==a) & (b==b) & (shifted<=2*limit);
+	}
+	return std::abs(a-b)<=bound;
+}
+
+template <typename T, ToleranceType Type, bool Rotations>
+std::size_t compareKernel(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T tolerance, std::uint8_t *equal)
+{
+	typedef typename std::make_unsigned<typename ComparisonDetail::UlpTraits<T>::Bits>::type Unsigned;
+	const long size=static_cast<long>(q1.size());
+	const T *aw=q1.w(), *ai=q1.i(), *aj=q1.j(), *ak=q1.k();
+	const T *bw=q2.w(), *bi=q2.i(), *bj=q2.j(), *bk=q2.k();
+	// The distances are whole numbers of ulps, so a fractional tolerance rounds
+	// down. Half the range is every finite value anyway
+	const Unsigned half=std::numeric_limits<Unsigned>::max()/2;
+	const Unsigned limit= tolerance>=T(half) ? half : Unsigned(tolerance);
+
+	std::size_t mismatches=0;
+	#pragma omp parallel for simd schedule(static) reduction(+:mismatches)
+	for (long n=0;n<size;++n){
+		const T w1=aw[n], i1=ai[n], j1=aj[n], k1=ak[n];
+		const T w2=bw[n], i2=bi[n], j2=bj[n], k2=bk[n];
+		T bound=tolerance;
+		if (Type==toleranceRelative){
+			bound*=std::max(std::sqrt(w1*w1+i1*i1+j1*j1+k1*k1),std::sqrt(w2*w2+i2*i2+j2*j2+k2*k2));
+		}
+		int same=close<T,Type>(w1,w2,bound,limit) & close<T,Type>(i1,i2,bound,limit)
+			& close<T,Type>(j1,j2,bound,limit) & close<T,Type>(k1,k2,bound,limit);
+		if (Rotations){
+			same|=close<T,Type>(w1,-w2,bound,limit) & close<T,Type>(i1,-i2,bound,limit)
+				& close<T,Type>(j1,-j2,bound,limit) & close<T,Type>(k1,-k2,bound,limit);
+		}
+		equal[n]=static_cast<std::uint8_t>(same);
+		mismatches+=static_cast<std::size_t>(1-same);
+	}
+	return mismatches;
+}
+
+template <typename T, ToleranceType Type>
+std::size_t compareKernel(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T tolerance, ComparisonMode mode, std::uint8_t *equal)
+{
+	return mode==compareRotations ? compareKernel<T,Type,true>(q1,q2,tolerance,equal) : compareKernel<T,Type,false>(q1,q2,tolerance,equal);
+}
+
+// The angular distance from the squared norms of q1-q2 and q1+q2 (see angularDistance in Comparison.h)
+template <typename T>
+inline T distance(T difference, T sum)
+{
+	difference=std::sqrt(difference);
+	sum=std::sqrt(sum);
+	return T(4)*std::atan2(std::min(difference,sum),std::max(difference,sum));
+}
+
+template <typename T>
+inline T differenceNorm(const T *aw, const T *ai, const T *aj, const T *ak, const T *bw, const T *bi, const T *bj, const T *bk, long n)
+{
+	const T dw=aw[n]-bw[n], di=ai[n]-bi[n], dj=aj[n]-bj[n], dk=ak[n]-bk[n];
+	return dw*dw+di*di+dj*dj+dk*dk;
+}
+
+template <typename T>
+inline T sumNorm(const T *aw, const T *ai, const T *aj, const T *ak, const T *bw, const T *bi, const T *bj, const T *bk, long n)
+{
+	const T sw=aw[n]+bw[n], si=ai[n]+bi[n], sj=aj[n]+bj[n], sk=ak[n]+bk[n];
+	return sw*sw+si*si+sj*sj+sk*sk;
+}
+
+} // End anonymous namespace
+
+// == Comparison
+template <typename T>
+std::size_t Quaternions::compare(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T tolerance,
+	ToleranceType type, ComparisonMode mode, std::uint8_t *equal)
+{
+	assert(q1.size()==q2.size() && "Batch sizes must match");
+	assert(tolerance>=T(0) && "Tolerances can't be negative");
+	switch (type){
+	case toleranceRelative:
+		return compareKernel<T,toleranceRelative>(q1,q2,tolerance,mode,equal);
+	case toleranceUlps:
+		return compareKernel<T,toleranceUlps>(q1,q2,tolerance,mode,equal);
+	default:
+		return compareKernel<T,toleranceAbsolute>(q1,q2,tolerance,mode,equal);
+	}
+}
+
+template <typename T>
+std::vector<std::size_t> Quaternions::findMismatches(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T tolerance,
+	ToleranceType type, ComparisonMode mode)
+{
+	std::vector<std::uint8_t> equal(q1.size());
+	std::vector<std::size_t> indices;
+	indices.reserve(compare(q1,q2,tolerance,type,mode,equal.data()));
+	for (std::size_t n=0;n<equal.size();++n){
+		if (!equal[n]){
+			indices.push_back(n);
+		}
+	}
+	return indices;
+}
+
+// == Angular distance
+template <typename T>
+void Quaternions::angularDistance(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T *out)
+{
+	assert(q1.size()==q2.size() && "Batch sizes must match");
+	const long size=static_cast<long>(q1.size());
+	const T *aw=q1.w(), *ai=q1.i(), *aj=q1.j(), *ak=q1.k();
+	const T *bw=q2.w(), *bi=q2.i(), *bj=q2.j(), *bk=q2.k();
+
+	// Note: glibc only has vector versions of atan2 under -ffast-math, so the
+	// norms vectorize and the atan2 calls stay scalar
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		out[n]=distance(differenceNorm(aw,ai,aj,ak,bw,bi,bj,bk,n),sumNorm(aw,ai,aj,ak,bw,bi,bj,bk,n));
+	}
+}
+
+template <typename T>
+AngularDistanceStats Quaternions::angularDistanceStats(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2)
+{
+	assert(q1.size()==q2.size() && "Batch sizes must match");
+	const long size=static_cast<long>(q1.size());
+	AngularDistanceStats stats;
+	if (size==0){
+		return stats;
+	}
+	const T *aw=q1.w(), *ai=q1.i(), *aj=q1.j(), *ak=q1.k();
+	const T *bw=q2.w(), *bi=q2.i(), *bj=q2.j(), *bk=q2.k();
+
+	// Note: each thread keeps its own maximum and sums, and they are combined
+	// once per thread at the end
+	double sum=0.0, squares=0.0;
+	stats.maximum=-1.0;
+	#pragma omp parallel
+	{
+		double localMaximum=-1.0, localSum=0.0, localSquares=0.0;
+		long localWorst=0;
+		#pragma omp for schedule(static) nowait
+		for (long n=0;n<size;++n){
+			const double angle=distance(differenceNorm(aw,ai,aj,ak,bw,bi,bj,bk,n),sumNorm(aw,ai,aj,ak,bw,bi,bj,bk,n));
+			localSum+=angle;
+			localSquares+=angle*angle;
+			if (angle>localMaximum){
+				localMaximum=angle;
+				localWorst=n;
+			}
+		}
+		#pragma omp critical
+		{
+			sum+=localSum;
+			squares+=localSquares;
+			const std::size_t worst=static_cast<std::size_t>(localWorst);
+			if (localMaximum>stats.maximum || (localMaximum==stats.maximum && worst<stats.worst)){
+				stats.maximum=localMaximum;
+				stats.worst=worst;
+			}
+		}
+	}
+	stats.maximum=std::max(stats.maximum,0.0); // All NaN
+	stats.mean=sum/double(size);
+	stats.rms=std::sqrt(squares/double(size));
+	return stats;
+}
+
+// Explicit instantiations: compile the kernels for float and double
+#define QUATERNION_INSTANTIATE_COMPARISON(T) \
+	template std::size_t Quaternions::compare(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, T, ToleranceType, ComparisonMode, std::uint8_t *); \
+	template std::vector<std::size_t> Quaternions::findMismatches(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, T, ToleranceType, ComparisonMode); \
+	template void Quaternions::angularDistance(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, T *); \
+	template AngularDistanceStats Quaternions::angularDistanceStats(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &);
+
+QUATERNION_INSTANTIATE_COMPARISON(float)
+QUATERNION_INSTANTIATE_COMPARISON(double)
+
+// End of file
@@ -0,0 +1,220 @@
+/* File Comparison.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Approximate comparison of quaternions and rotations, single and batch versions, and angular distances
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_COMPARISON_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_COMPARISON_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+
+// Include STL headers
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+/* Note: operator== compares exactly, which is right for copies and for
+ * results computed the same way, but almost nothing else: (q1*q2)*q3 and
+ * q1*(q2*q3) already differ in the last bits. approxEqual compares within a
+ * tolerance, of one of three types:
+ *
+ *   toleranceAbsolute  every component within tolerance: |a-b|<=tolerance.
+ *                      Right for unit quaternions, whose components are at
+ *                      most 1, e.g. tolerance=1e-12.
+ *   toleranceRelative  every component within tolerance times the larger
+ *                      norm: |a-b|<=tolerance*max(|q1|,|q2|). Scale
+ *                      independent. Measured against the norm rather than
+ *                      each component, because a component that should be
+ *                      zero is never relatively close to a rounded zero.
+ *   toleranceUlps      every component at most tolerance floating point
+ *                      values apart (units in the last place). For checking
+ *                      that two implementations agree to the last few bits,
+ *                      e.g. tolerance=4. Near zero the values are very dense
+ *                      (0 and 1e-300 are ~4e18 ulps apart), so only use it
+ *                      where components aren't expected to cancel to zero.
+ *
+ * and in one of two modes: compareQuaternions compares the quaternions, and
+ * compareRotations compares the rotations they stand for, so q and -q are
+ * equal. NaN is never equal to anything.
+ *
+ * angularDistance measures how far apart two rotations are, in radians: the
+ * angle of the rotation that takes one to the other, from 0 to pi. It is the
+ * most meaningful error of an orientation, e.g. "replayed within 1e-9 rad
+ * of the recording".
+ */
+
+namespace Quaternions{
+
+// The tolerance types
+typedef enum{
+	toleranceAbsolute,
+	toleranceRelative,
+	toleranceUlps
+}ToleranceType;
+
+// Whether q and -q are equal
+typedef enum{
+	compareQuaternions,
+	compareRotations
+}ComparisonMode;
+
+// Implementation helpers, not part of the interface
+namespace ComparisonDetail{
+
+// The signed integer type with the bits of T
+template <typename T>
+struct UlpTraits;
+
+template <>
+struct UlpTraits<float>
+{
+	typedef std::int32_t Bits;
+};
+
+template <>
+struct UlpTraits<double>
+{
+	typedef std::int64_t Bits;
+};
+
+// The bits of x as an integer that orders like the floating point values:
+// consecutive values differ by 1, and -0 and +0 are both 0
+/* Note: positive values already order like their bits. Negative ones (the
+ * sign bit set, i.e. negative integers) order backwards, so we mirror them
+ */
+template <typename T>
+inline typename UlpTraits<T>::Bits orderedBits(T x)
+{
+	typedef typename UlpTraits<T>::Bits Bits;
+	Bits bits;
+	std::memcpy(&bits,&x,sizeof(T));
+	return bits<0 ? std::numeric_limits<Bits>::min()-bits : bits;
+}
+
+// The number of floating point values between a and b (as a T, so that it
+// compares with the tolerance). Huge, not infinite, across the whole range
+template <typename T>
+inline T ulpDistance(T a, T b)
+{
+	const typename UlpTraits<T>::Bits x=orderedBits(a), y=orderedBits(b);
+	// Note: differences go through the unsigned type, where they can't overflow
+	typedef typename std::make_unsigned<typename UlpTraits<T>::Bits>::type Unsigned;
+	return T(x>y ? Unsigned(x)-Unsigned(y) : Unsigned(y)-Unsigned(x));
+}
+
+// long double has no integer of the same size everywhere; measure the
+// difference in units of the epsilon of the larger value instead (exact
+// within a binade, a slight overestimate across a power of 2)
+template <>
+inline long double ulpDistance(long double a, long double b)
+{
+	const long double larger=std::max(std::abs(a),std::abs(b));
+	if (larger==0.0L){
+		return 0.0L;
+	}
+	const long double ulp=std::ldexp(std::numeric_limits<long double>::epsilon(),std::ilogb(std::max(larger,std::numeric_limits<long double>::min())));
+	return std::abs(a-b)/ulp;
+}
+
+// Whether a and b are within the tolerance. scale is max(|q1|,|q2|), only
+// used by toleranceRelative
+template <typename T>
+inline bool componentsEqual(T a, T b, T tolerance, ToleranceType type, T scale)
+{
+	switch (type){
+	case toleranceRelative:
+		return std::abs(a-b)<=tolerance*scale;
+	case toleranceUlps:
+		return a==a && b==b && ulpDistance(a,b)<=tolerance; // NaN check: NaN!=NaN
+	default:
+		return std::abs(a-b)<=tolerance;
+	}
+}
+
+template <typename T>
+inline bool quaternionsEqual(const BasicQuaternion<T> &q1, const BasicQuaternion<T> &q2, T tolerance, ToleranceType type, T scale)
+{
+	return componentsEqual(q1.w(),q2.w(),tolerance,type,scale) && componentsEqual(q1.i(),q2.i(),tolerance,type,scale)
+		&& componentsEqual(q1.j(),q2.j(),tolerance,type,scale) && componentsEqual(q1.k(),q2.k(),tolerance,type,scale);
+}
+
+} // End namespace ComparisonDetail
+
+// Whether q1 and q2 are equal within the tolerance (see the note above)
+template <typename E1, typename E2>
+bool approxEqual(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2, PromotedScalar<E1,E2> tolerance,
+	ToleranceType type=toleranceAbsolute, ComparisonMode mode=compareQuaternions)
+{
+	typedef PromotedScalar<E1,E2> T;
+	const BasicQuaternion<T> p1(q1), p2(q2);
+	const T scale= type==toleranceRelative ? std::max(p1.norm(),p2.norm()) : T(0);
+	if (ComparisonDetail::quaternionsEqual(p1,p2,tolerance,type,scale)){
+		return true;
+	}
+	return mode==compareRotations && ComparisonDetail::quaternionsEqual(p1,BasicQuaternion<T>(T(-1)*p2),tolerance,type,scale);
+}
+
+// The angle (radians, from 0 to pi) of the rotation between the UNIT quaternions q1 and q2
+/* Note: |q1-q2| and |q1+q2| are 2sin(angle/4) and 2cos(angle/4) (or the other
+ * way round, for the opposite sign), so atan2 gives the angle at full
+ * precision for every angle; the textbook 2*acos(|dot(q1,q2)|) loses half the
+ * digits for close rotations, exactly where validation needs them.
+ */
+template <typename E1, typename E2>
+PromotedScalar<E1,E2> angularDistance(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	typedef PromotedScalar<E1,E2> T;
+	const BasicQuaternion<T> p1(q1), p2(q2);
+	const T difference=BasicQuaternion<T>(p1-p2).norm(), sum=BasicQuaternion<T>(p1+p2).norm();
+	return T(4)*std::atan2(std::min(difference,sum),std::max(difference,sum));
+}
+
+// === Batch versions ===
+/* Note: these are compiled (explicitly instantiated) in Comparison.cpp for
+ * float and double. They split the work across all OpenMP threads and
+ * vectorize within each thread. Both batches must have the same size.
+ */
+
+// equal[n]=1 if q1[n] and q2[n] are approxEqual, 0 otherwise. The mask must
+// hold q1.size() values. Returns the number of mismatches (zeros)
+template <typename T>
+std::size_t compare(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T tolerance,
+	ToleranceType type, ComparisonMode mode, std::uint8_t *equal);
+
+// The indices of the pairs that are not approxEqual, in increasing order
+template <typename T>
+std::vector<std::size_t> findMismatches(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T tolerance,
+	ToleranceType type=toleranceAbsolute, ComparisonMode mode=compareQuaternions);
+
+// out[n]=angularDistance(q1[n],q2[n]). The output array must hold q1.size() values
+template <typename T>
+void angularDistance(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, T *out);
+
+// Summary of the angular distances of two batches of UNIT quaternions
+struct AngularDistanceStats
+{
+	double maximum=0.0; // Radians
+	double mean=0.0;
+	double rms=0.0;     // Root mean square
+	std::size_t worst=0; // Index of the (first) largest distance
+};
+
+/* Note: the sums are accumulated in double, per thread, so the mean and rms
+ * may differ in the last bits between thread counts; the maximum and its
+ * index don't.
+ */
+template <typename T>
+AngularDistanceStats angularDistanceStats(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2);
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,143 @@
+/* File Composition.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the parallel rotation composition
+ * \author Nikos Kazazakis
+ */
+
+#include "Composition.h"
+
+// Other includes
+#include <cmath>
+#include <omp.h>
+
+using namespace Quaternions;
+
+// Divide q by its norm
+template <typename T>
+static inline void renormalize(BasicQuaternion<T> &q)
+{
+	q=(T(1)/std::sqrt(dot(q,q)))*q;
+}
+
+// Multiply product by quaternions[first..last) in order, renormalizing every
+// renormalizeEvery products. If out is not null, store every running product in it
+template <typename T>
+static BasicQuaternion<T> chain(BasicQuaternion<T> product, const BasicQuaternion<T> *quaternions,
+		std::size_t first, std::size_t last, std::size_t renormalizeEvery, BasicQuaternion<T> *out)
+{
+	std::size_t sinceRenormalization=0;
+	for (std::size_t n=first;n<last;++n){
+		product=product*quaternions[n];
+		if (renormalizeEvery>0 && ++sinceRenormalization==renormalizeEvery){
+			renormalize(product);
+			sinceRenormalization=0;
+		}
+		if (out){
+			out[n]=product;
+		}
+	}
+	return product;
+}
+
+// Product of the chunk quaternions[first..last), starting from its first element
+template <typename T>
+static BasicQuaternion<T> chunkProduct(const BasicQuaternion<T> *quaternions, std::size_t first, std::size_t last, std::size_t renormalizeEvery)
+{
+	if (first==last){
+		return BasicQuaternion<T>(T(1),T(0),T(0),T(0));
+	}
+	return chain(quaternions[first],quaternions,first+1,last,renormalizeEvery,static_cast<BasicQuaternion<T>*>(nullptr));
+}
+
+/* Note: the chunk of thread t is [n*t/threads, n*(t+1)/threads). We ask
+ * OpenMP for the number of threads inside the parallel region, because it
+ * may give us fewer than omp_get_max_threads().
+ */
+
+template <typename T>
+BasicQuaternion<T> Quaternions::compose(const BasicQuaternion<T> *quaternions, std::size_t n, std::size_t renormalizeEvery)
+{
+	if (n<kParallelCompositionSize){
+		BasicQuaternion<T> product=chunkProduct(quaternions,0,n,renormalizeEvery);
+		if (renormalizeEvery>0){
+			renormalize(product);
+		}
+		return product;
+	}
+
+	// One partial product per thread
+	std::vector<BasicQuaternion<T> > partials(omp_get_max_threads());
+	int threads=1;
+	#pragma omp parallel
+	{
+		#pragma omp single
+		threads=omp_get_num_threads(); // The other threads wait at the end of "single"
+		const std::size_t thread=omp_get_thread_num();
+		partials[thread]=chunkProduct(quaternions,n*thread/threads,n*(thread+1)/threads,renormalizeEvery);
+	}
+
+	// Combine the partial products, in order
+	BasicQuaternion<T> product=partials[0];
+	for (int thread=1;thread<threads;++thread){
+		product=product*partials[thread];
+		if (renormalizeEvery>0){
+			renormalize(product);
+		}
+	}
+	if (renormalizeEvery>0){
+		renormalize(product);
+	}
+	return product;
+}
+
+template <typename T>
+void Quaternions::composeScan(const BasicQuaternion<T> *quaternions, std::size_t n, BasicQuaternion<T> *out, std::size_t renormalizeEvery)
+{
+	const BasicQuaternion<T> identity(T(1),T(0),T(0),T(0));
+	if (n<kParallelCompositionSize){
+		chain(identity,quaternions,0,n,renormalizeEvery,out);
+		return;
+	}
+
+	// prefixes[t] will be the product of everything before the chunk of thread t
+	std::vector<BasicQuaternion<T> > prefixes(omp_get_max_threads()+1,identity);
+	#pragma omp parallel
+	{
+		const std::size_t threads=omp_get_num_threads();
+		const std::size_t thread=omp_get_thread_num();
+		const std::size_t first=n*thread/threads, last=n*(thread+1)/threads;
+
+		// Pass 1: the product of every chunk (the last chunk's isn't needed)
+		if (thread+1<threads){
+			prefixes[thread+1]=chunkProduct(quaternions,first,last,renormalizeEvery);
+		}
+		#pragma omp barrier
+
+		// Turn the chunk products into prefix products. This is a handful of products
+		#pragma omp single
+		for (std::size_t t=1;t<threads;++t){
+			prefixes[t]=prefixes[t-1]*prefixes[t];
+			if (renormalizeEvery>0){
+				renormalize(prefixes[t]);
+			}
+		} // Implicit barrier: every thread waits for its prefix
+
+		// Pass 2: rescan every chunk from its prefix
+		/* Note: in-place scans are fine, pass 1 has finished reading the
+		 * input before anything is written, and each thread only writes
+		 * its own chunk */
+		chain(prefixes[thread],quaternions,first,last,renormalizeEvery,out);
+	}
+}
+
+// Explicit instantiations for all the quaternion types
+#define QUATERNION_INSTANTIATE_COMPOSITION(T) \
+	template BasicQuaternion<T> Quaternions::compose(const BasicQuaternion<T> *, std::size_t, std::size_t); \
+	template void Quaternions::composeScan(const BasicQuaternion<T> *, std::size_t, BasicQuaternion<T> *, std::size_t);
+
+QUATERNION_INSTANTIATE_COMPOSITION(float)
+QUATERNION_INSTANTIATE_COMPOSITION(double)
+QUATERNION_INSTANTIATE_COMPOSITION(long double)
+
+// End of file
@@ -0,0 +1,76 @@
+/* File Composition.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Composition of long rotation sequences: parallel product reduction and prefix products (scan)
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_COMPOSITION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_COMPOSITION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+
+// Include STL headers
+#include <cstddef>
+#include <vector>
+
+/* Note: composing a kinematic chain or a sequence of IMU deltas is the
+ * product q[0]*q[1]*...*q[n-1]. Written as a loop, every product depends on
+ * the previous one, so it runs on one core at the latency of a Hamilton
+ * product, however many cores there are.
+ *
+ * The Hamilton product is not commutative, but it IS associative:
+ *     (q0*q1)*(q2*q3) = q0*(q1*(q2*q3))
+ * so we can cut the sequence into one contiguous chunk per thread, multiply
+ * the chunks out in parallel and then multiply the (few) partial products in
+ * order. The prefix products (scan) take two passes: the first finds every
+ * chunk's product, which gives the product of everything before each chunk;
+ * the second rescans every chunk starting from that prefix.
+ *
+ * Reassociating changes the rounding, so the results differ from the serial
+ * chain (and between thread counts) in the last bits: relative differences
+ * of order n*epsilon, the same order as the rounding error of the chain itself.
+ *
+ * Drift: even with unit inputs, the norm of a long product drifts away from 1
+ * by about epsilon per product. Set renormalizeEvery to k>0 to divide the
+ * running products by their norm every k products (and every partial product
+ * when they are combined). For unit inputs this only removes the drift; for
+ * non-unit inputs it returns the unit quaternion of the product.
+ *
+ * Short sequences are multiplied on the calling thread, where the OpenMP
+ * start-up would cost more than the products.
+ */
+
+namespace Quaternions{
+
+// Sequences shorter than this are composed serially
+const std::size_t kParallelCompositionSize=8192;
+
+// Product of all the quaternions in order, q[0]*q[1]*...*q[n-1]. The empty product is the identity
+template <typename T>
+BasicQuaternion<T> compose(const BasicQuaternion<T> *quaternions, std::size_t n, std::size_t renormalizeEvery=0);
+
+// All the prefix products (inclusive scan), out[m]=q[0]*q[1]*...*q[m]
+/* Note: out must hold n quaternions. It may be the input (in-place scan) */
+template <typename T>
+void composeScan(const BasicQuaternion<T> *quaternions, std::size_t n, BasicQuaternion<T> *out, std::size_t renormalizeEvery=0);
+
+// Versions for whole vectors
+template <typename T>
+inline BasicQuaternion<T> compose(const std::vector<BasicQuaternion<T> > &quaternions, std::size_t renormalizeEvery=0)
+{
+	return compose(quaternions.data(),quaternions.size(),renormalizeEvery);
+}
+
+template <typename T>
+inline std::vector<BasicQuaternion<T> > composeScan(const std::vector<BasicQuaternion<T> > &quaternions, std::size_t renormalizeEvery=0)
+{
+	std::vector<BasicQuaternion<T> > out(quaternions.size());
+	composeScan(quaternions.data(),quaternions.size(),out.data(),renormalizeEvery);
+	return out;
+}
+
+} // End namespace Quaternions
+
+#endif
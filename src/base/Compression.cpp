@@ -0,0 +1,126 @@
+/* File Compression.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the bulk quaternion encoding and decoding
+ * \author Nikos Kazazakis
+ */
+
+#include "Compression.h"
+
+using namespace Quaternions;
+
+/* Note on the smallest-three errors in Compression.h: the three stored
+ * components are rounded to the nearest of 2^B-1 levels spaced
+ * step=sqrt(2)/(2^B-2) apart, so each is off by at most e=step/2. The
+ * recomputed largest component L absorbs the rest: to first order it moves
+ * by -(a*da+b*db+c*dc)/L. The worst case is a=b=c=L=1/2 with all three
+ * errors equal, where L moves by 3e and the error has length sqrt(12)*e.
+ * The angle between two close unit quaternions is twice the distance
+ * between them, so the bound is 2*sqrt(12)*e=2*sqrt(6)/(2^B-2).
+ *
+ * The loops read and write the components directly (not through the
+ * Quaternion constructor), so that they vectorize. SmallestThree48 is 6
+ * bytes, and SSE2 can't shuffle 6 byte records into vectors: its loops only
+ * vectorize with AVX2 (QUATERNION_NATIVE_ARCH on a machine that has it).
+ */
+
+namespace{
+
+template <int ComponentBits, typename Store>
+void encodeLoop(const Quaternion *q, std::size_t n, Store store)
+{
+	const long size=static_cast<long>(n);
+	#pragma omp parallel for simd schedule(static)
+	for (long m=0;m<size;++m){
+		store(m,CompressionDetail::encodeSmallestThree<ComponentBits>(q[m][qw],q[m][qi],q[m][qj],q[m][qk]));
+	}
+}
+
+template <int ComponentBits, typename Load>
+void decodeLoop(std::size_t n, Quaternion *out, Load load)
+{
+	const long size=static_cast<long>(n);
+	#pragma omp parallel for simd schedule(static)
+	for (long m=0;m<size;++m){
+		double w, i, j, k;
+		std::uint32_t low, high;
+		load(m,low,high);
+		CompressionDetail::decodeSmallestThree<ComponentBits>(low,high,w,i,j,k);
+		out[m][qw]=w;
+		out[m][qi]=i;
+		out[m][qj]=j;
+		out[m][qk]=k;
+	}
+}
+
+} // End anonymous namespace
+
+// == Encoding
+void Quaternions::encode(const Quaternion *q, std::size_t n, SmallestThree32 *out)
+{
+	encodeLoop<10>(q,n,[out](long m, std::uint64_t bits){out[m].bits=static_cast<std::uint32_t>(bits);});
+}
+
+void Quaternions::encode(const Quaternion *q, std::size_t n, SmallestThree48 *out)
+{
+	encodeLoop<15>(q,n,[out](long m, std::uint64_t bits){
+		out[m].bits[0]=static_cast<std::uint16_t>(bits);
+		out[m].bits[1]=static_cast<std::uint16_t>(bits>>16);
+		out[m].bits[2]=static_cast<std::uint16_t>(bits>>32);
+	});
+}
+
+void Quaternions::encode(const Quaternion *q, std::size_t n, SmallestThree64 *out)
+{
+	encodeLoop<20>(q,n,[out](long m, std::uint64_t bits){out[m].bits=bits;});
+}
+
+void Quaternions::encode(const Quaternion *q, std::size_t n, HalfQuaternion *out)
+{
+	using CompressionDetail::toHalf;
+	const long size=static_cast<long>(n);
+	#pragma omp parallel for simd schedule(static)
+	for (long m=0;m<size;++m){
+		out[m].w=toHalf(q[m][qw]);
+		out[m].i=toHalf(q[m][qi]);
+		out[m].j=toHalf(q[m][qj]);
+		out[m].k=toHalf(q[m][qk]);
+	}
+}
+
+// == Decoding
+void Quaternions::decode(const SmallestThree32 *packed, std::size_t n, Quaternion *out)
+{
+	decodeLoop<10>(n,out,[packed](long m, std::uint32_t &low, std::uint32_t &high){low=packed[m].bits; high=0;});
+}
+
+void Quaternions::decode(const SmallestThree48 *packed, std::size_t n, Quaternion *out)
+{
+	decodeLoop<15>(n,out,[packed](long m, std::uint32_t &low, std::uint32_t &high){
+		low=packed[m].bits[0] | (std::uint32_t(packed[m].bits[1])<<16);
+		high=packed[m].bits[2];
+	});
+}
+
+void Quaternions::decode(const SmallestThree64 *packed, std::size_t n, Quaternion *out)
+{
+	decodeLoop<20>(n,out,[packed](long m, std::uint32_t &low, std::uint32_t &high){
+		low=static_cast<std::uint32_t>(packed[m].bits);
+		high=static_cast<std::uint32_t>(packed[m].bits>>32);
+	});
+}
+
+void Quaternions::decode(const HalfQuaternion *packed, std::size_t n, Quaternion *out)
+{
+	using CompressionDetail::fromHalf;
+	const long size=static_cast<long>(n);
+	#pragma omp parallel for simd schedule(static)
+	for (long m=0;m<size;++m){
+		out[m][qw]=fromHalf(packed[m].w);
+		out[m][qi]=fromHalf(packed[m].i);
+		out[m][qj]=fromHalf(packed[m].j);
+		out[m][qk]=fromHalf(packed[m].k);
+	}
+}
+
+// End of file
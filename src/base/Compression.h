@@ -0,0 +1,288 @@
+/* File Compression.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Compact quaternion encodings (smallest-three in 32, 48 and 64 bits, half floats) with bulk encode/decode
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_COMPRESSION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_COMPRESSION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+
+// Include STL headers
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Note: a Quaternion takes 32 bytes. Rotations need much less:
+ *
+ * Smallest-three: a unit quaternion has only 3 degrees of freedom, and q and
+ * -q are the same rotation. So we flip the sign to make the largest (in
+ * magnitude) component positive, store which component it was (2 bits) and
+ * the other three, and recompute the largest as sqrt(1-a^2-b^2-c^2) when
+ * decoding. The three are never larger than 1/sqrt(2) in magnitude (else
+ * they would be the largest), so we quantize [-1/sqrt(2),1/sqrt(2)]
+ * uniformly, into an odd number of levels (the last code is never used) so
+ * that 0 is one of them: rotations about an axis encode exactly.
+ *
+ *   format          size     bits per component   max angular error
+ *                                                  bound        measured
+ *   SmallestThree32  4 bytes  10                   4.8e-3 rad   4.6e-3 rad (0.26 degrees)
+ *   SmallestThree48  6 bytes  15                   1.5e-4 rad   1.4e-4 rad
+ *   SmallestThree64  8 bytes  20                   4.7e-6 rad   4.2e-6 rad
+ *
+ * The angular error is the angle of the rotation between the input and its
+ * decoded value (angularDistance in Comparison.h). The bound is derived in
+ * Compression.cpp; the measured maximum is over 10^7 random rotations.
+ * Encoding normalizes the input first (the zero quaternion and NaN become
+ * the identity), and decoding always gives a unit quaternion, with the sign
+ * that makes the largest component positive.
+ *
+ * HalfQuaternion stores the 4 components as IEEE 754 half-precision floats
+ * (8 bytes), correctly rounded. It is not limited to rotations: any
+ * quaternion with components up to 65504 keeps a relative error of at most
+ * 2^-11 (4.9e-4) per component; larger ones become infinite and components
+ * below 6.1e-5 lose precision (subnormal halves). For unit quaternions every
+ * component is off by at most 2^-12, so the angular error is at most
+ * 2*2*2^-12=9.8e-4 rad (8.3e-4 measured), and the decoded value is unit
+ * within 4.9e-4: normalize it if that matters.
+ *
+ * The bulk versions encode and decode whole arrays, vectorized and across
+ * all OpenMP threads, and give the same bits as the single ones.
+ */
+
+namespace Quaternions{
+
+// The formats. They are plain bits, so arrays of them can be copied,
+// written to files or sent as they are
+struct SmallestThree32
+{
+	std::uint32_t bits;
+};
+
+struct SmallestThree48
+{
+	std::uint16_t bits[3]; // Least significant part first
+};
+
+struct SmallestThree64
+{
+	std::uint64_t bits;
+};
+
+struct HalfQuaternion
+{
+	std::uint16_t w, i, j, k;
+};
+
+// Implementation helpers, not part of the interface
+namespace CompressionDetail{
+
+// x rounded to the nearest level in [0,levels] (NaN goes to the middle one)
+inline double roundLevel(double x, double levels)
+{
+	const double twoTo52=4503599627370496.0; // Adding 2^52 rounds away the fraction
+	const double upper= x<levels ? x : levels;
+	const double clamped= x>0.0 ? upper : 0.0;
+	return ((x==x ? clamped : 0.5*levels)+twoTo52)-twoTo52;
+}
+
+// The integer x<2^52, read from the bits of the double x+2^52
+inline std::uint64_t integerBits(double x)
+{
+	const double shifted=x+4503599627370496.0;
+	std::uint64_t bits;
+	std::memcpy(&bits,&shifted,sizeof(double));
+	return bits&0xFFFFFFFFFFFFFull;
+}
+
+// Smallest-three with ComponentBits bits per component, packed into the low
+// 3*ComponentBits+2 bits of the result
+/* Note: everything is written with selects instead of branches, so that the
+ * bulk loops that inline this vectorize. The rounding and packing are done
+ * in double, and only the packed halves are turned into integers (by their
+ * bits): SSE2 has no vector conversion from double to 64-bit integers.
+ */
+template <int ComponentBits>
+inline std::uint64_t encodeSmallestThree(double w, double i, double j, double k)
+{
+	const double levels=double((1u<<ComponentBits)-2), half=0.5*levels, shift=double(1u<<ComponentBits);
+	const double scale=half*std::sqrt(2.0); // [-1/sqrt(2),1/sqrt(2)] to [-levels/2,levels/2]
+
+	// The largest component (the first one, on ties)
+	const double aw=std::abs(w), ai=std::abs(i), aj=std::abs(j), ak=std::abs(k);
+	double largest=0.0, maximum=aw, value=w;
+	largest= ai>maximum ? 1.0 : largest; value= ai>maximum ? i : value; maximum= ai>maximum ? ai : maximum;
+	largest= aj>maximum ? 2.0 : largest; value= aj>maximum ? j : value; maximum= aj>maximum ? aj : maximum;
+	largest= ak>maximum ? 3.0 : largest; value= ak>maximum ? k : value;
+
+	// Normalize, and flip the sign so that the largest component is positive
+	const double factor=(value<0.0 ? -scale : scale)/std::sqrt(w*w+i*i+j*j+k*k);
+	const double a= largest==0.0 ? i : w;
+	const double b= largest<=1.0 ? j : i;
+	const double c= largest<=2.0 ? k : j;
+
+	// Rounding can push the scaled values past +-levels/2 by a little: they are
+	// clamped. The zero quaternion (and NaN) gives NaN here, and encodes to
+	// (almost) the identity
+	const double ua=roundLevel(a*factor+half,levels);
+	const double ub=roundLevel(b*factor+half,levels);
+	const double uc=roundLevel(c*factor+half,levels);
+	const std::uint64_t high=integerBits(largest*shift+ua), low=integerBits(ub*shift+uc);
+	return (high<<(2*ComponentBits)) | low;
+}
+
+// ComponentBits bits of the 64 bits high:low, starting at bit Offset (<32)
+template <int ComponentBits, int Offset>
+inline std::int32_t bitField(std::uint32_t low, std::uint32_t high)
+{
+	const std::uint32_t mask=(1u<<ComponentBits)-1;
+	return static_cast<std::int32_t>(((low>>Offset) | (Offset==0 ? 0u : high<<((32-Offset)%32)))&mask);
+}
+
+// The inverse of encodeSmallestThree, with the bits split into the low and
+// high 32 (every operation stays 32 bits wide, for SSE2)
+template <int ComponentBits>
+inline void decodeSmallestThree(std::uint32_t low, std::uint32_t high, double &w, double &i, double &j, double &k)
+{
+	const int B=ComponentBits;
+	const double levels=double((1u<<ComponentBits)-2), half=0.5*levels;
+	const double scale=std::sqrt(2.0)/levels;
+	const double largest=double(3*B<32 ? bitField<2,(3*B)%32>(low,high) : bitField<2,(3*B)%32>(high,0));
+	const double a=(double(2*B<32 ? bitField<B,(2*B)%32>(low,high) : bitField<B,(2*B)%32>(high,0))-half)*scale;
+	const double b=(double(bitField<B,B>(low,high))-half)*scale;
+	const double c=(double(bitField<B,0>(low,high))-half)*scale;
+	const double value=std::sqrt(std::max(1.0-a*a-b*b-c*c,0.0));
+	w= largest==0.0 ? value : a;
+	i= largest==0.0 ? a : largest==1.0 ? value : b;
+	j= largest<=1.0 ? b : largest==2.0 ? value : c;
+	k= largest<=2.0 ? c : value;
+}
+
+// Round x to the nearest half (ties to even)
+/* Note: we work on the bits of the double. For normal halves, adding
+ * 2^41-1 (plus 1 if the lowest kept bit is odd) to the bits rounds away the
+ * 42 mantissa bits a half doesn't have; a carry out of the mantissa
+ * correctly increments the exponent. Subnormal halves are multiples of
+ * 2^-24, and adding and subtracting 2^52 rounds to the nearest integer.
+ */
+inline std::uint16_t toHalf(double x)
+{
+	std::uint64_t bits;
+	std::memcpy(&bits,&x,sizeof(double));
+	const std::uint16_t sign=static_cast<std::uint16_t>((bits>>48)&0x8000);
+	const std::uint64_t magnitude=bits&0x7FFFFFFFFFFFFFFFull;
+	const double absolute=std::abs(x);
+
+	const std::uint64_t rounded=magnitude+0x1FFFFFFFFFFull+((magnitude>>42)&1);
+	const std::uint64_t normal=(rounded>>42)-(std::uint64_t(1023-15)<<10);
+	const double twoTo52=4503599627370496.0;
+	const std::uint64_t subnormal=static_cast<std::uint64_t>(static_cast<std::int32_t>((absolute*16777216.0+twoTo52)-twoTo52)); // 2^24*absolute
+	std::uint64_t half= absolute<6.103515625e-05 ? subnormal : normal; // 2^-14, the smallest normal half
+	half= absolute>=65520.0 ? 0x7C00 : half; // Rounds to infinity
+	half= x!=x ? 0x7E00 : half;              // NaN
+	return static_cast<std::uint16_t>(sign|half);
+}
+
+// Halves are exactly floats (with fewer bits), so we build the float
+inline double fromHalf(std::uint16_t half)
+{
+	const std::uint32_t sign=std::uint32_t(half&0x8000)<<16;
+	const std::uint32_t exponent=(half>>10)&0x1F, mantissa=half&0x3FF;
+	// Normal halves, infinities and NaN: the same bits, with the exponent rebiased
+	const std::uint32_t bits=sign | ((exponent==0x1F ? 0xFF : exponent+127-15)<<23) | (mantissa<<13);
+	float normal;
+	std::memcpy(&normal,&bits,sizeof(float));
+	// Subnormal halves are multiples of 2^-24
+	const float subnormal=(sign ? -5.9604644775390625e-08f : 5.9604644775390625e-08f)*float(static_cast<std::int32_t>(mantissa));
+	return double(exponent==0 ? subnormal : normal);
+}
+
+} // End namespace CompressionDetail
+
+// === Single quaternions ===
+inline SmallestThree32 encode32(const Quaternion &q)
+{
+	return SmallestThree32{static_cast<std::uint32_t>(CompressionDetail::encodeSmallestThree<10>(q.w(),q.i(),q.j(),q.k()))};
+}
+
+inline SmallestThree48 encode48(const Quaternion &q)
+{
+	const std::uint64_t bits=CompressionDetail::encodeSmallestThree<15>(q.w(),q.i(),q.j(),q.k());
+	return SmallestThree48{{static_cast<std::uint16_t>(bits),static_cast<std::uint16_t>(bits>>16),static_cast<std::uint16_t>(bits>>32)}};
+}
+
+inline SmallestThree64 encode64(const Quaternion &q)
+{
+	return SmallestThree64{CompressionDetail::encodeSmallestThree<20>(q.w(),q.i(),q.j(),q.k())};
+}
+
+inline HalfQuaternion encodeHalf(const Quaternion &q)
+{
+	using CompressionDetail::toHalf;
+	return HalfQuaternion{toHalf(q.w()),toHalf(q.i()),toHalf(q.j()),toHalf(q.k())};
+}
+
+inline Quaternion decode(const SmallestThree32 &packed)
+{
+	double w, i, j, k;
+	CompressionDetail::decodeSmallestThree<10>(packed.bits,0,w,i,j,k);
+	return Quaternion(w,i,j,k);
+}
+
+inline Quaternion decode(const SmallestThree48 &packed)
+{
+	double w, i, j, k;
+	CompressionDetail::decodeSmallestThree<15>(packed.bits[0] | (std::uint32_t(packed.bits[1])<<16),packed.bits[2],w,i,j,k);
+	return Quaternion(w,i,j,k);
+}
+
+inline Quaternion decode(const SmallestThree64 &packed)
+{
+	double w, i, j, k;
+	CompressionDetail::decodeSmallestThree<20>(static_cast<std::uint32_t>(packed.bits),static_cast<std::uint32_t>(packed.bits>>32),w,i,j,k);
+	return Quaternion(w,i,j,k);
+}
+
+inline Quaternion decode(const HalfQuaternion &packed)
+{
+	using CompressionDetail::fromHalf;
+	return Quaternion(fromHalf(packed.w),fromHalf(packed.i),fromHalf(packed.j),fromHalf(packed.k));
+}
+
+// === Arrays ===
+// out must hold n encoded (decoded) values
+void encode(const Quaternion *q, std::size_t n, SmallestThree32 *out);
+void encode(const Quaternion *q, std::size_t n, SmallestThree48 *out);
+void encode(const Quaternion *q, std::size_t n, SmallestThree64 *out);
+void encode(const Quaternion *q, std::size_t n, HalfQuaternion *out);
+
+void decode(const SmallestThree32 *packed, std::size_t n, Quaternion *out);
+void decode(const SmallestThree48 *packed, std::size_t n, Quaternion *out);
+void decode(const SmallestThree64 *packed, std::size_t n, Quaternion *out);
+void decode(const HalfQuaternion *packed, std::size_t n, Quaternion *out);
+
+// Versions for whole vectors, e.g. encode<SmallestThree32>(rotations)
+template <typename Format>
+inline std::vector<Format> encode(const std::vector<Quaternion> &q)
+{
+	std::vector<Format> packed(q.size());
+	encode(q.data(),q.size(),packed.data());
+	return packed;
+}
+
+template <typename Format>
+inline std::vector<Quaternion> decode(const std::vector<Format> &packed)
+{
+	std::vector<Quaternion> q(packed.size());
+	decode(packed.data(),packed.size(),q.data());
+	return q;
+}
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,168 @@
+/* File Conversion.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the batch rotation conversions
+ * \author Nikos Kazazakis
+ */
+
+#include "Conversion.h"
+
+using namespace Quaternions;
+
+// === Matrix batch container ===
+template <typename T>
+BasicMatrix3<T> BasicMatrix3Batch<T>::get(std::size_t n) const
+{
+	BasicMatrix3<T> matrix;
+	for (int row=0;row<3;++row){
+		for (int column=0;column<3;++column){
+			matrix.m[row][column]=elements_[3*row+column][n];
+		}
+	}
+	return matrix;
+}
+
+template <typename T>
+void BasicMatrix3Batch<T>::set(std::size_t n, const BasicMatrix3<T> &matrix)
+{
+	for (int row=0;row<3;++row){
+		for (int column=0;column<3;++column){
+			elements_[3*row+column][n]=matrix.m[row][column];
+		}
+	}
+}
+
+/* Note: as in Interpolation.cpp, every kernel gathers element n into a small
+ * struct, calls the inline scalar conversion and scatters the result. After
+ * inlining the structs only live in registers, and the batch and scalar
+ * versions are guaranteed to give the same results. The loops are split
+ * across the OpenMP threads and vectorized within each thread.
+ */
+
+// == Quaternions -> matrices
+template <typename T>
+void Quaternions::toMatrix(const BasicQuaternionBatch<T> &q, BasicMatrix3Batch<T> &out)
+{
+	const long size=static_cast<long>(q.size());
+	out.resize(q.size());
+
+	const T *qw=q.w(), *qx=q.i(), *qy=q.j(), *qz=q.k();
+	T *m00=out.element(0,0), *m01=out.element(0,1), *m02=out.element(0,2);
+	T *m10=out.element(1,0), *m11=out.element(1,1), *m12=out.element(1,2);
+	T *m20=out.element(2,0), *m21=out.element(2,1), *m22=out.element(2,2);
+
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		const BasicMatrix3<T> M=toMatrix(BasicQuaternion<T>(qw[n],qx[n],qy[n],qz[n]));
+		m00[n]=M.m[0][0]; m01[n]=M.m[0][1]; m02[n]=M.m[0][2];
+		m10[n]=M.m[1][0]; m11[n]=M.m[1][1]; m12[n]=M.m[1][2];
+		m20[n]=M.m[2][0]; m21[n]=M.m[2][1]; m22[n]=M.m[2][2];
+	}
+}
+
+// == Matrices -> quaternions
+template <typename T>
+void Quaternions::fromMatrix(const BasicMatrix3Batch<T> &M, BasicQuaternionBatch<T> &out)
+{
+	const long size=static_cast<long>(M.size());
+	out.resize(M.size());
+
+	const T *m00=M.element(0,0), *m01=M.element(0,1), *m02=M.element(0,2);
+	const T *m10=M.element(1,0), *m11=M.element(1,1), *m12=M.element(1,2);
+	const T *m20=M.element(2,0), *m21=M.element(2,1), *m22=M.element(2,2);
+	T *qw=out.w(), *qx=out.i(), *qy=out.j(), *qz=out.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		const BasicMatrix3<T> matrix={{{m00[n],m01[n],m02[n]},{m10[n],m11[n],m12[n]},{m20[n],m21[n],m22[n]}}};
+		const BasicQuaternion<T> q=fromMatrix(matrix);
+		qw[n]=q.w();
+		qx[n]=q.i();
+		qy[n]=q.j();
+		qz[n]=q.k();
+	}
+}
+
+// == Axis-angle -> quaternions
+template <typename T>
+void Quaternions::fromAxisAngle(const T *x, const T *y, const T *z, const T *angle, std::size_t n, BasicQuaternionBatch<T> &out)
+{
+	const long size=static_cast<long>(n);
+	out.resize(n);
+	T *qw=out.w(), *qx=out.i(), *qy=out.j(), *qz=out.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long m=0;m<size;++m){
+		const BasicQuaternion<T> q=fromAxisAngle(x[m],y[m],z[m],angle[m]);
+		qw[m]=q.w();
+		qx[m]=q.i();
+		qy[m]=q.j();
+		qz[m]=q.k();
+	}
+}
+
+// == Quaternions -> axis-angle
+template <typename T>
+void Quaternions::toAxisAngle(const BasicQuaternionBatch<T> &q, T *x, T *y, T *z, T *angle)
+{
+	const long size=static_cast<long>(q.size());
+	const T *qw=q.w(), *qx=q.i(), *qy=q.j(), *qz=q.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		const BasicAxisAngle<T> rotation=toAxisAngle(BasicQuaternion<T>(qw[n],qx[n],qy[n],qz[n]));
+		x[n]=rotation.x;
+		y[n]=rotation.y;
+		z[n]=rotation.z;
+		angle[n]=rotation.angle;
+	}
+}
+
+// == Euler angles -> quaternions
+template <typename T>
+void Quaternions::fromEuler(const T *a1, const T *a2, const T *a3, std::size_t n, EulerOrder order, BasicQuaternionBatch<T> &out)
+{
+	const long size=static_cast<long>(n);
+	out.resize(n);
+	T *qw=out.w(), *qx=out.i(), *qy=out.j(), *qz=out.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long m=0;m<size;++m){
+		const BasicQuaternion<T> q=fromEuler(a1[m],a2[m],a3[m],order);
+		qw[m]=q.w();
+		qx[m]=q.i();
+		qy[m]=q.j();
+		qz[m]=q.k();
+	}
+}
+
+// == Quaternions -> Euler angles
+template <typename T>
+void Quaternions::toEuler(const BasicQuaternionBatch<T> &q, EulerOrder order, T *a1, T *a2, T *a3)
+{
+	const long size=static_cast<long>(q.size());
+	const T *qw=q.w(), *qx=q.i(), *qy=q.j(), *qz=q.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		const BasicEulerAngles<T> angles=toEuler(BasicQuaternion<T>(qw[n],qx[n],qy[n],qz[n]),order);
+		a1[n]=angles.a1;
+		a2[n]=angles.a2;
+		a3[n]=angles.a3;
+	}
+}
+
+// Explicit instantiations: compile the container and the kernels for float and double
+#define QUATERNION_INSTANTIATE_CONVERSION(T) \
+	template class Quaternions::BasicMatrix3Batch<T>; \
+	template void Quaternions::toMatrix(const BasicQuaternionBatch<T> &, BasicMatrix3Batch<T> &); \
+	template void Quaternions::fromMatrix(const BasicMatrix3Batch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::fromAxisAngle(const T *, const T *, const T *, const T *, std::size_t, BasicQuaternionBatch<T> &); \
+	template void Quaternions::toAxisAngle(const BasicQuaternionBatch<T> &, T *, T *, T *, T *); \
+	template void Quaternions::fromEuler(const T *, const T *, const T *, std::size_t, EulerOrder, BasicQuaternionBatch<T> &); \
+	template void Quaternions::toEuler(const BasicQuaternionBatch<T> &, EulerOrder, T *, T *, T *);
+
+QUATERNION_INSTANTIATE_CONVERSION(float)
+QUATERNION_INSTANTIATE_CONVERSION(double)
+
+// End of file
@@ -0,0 +1,349 @@
+/* File Conversion.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Conversions between quaternions, rotation matrices, axis-angle and Euler angles
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_CONVERSION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_CONVERSION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+#include "AlignedAllocator.h"
+
+// Include STL headers
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+/* Note: conventions used throughout this file
+ *  - Rotations are active (they move the points, not the coordinate frame),
+ *    right-handed, and vectors are columns: p'=M*p.
+ *  - Quaternions to be converted should be unit quaternions. toMatrix() and
+ *    toAxisAngle() also accept non-unit ones (they convert q/|q|).
+ *  - Every conversion has a scalar version (inline, in this header) and a
+ *    batch version that converts whole structure-of-arrays at once (compiled
+ *    for float and double in Conversion.cpp). The batch versions evaluate the
+ *    same expressions, so they give bit-for-bit the same results.
+ *    The matrix conversions are pure arithmetic and vectorize. The others call
+ *    sin, cos and atan2, which the compiler only vectorizes if a vector math
+ *    library is available (e.g. glibc's libmvec, which GCC only uses with -ffast-math).
+ */
+
+namespace Quaternions{
+
+// === Rotation matrices ===
+
+// A 3x3 matrix, stored row by row. Trivially copyable
+template <typename T>
+struct BasicMatrix3
+{
+	T m[3][3];
+
+	T &operator()(int row, int column) {return m[row][column];}
+	const T &operator()(int row, int column) const {return m[row][column];}
+};
+
+typedef BasicMatrix3<float> Matrix3F;
+typedef BasicMatrix3<double> Matrix3;
+
+/**
+ * BasicMatrix3Batch stores many 3x3 matrices as a structure of arrays, one
+ * aligned array per element, for the same reasons as QuaternionBatch.
+ */
+template <typename T>
+class BasicMatrix3Batch
+{
+public :
+	BasicMatrix3Batch() {}
+	explicit BasicMatrix3Batch(std::size_t n) {resize(n);}
+
+	std::size_t size() const {return elements_[0].size();}
+	void resize(std::size_t n) {for (auto &element : elements_) element.resize(n,T(0));}
+
+	// Gather/scatter a single matrix
+	BasicMatrix3<T> get(std::size_t n) const;
+	void set(std::size_t n, const BasicMatrix3<T> &matrix);
+
+	// Raw access to the array of element (row, column)
+	T *element(int row, int column) {return elements_[3*row+column].data();}
+	const T *element(int row, int column) const {return elements_[3*row+column].data();}
+
+private:
+	AlignedVector<T> elements_[9];
+
+}; // End of BasicMatrix3Batch class
+
+typedef BasicMatrix3Batch<float> Matrix3BatchF;
+typedef BasicMatrix3Batch<double> Matrix3Batch;
+
+// Rotation matrix of the quaternion q
+/* Note: s=2/|q|^2 instead of 2 makes this correct for non-unit quaternions
+ * too, for the price of one division per quaternion.
+ * Why convert at all? Rotating a point with the matrix is 9 multiplications
+ * and 6 additions, against 15 and 15 for rotate(q,p) (Rotation.h) and 56
+ * flops for q*p*q.conjugate(). When many points are rotated by the same
+ * quaternion, convert it once and use rotate(matrix,points).
+ */
+template <typename T>
+inline BasicMatrix3<T> toMatrix(const BasicQuaternion<T> &q)
+{
+	const T s=T(2)/dot(q,q);
+	const T w=q.w(), x=q.i(), y=q.j(), z=q.k();
+	const T xx=s*x*x, yy=s*y*y, zz=s*z*z;
+	const T xy=s*x*y, xz=s*x*z, yz=s*y*z;
+	const T wx=s*w*x, wy=s*w*y, wz=s*w*z;
+	return BasicMatrix3<T>{{
+		{T(1)-(yy+zz), xy-wz,        xz+wy},
+		{xy+wz,        T(1)-(xx+zz), yz-wx},
+		{xz-wy,        yz+wx,        T(1)-(xx+yy)} }};
+}
+
+// Unit quaternion of the rotation matrix M, by Shepperd's method
+/* Note: every component of q can be found from the diagonal, e.g.
+ * 4w^2=1+trace and 4x^2=1+m00-m11-m22, or from the off-diagonal elements once
+ * one component is known, e.g. x=(m21-m12)/(4w). The naive method always
+ * starts from w, which loses all accuracy for rotations near 180 degrees
+ * (w->0, and we divide by it). Shepperd starts from the LARGEST of the four,
+ * which is always at least 1/2, so the divisions are always well conditioned.
+ * We pick the case with selects rather than branches, so that the batch
+ * version vectorizes. The sign of q is such that the largest component is
+ * positive (q and -q are the same rotation).
+ * M should be a rotation matrix (orthonormal, determinant 1). For nearly
+ * orthonormal matrices (e.g. accumulated in single precision) the result is
+ * close to the nearest rotation, but it isn't normalized again.
+ */
+template <typename T>
+inline BasicQuaternion<T> fromMatrix(const BasicMatrix3<T> &M)
+{
+	const T m00=M.m[0][0], m11=M.m[1][1], m22=M.m[2][2];
+	// 4 times the squares of w, x, y and z
+	const T tw=T(1)+m00+m11+m22;
+	const T tx=T(1)+m00-m11-m22;
+	const T ty=T(1)-m00+m11-m22;
+	const T tz=T(1)-m00-m11+m22;
+	// The off-diagonal combinations: 4wx, 4wy, 4wz, 4xy, 4xz, 4yz
+	const T wx=M.m[2][1]-M.m[1][2], wy=M.m[0][2]-M.m[2][0], wz=M.m[1][0]-M.m[0][1];
+	const T xy=M.m[0][1]+M.m[1][0], xz=M.m[0][2]+M.m[2][0], yz=M.m[1][2]+M.m[2][1];
+
+	// Pick the largest of the four
+	const bool caseW= tw>=tx && tw>=ty && tw>=tz;
+	const bool caseX= !caseW && tx>=ty && tx>=tz;
+	const bool caseY= !caseW && !caseX && ty>=tz;
+	const T t= caseW ? tw : caseX ? tx : caseY ? ty : tz;
+	const T r=std::sqrt(t);   // 2 times the largest component
+	const T s=T(0.5)/r;       // 1/(4 times the largest component)
+	const T h=T(0.5)*r;       // The largest component
+	return BasicQuaternion<T>(
+		caseW ? h    : caseX ? wx*s : caseY ? wy*s : wz*s,
+		caseW ? wx*s : caseX ? h    : caseY ? xy*s : xz*s,
+		caseW ? wy*s : caseX ? xy*s : caseY ? h    : yz*s,
+		caseW ? wz*s : caseX ? xz*s : caseY ? yz*s : h);
+}
+
+// Batch versions. The output is resized to match the input
+template <typename T>
+void toMatrix(const BasicQuaternionBatch<T> &q, BasicMatrix3Batch<T> &out);
+
+template <typename T>
+void fromMatrix(const BasicMatrix3Batch<T> &M, BasicQuaternionBatch<T> &out);
+
+// === Axis-angle ===
+
+// A rotation by angle (radians) around the axis (x,y,z)
+template <typename T>
+struct BasicAxisAngle
+{
+	T x;
+	T y;
+	T z;
+	T angle;
+};
+
+typedef BasicAxisAngle<float> AxisAngleF;
+typedef BasicAxisAngle<double> AxisAngle;
+
+// Unit quaternion of the rotation by angle around (x,y,z)
+/* Note: the axis doesn't have to be normalized, but must not be zero. It is
+ * divided by its largest component first, so that the squares can't overflow
+ * or underflow (which matters most for floats, whose squares overflow from
+ * about 1e19)
+ */
+template <typename T>
+inline BasicQuaternion<T> fromAxisAngle(T x, T y, T z, T angle)
+{
+	const T largest=std::max(std::abs(x),std::max(std::abs(y),std::abs(z)));
+	x/=largest;
+	y/=largest;
+	z/=largest;
+	const T s=std::sin(T(0.5)*angle)/std::sqrt(x*x+y*y+z*z);
+	return BasicQuaternion<T>(std::cos(T(0.5)*angle),s*x,s*y,s*z);
+}
+
+template <typename T>
+inline BasicQuaternion<T> fromAxisAngle(const BasicAxisAngle<T> &rotation)
+{
+	return fromAxisAngle(rotation.x,rotation.y,rotation.z,rotation.angle);
+}
+
+// Unit axis and angle of the rotation q, with the angle in [0,pi]
+/* Note: the angle is 2*atan2(|v|,w), which is accurate for all angles (the
+ * textbook 2*acos(w) loses half of the digits for small angles). q and -q
+ * give the same result. The identity has no axis; we return (1,0,0)
+ */
+template <typename T>
+inline BasicAxisAngle<T> toAxisAngle(const BasicQuaternion<T> &q)
+{
+	const T sign= q.w()<T(0) ? T(-1) : T(1); // Take the shorter way round
+	const T length=std::sqrt(q.i()*q.i()+q.j()*q.j()+q.k()*q.k());
+	const T angle=T(2)*std::atan2(length,sign*q.w());
+	const T scale= length>T(0) ? sign/length : T(0);
+	return BasicAxisAngle<T>{length>T(0) ? scale*q.i() : T(1),scale*q.j(),scale*q.k(),angle};
+}
+
+// Batch versions: element n of the arrays is one axis-angle. The quaternion
+// output is resized to match; the arrays must hold n (q.size()) values
+template <typename T>
+void fromAxisAngle(const T *x, const T *y, const T *z, const T *angle, std::size_t n, BasicQuaternionBatch<T> &out);
+
+template <typename T>
+void toAxisAngle(const BasicQuaternionBatch<T> &q, T *x, T *y, T *z, T *angle);
+
+// === Euler angles ===
+
+// The axis sequences. XYZ means a rotation about x, then about the NEW y,
+// then about the newest z (intrinsic rotations), i.e. q=qx(a1)*qy(a2)*qz(a3).
+// This is the same rotation as the extrinsic sequence z, y, x (about the fixed
+// axes) with the angles in reverse order.
+/* Note: the first six are the Tait-Bryan sequences (e.g. ZYX is the
+ * yaw-pitch-roll of aerospace), the last six are the proper Euler sequences
+ */
+typedef enum{
+	XYZ, XZY, YXZ, YZX, ZXY, ZYX,
+	XYX, XZX, YXY, YZY, ZXZ, ZYZ
+}EulerOrder;
+
+// Three angles (radians), in the order of the rotations
+template <typename T>
+struct BasicEulerAngles
+{
+	T a1;
+	T a2;
+	T a3;
+};
+
+typedef BasicEulerAngles<float> EulerAnglesF;
+typedef BasicEulerAngles<double> EulerAngles;
+
+namespace ConversionDetail{
+
+// The three axes (0=x, 1=y, 2=z) of an Euler sequence
+inline void eulerAxes(EulerOrder order, int &first, int &second, int &third)
+{
+	static const int axes[12][3]={
+		{0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0},
+		{0,1,0}, {0,2,0}, {1,0,1}, {1,2,1}, {2,0,2}, {2,1,2} };
+	first=axes[order][0];
+	second=axes[order][1];
+	third=axes[order][2];
+}
+
+// Rotation by angle about coordinate axis 0, 1 or 2
+template <typename T>
+inline BasicQuaternion<T> axisRotation(int axis, T angle)
+{
+	BasicQuaternion<T> q(std::cos(T(0.5)*angle),T(0),T(0),T(0));
+	q[static_cast<AxisType>(qi+axis)]=std::sin(T(0.5)*angle);
+	return q;
+}
+
+} // End namespace ConversionDetail
+
+// Unit quaternion of the Euler angles
+template <typename T>
+inline BasicQuaternion<T> fromEuler(T a1, T a2, T a3, EulerOrder order)
+{
+	int first, second, third;
+	ConversionDetail::eulerAxes(order,first,second,third);
+	return ConversionDetail::axisRotation(first,a1)*ConversionDetail::axisRotation(second,a2)*ConversionDetail::axisRotation(third,a3);
+}
+
+template <typename T>
+inline BasicQuaternion<T> fromEuler(const BasicEulerAngles<T> &angles, EulerOrder order)
+{
+	return fromEuler(angles.a1,angles.a2,angles.a3,order);
+}
+
+// Euler angles of the rotation q
+/* Note: a1 and a3 are in [-pi,pi]; a2 is in [-pi/2,pi/2] for the Tait-Bryan
+ * sequences and in [0,pi] for the proper Euler ones.
+ * We use the direct method of Bernardes and Viollet ("Quaternion to Euler
+ * angles conversion: a direct, general and computationally efficient method",
+ * PLoS ONE, 2022), which works on the quaternion itself for all twelve
+ * sequences, instead of building the rotation matrix and taking asin of one
+ * element (which loses accuracy near the gimbal lock, where asin is flat).
+ * Gimbal lock: when a2 is at the end of its range (e.g. pitch=+-90 degrees)
+ * only a1+a3 (or a1-a3) is defined. We then return a3=0 and put the whole
+ * rotation in a1.
+ */
+template <typename T>
+inline BasicEulerAngles<T> toEuler(const BasicQuaternion<T> &q, EulerOrder order)
+{
+	// The method is written for extrinsic sequences: intrinsic (i,j,k) is extrinsic (k,j,i) with the angles reversed
+	int k, j, i;
+	ConversionDetail::eulerAxes(order,k,j,i);
+	const bool proper= i==k;
+	if (proper){
+		k=3-i-j; // The axis that isn't used
+	}
+	const T sign=T((i-j)*(j-k)*(k-i)/2); // +1 for an even permutation of (x,y,z), -1 for an odd one
+	const T v[3]={q.i(),q.j(),q.k()};
+	const T a= proper ? q.w() : q.w()-v[j];
+	const T b= proper ? v[i] : v[i]+sign*v[k];
+	const T c= proper ? v[j] : v[j]+q.w();
+	const T d= proper ? sign*v[k] : sign*v[k]-v[i];
+
+	T angle2=T(2)*std::atan2(std::sqrt(c*c+d*d),std::sqrt(a*a+b*b));
+	const T halfSum=std::atan2(b,a);
+	const T halfDifference=std::atan2(d,c);
+	const T kPi=T(3.14159265358979323846264338327950288L);
+	// Gimbal lock, within the accuracy of the angle
+	const T tolerance=T(16)*std::numeric_limits<T>::epsilon();
+	T angle1, angle3;
+	if (std::abs(angle2)<=tolerance){
+		angle1=T(0);
+		angle3=T(2)*halfSum;
+	}
+	else if (std::abs(angle2-kPi)<=tolerance){
+		angle1=T(0);
+		angle3=T(2)*halfDifference;
+	}
+	else{
+		angle1=halfSum-halfDifference;
+		angle3=halfSum+halfDifference;
+	}
+	if (!proper){
+		angle3*=sign;
+		angle2-=T(0.5)*kPi;
+	}
+
+	// Wrap into [-pi,pi]
+	angle1= angle1>kPi ? angle1-T(2)*kPi : angle1<-kPi ? angle1+T(2)*kPi : angle1;
+	angle3= angle3>kPi ? angle3-T(2)*kPi : angle3<-kPi ? angle3+T(2)*kPi : angle3;
+	return BasicEulerAngles<T>{angle3,angle2,angle1};
+}
+
+// Batch versions: element n of the arrays is one set of angles. The quaternion
+// output is resized to match; the arrays must hold n (q.size()) values
+template <typename T>
+void fromEuler(const T *a1, const T *a2, const T *a3, std::size_t n, EulerOrder order, BasicQuaternionBatch<T> &out);
+
+template <typename T>
+void toEuler(const BasicQuaternionBatch<T> &q, EulerOrder order, T *a1, T *a2, T *a3);
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,389 @@
+/* File Dispatch.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief The per-instruction-set kernel variants and the selection between them
+ * \author Nikos Kazazakis
+ */
+
+#include "Dispatch.h"
+#include "UnitQuaternion.h"
+
+// Other includes
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+
+using namespace Quaternions;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QUATERNION_DISPATCH_X86
+#endif
+
+/* Note: this file is compiled with -ffp-contract=off (see CMakeLists.txt).
+ * The AVX-512 variant may use fused multiply-adds, which round once instead
+ * of twice; the compiler would then turn a*b+c into an FMA in that variant
+ * only, and its results would differ from the others in the last bit.
+ *
+ * How the variants are built: each kernel is written once, as an inlined
+ * loop over [first,last). The loop uses "#pragma omp simd if(simd: Simd)",
+ * so with Simd=false the compiler must keep it scalar (the reference path),
+ * and with Simd=true it vectorizes it. The variants below are thin functions
+ * with a target attribute, e.g. __attribute__((target("avx2"))), into which
+ * the loop is inlined and compiled with the vector width of that target.
+ * The parallel rotations open their OpenMP parallel region in the variant
+ * itself: the compiler outlines the region into a separate function, which
+ * only inherits the target of the function the region is written in.
+ */
+
+#define QUATERNION_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace{
+
+// == Hamilton product
+template <bool Simd, typename T>
+QUATERNION_ALWAYS_INLINE void multiplyLoop(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out)
+{
+	const std::size_t size=q1.size();
+	const T *aw=q1.w(), *ai=q1.i(), *aj=q1.j(), *ak=q1.k();
+	const T *bw=q2.w(), *bi=q2.i(), *bj=q2.j(), *bk=q2.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd if(simd: Simd)
+	for (std::size_t n=0;n<size;++n){
+		// Load everything first, in case out aliases one of the inputs
+		const T w1=aw[n], i1=ai[n], j1=aj[n], k1=ak[n];
+		const T w2=bw[n], i2=bi[n], j2=bj[n], k2=bk[n];
+		// Same expressions (and evaluation order) as the scalar operator*
+		ow[n]=w1*w2-i1*i2-j1*j2-k1*k2;
+		oi[n]=w1*i2+i1*w2+j1*k2-k1*j2;
+		oj[n]=w1*j2-i1*k2+j1*w2+k1*i2;
+		ok[n]=w1*k2+i1*j2-j1*i2+k1*w2;
+	}
+}
+
+// == Norm
+template <bool Simd, typename T>
+QUATERNION_ALWAYS_INLINE void normLoop(const BasicQuaternionBatch<T> &q, T *out)
+{
+	const std::size_t size=q.size();
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+
+	// Note: with -fno-math-errno the sqrt becomes a single vector instruction (vsqrtpd)
+	#pragma omp simd if(simd: Simd)
+	for (std::size_t n=0;n<size;++n){
+		out[n]=std::sqrt(aw[n]*aw[n]+ai[n]*ai[n]+aj[n]*aj[n]+ak[n]*ak[n]);
+	}
+}
+
+// == Normalization
+template <bool Simd, typename T>
+QUATERNION_ALWAYS_INLINE void normalizeLoop(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out)
+{
+	const std::size_t size=q.size();
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd if(simd: Simd)
+	for (std::size_t n=0;n<size;++n){
+		const T w=aw[n], i=ai[n], j=aj[n], k=ak[n];
+		// One division and four multiplications, exactly as (1/q.norm())*q
+		const T inverseNorm=T(1)/std::sqrt(w*w+i*i+j*j+k*k);
+		ow[n]=inverseNorm*w;
+		oi[n]=inverseNorm*i;
+		oj[n]=inverseNorm*j;
+		ok[n]=inverseNorm*k;
+	}
+}
+
+template <bool Simd, typename T>
+QUATERNION_ALWAYS_INLINE void fastNormalizeLoop(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out)
+{
+	const std::size_t size=q.size();
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd if(simd: Simd)
+	for (std::size_t n=0;n<size;++n){
+		const T w=aw[n], i=ai[n], j=aj[n], k=ak[n];
+		// The same operations as the scalar fastNormalize
+		const T inverseNorm=fastInverseSqrt(w*w+i*i+j*j+k*k);
+		ow[n]=inverseNorm*w;
+		oi[n]=inverseNorm*i;
+		oj[n]=inverseNorm*j;
+		ok[n]=inverseNorm*k;
+	}
+}
+
+// == Rotations
+/* Note: as in Rotation.h, the same expressions as the single point rotate */
+template <bool Simd>
+QUATERNION_ALWAYS_INLINE void rotateLoop(const Quaternion &q, const PointCloud &in, PointCloud &out, long first, long last)
+{
+	const double w=q.w(), x=q.i(), y=q.j(), z=q.k();
+	const double *px=in.x(), *py=in.y(), *pz=in.z();
+	double *ox=out.x(), *oy=out.y(), *oz=out.z();
+
+	#pragma omp simd if(simd: Simd)
+	for (long n=first;n<last;++n){
+		const double vx=px[n], vy=py[n], vz=pz[n];
+		const double tx=2.0*(y*vz-z*vy);
+		const double ty=2.0*(z*vx-x*vz);
+		const double tz=2.0*(x*vy-y*vx);
+		ox[n]=vx+w*tx+(y*tz-z*ty);
+		oy[n]=vy+w*ty+(z*tx-x*tz);
+		oz[n]=vz+w*tz+(x*ty-y*tx);
+	}
+}
+
+template <bool Simd>
+QUATERNION_ALWAYS_INLINE void rotateByMatrixLoop(const Matrix3 &M, const PointCloud &in, PointCloud &out, long first, long last)
+{
+	// Copy the matrix to locals, so that it stays in registers
+	const double m00=M.m[0][0], m01=M.m[0][1], m02=M.m[0][2];
+	const double m10=M.m[1][0], m11=M.m[1][1], m12=M.m[1][2];
+	const double m20=M.m[2][0], m21=M.m[2][1], m22=M.m[2][2];
+	const double *px=in.x(), *py=in.y(), *pz=in.z();
+	double *ox=out.x(), *oy=out.y(), *oz=out.z();
+
+	#pragma omp simd if(simd: Simd)
+	for (long n=first;n<last;++n){
+		const double vx=px[n], vy=py[n], vz=pz[n];
+		ox[n]=m00*vx+m01*vy+m02*vz;
+		oy[n]=m10*vx+m11*vy+m12*vz;
+		oz[n]=m20*vx+m21*vy+m22*vz;
+	}
+}
+
+template <bool Simd>
+QUATERNION_ALWAYS_INLINE void rotateBatchLoop(const QuaternionBatch &q, const PointCloud &in, PointCloud &out, long first, long last)
+{
+	const double *qw=q.w(), *qx=q.i(), *qy=q.j(), *qz=q.k();
+	const double *px=in.x(), *py=in.y(), *pz=in.z();
+	double *ox=out.x(), *oy=out.y(), *oz=out.z();
+
+	#pragma omp simd if(simd: Simd)
+	for (long n=first;n<last;++n){
+		const double w=qw[n], x=qx[n], y=qy[n], z=qz[n];
+		const double vx=px[n], vy=py[n], vz=pz[n];
+		const double tx=2.0*(y*vz-z*vy);
+		const double ty=2.0*(z*vx-x*vz);
+		const double tz=2.0*(x*vy-y*vx);
+		ox[n]=vx+w*tx+(y*tz-z*ty);
+		oy[n]=vy+w*ty+(z*tx-x*tz);
+		oz[n]=vz+w*tz+(x*ty-y*tx);
+	}
+}
+
+// First point of the calling thread's contiguous chunk, as schedule(static) would split them
+QUATERNION_ALWAYS_INLINE long chunkStart(long size, long chunk)
+{
+	return static_cast<long>(static_cast<long long>(size)*chunk/omp_get_num_threads());
+}
+
+} // End anonymous namespace
+
+// Define the kernels of one variant in namespace NAME, compiled with the
+// function attributes TARGET. SIMD is false for the scalar reference path
+#define QUATERNION_DISPATCH_VARIANT(NAME, TARGET, SIMD) \
+namespace NAME{ \
+	template <typename T> TARGET \
+	void multiply(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out) \
+	{ multiplyLoop<SIMD>(q1,q2,out); } \
+	template <typename T> TARGET \
+	void norm(const BasicQuaternionBatch<T> &q, T *out) \
+	{ normLoop<SIMD>(q,out); } \
+	template <typename T> TARGET \
+	void normalize(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out) \
+	{ normalizeLoop<SIMD>(q,out); } \
+	template <typename T> TARGET \
+	void fastNormalize(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out) \
+	{ fastNormalizeLoop<SIMD>(q,out); } \
+	TARGET void rotate(const Quaternion &q, const PointCloud &in, PointCloud &out) \
+	{ \
+		const long size=static_cast<long>(in.size()); \
+		_Pragma("omp parallel") \
+		{ \
+			const long thread=omp_get_thread_num(); \
+			rotateLoop<SIMD>(q,in,out,chunkStart(size,thread),chunkStart(size,thread+1)); \
+		} \
+	} \
+	TARGET void rotateByMatrix(const Matrix3 &M, const PointCloud &in, PointCloud &out) \
+	{ \
+		const long size=static_cast<long>(in.size()); \
+		_Pragma("omp parallel") \
+		{ \
+			const long thread=omp_get_thread_num(); \
+			rotateByMatrixLoop<SIMD>(M,in,out,chunkStart(size,thread),chunkStart(size,thread+1)); \
+		} \
+	} \
+	TARGET void rotateBatch(const QuaternionBatch &q, const PointCloud &in, PointCloud &out) \
+	{ \
+		const long size=static_cast<long>(in.size()); \
+		_Pragma("omp parallel") \
+		{ \
+			const long thread=omp_get_thread_num(); \
+			rotateBatchLoop<SIMD>(q,in,out,chunkStart(size,thread),chunkStart(size,thread+1)); \
+		} \
+	} \
+}
+
+// The scalar reference and the baseline vector variant use the flags the
+// library is compiled with (SSE2 on x86-64, or whatever -march asks for)
+QUATERNION_DISPATCH_VARIANT(ScalarVariant, , false)
+QUATERNION_DISPATCH_VARIANT(SSE2Variant, , true)
+#ifdef QUATERNION_DISPATCH_X86
+QUATERNION_DISPATCH_VARIANT(AVX2Variant, __attribute__((target("avx2"))), true)
+QUATERNION_DISPATCH_VARIANT(AVX512Variant, __attribute__((target("avx512f"))), true)
+#else
+// Never selected (instructionSetSupported is false), but keeps the tables complete
+namespace AVX2Variant=SSE2Variant;
+namespace AVX512Variant=SSE2Variant;
+#endif
+
+// The kernel tables, indexed by InstructionSet
+#define QUATERNION_BATCH_KERNELS(NAME, T) {NAME::multiply<T>,NAME::norm<T>,NAME::normalize<T>,NAME::fastNormalize<T>}
+#define QUATERNION_ROTATION_KERNELS(NAME) {NAME::rotate,NAME::rotateByMatrix,NAME::rotateBatch}
+
+namespace{
+
+template <typename T>
+const DispatchDetail::BatchKernels<T> *batchKernelTable()
+{
+	static const DispatchDetail::BatchKernels<T> table[isaCount]={
+		QUATERNION_BATCH_KERNELS(ScalarVariant,T),
+		QUATERNION_BATCH_KERNELS(SSE2Variant,T),
+		QUATERNION_BATCH_KERNELS(AVX2Variant,T),
+		QUATERNION_BATCH_KERNELS(AVX512Variant,T)
+	};
+	return table;
+}
+
+const DispatchDetail::RotationKernels kRotationKernels[isaCount]={
+	QUATERNION_ROTATION_KERNELS(ScalarVariant),
+	QUATERNION_ROTATION_KERNELS(SSE2Variant),
+	QUATERNION_ROTATION_KERNELS(AVX2Variant),
+	QUATERNION_ROTATION_KERNELS(AVX512Variant)
+};
+
+const char *const kInstructionSetNames[isaCount]={"scalar","sse2","avx2","avx512"};
+
+// The best instruction set this CPU supports
+InstructionSet bestInstructionSet()
+{
+	for (int isa=isaCount-1;isa>isaScalar;--isa){
+		if (instructionSetSupported(InstructionSet(isa))){
+			return InstructionSet(isa);
+		}
+	}
+	return isaScalar;
+}
+
+// QUATERNION_ISA if it is set and supported, the best instruction set otherwise
+InstructionSet selectInstructionSet()
+{
+	const InstructionSet best=bestInstructionSet();
+	const char *requested=std::getenv("QUATERNION_ISA");
+	if (!requested || !*requested){
+		return best;
+	}
+	InstructionSet isa;
+	if (!parseInstructionSet(requested,isa)){
+		std::cerr<<"QUATERNION_ISA="<<requested<<" is not one of scalar, sse2, avx2 or avx512; using "
+			<<instructionSetName(best)<<std::endl;
+		return best;
+	}
+	if (!instructionSetSupported(isa)){
+		std::cerr<<"QUATERNION_ISA="<<requested<<" is not supported by this CPU; using "
+			<<instructionSetName(best)<<std::endl;
+		return best;
+	}
+	return isa;
+}
+
+// The active instruction set, -1 until the first kernel call (or the first query)
+std::atomic<int> activeSet(-1);
+
+// Select at load time, so that a bad QUATERNION_ISA is reported right away
+const InstructionSet loadTimeSelection=activeInstructionSet();
+
+} // End anonymous namespace
+
+const char *Quaternions::instructionSetName(InstructionSet isa)
+{
+	return (isa>=isaScalar && isa<isaCount) ? kInstructionSetNames[isa] : "unknown";
+}
+
+bool Quaternions::parseInstructionSet(const char *name, InstructionSet &isa)
+{
+	for (int candidate=isaScalar;candidate<isaCount;++candidate){
+		if (std::strcmp(name,kInstructionSetNames[candidate])==0){
+			isa=InstructionSet(candidate);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Quaternions::instructionSetSupported(InstructionSet isa)
+{
+#ifdef QUATERNION_DISPATCH_X86
+	__builtin_cpu_init(); // Needed when called during static initialization
+#endif
+	switch (isa){
+	case isaScalar:
+	case isaSSE2: // The baseline of the build
+		return true;
+#ifdef QUATERNION_DISPATCH_X86
+	// Note: these also check that the operating system saves the wide registers
+	case isaAVX2: return __builtin_cpu_supports("avx2");
+	case isaAVX512: return __builtin_cpu_supports("avx512f");
+#endif
+	default: return false;
+	}
+}
+
+InstructionSet Quaternions::defaultInstructionSet()
+{
+	static const InstructionSet isa=selectInstructionSet();
+	return isa;
+}
+
+InstructionSet Quaternions::activeInstructionSet()
+{
+	int isa=activeSet.load(std::memory_order_relaxed);
+	if (isa<0){
+		// Only replace -1: setInstructionSet may have been called in the meantime
+		int unset=-1;
+		activeSet.compare_exchange_strong(unset,defaultInstructionSet(),std::memory_order_relaxed);
+		isa=activeSet.load(std::memory_order_relaxed);
+	}
+	return InstructionSet(isa);
+}
+
+bool Quaternions::setInstructionSet(InstructionSet isa)
+{
+	if (!instructionSetSupported(isa)){
+		return false;
+	}
+	activeSet.store(isa,std::memory_order_relaxed);
+	return true;
+}
+
+template <typename T>
+const DispatchDetail::BatchKernels<T> &DispatchDetail::batchKernels()
+{
+	return batchKernelTable<T>()[activeInstructionSet()];
+}
+
+const DispatchDetail::RotationKernels &DispatchDetail::rotationKernels()
+{
+	return kRotationKernels[activeInstructionSet()];
+}
+
+// Explicit instantiations for float and double
+template const DispatchDetail::BatchKernels<float> &DispatchDetail::batchKernels<float>();
+template const DispatchDetail::BatchKernels<double> &DispatchDetail::batchKernels<double>();
+
+// End of file
@@ -0,0 +1,102 @@
+/* File Dispatch.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Runtime selection of the instruction set used by the bulk kernels
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_DISPATCH_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_DISPATCH_LIB
+
+// Include project headers
+#include "QuaternionBatch.h"
+#include "Rotation.h"
+
+/* Note: a library compiled with -march=native only runs on machines with
+ * the same instructions as the build machine, and one compiled for plain
+ * x86-64 only uses 128 bit (SSE2) vectors. Instead, the hot kernels (batch
+ * Hamilton product, norm and (fast) normalization, and the point cloud rotations)
+ * are compiled several times, once per instruction set, and the best one the
+ * CPU supports is picked (with CPUID) the first time a kernel runs:
+ *
+ *     scalar   no vectorization at all, the reference implementation
+ *     sse2     128 bit vectors, every x86-64 CPU has them
+ *     avx2     256 bit vectors
+ *     avx512   512 bit vectors (AVX-512F)
+ *
+ * Set the environment variable QUATERNION_ISA to one of these names to force
+ * an instruction set, e.g. QUATERNION_ISA=scalar ./myProgram. An unknown or
+ * unsupported name is reported on cerr and ignored.
+ *
+ * All variants compute exactly the same operations in the same order, and
+ * they are compiled without contracting a*b+c into fused multiply-adds, so
+ * they give bit-for-bit the same results as each other and as the scalar
+ * operators. Switching instruction sets never changes a result.
+ *
+ * On other architectures only the scalar and the portable vectorized (sse2
+ * slot) variants exist.
+ */
+
+namespace Quaternions{
+
+// The instruction sets the kernels are compiled for
+typedef enum{
+	isaScalar,
+	isaSSE2,
+	isaAVX2,
+	isaAVX512,
+	isaCount // Number of instruction sets, not an instruction set
+}InstructionSet;
+
+// Name of an instruction set, as accepted by QUATERNION_ISA
+const char *instructionSetName(InstructionSet isa);
+
+// Parse an instruction set name. Returns false if the name is unknown
+bool parseInstructionSet(const char *name, InstructionSet &isa);
+
+// Whether this CPU (and operating system) can run the variant
+bool instructionSetSupported(InstructionSet isa);
+
+// The instruction set picked when the library was first used: QUATERNION_ISA
+// if set and supported, otherwise the best supported one
+InstructionSet defaultInstructionSet();
+
+// The instruction set the kernels currently use
+InstructionSet activeInstructionSet();
+
+// Use another instruction set from now on, e.g. to compare the variants.
+// Returns false (and changes nothing) if it isn't supported
+/* Note: this affects all threads; don't switch while kernels are running */
+bool setInstructionSet(InstructionSet isa);
+
+namespace DispatchDetail{
+
+// The dispatched kernels for one scalar type and instruction set. The output
+// is already resized when they are called
+template <typename T>
+struct BatchKernels
+{
+	void (*multiply)(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out);
+	void (*norm)(const BasicQuaternionBatch<T> &q, T *out);
+	void (*normalize)(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out);
+	void (*fastNormalize)(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out);
+};
+
+struct RotationKernels
+{
+	void (*rotate)(const Quaternion &q, const PointCloud &in, PointCloud &out);
+	void (*rotateByMatrix)(const Matrix3 &M, const PointCloud &in, PointCloud &out);
+	void (*rotateBatch)(const QuaternionBatch &q, const PointCloud &in, PointCloud &out);
+};
+
+// The kernels of the active instruction set
+template <typename T>
+const BatchKernels<T> &batchKernels();
+
+const RotationKernels &rotationKernels();
+
+} // End namespace DispatchDetail
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,104 @@
+/* File DualQuaternion.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the batch dual quaternion skinning kernel
+ * \author Nikos Kazazakis
+ */
+
+#include "DualQuaternion.h"
+
+// Other includes
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace Quaternions;
+
+void Quaternions::skin(const std::vector<DualQuaternion> &joints, const SkinningWeights &weights, const PointCloud &in, PointCloud &out)
+{
+	assert(weights.vertices()==in.size() && "Need the weights of every vertex");
+	const long size=static_cast<long>(in.size());
+	const std::size_t influences=weights.influences();
+	out.resize(in.size());
+	if (size==0 || influences==0){
+		return;
+	}
+
+	// The joints as a structure of arrays: 8 components, each over the joints
+	const std::size_t jointCount=joints.size();
+	AlignedVector<double> components(8*jointCount);
+	double *rw=components.data(), *rx=rw+jointCount, *ry=rx+jointCount, *rz=ry+jointCount;
+	double *dw=rz+jointCount, *dx=dw+jointCount, *dy=dx+jointCount, *dz=dy+jointCount;
+	for (std::size_t n=0;n<jointCount;++n){
+		const Quaternion &r=joints[n].real(), &d=joints[n].dual();
+		rw[n]=r.w(); rx[n]=r.i(); ry[n]=r.j(); rz[n]=r.k();
+		dw[n]=d.w(); dx[n]=d.i(); dy[n]=d.j(); dz[n]=d.k();
+	}
+	for (std::size_t slot=0;slot<influences;++slot){
+		for (long n=0;n<size;++n){
+			assert(weights.joints(slot)[n]<jointCount && "Joint index out of range");
+		}
+	}
+
+	const double *px=in.x(), *py=in.y(), *pz=in.z();
+	double *ox=out.x(), *oy=out.y(), *oz=out.z();
+	const long chunks=(size+kSkinningChunk-1)/kSkinningChunk;
+
+	/* Note: this is dlb (DualQuaternion.h) and transform written out on the
+	 * components, so that it vectorizes: the sign flip is a select, and the
+	 * blended transform is never normalized as such. Dividing its real part
+	 * by its length normalizes the rotation, and the translation formula
+	 * 2*(rw*dv-dw*rv+rv x dv) only needs the dual part divided by the same
+	 * length (the component along the real part cancels out), so the whole
+	 * normalization is one square root and one division per vertex.
+	 * The vertices go in chunks: the blend runs slot by slot over the whole
+	 * chunk, accumulating into arrays that stay in the L1 cache, so that the
+	 * loops over the vertices are the inner ones and vectorize.
+	 */
+	#pragma omp parallel for schedule(static)
+	for (long chunk=0;chunk<chunks;++chunk){
+		const long first=chunk*kSkinningChunk;
+		const long count=std::min<long>(kSkinningChunk,size-first);
+		alignas(kBatchAlignment) double bw[kSkinningChunk], bx[kSkinningChunk], by[kSkinningChunk], bz[kSkinningChunk];
+		alignas(kBatchAlignment) double cw[kSkinningChunk], cx[kSkinningChunk], cy[kSkinningChunk], cz[kSkinningChunk];
+
+		// Blend
+		#pragma omp simd
+		for (long n=0;n<count;++n){
+			bw[n]=bx[n]=by[n]=bz[n]=cw[n]=cx[n]=cy[n]=cz[n]=0.0;
+		}
+		const std::uint32_t *pivots=weights.joints(0)+first;
+		for (std::size_t slot=0;slot<influences;++slot){
+			const std::uint32_t *slotJoints=weights.joints(slot)+first;
+			const double *slotWeights=weights.weights(slot)+first;
+			#pragma omp simd
+			for (long n=0;n<count;++n){
+				const std::uint32_t pivot=pivots[n], joint=slotJoints[n];
+				const double alignment=rw[pivot]*rw[joint]+rx[pivot]*rx[joint]+ry[pivot]*ry[joint]+rz[pivot]*rz[joint];
+				const double weight=(alignment<0.0 ? -1.0 : 1.0)*slotWeights[n];
+				bw[n]+=weight*rw[joint]; bx[n]+=weight*rx[joint]; by[n]+=weight*ry[joint]; bz[n]+=weight*rz[joint];
+				cw[n]+=weight*dw[joint]; cx[n]+=weight*dx[joint]; cy[n]+=weight*dy[joint]; cz[n]+=weight*dz[joint];
+			}
+		}
+
+		// Normalize, rotate (see rotate in Rotation.h) and translate
+		#pragma omp simd
+		for (long n=0;n<count;++n){
+			const double scale=1.0/std::sqrt(bw[n]*bw[n]+bx[n]*bx[n]+by[n]*by[n]+bz[n]*bz[n]);
+			const double qw=bw[n]*scale, qx=bx[n]*scale, qy=by[n]*scale, qz=bz[n]*scale;
+			const double ew=cw[n]*scale, ex=cx[n]*scale, ey=cy[n]*scale, ez=cz[n]*scale;
+			const double x=px[first+n], y=py[first+n], z=pz[first+n];
+			const double tx=2.0*(qy*z-qz*y);
+			const double ty=2.0*(qz*x-qx*z);
+			const double tz=2.0*(qx*y-qy*x);
+			const double sx=2.0*(qw*ex-ew*qx+(qy*ez-qz*ey));
+			const double sy=2.0*(qw*ey-ew*qy+(qz*ex-qx*ez));
+			const double sz=2.0*(qw*ez-ew*qz+(qx*ey-qy*ex));
+			ox[first+n]=x+qw*tx+(qy*tz-qz*ty)+sx;
+			oy[first+n]=y+qw*ty+(qz*tx-qx*tz)+sy;
+			oz[first+n]=z+qw*tz+(qx*ty-qy*tx)+sz;
+		}
+	}
+}
+
+// End of file
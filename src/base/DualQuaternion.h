@@ -0,0 +1,336 @@
+/* File DualQuaternion.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Dual quaternions (rigid transforms), screw interpolation, blending and batch skinning
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_DUAL_QUATERNION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_DUAL_QUATERNION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "Rotation.h"
+#include "AlignedAllocator.h"
+
+// Include STL headers
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/* Note: a dual quaternion is r+e*d, two quaternions r (the real part) and
+ * d (the dual part) with the dual unit e, where e*e=0. A rotation by the unit
+ * quaternion q followed by a translation t is the UNIT dual quaternion
+ *     r=q,  d=(0,t)*q/2
+ * ("unit" means |r|=1 and dot(r,d)=0). Then, exactly like quaternions:
+ * - composing two transforms is one product, dq1*dq2 applies dq2, then dq1;
+ * - the inverse transform is the conjugate (r*, d*);
+ * - the transform of a point p is rotate(r,p)+t, with t=2*d*r* (see
+ *   transform below, which does it without building t as a quaternion).
+ * So a joint is one object instead of a quaternion plus a vector, and a
+ * chain of joints is a chain of products.
+ *
+ * Interpolation:
+ * - sclerp (screw linear interpolation) moves along the screw motion from
+ *   one transform to the other: a constant rotation about, and translation
+ *   along, one axis. It is the dual quaternion slerp, with the same cost
+ *   (atan2, sin and cos).
+ * - dlb (dual quaternion linear blending, Kavan et al., "Geometric skinning
+ *   with approximate dual quaternion blending", 2008) takes the weighted sum
+ *   of several transforms and normalizes it. It is not exactly on the screw
+ *   path, but it is close, it takes any number of transforms at the cost of
+ *   a few multiplications, and unlike blending matrices it never shrinks the
+ *   mesh ("candy wrapper"). This is what skinning uses.
+ * Like q and -q, dq and -dq are the same transform; both pick the sign of
+ * each transform that is closest to the first one, to take the short way.
+ */
+
+namespace Quaternions{
+
+template <typename T>
+class BasicDualQuaternion
+{
+public :
+	typedef T Scalar;
+
+	// The identity transform
+	constexpr BasicDualQuaternion() : real_(T(1),T(0),T(0),T(0)), dual_(T(0),T(0),T(0),T(0)) {}
+
+	// Build from the two parts
+	constexpr BasicDualQuaternion(const BasicQuaternion<T> &real, const BasicQuaternion<T> &dual) : real_(real), dual_(dual) {}
+
+	// The transform that rotates by the UNIT quaternion q, then translates by t
+	static BasicDualQuaternion fromRotationTranslation(const BasicQuaternion<T> &q, const Vector3 &t)
+	{
+		const BasicQuaternion<T> translation(T(0),T(t.x),T(t.y),T(t.z));
+		return BasicDualQuaternion(q,T(0.5)*(translation*q));
+	}
+
+	// A pure rotation or a pure translation
+	static BasicDualQuaternion fromRotation(const BasicQuaternion<T> &q) {return BasicDualQuaternion(q,BasicQuaternion<T>(T(0),T(0),T(0),T(0)));}
+	static BasicDualQuaternion fromTranslation(const Vector3 &t) {return fromRotationTranslation(BasicQuaternion<T>(T(1),T(0),T(0),T(0)),t);}
+
+	// The two parts
+	constexpr const BasicQuaternion<T> &real()const {return real_;}
+	constexpr const BasicQuaternion<T> &dual()const {return dual_;}
+
+	// The rotation and the translation of a unit dual quaternion
+	constexpr const BasicQuaternion<T> &rotation()const {return real_;}
+	Vector3 translation()const
+	{
+		// The vector part of 2*d*r*
+		const T rw=real_.w(), rx=real_.i(), ry=real_.j(), rz=real_.k();
+		const T dw=dual_.w(), dx=dual_.i(), dy=dual_.j(), dz=dual_.k();
+		return Vector3{
+			double(T(2)*(rw*dx-dw*rx+(ry*dz-rz*dy))),
+			double(T(2)*(rw*dy-dw*ry+(rz*dx-rx*dz))),
+			double(T(2)*(rw*dz-dw*rz+(rx*dy-ry*dx))) };
+	}
+
+	// The quaternion conjugate of both parts: the inverse of a unit dual quaternion
+	constexpr BasicDualQuaternion conjugate()const {return BasicDualQuaternion(real_.conjugate(),dual_.conjugate());}
+
+	// Make this a unit dual quaternion: divide by |r|, then remove the
+	// component of d along r (so that dot(r,d)=0). r must not be zero
+	/* Note: rounding makes long products drift away from unit norm, exactly
+	 * like quaternions; normalize every now and then
+	 */
+	BasicDualQuaternion &normalize()
+	{
+		const T length=real_.norm();
+		assert(length>T(0) && "Can't normalize a dual quaternion with a zero real part");
+		const T scale=T(1)/length;
+		real_=scale*real_;
+		dual_=scale*dual_;
+		dual_=dual_-dot(real_,dual_)*real_;
+		return *this;
+	}
+
+private:
+	BasicQuaternion<T> real_;
+	BasicQuaternion<T> dual_;
+
+}; // End of dual quaternion class
+
+// The dual quaternion types
+typedef BasicDualQuaternion<float> DualQuaternionF;
+typedef BasicDualQuaternion<double> DualQuaternion;
+typedef BasicDualQuaternion<long double> DualQuaternionL;
+
+// === Arithmetic ===
+// Product (r1+e*d1)*(r2+e*d2)=r1*r2+e*(r1*d2+d1*r2). For unit dual
+// quaternions this composes the transforms: dq1*dq2 applies dq2, then dq1
+template <typename T>
+inline BasicDualQuaternion<T> operator*(const BasicDualQuaternion<T> &dq1, const BasicDualQuaternion<T> &dq2)
+{
+	return BasicDualQuaternion<T>(dq1.real()*dq2.real(),dq1.real()*dq2.dual()+dq1.dual()*dq2.real());
+}
+
+// Sums and scalar products, for blending
+template <typename T>
+inline BasicDualQuaternion<T> operator+(const BasicDualQuaternion<T> &dq1, const BasicDualQuaternion<T> &dq2)
+{
+	return BasicDualQuaternion<T>(dq1.real()+dq2.real(),dq1.dual()+dq2.dual());
+}
+
+template <typename T>
+inline BasicDualQuaternion<T> operator-(const BasicDualQuaternion<T> &dq1, const BasicDualQuaternion<T> &dq2)
+{
+	return BasicDualQuaternion<T>(dq1.real()-dq2.real(),dq1.dual()-dq2.dual());
+}
+
+template <typename T>
+inline BasicDualQuaternion<T> operator*(const T c, const BasicDualQuaternion<T> &dq)
+{
+	return BasicDualQuaternion<T>(c*dq.real(),c*dq.dual());
+}
+
+template <typename T>
+inline BasicDualQuaternion<T> operator*(const BasicDualQuaternion<T> &dq, const T c)
+{
+	return c*dq;
+}
+
+// Comparison operators
+template <typename T>
+inline bool operator==(const BasicDualQuaternion<T> &dq1, const BasicDualQuaternion<T> &dq2)
+{
+	return dq1.real()==dq2.real() && dq1.dual()==dq2.dual();
+}
+
+template <typename T>
+inline bool operator!=(const BasicDualQuaternion<T> &dq1, const BasicDualQuaternion<T> &dq2)
+{
+	return !(dq1==dq2);
+}
+
+// A normalized copy (see the member function)
+template <typename T>
+inline BasicDualQuaternion<T> normalize(const BasicDualQuaternion<T> &dq)
+{
+	BasicDualQuaternion<T> p(dq);
+	p.normalize();
+	return p;
+}
+
+// The inverse of any dual quaternion with a non-zero real part:
+// (r+e*d)^{-1}=r^{-1}-e*r^{-1}*d*r^{-1}. For unit ones use the conjugate
+template <typename T>
+inline BasicDualQuaternion<T> inverse(const BasicDualQuaternion<T> &dq)
+{
+	const BasicQuaternion<T> realInverse=inverse(dq.real());
+	return BasicDualQuaternion<T>(realInverse,T(-1)*(realInverse*dq.dual()*realInverse));
+}
+
+// Transform the point p by the UNIT dual quaternion dq: rotate, then translate
+/* Note: 2*d*r* gives the translation. Its vector part expands to
+ *     t=2*(rw*dv-dw*rv+rv x dv)
+ * which with the rotation formula of Rotation.h is 30 multiplications
+ */
+inline Vector3 transform(const DualQuaternion &dq, const Vector3 &p)
+{
+	const Vector3 rotated=rotate(dq.real(),p);
+	const Vector3 t=dq.translation();
+	return Vector3{rotated.x+t.x,rotated.y+t.y,rotated.z+t.z};
+}
+
+// === Interpolation ===
+// Implementation helpers, not part of the interface
+namespace DualQuaternionDetail{
+
+// dq^t for a UNIT dual quaternion, through its screw parameters: the angle
+// theta about, and the distance d along, the axis l through the moment m:
+//     r=(cos(theta/2), sin(theta/2)*l)
+//     d=(-d/2*sin(theta/2), sin(theta/2)*m+d/2*cos(theta/2)*l)
+// The power scales theta and d by t
+template <typename T>
+BasicDualQuaternion<T> power(const BasicDualQuaternion<T> &dq, T t)
+{
+	const BasicQuaternion<T> &r=dq.real(), &e=dq.dual();
+	const T sinHalf=std::sqrt(r.i()*r.i()+r.j()*r.j()+r.k()*r.k());
+
+	// (Almost) no rotation: the axis is undefined, and the motion is a
+	// translation. Scale the vector part of r (exact to O(angle^3)) and the translation
+	if (sinHalf<std::sqrt(std::numeric_limits<T>::epsilon())){
+		const BasicQuaternion<T> translation=T(2)*(e*r.conjugate());
+		const BasicQuaternion<T> rotation=normalize(BasicQuaternion<T>(r.w(),t*r.i(),t*r.j(),t*r.k()));
+		return BasicDualQuaternion<T>(rotation,T(0.5)*(t*translation)*rotation);
+	}
+
+	const T halfAngle=std::atan2(sinHalf,r.w());
+	const T scale=T(1)/sinHalf;
+	const T lx=r.i()*scale, ly=r.j()*scale, lz=r.k()*scale; // Axis
+	const T distance=T(-2)*e.w()*scale;                    // Along the axis
+	const T halfCos=T(0.5)*distance*r.w();
+	const T mx=(e.i()-lx*halfCos)*scale, my=(e.j()-ly*halfCos)*scale, mz=(e.k()-lz*halfCos)*scale; // Moment
+
+	const T s=std::sin(t*halfAngle), c=std::cos(t*halfAngle);
+	const T halfDistance=T(0.5)*t*distance;
+	return BasicDualQuaternion<T>(
+		BasicQuaternion<T>(c,s*lx,s*ly,s*lz),
+		BasicQuaternion<T>(-halfDistance*s,s*mx+halfDistance*c*lx,s*my+halfDistance*c*ly,s*mz+halfDistance*c*lz));
+}
+
+} // End namespace DualQuaternionDetail
+
+// Screw linear interpolation between the UNIT dual quaternions dq0 (t=0) and dq1 (t=1)
+template <typename T>
+BasicDualQuaternion<T> sclerp(const BasicDualQuaternion<T> &dq0, const BasicDualQuaternion<T> &dq1, T t)
+{
+	// Take the short way: the sign of dq1 closest to dq0
+	const BasicDualQuaternion<T> target= dot(dq0.real(),dq1.real())<T(0) ? T(-1)*dq1 : dq1;
+	return dq0*DualQuaternionDetail::power(dq0.conjugate()*target,t);
+}
+
+// Dual quaternion linear blending of n UNIT dual quaternions with the given
+// weights. The weights should add up to 1, and must not cancel out
+template <typename T>
+BasicDualQuaternion<T> dlb(const BasicDualQuaternion<T> *dqs, const T *weights, std::size_t n)
+{
+	assert(n>0 && "Nothing to blend");
+	BasicQuaternion<T> real(T(0),T(0),T(0),T(0)), dual(T(0),T(0),T(0),T(0));
+	for (std::size_t m=0;m<n;++m){
+		// Flip every transform to the sign closest to the first one
+		const T weight= dot(dqs[0].real(),dqs[m].real())<T(0) ? -weights[m] : weights[m];
+		real=real+weight*dqs[m].real();
+		dual=dual+weight*dqs[m].dual();
+	}
+	return normalize(BasicDualQuaternion<T>(real,dual));
+}
+
+// Versions for whole vectors
+template <typename T>
+BasicDualQuaternion<T> dlb(const std::vector<BasicDualQuaternion<T> > &dqs, const std::vector<T> &weights)
+{
+	assert(dqs.size()==weights.size() && "Need one weight per dual quaternion");
+	return dlb(dqs.data(),weights.data(),dqs.size());
+}
+
+// === Skinning ===
+/**
+ * SkinningWeights holds the joint influences of every vertex of a mesh: up to
+ * influences() (joint, weight) pairs per vertex. Slots a vertex doesn't use
+ * keep weight 0. They are stored slot by slot, and within a slot as arrays
+ * over the vertices, so that the skinning kernel reads them contiguously.
+ */
+class SkinningWeights
+{
+public :
+	SkinningWeights() {}
+	SkinningWeights(std::size_t vertices, std::size_t influences) {resize(vertices,influences);}
+
+	std::size_t vertices() const {return vertices_;}
+	std::size_t influences() const {return influences_;}
+
+	// Change the size. All the weights are reset to zero
+	void resize(std::size_t vertices, std::size_t influences)
+	{
+		vertices_=vertices;
+		influences_=influences;
+		joints_.assign(vertices*influences,0);
+		weights_.assign(vertices*influences,0.0);
+	}
+
+	// Get/set influence slot of vertex
+	std::uint32_t joint(std::size_t vertex, std::size_t slot) const {return joints_[slot*vertices_+vertex];}
+	double weight(std::size_t vertex, std::size_t slot) const {return weights_[slot*vertices_+vertex];}
+	void set(std::size_t vertex, std::size_t slot, std::uint32_t joint, double weight)
+	{
+		assert(slot<influences_ && "Influence slot out of range");
+		joints_[slot*vertices_+vertex]=joint;
+		weights_[slot*vertices_+vertex]=weight;
+	}
+
+	// Raw access to one slot of all the vertices
+	const std::uint32_t *joints(std::size_t slot) const {return joints_.data()+slot*vertices_;}
+	const double *weights(std::size_t slot) const {return weights_.data()+slot*vertices_;}
+
+private:
+	std::size_t vertices_=0;
+	std::size_t influences_=0;
+
+	AlignedVector<std::uint32_t> joints_;
+	AlignedVector<double> weights_;
+
+}; // End of SkinningWeights class
+
+// Dual quaternion skinning: blend the UNIT joint transforms of every vertex
+// with dlb and transform the vertex (in the bind pose) by the result
+/* Note: the joint transforms are first copied to a structure of arrays, so
+ * the kernel reads them with one indexed load per component. The vertices
+ * are split across all OpenMP threads and vectorized within each thread.
+ * The output is resized to match the input, and may be the same object.
+ * The weights of every vertex must not cancel out (e.g. be all zero), and
+ * every joint index must be below joints.size().
+ */
+// Number of vertices blended together by one thread (see DualQuaternion.cpp)
+const std::size_t kSkinningChunk=256;
+
+void skin(const std::vector<DualQuaternion> &joints, const SkinningWeights &weights, const PointCloud &in, PointCloud &out);
+
+} // End namespace Quaternions
+
+#endif
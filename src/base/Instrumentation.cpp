@@ -0,0 +1,227 @@
+/* File Instrumentation.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the per-thread counters, snapshots and JSON output
+ * \author Nikos Kazazakis
+ */
+
+#include "Instrumentation.h"
+
+// Other includes
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace Quaternions;
+
+namespace{
+
+/* Note: every counter is only ever written by its own thread, so a relaxed
+ * load and store is enough (no locked instructions). They are atomics only
+ * so that snapshots can read them from other threads without a data race.
+ */
+typedef std::atomic<std::uint64_t> Counter;
+
+inline void increment(Counter &counter, std::uint64_t amount=1)
+{
+	counter.store(counter.load(std::memory_order_relaxed)+amount,std::memory_order_relaxed);
+}
+
+struct ThreadCounters
+{
+	Counter calls[opCount];
+	Counter latency[opCount][kLatencyBuckets];
+	std::uint32_t untilNextSample[opCount]; // Only used by the owning thread
+
+	ThreadCounters()
+	{
+		clear();
+		std::fill(untilNextSample,untilNextSample+opCount,0u);
+	}
+
+	void clear()
+	{
+		for (std::size_t operation=0;operation<opCount;++operation){
+			calls[operation].store(0,std::memory_order_relaxed);
+			for (auto &bucket : latency[operation]){
+				bucket.store(0,std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Add these counters to a snapshot
+	void addTo(InstrumentationSnapshot &snapshot) const
+	{
+		for (std::size_t operation=0;operation<opCount;++operation){
+			snapshot.calls[operation]+=calls[operation].load(std::memory_order_relaxed);
+			for (std::size_t bucket=0;bucket<kLatencyBuckets;++bucket){
+				snapshot.latency[operation][bucket]+=latency[operation][bucket].load(std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+// All the threads' counters. The mutex is only taken when a thread first
+// records something, when it exits, and for snapshots and resets
+struct Registry
+{
+	std::mutex mutex;
+	std::vector<ThreadCounters*> threads;
+	InstrumentationSnapshot retired{}; // Totals of the threads that have exited
+};
+
+Registry &registry()
+{
+	// Never destroyed: threads may still exit after static destruction starts
+	static Registry *instance=new Registry;
+	return *instance;
+}
+
+std::atomic<std::uint32_t> samplingPeriod(64);
+
+// Owns the counters of one thread, registers them on creation and folds them
+// into the retired totals when the thread exits
+class ThreadCountersOwner
+{
+public :
+	ThreadCountersOwner()
+	{
+		Registry &shared=registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		shared.threads.push_back(&counters);
+	}
+
+	~ThreadCountersOwner()
+	{
+		Registry &shared=registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		counters.addTo(shared.retired);
+		shared.threads.erase(std::find(shared.threads.begin(),shared.threads.end(),&counters));
+	}
+
+	ThreadCounters counters;
+};
+
+ThreadCounters &threadCounters()
+{
+	static thread_local ThreadCountersOwner owner;
+	return owner.counters;
+}
+
+// Bucket of a latency: the position of its highest set bit
+std::size_t latencyBucket(std::uint64_t nanoseconds)
+{
+	std::size_t bucket=0;
+	while (nanoseconds>1 && bucket+1<kLatencyBuckets){
+		nanoseconds>>=1;
+		++bucket;
+	}
+	return bucket;
+}
+
+} // End anonymous namespace
+
+const char *Quaternions::operationName(InstrumentedOperation operation)
+{
+	switch (operation){
+	case opConstruct: return "construct";
+	case opEvaluate: return "evaluate";
+	case opAdd: return "add";
+	case opSubtract: return "subtract";
+	case opScalarAdd: return "scalarAdd";
+	case opScalarMultiply: return "scalarMultiply";
+	case opHamilton: return "hamilton";
+	case opConjugate: return "conjugate";
+	case opNorm: return "norm";
+	case opDot: return "dot";
+	case opExp: return "exp";
+	case opLog: return "log";
+	case opNormalize: return "normalize";
+	case opInverse: return "inverse";
+	case opSparseConstruct: return "sparseConstruct";
+	case opAllocation: return "allocation";
+	default: return "unknown";
+	}
+}
+
+std::uint64_t InstrumentationSnapshot::samples(InstrumentedOperation operation) const
+{
+	std::uint64_t total=0;
+	for (std::size_t bucket=0;bucket<kLatencyBuckets;++bucket){
+		total+=latency[operation][bucket];
+	}
+	return total;
+}
+
+InstrumentationSnapshot Quaternions::instrumentationSnapshot()
+{
+	Registry &shared=registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+	InstrumentationSnapshot snapshot=shared.retired;
+	for (const ThreadCounters *counters : shared.threads){
+		counters->addTo(snapshot);
+	}
+	return snapshot;
+}
+
+void Quaternions::resetInstrumentation()
+{
+	Registry &shared=registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+	shared.retired=InstrumentationSnapshot{};
+	for (ThreadCounters *counters : shared.threads){
+		counters->clear();
+	}
+}
+
+void Quaternions::setLatencySamplingPeriod(std::uint32_t period)
+{
+	samplingPeriod.store(std::max(period,1u),std::memory_order_relaxed);
+}
+
+void Quaternions::writeInstrumentationJson(std::ostream &out, const InstrumentationSnapshot &snapshot)
+{
+	out<<"{\"enabled\":"<<(instrumentationEnabled() ? "true" : "false")<<",\"operations\":{";
+	bool first=true;
+	for (std::size_t operation=0;operation<opCount;++operation){
+		if (snapshot.calls[operation]==0){
+			continue;
+		}
+		out<<(first ? "" : ",")<<"\""<<operationName(InstrumentedOperation(operation))<<"\":{";
+		out<<"\"calls\":"<<snapshot.calls[operation];
+		out<<",\"latencySamples\":"<<snapshot.samples(InstrumentedOperation(operation));
+		out<<",\"latencyHistogramNs\":[";
+		for (std::size_t bucket=0;bucket<kLatencyBuckets;++bucket){
+			out<<(bucket==0 ? "" : ",")<<snapshot.latency[operation][bucket];
+		}
+		out<<"]}";
+		first=false;
+	}
+	out<<"}}";
+}
+
+// === Recording ===
+void InstrumentationDetail::recordCall(InstrumentedOperation operation)
+{
+	increment(threadCounters().calls[operation]);
+}
+
+bool InstrumentationDetail::sampleLatency(InstrumentedOperation operation)
+{
+	std::uint32_t &untilNextSample=threadCounters().untilNextSample[operation];
+	const std::uint32_t period=samplingPeriod.load(std::memory_order_relaxed);
+	if (untilNextSample==0 || untilNextSample>=period){ // The period may have been shortened
+		untilNextSample=period-1;
+		return true;
+	}
+	--untilNextSample;
+	return false;
+}
+
+void InstrumentationDetail::recordLatency(InstrumentedOperation operation, std::uint64_t nanoseconds)
+{
+	increment(threadCounters().latency[operation][latencyBucket(nanoseconds)]);
+}
+
+// End of file
@@ -0,0 +1,186 @@
+/* File Instrumentation.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Opt-in per-operator call counters and sampled latency histograms
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_INSTRUMENTATION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_INSTRUMENTATION_LIB
+
+// Include STL headers
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+/* Note: the instrumentation is compiled in only if QUATERNION_INSTRUMENTATION
+ * is defined (cmake -DQUATERNION_INSTRUMENTATION=ON, which defines it for the
+ * whole project). Otherwise the macros below expand to nothing and the
+ * operators cost exactly what they did before. Code that includes the
+ * library headers must be compiled with the same setting.
+ *
+ * What is recorded, per operation:
+ * - the number of calls, e.g. how many Hamilton products were built;
+ * - for the out-of-line functions (norm, exp, log and the sparse operators),
+ *   a latency histogram of one call in every samplingPeriod (64 by default),
+ *   because reading the clock costs more than a Hamilton product.
+ * Constructions of dense quaternions count the component constructors and
+ * expression evaluations; copies are not counted, they are plain memcpys
+ * (Quaternion must stay trivially copyable). Allocations are the node
+ * allocations of sparse quaternions (see ArenaAllocator.h).
+ *
+ * Every thread counts into its own counters, so there are no locks or atomic
+ * read-modify-writes on the hot path. A snapshot adds up the counters of all
+ * the threads (and of the threads that have exited).
+ *
+ * Compile-time evaluation: the operators are constexpr, and a constant
+ * expression can't touch the counters. QUATERNION_COUNT_CONSTEXPR asks the
+ * compiler whether it is evaluating a constant expression and only counts
+ * calls made at run time. Compilers without __builtin_is_constant_evaluated
+ * don't count the constexpr functions at all.
+ */
+
+namespace Quaternions{
+
+// The instrumented operations
+typedef enum{
+	opConstruct,     // Dense quaternion constructed from components
+	opEvaluate,      // Expression evaluated into a dense quaternion
+	opAdd,           // q1+q2
+	opSubtract,      // q1-q2
+	opScalarAdd,     // c+q, q+c, c-q, q-c
+	opScalarMultiply,// c*q, q*c
+	opHamilton,      // q1*q2
+	opConjugate,
+	opNorm,
+	opDot,
+	opExp,
+	opLog,
+	opNormalize,
+	opInverse,
+	opSparseConstruct,
+	opAllocation,    // Sparse quaternion node allocations
+	opCount          // Number of operations, not an operation
+}InstrumentedOperation;
+
+// Name of an operation, as used in the JSON output
+const char *operationName(InstrumentedOperation operation);
+
+// Latency histograms have one bucket per power of 2: bucket b counts the
+// samples that took [2^b,2^(b+1)) nanoseconds (bucket 0 also takes 0 ns)
+const std::size_t kLatencyBuckets=32;
+
+// Whether the library was compiled with the instrumentation
+constexpr bool instrumentationEnabled()
+{
+#ifdef QUATERNION_INSTRUMENTATION
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Totals over all threads
+struct InstrumentationSnapshot
+{
+	std::uint64_t calls[opCount];
+	std::uint64_t latency[opCount][kLatencyBuckets];
+
+	// Number of latency samples of an operation
+	std::uint64_t samples(InstrumentedOperation operation) const;
+};
+
+// Add up the counters of all threads
+/* Note: counters of threads that are still running may be a few calls
+ * behind, which doesn't matter for monitoring
+ */
+InstrumentationSnapshot instrumentationSnapshot();
+
+// Zero all counters. Calls made concurrently with the reset may be lost
+void resetInstrumentation();
+
+// Time one call in every period (per thread and operation). 1 times every call
+void setLatencySamplingPeriod(std::uint32_t period);
+
+// Write a snapshot as JSON:
+// {"enabled":true,"operations":{"hamilton":{"calls":10,"latencySamples":1,"latencyHistogramNs":[0,0,...]},...}}
+// Operations that were never called are left out
+void writeInstrumentationJson(std::ostream &out, const InstrumentationSnapshot &snapshot);
+
+// === Recording ===
+/* Note: use the macros below, which compile to nothing when the
+ * instrumentation is disabled
+ */
+namespace InstrumentationDetail{
+
+void recordCall(InstrumentedOperation operation);
+
+// Whether the calling thread should time this call (counts down the sampling period)
+bool sampleLatency(InstrumentedOperation operation);
+
+void recordLatency(InstrumentedOperation operation, std::uint64_t nanoseconds);
+
+// Times its own lifetime if the call was sampled
+class ScopedLatency
+{
+public :
+	explicit ScopedLatency(InstrumentedOperation operation) :
+		operation_(operation), sampled_(sampleLatency(operation))
+	{
+		if (sampled_){
+			start_=std::chrono::steady_clock::now();
+		}
+	}
+
+	~ScopedLatency()
+	{
+		if (sampled_){
+			const auto elapsed=std::chrono::steady_clock::now()-start_;
+			recordLatency(operation_,std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		}
+	}
+
+	ScopedLatency(const ScopedLatency &)=delete;
+	ScopedLatency &operator=(const ScopedLatency &)=delete;
+
+private:
+	InstrumentedOperation operation_;
+	bool sampled_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+} // End namespace InstrumentationDetail
+
+} // End namespace Quaternions
+
+// Whether the compiler can tell constant evaluation from run time
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define QUATERNION_HAS_IS_CONSTANT_EVALUATED
+#endif
+#elif defined(__GNUC__) && __GNUC__>=9
+#define QUATERNION_HAS_IS_CONSTANT_EVALUATED
+#endif
+
+#ifdef QUATERNION_INSTRUMENTATION
+// Count a call of a regular function
+#define QUATERNION_COUNT(operation) ::Quaternions::InstrumentationDetail::recordCall(operation)
+// Count a call and sample its latency until the end of the enclosing scope
+#define QUATERNION_TIME(operation) \
+	::Quaternions::InstrumentationDetail::recordCall(operation); \
+	const ::Quaternions::InstrumentationDetail::ScopedLatency quaternionScopedLatency_(operation)
+// Count a call of a constexpr function, when it runs at run time
+#ifdef QUATERNION_HAS_IS_CONSTANT_EVALUATED
+#define QUATERNION_COUNT_CONSTEXPR(operation) \
+	do{ if (!__builtin_is_constant_evaluated()){::Quaternions::InstrumentationDetail::recordCall(operation);} }while(0)
+#else
+#define QUATERNION_COUNT_CONSTEXPR(operation) do{}while(0)
+#endif
+#else
+#define QUATERNION_COUNT(operation) do{}while(0)
+#define QUATERNION_TIME(operation) do{}while(0)
+#define QUATERNION_COUNT_CONSTEXPR(operation) do{}while(0)
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+/* File Integration.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the single sensor and the parallel batch gyroscope integration
+ * \author Nikos Kazazakis
+ */
+
+#include "Integration.h"
+
+// Other includes
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace Quaternions;
+
+void GyroSamples::resize(std::size_t sensors, std::size_t samples)
+{
+	const std::size_t lineSize=kBatchAlignment/sizeof(double);
+	sensors_=sensors;
+	samples_=samples;
+	stride_=(sensors+lineSize-1)/lineSize*lineSize;
+	x_.assign(stride_*samples,0.0);
+	y_.assign(stride_*samples,0.0);
+	z_.assign(stride_*samples,0.0);
+}
+
+namespace{
+
+// === Shared step formulas ===
+/* Note: these are written on plain doubles so that the single sensor and the
+ * batch versions compute the same thing, and so that they inline into the
+ * vectorized loops.
+ */
+
+// Rotation vector of one step (its length is the rotation angle), from the
+// rates a at the start and b at the end of the step
+template <IntegrationScheme Scheme>
+inline void rotationVector(double ax, double ay, double az, double bx, double by, double bz, double dt,
+	double &px, double &py, double &pz)
+{
+	if (Scheme==integrateFirstOrder){
+		px=ax*dt; py=ay*dt; pz=az*dt;
+	}else{
+		// Average rate plus the coning correction (a x b)*dt^2/12
+		const double halfDt=0.5*dt, coning=dt*dt/12.0;
+		px=halfDt*(ax+bx)+coning*(ay*bz-az*by);
+		py=halfDt*(ay+by)+coning*(az*bx-ax*bz);
+		pz=halfDt*(az+bz)+coning*(ax*by-ay*bx);
+	}
+}
+
+// The largest half angle (squared) of a delta rotation computed with the
+// polynomials below: 0.5 rad, i.e. a rotation of about 57 degrees per sample
+const double kMaxPolynomialHalfAngleSquared=0.25;
+
+// cos(a) and sin(a)/a as Taylor polynomials in a^2, evaluated with Horner's
+// rule. For a^2<=kMaxPolynomialHalfAngleSquared the first omitted terms are
+// below 1e-18, so they are as accurate as std::cos and std::sin
+inline void cosSinc(double a2, double &c, double &s)
+{
+	c=1.0+a2*(-1.0/2.0+a2*(1.0/24.0+a2*(-1.0/720.0+a2*(1.0/40320.0+a2*(-1.0/3628800.0
+		+a2*(1.0/479001600.0+a2*(-1.0/87178291200.0)))))));
+	s=1.0+a2*(-1.0/6.0+a2*(1.0/120.0+a2*(-1.0/5040.0+a2*(1.0/362880.0+a2*(-1.0/39916800.0
+		+a2*(1.0/6227020800.0+a2*(-1.0/1307674368000.0)))))));
+}
+
+// q=q*(dw,dx,dy,dz), the same expressions as the Quaternion operator*
+inline void multiplyInPlace(double &w, double &x, double &y, double &z, double dw, double dx, double dy, double dz)
+{
+	const double w1=w, i1=x, j1=y, k1=z;
+	w=w1*dw-i1*dx-j1*dy-k1*dz;
+	x=w1*dx+i1*dw+j1*dz-k1*dy;
+	y=w1*dy-i1*dz+j1*dw+k1*dx;
+	z=w1*dz+i1*dy-j1*dx+k1*dw;
+}
+
+// dq/dt=q*(0,r)/2
+inline void derivative(double w, double x, double y, double z, double rx, double ry, double rz,
+	double &dw, double &dx, double &dy, double &dz)
+{
+	dw=0.5*(-x*rx-y*ry-z*rz);
+	dx=0.5*(w*rx+y*rz-z*ry);
+	dy=0.5*(w*ry-x*rz+z*rx);
+	dz=0.5*(w*rz+x*ry-y*rx);
+}
+
+// One classical Runge-Kutta step of dq/dt=q*(0,r(t))/2, with r going linearly from a to b
+inline void rungeKuttaStep(double &w, double &x, double &y, double &z,
+	double ax, double ay, double az, double bx, double by, double bz, double dt)
+{
+	const double mx=0.5*(ax+bx), my=0.5*(ay+by), mz=0.5*(az+bz); // The rate half way
+	const double halfDt=0.5*dt;
+	double k1w, k1x, k1y, k1z, k2w, k2x, k2y, k2z, k3w, k3x, k3y, k3z, k4w, k4x, k4y, k4z;
+	derivative(w,x,y,z,ax,ay,az,k1w,k1x,k1y,k1z);
+	derivative(w+halfDt*k1w,x+halfDt*k1x,y+halfDt*k1y,z+halfDt*k1z,mx,my,mz,k2w,k2x,k2y,k2z);
+	derivative(w+halfDt*k2w,x+halfDt*k2x,y+halfDt*k2y,z+halfDt*k2z,mx,my,mz,k3w,k3x,k3y,k3z);
+	derivative(w+dt*k3w,x+dt*k3x,y+dt*k3y,z+dt*k3z,bx,by,bz,k4w,k4x,k4y,k4z);
+	const double sixthDt=dt/6.0;
+	w+=sixthDt*(k1w+2.0*k2w+2.0*k3w+k4w);
+	x+=sixthDt*(k1x+2.0*k2x+2.0*k3x+k4x);
+	y+=sixthDt*(k1y+2.0*k2y+2.0*k3y+k4y);
+	z+=sixthDt*(k1z+2.0*k2z+2.0*k3z+k4z);
+}
+
+// Whether step s (counting from 0) ends with a renormalization
+inline bool renormalizeAfter(std::size_t step, std::size_t renormalizeEvery)
+{
+	return renormalizeEvery>0 && (step+1)%renormalizeEvery==0;
+}
+
+// === Batch kernels ===
+// Integrate sensors [first,last) (at most kIntegrationChunk of them) over all the samples
+template <IntegrationScheme Scheme>
+void integrateChunk(const GyroSamples &rates, double dt, QuaternionBatch &orientations,
+	std::size_t first, std::size_t last, std::size_t renormalizeEvery)
+{
+	const std::size_t size=last-first;
+	double *qw=orientations.w()+first, *qx=orientations.i()+first, *qy=orientations.j()+first, *qz=orientations.k()+first;
+
+	// The delta rotations of one step
+	alignas(kBatchAlignment) double dw[kIntegrationChunk], dx[kIntegrationChunk], dy[kIntegrationChunk], dz[kIntegrationChunk];
+
+	for (std::size_t step=0;step+1<rates.samples();++step){
+		const double *ax=rates.x(step)+first, *ay=rates.y(step)+first, *az=rates.z(step)+first;
+		const double *bx=rates.x(step+1)+first, *by=rates.y(step+1)+first, *bz=rates.z(step+1)+first;
+
+		if (Scheme==integrateRK4){
+			#pragma omp simd
+			for (std::size_t n=0;n<size;++n){
+				rungeKuttaStep(qw[n],qx[n],qy[n],qz[n],ax[n],ay[n],az[n],bx[n],by[n],bz[n],dt);
+			}
+		}else{
+			// Pass 1: the delta rotations, exp((0,p)/2)
+			int tooLarge=0;
+			#pragma omp simd reduction(|:tooLarge)
+			for (std::size_t n=0;n<size;++n){
+				double px, py, pz;
+				rotationVector<Scheme>(ax[n],ay[n],az[n],bx[n],by[n],bz[n],dt,px,py,pz);
+				px*=0.5; py*=0.5; pz*=0.5; // Half angle
+				const double a2=px*px+py*py+pz*pz;
+				double c, s;
+				cosSinc(a2,c,s);
+				dw[n]=c; dx[n]=s*px; dy[n]=s*py; dz[n]=s*pz;
+				tooLarge|= a2>kMaxPolynomialHalfAngleSquared;
+			}
+			// Rare: rotations too large for the polynomials (over 1 rad per sample)
+			if (tooLarge){
+				for (std::size_t n=0;n<size;++n){
+					double px, py, pz;
+					rotationVector<Scheme>(ax[n],ay[n],az[n],bx[n],by[n],bz[n],dt,px,py,pz);
+					const Quaternion delta=exp(Quaternion(0.0,0.5*px,0.5*py,0.5*pz));
+					dw[n]=delta.w(); dx[n]=delta.i(); dy[n]=delta.j(); dz[n]=delta.k();
+				}
+			}
+			// Pass 2: q=q*delta
+			#pragma omp simd
+			for (std::size_t n=0;n<size;++n){
+				multiplyInPlace(qw[n],qx[n],qy[n],qz[n],dw[n],dx[n],dy[n],dz[n]);
+			}
+		}
+
+		if (renormalizeAfter(step,renormalizeEvery)){
+			#pragma omp simd
+			for (std::size_t n=0;n<size;++n){
+				const double scale=1.0/std::sqrt(qw[n]*qw[n]+qx[n]*qx[n]+qy[n]*qy[n]+qz[n]*qz[n]);
+				qw[n]*=scale; qx[n]*=scale; qy[n]*=scale; qz[n]*=scale;
+			}
+		}
+	}
+}
+
+} // End anonymous namespace
+
+Quaternion Quaternions::integrate(const Quaternion &q0, const Vector3 *rates, std::size_t samples, double dt,
+	IntegrationScheme scheme, std::size_t renormalizeEvery)
+{
+	Quaternion q=q0;
+	for (std::size_t step=0;step+1<samples;++step){
+		const Vector3 &a=rates[step], &b=rates[step+1];
+		if (scheme==integrateRK4){
+			double w=q.w(), x=q.i(), y=q.j(), z=q.k();
+			rungeKuttaStep(w,x,y,z,a.x,a.y,a.z,b.x,b.y,b.z,dt);
+			q=Quaternion(w,x,y,z);
+		}else{
+			double px, py, pz;
+			if (scheme==integrateFirstOrder){
+				rotationVector<integrateFirstOrder>(a.x,a.y,a.z,b.x,b.y,b.z,dt,px,py,pz);
+			}else{
+				rotationVector<integrateMagnus>(a.x,a.y,a.z,b.x,b.y,b.z,dt,px,py,pz);
+			}
+			q=q*exp(Quaternion(0.0,0.5*px,0.5*py,0.5*pz));
+		}
+		if (renormalizeAfter(step,renormalizeEvery)){
+			q.normalize();
+		}
+	}
+	return q;
+}
+
+void Quaternions::integrate(const GyroSamples &rates, double dt, IntegrationScheme scheme,
+	QuaternionBatch &orientations, std::size_t renormalizeEvery)
+{
+	assert(orientations.size()==rates.sensors() && "Need one orientation per sensor");
+	const std::size_t sensors=rates.sensors();
+	const long chunks=static_cast<long>((sensors+kIntegrationChunk-1)/kIntegrationChunk);
+
+	/* Note: schedule(dynamic) hands out one chunk at a time to whichever
+	 * thread is free, so the load balances itself even when some threads
+	 * run slower. A chunk is hundreds of sensors times all the samples, so
+	 * the cost of taking a chunk from the shared counter doesn't matter.
+	 * A single chunk runs on the calling thread.
+	 */
+	#pragma omp parallel for schedule(dynamic) if(chunks>1)
+	for (long chunk=0;chunk<chunks;++chunk){
+		const std::size_t first=chunk*kIntegrationChunk;
+		const std::size_t last=std::min(first+kIntegrationChunk,sensors);
+		switch (scheme){
+		case integrateFirstOrder:
+			integrateChunk<integrateFirstOrder>(rates,dt,orientations,first,last,renormalizeEvery);
+			break;
+		case integrateMagnus:
+			integrateChunk<integrateMagnus>(rates,dt,orientations,first,last,renormalizeEvery);
+			break;
+		default:
+			integrateChunk<integrateRK4>(rates,dt,orientations,first,last,renormalizeEvery);
+			break;
+		}
+	}
+}
+
+// End of file
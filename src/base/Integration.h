@@ -0,0 +1,138 @@
+/* File Integration.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Integration of gyroscope (angular rate) samples into orientations, for one or many sensors
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_INTEGRATION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_INTEGRATION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+#include "AlignedAllocator.h"
+#include "Rotation.h"
+
+// Include STL headers
+#include <cstddef>
+
+/* Note: a gyroscope measures the angular rate w (rad/s) in the frame of the
+ * sensor (the body frame). The orientation q (body to world) then follows
+ *     dq/dt = q*(0,w)/2
+ * and over a short step dt, with the rate constant, the exact solution is
+ *     q(t+dt) = q(t)*exp((0,w*dt)/2)
+ * i.e. a multiplication by the small "delta" rotation of angle |w|*dt
+ * around w. The schemes below differ in how they treat a rate that changes
+ * during the step. The samples w[0..n-1] are taken every dt, and every
+ * scheme integrates from the time of the first sample to that of the last,
+ * n-1 steps in all:
+ *
+ *     integrateFirstOrder  delta rotation of w[s]*dt (the rate at the start
+ *                          of the step). Error O(dt) over a fixed interval.
+ *     integrateMagnus      delta rotation of the Magnus (coning-corrected)
+ *                          rotation vector (w[s]+w[s+1])*dt/2 +
+ *                          (w[s] x w[s+1])*dt^2/12: the Magnus series of
+ *                          a rate that varies linearly during the step,
+ *                          truncated after its second (coning) term, so
+ *                          even that rate leaves a small error. O(dt^2).
+ *     integrateRK4         classical 4th order Runge-Kutta on dq/dt above,
+ *                          with the rate interpolated linearly. O(dt^2) too,
+ *                          because the interpolated rate is only 2nd order,
+ *                          and it isn't an exact rotation, so it needs the
+ *                          renormalization. It is here as the textbook
+ *                          reference; in the batch version it costs about as
+ *                          much as Magnus, which needs a sin and a cos.
+ *
+ * The delta rotations are unit quaternions, but every product rounds, so
+ * the norm of q drifts by about an epsilon per step. renormalizeEvery=k
+ * divides q by its norm every k steps (1, every step, by default; 0 never).
+ */
+
+namespace Quaternions{
+
+// The integration schemes
+typedef enum{
+	integrateFirstOrder,
+	integrateMagnus,
+	integrateRK4
+}IntegrationScheme;
+
+/**
+ * GyroSamples holds the angular rates of many sensors, all sampled at the
+ * same times. They are stored sample by sample, and within a sample as a
+ * structure of arrays over the sensors (all x's, then all y's, then all z's),
+ * so that one step of many sensors is a vectorizable loop over contiguous
+ * memory. Every row of the arrays starts on a cache line.
+ */
+class GyroSamples
+{
+public :
+	GyroSamples() {}
+	GyroSamples(std::size_t sensors, std::size_t samples) {resize(sensors,samples);}
+
+	std::size_t sensors() const {return sensors_;}
+	std::size_t samples() const {return samples_;}
+
+	// Change the size. All the rates are reset to zero
+	void resize(std::size_t sensors, std::size_t samples);
+
+	// Gather/scatter the rate of one sensor at one sample
+	Vector3 get(std::size_t sample, std::size_t sensor) const
+	{
+		const std::size_t n=sample*stride_+sensor;
+		return Vector3{x_[n],y_[n],z_[n]};
+	}
+	void set(std::size_t sample, std::size_t sensor, const Vector3 &rate)
+	{
+		const std::size_t n=sample*stride_+sensor;
+		x_[n]=rate.x; y_[n]=rate.y; z_[n]=rate.z;
+	}
+
+	// Raw access to the rates of all the sensors at one sample
+	double *x(std::size_t sample) {return x_.data()+sample*stride_;}
+	double *y(std::size_t sample) {return y_.data()+sample*stride_;}
+	double *z(std::size_t sample) {return z_.data()+sample*stride_;}
+	const double *x(std::size_t sample) const {return x_.data()+sample*stride_;}
+	const double *y(std::size_t sample) const {return y_.data()+sample*stride_;}
+	const double *z(std::size_t sample) const {return z_.data()+sample*stride_;}
+
+private:
+	std::size_t sensors_=0;
+	std::size_t samples_=0;
+	std::size_t stride_=0; // Sensors rounded up to a whole number of cache lines
+
+	AlignedVector<double> x_;
+	AlignedVector<double> y_;
+	AlignedVector<double> z_;
+
+}; // End of GyroSamples class
+
+// Integrate the rates of one sensor, sampled every dt seconds, starting from
+// the orientation q0. Returns the orientation at the time of the last sample
+/* Note: this version is built on the Quaternion operators (Hamilton product
+ * and exp) and is the reference for the batch version below
+ */
+Quaternion integrate(const Quaternion &q0, const Vector3 *rates, std::size_t samples, double dt,
+	IntegrationScheme scheme, std::size_t renormalizeEvery=1);
+
+// Number of sensors integrated together by one thread
+const std::size_t kIntegrationChunk=256;
+
+// Integrate many sensors at once: orientations holds the initial orientation
+// of every sensor, and is updated to the orientation at the last sample
+/* Note: the sensors are split in chunks of kIntegrationChunk. Every chunk is
+ * integrated over all the samples by one thread, one step at a time for the
+ * whole chunk with vectorized kernels, while its orientations stay in the L1
+ * cache. The chunks are handed out to the OpenMP threads dynamically, so a
+ * thread that is slowed down (or shares its core) simply takes fewer chunks.
+ * The results match the single sensor version to within rounding (the delta
+ * rotations use a polynomial instead of std::sin and std::cos, so that they
+ * vectorize), and don't depend on the number of threads.
+ */
+void integrate(const GyroSamples &rates, double dt, IntegrationScheme scheme,
+	QuaternionBatch &orientations, std::size_t renormalizeEvery=1);
+
+} // End namespace Quaternions
+
+#endif
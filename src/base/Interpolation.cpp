@@ -0,0 +1,105 @@
+/* File Interpolation.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the batch interpolation kernels
+ * \author Nikos Kazazakis
+ */
+
+#include "Interpolation.h"
+
+// Other includes
+#include <cassert>
+
+using namespace Quaternions;
+
+/* Note: every kernel gathers element n of each input into a quaternion, calls
+ * the inline scalar function and scatters the result. Once the scalar function
+ * is inlined the quaternions only live in registers, so this costs nothing,
+ * and it guarantees that the batch and scalar versions give identical results.
+ * "parallel for simd" splits the loop across the threads and vectorizes each
+ * chunk, with a signed loop counter for old OpenMP versions.
+ */
+
+// Gather element n of a batch
+#define QUATERNION_GATHER(q,n) BasicQuaternion<T>(q##w[n],q##i[n],q##j[n],q##k[n])
+
+// Interpolate every pair of q0 and q1 with the scalar function "function"
+template <typename T, typename Function>
+static void interpolateBatch(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t,
+		BasicQuaternionBatch<T> &out, Function function)
+{
+	assert(q0.size()==q1.size() && "Batch sizes must match");
+	const long size=static_cast<long>(q0.size());
+	out.resize(q0.size());
+
+	const T *aw=q0.w(), *ai=q0.i(), *aj=q0.j(), *ak=q0.k();
+	const T *bw=q1.w(), *bi=q1.i(), *bj=q1.j(), *bk=q1.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		const BasicQuaternion<T> q=function(QUATERNION_GATHER(a,n),QUATERNION_GATHER(b,n),t[n]);
+		ow[n]=q.w();
+		oi[n]=q.i();
+		oj[n]=q.j();
+		ok[n]=q.k();
+	}
+}
+
+template <typename T>
+void Quaternions::slerp(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t, BasicQuaternionBatch<T> &out)
+{
+	interpolateBatch(q0,q1,t,out,[](const BasicQuaternion<T> &a, const BasicQuaternion<T> &b, T s){return slerp(a,b,s);});
+}
+
+template <typename T>
+void Quaternions::nlerp(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t, BasicQuaternionBatch<T> &out)
+{
+	interpolateBatch(q0,q1,t,out,[](const BasicQuaternion<T> &a, const BasicQuaternion<T> &b, T s){return nlerp(a,b,s);});
+}
+
+template <typename T>
+void Quaternions::fastSlerp(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t, BasicQuaternionBatch<T> &out)
+{
+	interpolateBatch(q0,q1,t,out,[](const BasicQuaternion<T> &a, const BasicQuaternion<T> &b, T s){return fastSlerp(a,b,s);});
+}
+
+template <typename T>
+void Quaternions::squad(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1,
+		const BasicQuaternionBatch<T> &s0, const BasicQuaternionBatch<T> &s1, const T *t, BasicQuaternionBatch<T> &out)
+{
+	assert(q0.size()==q1.size() && q0.size()==s0.size() && q0.size()==s1.size() && "Batch sizes must match");
+	const long size=static_cast<long>(q0.size());
+	out.resize(q0.size());
+
+	const T *aw=q0.w(), *ai=q0.i(), *aj=q0.j(), *ak=q0.k();
+	const T *bw=q1.w(), *bi=q1.i(), *bj=q1.j(), *bk=q1.k();
+	const T *cw=s0.w(), *ci=s0.i(), *cj=s0.j(), *ck=s0.k();
+	const T *dw=s1.w(), *di=s1.i(), *dj=s1.j(), *dk=s1.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp parallel for simd schedule(static)
+	for (long n=0;n<size;++n){
+		const BasicQuaternion<T> q=squad(QUATERNION_GATHER(a,n),QUATERNION_GATHER(b,n),
+				QUATERNION_GATHER(c,n),QUATERNION_GATHER(d,n),t[n]);
+		ow[n]=q.w();
+		oi[n]=q.i();
+		oj[n]=q.j();
+		ok[n]=q.k();
+	}
+}
+
+#undef QUATERNION_GATHER
+
+// Explicit instantiations: compile the kernels for float and double
+#define QUATERNION_INSTANTIATE_INTERPOLATION(T) \
+	template void Quaternions::slerp(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, const T *, BasicQuaternionBatch<T> &); \
+	template void Quaternions::nlerp(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, const T *, BasicQuaternionBatch<T> &); \
+	template void Quaternions::fastSlerp(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, const T *, BasicQuaternionBatch<T> &); \
+	template void Quaternions::squad(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, \
+			const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, const T *, BasicQuaternionBatch<T> &);
+
+QUATERNION_INSTANTIATE_INTERPOLATION(float)
+QUATERNION_INSTANTIATE_INTERPOLATION(double)
+
+// End of file
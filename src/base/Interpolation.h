@@ -0,0 +1,188 @@
+/* File Interpolation.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Interpolation between orientations: SLERP, NLERP, fast approximate SLERP and SQUAD
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_INTERPOLATION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_INTERPOLATION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+
+// Include STL headers
+#include <cmath>
+#include <limits>
+
+/* Note: all the functions in this file expect UNIT quaternions and return
+ * unit quaternions (up to rounding). t=0 gives q0 and t=1 gives q1.
+ *
+ * Which one should I use? (errors measured over 10^6 random pairs and t in
+ * [0,1], as the angle of the rotation between the result and the exact slerp)
+ *
+ *   function    | cost             | max error (double) | max error (float)
+ *   ------------+------------------+--------------------+-------------------
+ *   slerp       | atan2 + 3 sin    | 1e-15 rad          | 5e-7 rad
+ *   fastSlerp   | polynomial, sqrt | 8e-4 rad           | 8e-4 rad
+ *   nlerp       | sqrt             | 0.14 rad (8 deg)   | 0.14 rad (8 deg)
+ *
+ * slerp moves at constant angular velocity along the shortest arc and is
+ * the reference. nlerp follows the same arc but not at constant speed: it
+ * is exact at t=0, 1/2 and 1, and the error grows with the angle between
+ * q0 and q1 (the 8 degrees are for keyframes 180 degrees apart; for 30
+ * degrees apart it is 0.03 degrees). fastSlerp corrects t with a
+ * polynomial fitted to the slerp velocity (A. Kapoulkine, "Approximating
+ * slerp", 2015), which makes nlerp nearly exact at the cost of a few more
+ * multiplications. Its error does not improve in double precision, because
+ * it comes from the fit, not from rounding.
+ */
+
+namespace Quaternions{
+
+// Implementation helpers, not part of the interface
+namespace InterpolationDetail{
+
+// Spherical interpolation along the arc from q0 to q1, without taking the
+// shortest path. This is what SQUAD needs
+/* Note: the textbook formula computes the angle as acos(dot(q0,q1)), which
+ * loses half of the significant digits when the quaternions are close (the
+ * most common case for keyframes sampled at a high rate). The half chord
+ * lengths |q1-q0|=2sin(angle/2) and |q1+q0|=2cos(angle/2) give the angle with
+ * atan2 at full precision for every angle.
+ * Small-angle fallback: sin(t*angle)/sin(angle)=t*(1-(t^2-1)*angle^2/6+...),
+ * so once angle^2 is below the machine epsilon the linear weights are exact
+ * to the last bit, and we use them instead of dividing by sin(0)=0.
+ */
+template <typename T>
+inline BasicQuaternion<T> slerpArc(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1, T t)
+{
+	const T angle=T(2)*std::atan2(std::sqrt(dot(q1-q0,q1-q0)),std::sqrt(dot(q1+q0,q1+q0)));
+	T a, b;
+	if (angle<std::sqrt(std::numeric_limits<T>::epsilon())){
+		a=T(1)-t;
+		b=t;
+	}
+	else{
+		const T s=std::sin(angle);
+		a=std::sin((T(1)-t)*angle)/s;
+		b=std::sin(t*angle)/s;
+	}
+	return a*q0+b*q1;
+}
+
+// q and -q are the same rotation. Flip q1 to the hemisphere of q0, so that
+// interpolation takes the shortest path (at most 180 degrees)
+template <typename T>
+inline BasicQuaternion<T> nearest(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1)
+{
+	// Select the sign rather than the quaternion: a select is a single
+	// blend instruction, while a branch would stop the batch loops vectorizing
+	const T sign=std::copysign(T(1),dot(q0,q1));
+	return sign*q1;
+}
+
+// Normalized linear interpolation of two quaternions in the same hemisphere
+template <typename T>
+inline BasicQuaternion<T> normalizedLerp(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1, T t)
+{
+	const BasicQuaternion<T> q=(T(1)-t)*q0+t*q1;
+	return (T(1)/std::sqrt(dot(q,q)))*q;
+}
+
+/* Note: the helpers above compute lengths as sqrt(dot(q,q)) rather than
+ * q.norm(), which gives the same result but is inline (norm() is compiled in
+ * Quaternion.cpp), so the batch kernels can inline and vectorize everything
+ */
+
+} // End namespace InterpolationDetail
+
+/* Note: the interpolation parameter is "typename BasicQuaternion<T>::Scalar"
+ * rather than T so that it doesn't take part in template argument deduction:
+ * this way slerp(qf0,qf1,0.5) works for float quaternions with a double t.
+ */
+
+// Spherical linear interpolation along the shortest path, at constant angular velocity
+template <typename T>
+inline BasicQuaternion<T> slerp(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1, typename BasicQuaternion<T>::Scalar t)
+{
+	return InterpolationDetail::slerpArc(q0,InterpolationDetail::nearest(q0,q1),t);
+}
+
+// Normalized linear interpolation: the cheapest option, see the table above for its error
+template <typename T>
+inline BasicQuaternion<T> nlerp(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1, typename BasicQuaternion<T>::Scalar t)
+{
+	return InterpolationDetail::normalizedLerp(q0,InterpolationDetail::nearest(q0,q1),t);
+}
+
+// Approximate slerp: nlerp with a corrected interpolation parameter ("onlerp")
+template <typename T>
+inline BasicQuaternion<T> fastSlerp(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1, typename BasicQuaternion<T>::Scalar t)
+{
+	const BasicQuaternion<T> q1n=InterpolationDetail::nearest(q0,q1);
+	const T d=dot(q0,q1n); // cos(angle), in [0,1]
+	// The polynomial fit to the slerp velocity
+	const T ca=T(1.0904)+d*(T(-3.2452)+d*(T(3.55645)-d*T(1.43519)));
+	const T cb=T(0.848013)+d*(T(-1.06021)+d*T(0.215638));
+	const T k=ca*(t-T(0.5))*(t-T(0.5))+cb;
+	const T tCorrected=t+t*(t-T(0.5))*(t-T(1))*k;
+	return InterpolationDetail::normalizedLerp(q0,q1n,tCorrected);
+}
+
+// === SQUAD (spherical quadrangle) splines ===
+/* Note: squad interpolates keyframe q0 to keyframe q1 like slerp, but the
+ * angular velocity is continuous across keyframes (slerp turns sharply at
+ * every keyframe). It needs one control point per keyframe:
+ *
+ *     s[n]=squadControlPoint(q[n-1],q[n],q[n+1]);
+ *     orientation=squad(q[n],q[n+1],s[n],s[n+1],t);
+ *
+ * (for the first and last keyframes use s=q). Every keyframe must be in the
+ * same hemisphere as the previous one, dot(q[n],q[n+1])>=0; negate the ones
+ * that are not (q and -q are the same rotation). squad does not flip them
+ * itself, because the control points would no longer match.
+ */
+
+// Control point of keyframe q, from its neighbours: q*exp(-(log(q^{-1}qNext)+log(q^{-1}qPrevious))/4)
+template <typename T>
+inline BasicQuaternion<T> squadControlPoint(const BasicQuaternion<T> &qPrevious, const BasicQuaternion<T> &q, const BasicQuaternion<T> &qNext)
+{
+	const BasicQuaternion<T> inverse=q.conjugate(); // q is a unit quaternion
+	return q*exp(T(-0.25)*(log(inverse*InterpolationDetail::nearest(q,qNext))+log(inverse*InterpolationDetail::nearest(q,qPrevious))));
+}
+
+// Interpolate between keyframes q0 and q1 with control points s0 and s1
+template <typename T>
+inline BasicQuaternion<T> squad(const BasicQuaternion<T> &q0, const BasicQuaternion<T> &q1,
+		const BasicQuaternion<T> &s0, const BasicQuaternion<T> &s1, typename BasicQuaternion<T>::Scalar t)
+{
+	return InterpolationDetail::slerpArc(InterpolationDetail::slerpArc(q0,q1,t),InterpolationDetail::slerpArc(s0,s1,t),T(2)*t*(T(1)-t));
+}
+
+// === Batch interpolation ===
+/* Note: element n of the output interpolates element n of the inputs with
+ * parameter t[n], so t must hold q0.size() values and all the batches must have
+ * the same size. The output is resized to match. As with the other kernels,
+ * the work is split across the OpenMP threads and the output may be one of
+ * the inputs. The results are bit-for-bit identical to the functions above.
+ * Compiled for float and double in Interpolation.cpp.
+ */
+
+template <typename T>
+void slerp(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t, BasicQuaternionBatch<T> &out);
+
+template <typename T>
+void nlerp(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t, BasicQuaternionBatch<T> &out);
+
+template <typename T>
+void fastSlerp(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1, const T *t, BasicQuaternionBatch<T> &out);
+
+template <typename T>
+void squad(const BasicQuaternionBatch<T> &q0, const BasicQuaternionBatch<T> &q1,
+		const BasicQuaternionBatch<T> &s0, const BasicQuaternionBatch<T> &s1, const T *t, BasicQuaternionBatch<T> &out);
+
+} // End namespace Quaternions
+
+#endif
@@ -1,363 +1,164 @@
 /* File Quaternion.cpp
- * 
+ *
  * Copyright (c) Nikos Kazazakis 2016
  * \brief Implementation of a Quaternion arithmetic library in C++14
  * \author Nikos Kazazakis
  */
 
-/* Include the header file of the class. Note that this carries over 
+/* Include the header file of the class. Note that this carries over
  * any includes we made in the header */
 #include "Quaternion.h"
 
 // Other includes
-#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <type_traits>
 
 // Define our namespace. This conveniently allows us to use all our
 // definitions without the Quaternions:: prefix
 using namespace Quaternions;
 
-// Default constructor: create zero (nonempty!) quaternion
-Quaternion::Quaternion() // TODO: Think about creating a sparse quaternion instead
-{
-	// Assign quaternion values using std::map
-	// - Real part
-	elements_[qw]=0;
-	// - Vector part
-	elements_[qi]=0;
-	elements_[qj]=0;
-	elements_[qk]=0;
-}
-
-// Consrtuct a quaternion by defining all its elements
-Quaternion::Quaternion(double w, double i, double j, double k)
-{
-	// Assign quaternion values
-	// - Real part
-	if (w!=0){elements_[qw]=w;} // The quaternion is sparse; we only assign a value if it's non-zero
-	// - Vector part
-	if (i!=0){elements_[qi]=i;}
-	if (j!=0){elements_[qj]=j;}
-	if (k!=0){elements_[qk]=k;}
-}
-
-// Default destructor. All data in an object is (usually) stored in its private members
-// so when the object is destroyed we must deallocate that memory.
-// An exception is when using shared pointers, where the destructor will simply
-// decrease the reference count by 1.
-// It is good practice to write code for the destruction of an object here when you 
-// first create it, to avoid memory leaks
-Quaternion::~Quaternion()
-{
-	 // Techincally not necessary because it's an STL object, but good practice to 
-	//  get in the habid of destroying the private members
-	elements_.clear();
-}
-
-// ===Begin member operator overloading===
-// Copy constructor
-Quaternion::Quaternion(const Quaternion &q)
-{
-	// Currently a place holder, we don't use this yet
-	cout<<"Copy constructor invoked (not yet implemented)"<<endl;
-	// Don't let the user run this thinking it's working
-	assert(!"Copy constructor invoked (not yet implemented)"); 
-}
-
-// Copy assignment operator
-void Quaternion::operator=(Quaternion &q) // has to return void to agree with our move semantics
-{
-	/* Use ranged-for loop for better performance. We don't want to give this permission
-	 * to access the map, by writing a public function to return it, so we access it as 
-	 * a private member
-	 */
-	/* Note: you'll see further down that we use old-style C++ loops for the non-member operators
-	 *       this is because non-members don't have access to elements_ (it's private)! Can be 
-	 *       changed using "friends", but I find that too permissive
-	 */
-	for (auto &element : q.elements_ ){ 
-		elements_[element.first]=element.second;                 
-	}  
-}
-
-// Move assignment operator
-void Quaternion::operator=(Quaternion &&q)
-{
-//	cout<<"Move assignment operator invoked"<<endl;
-	for (auto &&element : q.elements_ ){ 
-		elements_[element.first]=element.second;                 
-	}  
-}
-
-// ====End member operator overloading====
-
-// Return the conjugate of this quaternion. C++11 moves the q stack variable to
-// the return output automatically
-Quaternion Quaternion::conjugate()
-{
-	Quaternion q = Quaternion(w(),-i(),-j(),-k());
-	return q;
-}
+// Make sure nobody accidentally breaks the dense layout guarantees
+static_assert(std::is_trivially_copyable<Quaternion>::value,"Quaternion must be trivially copyable");
+static_assert(sizeof(Quaternion)==4*sizeof(double),"Quaternion must be exactly four packed doubles");
+static_assert(alignof(Quaternion)==32,"Quaternion must be 32-byte aligned");
+static_assert(std::is_literal_type<Quaternion>::value,"Quaternion must be usable in constant expressions");
+static_assert(std::is_trivially_copyable<QuaternionF>::value && sizeof(QuaternionF)==4*sizeof(float),"QuaternionF must be four packed floats");
 
 // Return the norm of the quaternion
-double Quaternion::norm() const
-{
-	double norm=0.0;
-	// Use a const_iterator even though its redundant (it's good practice!)
-	// This is an old-style C++ loop, here for demonstration reasons. 
-	// For the new loops we can use for (const auto ...) instead of the const_iterator
-	// TODO: replace this with a C++11 version in next revision
-	for ( std::map<AxisType,double>::const_iterator element=elements_.begin();element!=elements_.end();++element )
-	{
-		norm+=pow((*element).second,2); // TODO: Use bitwise operations to massively improve speed
-	}
-	norm=std::sqrt(norm);
-	return norm;
-}
-
-// Return whether the elements_ map size is zero
-bool Quaternion::isEmpty() const
+template <typename T>
+T BasicQuaternion<T>::norm() const
 {
-	if (elements_.empty()){
-		return true;
-	}else{
-		return false;
-	}
+	QUATERNION_TIME(opNorm);
+	// Plain products instead of pow(x,2) (see squaredNorm): pow is a library call, x*x is one instruction
+	return std::sqrt(squaredNorm());
 }
 
 // Print output. Prints to cout by default
-void Quaternion::write(std::ostream &out) const
+/* Note: only the non-zero elements are printed, which gives the same notation
+ * as the sparse storage did, e.g. "+1+2j" for Quaternion(1,0,2,0)
+ */
+template <typename T>
+void BasicQuaternion<T>::write(std::ostream &out) const
 {
-	for (const auto &element : elements_ ){ // We use a reference to the elements to avoid a copy!
-		if (element.second != 0.0 ){
-			cout<<std::showpos<<element.second; // Show the +/- sign if non-zero
-		}else{
-			cout<<element.second;
+	bool printed=false;
+	for (auto it=elementsBegin();it!=elementsEnd();++it){
+		if ((*it).second == 0.0 ){
+			continue;
 		}
-		switch (element.first){ // Print the appropriate unit vectors
+		out<<std::showpos<<(*it).second; // Show the +/- sign
+		switch ((*it).first){ // Print the appropriate unit vectors
 		case qw:
 			break;
 		case qi:
-			cout<<"i";
+			out<<"i";
 			break;
 		case qj:
-			cout<<"j";
+			out<<"j";
 			break;
 		case qk:
-			cout<<"k";
+			out<<"k";
 			break;
 		default:
 			// No default behaviour specified, break
 			break;
 		}
+		printed=true;
 	}
-	cout<<std::noshowpos; // Reset the showpos format
-}
-
-double Quaternion::w() const
-{
-	if ( elements_.find(qw) == elements_.end() ) {
-		return 0.0;
-	} else {
-		return elements_.at(qw);
-	}
-}
-
-double Quaternion::i() const
-{
-	if ( elements_.find(qi) == elements_.end() ) {
-		return 0.0;
-	} else {
-		return elements_.at(qi);
-	}
-}
-
-double Quaternion::j() const
-{
-	if ( elements_.find(qj) == elements_.end() ) {
-		return 0.0;
-	} else {
-		return elements_.at(qj);
-	}
-}
-
-double Quaternion::k() const
-{
-	if ( elements_.find(qk) == elements_.end() ) {
-		return 0.0;
-	} else {
-		return elements_.at(qk);
-	}
-}
-// ==== Begin non-member operator overloading ===
-// - Quaternion addition
-Quaternion Quaternions::operator+(const Quaternion &q1, const Quaternion &q2)
-{
-	if (q1.isEmpty() && q2.isEmpty() ){
-		assert(!"Addition of two uninitialized quaternions"); // FIXME: this doesn't properly detect the uninitialized map
-	}
-	Quaternion q = Quaternion(
-			q1.w()+q2.w(),
-			q1.i()+q2.i(),
-			q1.j()+q2.j(),
-			q1.k()+q2.k() );
-
-	return q;
-}
-
-Quaternion Quaternions::operator+(const double c, const Quaternion &q2)
-{
-	if (q2.isEmpty() ){
-		assert(!"Addition of two uninitialized quaternions"); // FIXME: this doesn't properly detect the uninitialized map
-	}
-	Quaternion q = Quaternion(
-			c+q2.w(),
-			c+q2.i(),
-			c+q2.j(),
-			c+q2.k() );
-
-	return q;
-}
-
-Quaternion Quaternions::operator+(const Quaternion &q2, const double c)
-{
-	if (q2.isEmpty() ){
-		assert(!"Addition of two uninitialized quaternions"); // FIXME: this doesn't properly detect the uninitialized map
-	}
-	Quaternion q = Quaternion(
-			c+q2.w(),
-			c+q2.i(),
-			c+q2.j(),
-			c+q2.k() );
-
-	return q;
-}
-
-// Quaternion subtraction
-Quaternion Quaternions::operator-(const Quaternion &q1, const Quaternion &q2)
-{
-	if (q1.isEmpty() && q2.isEmpty() ){
-		assert(!"Subtraction of two uninitialized quaternions"); // FIXME: this doesn't properly detect the uninitialized map
-	}
-	Quaternion q = Quaternion(
-			q1.w()-q2.w(),
-			q1.i()-q2.i(),
-			q1.j()-q2.j(),
-			q1.k()-q2.k() );
-
-	return q;
-}
-
-Quaternion Quaternions::operator-(const double c, const Quaternion &q2)
-{
-	if (q2.isEmpty() ){
-		assert(!"Subtraction of two uninitialized quaternions"); // FIXME: this doesn't properly detect the uninitialized map
+	if (!printed){
+		out<<T(0); // The zero quaternion
 	}
-	Quaternion q = Quaternion(
-			c-q2.w(),
-			c-q2.i(),
-			c-q2.j(),
-			c-q2.k() );
-
-	return q;
+	out<<std::noshowpos; // Reset the showpos format
 }
 
-Quaternion Quaternions::operator-(const Quaternion &q2, const double c)
-{
-	if (q2.isEmpty() ){
-		assert(!"Subtraction of two uninitialized quaternions"); // FIXME: this doesn't properly detect the uninitialized map
-	}
-	Quaternion q = Quaternion(
-			q2.w()-c,
-			q2.i()-c,
-			q2.j()-c,
-			q2.k()-c );
+// Convert a C string to a number, with the strto* function of each type
+static inline float parseScalar(const char *text, char **end, float){return std::strtof(text,end);}
+static inline double parseScalar(const char *text, char **end, double){return std::strtod(text,end);}
+static inline long double parseScalar(const char *text, char **end, long double){return std::strtold(text,end);}
 
-	return q;
-}
-
-// - Multiplication
-//   == Scalar multiplication
-Quaternion Quaternions::operator*(const double c, Quaternion &q2) // double
-{
-	Quaternion q = Quaternion();
-	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
-		q[(*it).first]=c*(*it).second;
-	}
-	return q;
-}
+// Read a quaternion in the write() notation
+/* Note: we don't use in>>value for the numbers. The formatted extraction goes
+ * through the locale machinery for every character and is several times
+ * slower than copying the term into a small buffer and calling strtod.
+ */
+template <typename T>
+std::istream &Quaternions::operator>>(std::istream &in, BasicQuaternion<T> &q)
+{
+	const std::istream::sentry sentry(in); // Skips leading whitespace
+	if (!sentry){
+		return in;
+	}
+
+	T elements[4]={T(0),T(0),T(0),T(0)};
+	char term[64];
+	while (true){
+		// Copy the number: sign, digits, decimal point and exponent (with its own sign)
+		std::size_t length=0;
+		int c=in.peek();
+		while (length<sizeof(term)-1 && (std::isdigit(c) || c=='.' || c=='e' || c=='E' ||
+				((c=='+' || c=='-') && (length==0 || term[length-1]=='e' || term[length-1]=='E')))){
+			term[length++]=static_cast<char>(in.get());
+			c=in.peek();
+		}
+		// Or the non-finite numbers that write() prints, "inf" and "nan"
+		if (length==0 || (length==1 && (term[0]=='+' || term[0]=='-'))){
+			const char *word= std::tolower(c)=='n' ? "nan" : "inf";
+			for (std::size_t n=0;n<3 && std::tolower(c)==word[n];++n){
+				term[length++]=static_cast<char>(in.get());
+				c=in.peek();
+			}
+		}
+		term[length]='\0';
 
-Quaternion Quaternions::operator*(const int c, Quaternion &q2) // int
-{
-	Quaternion q = Quaternion();
-	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
-		q[(*it).first]=(double)(c)*(*it).second;  // Typecast int to double
-	}
-	return q;
-}
+		char *end=nullptr;
+		const T value=parseScalar(term,&end,T());
+		if (length==0 || end!=term+length){
+			in.setstate(std::ios::failbit);
+			return in;
+		}
 
-Quaternion Quaternions::operator*(Quaternion &q2, const double c) // double
-{
-	Quaternion q = Quaternion();
-	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
-		q[(*it).first]=c*(*it).second;
-	}
-	return q;
-}
+		// The unit vector, if any
+		AxisType axis=qw;
+		switch (c){
+		case 'i':
+			axis=qi;
+			break;
+		case 'j':
+			axis=qj;
+			break;
+		case 'k':
+			axis=qk;
+			break;
+		default:
+			break;
+		}
+		if (axis!=qw){
+			in.get();
+			c=in.peek();
+		}
+		elements[axis]+=value;
 
-Quaternion Quaternions::operator*(Quaternion &q2, const int c) // int
-{
-	Quaternion q = Quaternion();
-	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
-		q[(*it).first]=(double)(c)*(*it).second;  // Typecast int to double
+		// Every term after the first starts with its sign
+		if (c!='+' && c!='-'){
+			break;
+		}
 	}
-	return q;
-}
 
-// == Quaternion multiplication
-Quaternion Quaternions::operator*(const Quaternion &q1, const Quaternion &q2) // FIXME: See if I can speed this up
-{
-	Quaternion q = Quaternion();
-	// Real part
-	q[qw]=	 q1.w()*q2.w()
-		-q1.i()*q2.i()
-		-q1.j()*q2.j()
-		-q1.k()*q2.k();
-	// i
-	q[qi]=   q1.w()*q2.i()
-		+q1.i()*q2.w()
-		+q1.j()*q2.k()
-		-q1.k()*q2.j();
-	// j
-	q[qj]=   q1.w()*q2.j()
-		-q1.i()*q2.k()
-		+q1.j()*q2.w()
-		+q1.k()*q2.i();
-	// k
-	q[qk]=   q1.w()*q2.k()
-		+q1.i()*q2.j()
-		-q1.j()*q2.i()
-		+q1.k()*q2.w();
-//	cout<<"returning move operation"<<endl;
-	return q;
+	q=BasicQuaternion<T>(elements[qw],elements[qi],elements[qj],elements[qk]);
+	return in;
 }
 
-// Comparison operators
-bool Quaternions::operator==(const Quaternion &q1, const Quaternion &q2)
-{
-	bool isEqual=true; // Initialize in case q1.w is empty
-
-	isEqual = (q1.w()==q2.w());
-	if (isEqual){isEqual = (q1.i()==q2.i());}
-	if (isEqual){isEqual = (q1.j()==q2.j());}
-	if (isEqual){isEqual = (q1.k()==q2.k());}
-
-	return isEqual;
-}
+/* Note: the arithmetic and comparison operators are expression templates,
+ * so they are defined in QuaternionExpression.h
+ */
 
-bool Quaternions::operator!=(const Quaternion &q1, const Quaternion &q2)
-{
-	return !(q1==q2);
-}
-// ======End non-member operator overloading======
+// Explicit instantiations. These compile the out-of-line members (and operator>>)
+// once, here, for the three supported types (see the "extern template" in the header)
+template class Quaternions::BasicQuaternion<float>;
+template class Quaternions::BasicQuaternion<double>;
+template class Quaternions::BasicQuaternion<long double>;
+template std::istream &Quaternions::operator>>(std::istream &, BasicQuaternion<float> &);
+template std::istream &Quaternions::operator>>(std::istream &, BasicQuaternion<double> &);
+template std::istream &Quaternions::operator>>(std::istream &, BasicQuaternion<long double> &);
 
 // End of file
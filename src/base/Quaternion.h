@@ -1,5 +1,5 @@
 /* File Quaternion.h
- * 
+ *
  * Copyright (c) Nikos Kazazakis 2016
  * \brief Define Quaternion class for quaternion arithmetic in C++14
  * \author Nikos Kazazakis
@@ -9,9 +9,13 @@
 #define QUATERNION_LIB
 
 // Include STL headers
+#include <cassert>
 #include <iostream>
 #include <cmath>
-#include <map>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <type_traits>
 
 // Define some commonly used std functions for convenience
 /* Note how we don't simply use "using namespace std;"
@@ -45,88 +49,149 @@ typedef enum{
 	qk
 }AxisType;
 
-// Forward-declare the class to define operators
-class Quaternion;
-
-// === Object versions ===
-// - Addition and subtraction
-Quaternion operator+(const Quaternion &q1, const Quaternion &q2);  // std::map[] can't be const, however map.at is!
-Quaternion operator-(const Quaternion &q1, const Quaternion &q2);
+} // End namespace Quaternions
 
-Quaternion operator+(const double c, const Quaternion &q2);
-Quaternion operator+(const Quaternion &q2,const double c);
+// The arithmetic and comparison operators are expression templates
+#include "QuaternionExpression.h"
 
-Quaternion operator-(const double c, const Quaternion &q2);
-Quaternion operator-(const Quaternion &q2, const double c);
+namespace Quaternions{
 
-// - Multiplication
-//   == Scalar multiplications
-/* Note that we forego passing the quaternions as const so that we
- * can take advantage of r-value semantics
+// Element view returned when iterating over the quaternion components
+/* Note: this mirrors the std::pair interface of the old std::map storage,
+ * so (*it).first is the axis and (*it).second is a reference to the value,
+ * and code written against the map iterators keeps working
  */
-Quaternion operator*(const double c, Quaternion &q2);
-Quaternion operator*(const int c, Quaternion &q2);
-Quaternion operator*(Quaternion &q2, const double c);
-Quaternion operator*(Quaternion &q2, const int c);
-
-//   == Quaternion-quaternion multiplication
-/* We use the formula for the Hamilton product:
- * https://en.wikipedia.org/wiki/Quaternion#Hamilton_product */
-/* Note: Using const here is important! It allows us to chain
- *       multiplications, i.e., q1*q2*q3*q4. This is only possible
- *       if the 2nd argument is a CONST reference. For instance,
- *       q3*q4 returns a temporary object. This cannot bind to the
- *       second argument of the operator for the calculation
- *       q2*(q3*q4) unless it's const (otherwise it will be destroyed
- *       and we will assign a value that's about to disappear!)
+template <typename Value>
+struct QuaternionElement
+{
+	AxisType first;
+	Value &second;
+};
+
+// Iterator over the (axis, value) elements of a dense quaternion
+/* Note: the dereferenced element is a proxy built on the fly, which is
+ * why this is an input iterator rather than a forward iterator
  */
-Quaternion operator*(const Quaternion &q1, const Quaternion &q2);
+template <typename Value>
+class QuaternionElementIterator
+{
+public :
+	typedef std::input_iterator_tag iterator_category;
+	typedef QuaternionElement<Value> value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef QuaternionElement<Value> reference;
+
+	// Helper so that it->first and it->second work like they do for std::map
+	struct pointer
+	{
+		QuaternionElement<Value> element;
+		const QuaternionElement<Value> *operator->() const {return &element;}
+	};
+
+	QuaternionElementIterator(Value *elements, int axis) : elements_(elements), axis_(axis) {}
 
-// Comparison operators
-bool operator==(const Quaternion &q1, const Quaternion &q2);
-bool operator!=(const Quaternion &q1, const Quaternion &q2);
+	reference operator*() const {return reference{static_cast<AxisType>(axis_),elements_[axis_]};}
+	pointer operator->() const {return pointer{**this};}
+
+	QuaternionElementIterator &operator++() {++axis_; return *this;}
+	QuaternionElementIterator operator++(int) {QuaternionElementIterator it=*this; ++axis_; return it;}
+
+	bool operator==(const QuaternionElementIterator &it) const {return elements_==it.elements_ && axis_==it.axis_;}
+	bool operator!=(const QuaternionElementIterator &it) const {return !(*this==it);}
+
+private:
+	Value *elements_;
+	int axis_;
+};
 
 
 /**
- * Quaternion is a base class for performing fast Quaternion arithmetic.
+ * BasicQuaternion is a base class for performing fast Quaternion arithmetic.
  * A quaternion is a vector with 4 components: q = w + a*i + b*j + c*k,
  * where w is the "real part" of the quaternion and "a*i + b*j + c*k" is
  * the "imaginary" or "vector" part.
- * 
- * This class uses commutative operator overloading for basic arithmetic operations,
- * and supports move semantics for efficient calculations.
- * 
- * The quaternion elements are stored in an std::map container to support
- * sparsity and logarithmic lookup complexity (although it's only 4 elements anyway)
- * 
- * The class implements operations with shared pointers to quaternions
- * as well as regular operations, for increased functionality.
- * 
+ *
+ * The template parameter T is the floating point type of the components.
+ * Use the typedefs below: Quaternion (double, the default everywhere in the
+ * library), QuaternionF (float: twice as many components per SIMD register
+ * and half the memory bandwidth) and QuaternionL (long double, for offline
+ * high-accuracy work).
+ *
+ * This class uses commutative operator overloading for basic arithmetic operations.
+ * The operators are lazy expression templates (see QuaternionExpression.h):
+ * a chain such as (2+q1)*q2+2.25 is evaluated in one fused pass when it is
+ * assigned to a Quaternion, without intermediate quaternion objects.
+ * Mixed precision arithmetic follows the C++ promotion rules, e.g. a
+ * QuaternionF times a Quaternion is a double precision expression.
+ * Converting to a wider type (float -> double) is implicit, converting to a
+ * narrower one (double -> float) has to be explicit: QuaternionF(q).
+ *
+ * The quaternion elements are stored densely as four contiguous, aligned
+ * components in the order w, i, j, k. The class is trivially copyable and never
+ * allocates, so copies and moves are plain memory copies and arrays of
+ * quaternions can be handed directly to vectorized kernels.
+ * If you really need the old std::map behaviour, use SparseQuaternion
+ * (SparseQuaternion.h) explicitly.
+ *
+ * BasicQuaternion is also a literal type: the constructors, element access,
+ * conjugate() and all arithmetic and comparison operators are constexpr, so
+ * fixed orientations can be computed by the compiler and stored in read-only
+ * data, e.g.
+ *     constexpr Quaternion mount=kRotationZ90*kRotationX180;
+ * (see StaticRotations.h for canonical rotations and compile-time axis-angle).
+ *
  * Quaternions are particularly interesting in 3D calculations because they
  * provide a more efficient representation of 3D rotations, e.g., if we
  * want to rotate vector p in 3 space, the new vector p' can be acquired
  * by the operation: p'=qpq^{-1}. Notice how this operation involves less calculations
  * than a regular rotation matrix rotation.
- * 
+ *
  * Make sure to report any bugs/design improvements you find! Have fun!
  */
 
-class Quaternion
+// True if From converts to To without losing precision (e.g. float -> double)
+template <typename From, typename To>
+struct IsLosslessConversion :
+	std::integral_constant<bool,std::is_same<typename std::common_type<From,To>::type,To>::value> {};
+
+template <typename T>
+class BasicQuaternion : public QuaternionExpression<BasicQuaternion<T> >
 {
+	static_assert(std::is_floating_point<T>::value,"Quaternion components must be a floating point type");
+
 public :
+	typedef T Scalar;
+	typedef QuaternionElementIterator<T> iterator;
+	typedef QuaternionElementIterator<const T> const_iterator;
+
 	// Default constructor, initialize to zero
-	Quaternion();
-	
+	constexpr BasicQuaternion() : elements_{T(0),T(0),T(0),T(0)} {QUATERNION_COUNT_CONSTEXPR(opConstruct);}
+
 	// Constructor for all 4 parts
-	// Note: to build a quaternion with a custom number of elements
-	// use the [] operator.
-	Quaternion(double w, double i, double j, double k);
-	
-	// Destructor
-	~Quaternion();
-//
-	// Copy constructor
-	Quaternion(const Quaternion &q);
+	// Note: to change individual elements afterwards use the [] operator.
+	constexpr BasicQuaternion(T w, T i, T j, T k) : elements_{w,i,j,k} {QUATERNION_COUNT_CONSTEXPR(opConstruct);}
+
+	// Evaluate an expression, e.g. Quaternion q=q1*q2+q3;
+	/* Note: this is deliberately not explicit, so that expressions can be
+	 * passed wherever a Quaternion is expected. It only takes expressions
+	 * that convert without loss of precision; the overload below handles the
+	 * others, and is explicit so that precision is never lost silently
+	 */
+	template <typename E, typename std::enable_if<IsLosslessConversion<typename E::Scalar,T>::value,int>::type=0>
+	constexpr BasicQuaternion(const QuaternionExpression<E> &q) :
+		elements_{T(q.w()),T(q.i()),T(q.j()),T(q.k())} {QUATERNION_COUNT_CONSTEXPR(opEvaluate);}
+
+	// Narrowing conversion, e.g. QuaternionF qf=QuaternionF(q1*q2);
+	template <typename E, typename std::enable_if<!IsLosslessConversion<typename E::Scalar,T>::value,int>::type=0>
+	explicit constexpr BasicQuaternion(const QuaternionExpression<E> &q) :
+		elements_{T(q.w()),T(q.i()),T(q.j()),T(q.k())} {QUATERNION_COUNT_CONSTEXPR(opEvaluate);}
+
+	/* Note: we deliberately do not declare a destructor, copy/move constructors
+	 * or assignment operators. The compiler-generated ones copy the four components,
+	 * which keeps the class trivially copyable (i.e. memcpy-able). Declaring any
+	 * of them ourselves, even with an empty body, would lose that property.
+	 * This also means assignment returns a reference, so q1=q2=q3 works.
+	 */
 
 	// ==========Overload member operators=========
 	/* TRIVIA: The binary operators = (assignment), [] (array subscription),
@@ -134,47 +199,50 @@ public :
 	 * must always be implemented as member functions, because the syntax of
 	 * the language requires them to.  */
 
-	// Copy Assignment operator
-	/* Note: Once we assign a move assignment operator, the default copy
-	 * assignment operator is deleted, so we have to explicitly define it if
-	 * we wish to maintain the functionality.
-	 */
-	/* Note how these functions are not marked as inline.
-	 * This is because the compiler is smart enough (in most cases) to decide 
-	 * on its own what should be inlined when we turn on optimizations
+	// Assign an expression, e.g. q=q1*q2+q3;
+	/* Note: the expression is fully evaluated before any element is
+	 * overwritten, so the quaternion may appear in the expression itself.
+	 * Like the implicit constructor, this only accepts lossless conversions
 	 */
-	void operator=(Quaternion &q); // FIXME: Consider different design, as this doesn't allow reference chaining, i.e., q1=q2=q3
-
-	// Move assignment operator. Activates in instances such as q1=q2*q3
-	/* Note: the operator overloading for q2*q3 returns a regular l-value.
-	 * The move assignment operator activates if it's used in a temporary
-	 * context, e.g.:
-	 * Quaternion q1;
-	 * q1=q2*q3	 */
-	void operator=(Quaternion &&q);
+	template <typename E, typename std::enable_if<IsLosslessConversion<typename E::Scalar,T>::value,int>::type=0>
+	constexpr BasicQuaternion &operator=(const QuaternionExpression<E> &q)
+	{
+		QUATERNION_COUNT_CONSTEXPR(opEvaluate);
+		const T w=q.w(), i=q.i(), j=q.j(), k=q.k();
+		elements_[qw]=w; elements_[qi]=i; elements_[qj]=j; elements_[qk]=k;
+		return *this;
+	}
 
 	// Overload operator to get and assign individual values
-	double &operator[](AxisType axis){return elements_[axis];}
+	constexpr T &operator[](AxisType axis){return elements_[axis];}
+	constexpr const T &operator[](AxisType axis) const {return elements_[axis];}
 	// =========Done overloading operators========
-	
+
 	/* Get the conjugate of this quaternion */
-	Quaternion conjugate();
-	
+	constexpr BasicQuaternion conjugate() const
+	{
+		QUATERNION_COUNT_CONSTEXPR(opConjugate);
+		return BasicQuaternion(w(),-i(),-j(),-k());
+	}
+
 	// Get element iterators
-	/* Note: can't be const because the return value is an std::map
-	 * element
-	 */
-	auto elementsBegin(){return elements_.begin();}
-	auto elementsEnd(){return elements_.end();}
-	
+	iterator elementsBegin(){return iterator(elements_,qw);}
+	iterator elementsEnd(){return iterator(elements_,qk+1);}
+	const_iterator elementsBegin() const {return const_iterator(elements_,qw);}
+	const_iterator elementsEnd() const {return const_iterator(elements_,qk+1);}
+
 	// Retrieval function for individual elements
-	auto getAxisValue(AxisType axis){return elements_[axis];}
-	
+	constexpr T getAxisValue(AxisType axis) const {return elements_[axis];}
+
+	// Raw access to the four contiguous components (w, i, j, k)
+	constexpr T *data(){return elements_;}
+	constexpr const T *data() const {return elements_;}
+
 	// Check whether the quaternion is empty
-	/* Note: is the map has not been initilized this will always
-	 * return false
+	/* Note: dense storage is always initialized, so this is always false.
+	 * Kept for interface compatibility with SparseQuaternion
 	 */
-	bool isEmpty() const;
+	constexpr bool isEmpty() const {return false;}
 
 	// Print quaternion
 	/* Note: this function has a default argument, as denoted by the "="
@@ -183,32 +251,205 @@ public :
 	void write(std::ostream &out=cout) const;
 
 	// Get individual values.
-	double w()const;
-	double i()const;
-	double j()const;
-	double k()const;
+	/* Note: these are defined in the header so that they can be inlined
+	 * into the operators of other translation units (and used at compile time)
+	 */
+	constexpr T w()const {return elements_[qw];}
+	constexpr T i()const {return elements_[qi];}
+	constexpr T j()const {return elements_[qj];}
+	constexpr T k()const {return elements_[qk];}
 
 	/* Return the norm |q| = sqrt(\sum a_i^2)*/
 	/* Note: Notice that this function is flagged as const. This means that
 	 * it is forbidden to modify any private member, such as elements
-	 * Also note that we don't return a reference. This is because in C++11
-	 * a move operation will be used automatically for all STL objects.
-	 * CAUTION: If the return object is of custom type, the programmer needs
-	 * to code the move semantics for this to work, even if the object is in
-	 * an STL container (e.g. vector<Quaternion> giveMeAQuaternion() const)
-	 * Also note: in this case it's actually more efficient to return by value
+	 * Also note: it's more efficient to return by value
 	 * because the size of a double is about as large as a reference, but as
 	 * a primitive it's blitable
 	 */
-	double norm()const;
+	T norm()const;
+
+	// Return the squared norm |q|^2, the sum of the squared components
+	/* Note: no square root, so prefer it to norm() for comparisons, e.g.
+	 * q.squaredNorm()<r*r rather than q.norm()<r
+	 */
+	constexpr T squaredNorm()const {return w()*w()+i()*i()+j()*j()+k()*k();}
+
+	// Scale this quaternion to unit norm, q=q/|q|. q must not be zero
+	/* Note: one division and four multiplications, instead of four divisions.
+	 * Returns a reference, so that e.g. q.normalize().write() works. For a
+	 * normalized copy use the free function normalize(q)
+	 */
+	BasicQuaternion &normalize()
+	{
+		QUATERNION_COUNT(opNormalize);
+		const T length=norm();
+		assert(length>T(0) && "Can't normalize a zero quaternion");
+		const T scale=T(1)/length;
+		elements_[qw]*=scale; elements_[qi]*=scale; elements_[qj]*=scale; elements_[qk]*=scale;
+		return *this;
+	}
+
+	// Replace this quaternion by its inverse, q=q^{-1}=conjugate(q)/|q|^2,
+	// so that q*q^{-1}=1. q must not be zero. For a copy use inverse(q)
+	/* Note: for unit quaternions the inverse is just the conjugate, which is
+	 * exact and much cheaper (see UnitQuaternion.h)
+	 */
+	BasicQuaternion &invert()
+	{
+		QUATERNION_COUNT(opInverse);
+		const T lengthSquared=squaredNorm();
+		assert(lengthSquared>T(0) && "Can't invert a zero quaternion");
+		const T scale=T(1)/lengthSquared;
+		elements_[qw]*=scale; elements_[qi]*=-scale; elements_[qj]*=-scale; elements_[qk]*=-scale;
+		return *this;
+	}
 
 private:
 
-	// Elements container. Use map for sparse storage and O(log(n)) lookup complexity
-	std::map<AxisType,double> elements_;
+	// Elements container: w, i, j, k in this order (matches AxisType)
+	/* Note: aligning to the size of the whole quaternion (32 bytes for double,
+	 * 16 for float) means it is loaded with a single vector instruction and
+	 * never straddles a cache line
+	 */
+	alignas(4*sizeof(T)) T elements_[4];
 
 }; // End of quaternion class
 
+// The quaternion types used throughout the library
+typedef BasicQuaternion<float> QuaternionF;
+typedef BasicQuaternion<double> Quaternion;
+typedef BasicQuaternion<long double> QuaternionL;
+
+/* Note: norm() and write() are defined in Quaternion.cpp and explicitly
+ * instantiated there for these three types. "extern template" tells every
+ * other translation unit not to instantiate them again, which keeps compile
+ * times down (the inline members are unaffected and still get inlined)
+ */
+extern template class BasicQuaternion<float>;
+extern template class BasicQuaternion<double>;
+extern template class BasicQuaternion<long double>;
+
+// === Expression member functions that need the complete BasicQuaternion class ===
+template <typename Derived>
+constexpr auto QuaternionExpression<Derived>::eval() const
+{
+	return BasicQuaternion<typename Derived::Scalar>(derived());
+}
+
+template <typename Derived>
+constexpr auto QuaternionExpression<Derived>::conjugate() const
+{
+	return eval().conjugate();
+}
+
+template <typename Derived>
+constexpr auto QuaternionExpression<Derived>::squaredNorm() const
+{
+	return eval().squaredNorm();
+}
+
+template <typename Derived>
+auto QuaternionExpression<Derived>::norm() const
+{
+	return eval().norm();
+}
+
+template <typename Derived>
+void QuaternionExpression<Derived>::write(std::ostream &out) const
+{
+	eval().write(out);
+}
+
+// === Text input/output ===
+// Print in the write() notation, e.g. cout<<q1*q2<<endl; prints "+0.5+1.25i+1.5j+0.25k"
+template <typename E>
+std::ostream &operator<<(std::ostream &out, const QuaternionExpression<E> &q)
+{
+	q.write(out);
+	return out;
+}
+
+// Read a quaternion in the write() notation, e.g. "+1+2j", "-0.5i+3k" or "0"
+/* Note: the terms may come in any order and repeated axes are added up, so
+ * anything write() prints is read back, including the non-finite components
+ * (e.g. "+inf+1i" or "-nank"). Leading whitespace is skipped and
+ * reading stops at the first character that doesn't continue the quaternion.
+ * On a malformed quaternion the failbit is set and q is left unchanged.
+ * write() prints with the precision of the stream (6 digits by default); for
+ * an exact round trip set it to std::numeric_limits<T>::max_digits10 first.
+ * Defined (and instantiated for float, double and long double) in Quaternion.cpp
+ */
+template <typename T>
+std::istream &operator>>(std::istream &in, BasicQuaternion<T> &q);
+
+// === Free functions ===
+/* Note: these take any expression, so e.g. dot(q1*q2,q3) works without
+ * a temporary. They are templates, so they live in the header.
+ */
+
+// 4D dot product w1*w2+i1*i2+j1*j2+k1*k2. For unit quaternions this is the
+// cosine of half the angle between the two rotations
+template <typename E1, typename E2>
+constexpr PromotedScalar<E1,E2> dot(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opDot);
+	return q1.w()*q2.w()+q1.i()*q2.i()+q1.j()*q2.j()+q1.k()*q2.k();
+}
+
+// Quaternion exponential: exp(w+v) = e^w (cos|v| + v/|v| sin|v|)
+/* Note: for a pure quaternion (w=0) with |v|=angle/2 and a unit axis, this is
+ * the rotation by angle around that axis
+ */
+template <typename E>
+BasicQuaternion<typename E::Scalar> exp(const QuaternionExpression<E> &q)
+{
+	QUATERNION_TIME(opExp);
+	typedef typename E::Scalar T;
+	const BasicQuaternion<T> p(q);
+	const T length=std::sqrt(p.i()*p.i()+p.j()*p.j()+p.k()*p.k());
+	const T scale=std::exp(p.w());
+	// sin(x)/x -> 1 as x -> 0. Below sqrt(epsilon) the next term of the series (x^2/6) is lost anyway
+	const T sinc= length<std::sqrt(std::numeric_limits<T>::epsilon()) ? T(1) : std::sin(length)/length;
+	return BasicQuaternion<T>(scale*std::cos(length),scale*sinc*p.i(),scale*sinc*p.j(),scale*sinc*p.k());
+}
+
+// Quaternion logarithm: log(q) = ln|q| + v/|v| atan2(|v|,w), the inverse of exp
+/* Note: atan2 instead of the textbook acos(w/|q|), because acos loses half of
+ * the significant digits when w/|q| is close to 1 (small angles).
+ * The logarithm of a negative real quaternion is not unique (any axis works);
+ * we return the zero vector part for all real quaternions.
+ */
+template <typename E>
+BasicQuaternion<typename E::Scalar> log(const QuaternionExpression<E> &q)
+{
+	QUATERNION_TIME(opLog);
+	typedef typename E::Scalar T;
+	const BasicQuaternion<T> p(q);
+	const T length=std::sqrt(p.i()*p.i()+p.j()*p.j()+p.k()*p.k());
+	const T real=std::log(p.norm());
+	if (length==T(0)){
+		return BasicQuaternion<T>(real,T(0),T(0),T(0));
+	}
+	const T scale=std::atan2(length,p.w())/length;
+	return BasicQuaternion<T>(real,scale*p.i(),scale*p.j(),scale*p.k());
+}
+
+// The unit quaternion q/|q|. q must not be zero
+template <typename E>
+BasicQuaternion<typename E::Scalar> normalize(const QuaternionExpression<E> &q)
+{
+	BasicQuaternion<typename E::Scalar> p(q);
+	return p.normalize();
+}
+
+// The inverse q^{-1}=conjugate(q)/|q|^2. q must not be zero
+template <typename E>
+BasicQuaternion<typename E::Scalar> inverse(const QuaternionExpression<E> &q)
+{
+	BasicQuaternion<typename E::Scalar> p(q);
+	return p.invert();
+}
+
 } // End namespace Quaternions
 
 #endif
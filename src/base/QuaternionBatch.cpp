@@ -0,0 +1,229 @@
+/* File QuaternionBatch.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the structure-of-arrays quaternion container and its kernels
+ * \author Nikos Kazazakis
+ */
+
+#include "QuaternionBatch.h"
+#include "Dispatch.h"
+
+// Other includes
+#include <cassert>
+
+using namespace Quaternions;
+
+// Create a batch of n zero quaternions
+template <typename T>
+BasicQuaternionBatch<T>::BasicQuaternionBatch(std::size_t n)
+{
+	resize(n);
+}
+
+// AoS -> SoA
+template <typename T>
+BasicQuaternionBatch<T>::BasicQuaternionBatch(const std::vector<BasicQuaternion<T> > &quaternions)
+{
+	resize(quaternions.size());
+	for (std::size_t n=0;n<quaternions.size();++n){
+		set(n,quaternions[n]);
+	}
+}
+
+// SoA -> AoS
+template <typename T>
+std::vector<BasicQuaternion<T> > BasicQuaternionBatch<T>::toVector() const
+{
+	std::vector<BasicQuaternion<T> > quaternions(size());
+	for (std::size_t n=0;n<size();++n){
+		quaternions[n]=get(n);
+	}
+	return quaternions;
+}
+
+template <typename T>
+void BasicQuaternionBatch<T>::resize(std::size_t n)
+{
+	w_.resize(n,T(0));
+	i_.resize(n,T(0));
+	j_.resize(n,T(0));
+	k_.resize(n,T(0));
+}
+
+/* Note on the kernels below: "#pragma omp simd" (we always build with -fopenmp)
+ * tells the compiler that the iterations are independent, so it vectorizes
+ * the loop without having to prove that the arrays don't overlap. This is
+ * valid even when the output is one of the inputs, because every iteration
+ * only reads and writes its own index.
+ * We copy the array pointers to locals first: this way the compiler knows
+ * they don't change inside the loop and keeps them in registers.
+ * The Hamilton product, norm and (fast) normalization are compiled once per
+ * instruction set and picked at run time: see Dispatch.h and Dispatch.cpp.
+ */
+
+// == Hamilton product
+template <typename T>
+void Quaternions::multiply(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out)
+{
+	assert(q1.size()==q2.size() && "Batch sizes must match");
+	const std::size_t size=q1.size();
+	out.resize(size);
+
+	DispatchDetail::batchKernels<T>().multiply(q1,q2,out);
+}
+
+// == Addition
+template <typename T>
+void Quaternions::add(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out)
+{
+	assert(q1.size()==q2.size() && "Batch sizes must match");
+	const std::size_t size=q1.size();
+	out.resize(size);
+
+	const T *aw=q1.w(), *ai=q1.i(), *aj=q1.j(), *ak=q1.k();
+	const T *bw=q2.w(), *bi=q2.i(), *bj=q2.j(), *bk=q2.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd
+	for (std::size_t n=0;n<size;++n){
+		ow[n]=aw[n]+bw[n];
+		oi[n]=ai[n]+bi[n];
+		oj[n]=aj[n]+bj[n];
+		ok[n]=ak[n]+bk[n];
+	}
+}
+
+// == Subtraction
+template <typename T>
+void Quaternions::subtract(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out)
+{
+	assert(q1.size()==q2.size() && "Batch sizes must match");
+	const std::size_t size=q1.size();
+	out.resize(size);
+
+	const T *aw=q1.w(), *ai=q1.i(), *aj=q1.j(), *ak=q1.k();
+	const T *bw=q2.w(), *bi=q2.i(), *bj=q2.j(), *bk=q2.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd
+	for (std::size_t n=0;n<size;++n){
+		ow[n]=aw[n]-bw[n];
+		oi[n]=ai[n]-bi[n];
+		oj[n]=aj[n]-bj[n];
+		ok[n]=ak[n]-bk[n];
+	}
+}
+
+// == Scalar multiplication
+template <typename T>
+void Quaternions::scale(const BasicQuaternionBatch<T> &q, const typename BasicQuaternionBatch<T>::Scalar c, BasicQuaternionBatch<T> &out)
+{
+	const std::size_t size=q.size();
+	out.resize(size);
+
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd
+	for (std::size_t n=0;n<size;++n){
+		ow[n]=c*aw[n];
+		oi[n]=c*ai[n];
+		oj[n]=c*aj[n];
+		ok[n]=c*ak[n];
+	}
+}
+
+// == Conjugate
+template <typename T>
+void Quaternions::conjugate(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out)
+{
+	const std::size_t size=q.size();
+	out.resize(size);
+
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd
+	for (std::size_t n=0;n<size;++n){
+		ow[n]=aw[n];
+		oi[n]=-ai[n];
+		oj[n]=-aj[n];
+		ok[n]=-ak[n];
+	}
+}
+
+// == Norm
+template <typename T>
+void Quaternions::norm(const BasicQuaternionBatch<T> &q, T *out)
+{
+	DispatchDetail::batchKernels<T>().norm(q,out);
+}
+
+// == Squared norm
+template <typename T>
+void Quaternions::squaredNorm(const BasicQuaternionBatch<T> &q, T *out)
+{
+	const std::size_t size=q.size();
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+
+	#pragma omp simd
+	for (std::size_t n=0;n<size;++n){
+		out[n]=aw[n]*aw[n]+ai[n]*ai[n]+aj[n]*aj[n]+ak[n]*ak[n];
+	}
+}
+
+// == Normalization
+template <typename T>
+void Quaternions::normalize(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out)
+{
+	out.resize(q.size());
+	DispatchDetail::batchKernels<T>().normalize(q,out);
+}
+
+template <typename T>
+void Quaternions::fastNormalize(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out)
+{
+	out.resize(q.size());
+	DispatchDetail::batchKernels<T>().fastNormalize(q,out);
+}
+
+// == Inverse
+template <typename T>
+void Quaternions::inverse(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out)
+{
+	const std::size_t size=q.size();
+	out.resize(size);
+
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	T *ow=out.w(), *oi=out.i(), *oj=out.j(), *ok=out.k();
+
+	#pragma omp simd
+	for (std::size_t n=0;n<size;++n){
+		const T w=aw[n], i=ai[n], j=aj[n], k=ak[n];
+		// Same operations as BasicQuaternion::invert
+		const T scale=T(1)/(w*w+i*i+j*j+k*k);
+		ow[n]=w*scale;
+		oi[n]=i*-scale;
+		oj[n]=j*-scale;
+		ok[n]=k*-scale;
+	}
+}
+
+// Explicit instantiations: compile the container and the kernels for float and double
+#define QUATERNION_INSTANTIATE_BATCH(T) \
+	template class Quaternions::BasicQuaternionBatch<T>; \
+	template void Quaternions::multiply(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::add(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::subtract(const BasicQuaternionBatch<T> &, const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::scale(const BasicQuaternionBatch<T> &, const T, BasicQuaternionBatch<T> &); \
+	template void Quaternions::conjugate(const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::norm(const BasicQuaternionBatch<T> &, T *); \
+	template void Quaternions::squaredNorm(const BasicQuaternionBatch<T> &, T *); \
+	template void Quaternions::normalize(const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::fastNormalize(const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &); \
+	template void Quaternions::inverse(const BasicQuaternionBatch<T> &, BasicQuaternionBatch<T> &);
+
+QUATERNION_INSTANTIATE_BATCH(float)
+QUATERNION_INSTANTIATE_BATCH(double)
+
+// End of file
@@ -0,0 +1,155 @@
+/* File QuaternionBatch.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Structure-of-arrays container for bulk quaternion arithmetic
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_BATCH_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_BATCH_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "AlignedAllocator.h"
+
+// Include STL headers
+#include <cstddef>
+#include <vector>
+
+namespace Quaternions{
+
+/**
+ * BasicQuaternionBatch stores many quaternions as a structure of arrays (SoA):
+ * all the w components are contiguous, then all the i components, and so on.
+ *
+ * Why not just use std::vector<Quaternion>? In an array of structures (AoS)
+ * every quaternion is a little struct, so the i component of element n sits
+ * next to the w component of element n. A SIMD register, however, wants the
+ * same component of several quaternions next to each other (e.g. four w's
+ * in one AVX register). With SoA the bulk kernels below are simple loops over
+ * contiguous arrays that the compiler vectorizes without any shuffles.
+ *
+ * Every component array is 64-byte aligned (see AlignedAllocator.h).
+ *
+ * T is the component type. Use QuaternionBatch (double) or QuaternionBatchF
+ * (float, which fits twice as many quaternions in every vector register).
+ *
+ * Accuracy: the kernels evaluate exactly the same expressions, in the same
+ * order, as the scalar operators in Quaternion.cpp, so results are bit-for-bit
+ * identical as long as both are compiled with the same floating point
+ * contraction setting (the default with -std=c++14). If you compile with
+ * -ffp-contract=fast on an FMA-capable target, the compiler may fuse a
+ * multiply and an add differently in each version; the difference is then
+ * bounded by 2 ULP of the largest partial product per component.
+ */
+template <typename T>
+class BasicQuaternionBatch
+{
+public :
+	typedef T Scalar;
+
+	// Create an empty batch
+	BasicQuaternionBatch() {}
+
+	// Create a batch of n zero quaternions
+	explicit BasicQuaternionBatch(std::size_t n);
+
+	// Convert from an array of quaternions (AoS -> SoA)
+	explicit BasicQuaternionBatch(const std::vector<BasicQuaternion<T> > &quaternions);
+
+	// Convert back to an array of quaternions (SoA -> AoS)
+	std::vector<BasicQuaternion<T> > toVector() const;
+
+	// Number of quaternions in the batch
+	std::size_t size() const {return w_.size();}
+	bool empty() const {return w_.empty();}
+
+	// Change the number of quaternions. New elements are zero
+	void resize(std::size_t n);
+
+	// Gather/scatter a single quaternion
+	BasicQuaternion<T> get(std::size_t n) const {return BasicQuaternion<T>(w_[n],i_[n],j_[n],k_[n]);}
+	void set(std::size_t n, const BasicQuaternion<T> &q) {w_[n]=q.w(); i_[n]=q.i(); j_[n]=q.j(); k_[n]=q.k();}
+
+	// Raw access to the component arrays (for kernels and I/O)
+	T *w() {return w_.data();}
+	T *i() {return i_.data();}
+	T *j() {return j_.data();}
+	T *k() {return k_.data();}
+	const T *w() const {return w_.data();}
+	const T *i() const {return i_.data();}
+	const T *j() const {return j_.data();}
+	const T *k() const {return k_.data();}
+
+private:
+
+	// One aligned array per component
+	AlignedVector<T> w_;
+	AlignedVector<T> i_;
+	AlignedVector<T> j_;
+	AlignedVector<T> k_;
+
+}; // End of QuaternionBatch class
+
+// The batch types used throughout the library
+typedef BasicQuaternionBatch<float> QuaternionBatchF;
+typedef BasicQuaternionBatch<double> QuaternionBatch;
+
+// === Bulk kernels ===
+/* Note: the kernels are compiled (explicitly instantiated) in QuaternionBatch.cpp
+ * for float and double.
+ * All kernels write into an output batch, which is resized to match
+ * the input. Passing the same batch as input and output is allowed, so
+ * q1 can be multiplied in place with multiply(q1,q2,q1).
+ * Binary kernels require both inputs to have the same size.
+ */
+
+// out[n] = q1[n] * q2[n] (Hamilton product)
+template <typename T>
+void multiply(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out);
+
+// out[n] = q1[n] + q2[n]
+template <typename T>
+void add(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out);
+
+// out[n] = q1[n] - q2[n]
+template <typename T>
+void subtract(const BasicQuaternionBatch<T> &q1, const BasicQuaternionBatch<T> &q2, BasicQuaternionBatch<T> &out);
+
+// out[n] = c * q[n]
+template <typename T>
+void scale(const BasicQuaternionBatch<T> &q, const typename BasicQuaternionBatch<T>::Scalar c, BasicQuaternionBatch<T> &out);
+
+// out[n] = q[n].conjugate()
+template <typename T>
+void conjugate(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out);
+
+// out[n] = q[n].norm(). The output array must hold q.size() values
+template <typename T>
+void norm(const BasicQuaternionBatch<T> &q, T *out);
+
+// out[n] = q[n].squaredNorm(). The output array must hold q.size() values
+template <typename T>
+void squaredNorm(const BasicQuaternionBatch<T> &q, T *out);
+
+// out[n] = q[n]/q[n].norm(). Every q[n] must be non-zero
+template <typename T>
+void normalize(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out);
+
+// out[n] = fastNormalize(q[n]): within 2 epsilon of normalize, but without
+// square roots or divisions (see UnitQuaternion.h for when that is faster).
+// Every q[n] must be non-zero
+/* Note: use this to renormalize large arrays of rotations, e.g. after
+ * integrating or composing them, where the norms have drifted from 1
+ */
+template <typename T>
+void fastNormalize(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out);
+
+// out[n] = inverse(q[n]), i.e. q[n].conjugate()/q[n].squaredNorm(). Every q[n] must be non-zero
+/* Note: for batches of unit quaternions use conjugate, which is exact and cheaper */
+template <typename T>
+void inverse(const BasicQuaternionBatch<T> &q, BasicQuaternionBatch<T> &out);
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,325 @@
+/* File QuaternionExpression.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Expression templates for allocation-free, fused quaternion arithmetic
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_EXPRESSION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_EXPRESSION_LIB
+
+// Include project headers
+#include "Instrumentation.h"
+
+// Include STL headers
+#include <type_traits>
+
+/* Note: this header is included by Quaternion.h, include that instead.
+ *
+ * How this works: the arithmetic operators don't compute anything. Instead,
+ * they return a small "expression node" that remembers the operation and
+ * its operands, e.g. q1+q2 returns a QuaternionSum<Quaternion,Quaternion>.
+ * The actual calculation happens when the expression is assigned to (or used
+ * to construct) a Quaternion: then each component is computed once, in a
+ * single pass through the whole expression tree, e.g. for
+ *     Quaternion q=(2+q1)*q2+2.25;
+ * the compiler generates the same code as if we had written the four
+ * component formulas by hand, without any intermediate quaternions.
+ *
+ * This technique is called "expression templates", because the type of the
+ * expression (e.g. QuaternionScalarSum<QuaternionHamiltonProduct<...>>)
+ * encodes the expression itself, and is resolved at compile time.
+ *
+ * Design choices:
+ * - Nodes store their operands BY VALUE. A Quaternion is only 32 bytes and
+ *   trivially copyable, and once everything is inlined the compiler removes
+ *   the copies. In exchange, an expression never holds a dangling reference,
+ *   even if it is stored with "auto" and outlives its operands.
+ * - The Hamilton product needs every component of both operands four times.
+ *   Evaluating an operand expression lazily would recompute it four times
+ *   (and exponentially more for nested products), so the product node
+ *   evaluates its operands once, when it is built. The result lives on the
+ *   stack (in practice, in registers); there are still no heap allocations.
+ * - Everything is constexpr, so whole expressions can be evaluated by the
+ *   compiler when their operands are compile-time constants.
+ * - Every node has a Scalar type, following the usual C++ arithmetic
+ *   promotions: a float quaternion plus a double quaternion is a double
+ *   expression, and an int scalar times a float quaternion stays float.
+ */
+
+namespace Quaternions{
+
+// Forward-declare the class template, all expressions evaluate to it
+template <typename T>
+class BasicQuaternion;
+
+/**
+ * QuaternionExpression is the base class of everything that can be evaluated
+ * as a quaternion (including BasicQuaternion itself). Derived is the actual type:
+ * this is the "curiously recurring template pattern" (CRTP), which gives us
+ * static polymorphism (no virtual calls) so everything can be inlined.
+ * Every Derived type defines a Scalar typedef, its floating point type.
+ */
+/* Note: the return types here are "auto" because Derived is still an
+ * incomplete type when this base class is instantiated, so we can't name
+ * Derived::Scalar in the declarations. The types are deduced on first use.
+ */
+template <typename Derived>
+class QuaternionExpression
+{
+public :
+	// Access the derived expression
+	constexpr const Derived &derived() const {return static_cast<const Derived &>(*this);}
+
+	// Evaluate individual components
+	constexpr auto w() const {return derived().w();}
+	constexpr auto i() const {return derived().i();}
+	constexpr auto j() const {return derived().j();}
+	constexpr auto k() const {return derived().k();}
+
+	// Evaluate a component by axis
+	constexpr auto operator[](AxisType axis) const
+	{
+		switch (axis){
+		case qw: return w();
+		case qi: return i();
+		case qj: return j();
+		default: return k();
+		}
+	}
+
+	// Evaluate the whole expression into a quaternion of its own scalar type
+	constexpr auto eval() const;
+
+	// Convenience functions, so that e.g. (q1*q2).norm() works as before
+	constexpr auto conjugate() const;
+	constexpr auto squaredNorm() const;
+	auto norm() const;
+	void write(std::ostream &out=cout) const;
+};
+
+// Scalar type of the result of an operation between two expressions
+template <typename E1, typename E2>
+using PromotedScalar=typename std::common_type<typename E1::Scalar,typename E2::Scalar>::type;
+
+// Scalar type of the result of an operation between a number and an expression
+/* Note: this only exists if S is an arithmetic type, so the scalar operator
+ * templates below don't get in the way of the quaternion-quaternion ones
+ */
+template <typename S, typename E>
+using ScalarOperationResult=typename std::enable_if<std::is_arithmetic<S>::value,
+	typename std::common_type<S,typename E::Scalar>::type>::type;
+
+// === Expression nodes ===
+// q1 + q2
+template <typename E1, typename E2>
+class QuaternionSum : public QuaternionExpression<QuaternionSum<E1,E2> >
+{
+public :
+	typedef PromotedScalar<E1,E2> Scalar;
+	constexpr QuaternionSum(const E1 &q1, const E2 &q2) : q1_(q1), q2_(q2) {}
+	constexpr Scalar w() const {return q1_.w()+q2_.w();}
+	constexpr Scalar i() const {return q1_.i()+q2_.i();}
+	constexpr Scalar j() const {return q1_.j()+q2_.j();}
+	constexpr Scalar k() const {return q1_.k()+q2_.k();}
+private:
+	E1 q1_;
+	E2 q2_;
+};
+
+// q1 - q2
+template <typename E1, typename E2>
+class QuaternionDifference : public QuaternionExpression<QuaternionDifference<E1,E2> >
+{
+public :
+	typedef PromotedScalar<E1,E2> Scalar;
+	constexpr QuaternionDifference(const E1 &q1, const E2 &q2) : q1_(q1), q2_(q2) {}
+	constexpr Scalar w() const {return q1_.w()-q2_.w();}
+	constexpr Scalar i() const {return q1_.i()-q2_.i();}
+	constexpr Scalar j() const {return q1_.j()-q2_.j();}
+	constexpr Scalar k() const {return q1_.k()-q2_.k();}
+private:
+	E1 q1_;
+	E2 q2_;
+};
+
+// c + q (and q + c; floating point addition is commutative)
+/* Note: the scalar is added to every component, as the original operators did.
+ * T is the (promoted) scalar type of the result, the number is stored as a T
+ */
+template <typename T, typename E>
+class QuaternionScalarSum : public QuaternionExpression<QuaternionScalarSum<T,E> >
+{
+public :
+	typedef T Scalar;
+	constexpr QuaternionScalarSum(const T c, const E &q) : c_(c), q_(q) {}
+	constexpr Scalar w() const {return c_+q_.w();}
+	constexpr Scalar i() const {return c_+q_.i();}
+	constexpr Scalar j() const {return c_+q_.j();}
+	constexpr Scalar k() const {return c_+q_.k();}
+private:
+	T c_;
+	E q_;
+};
+
+// c - q
+template <typename T, typename E>
+class QuaternionScalarMinus : public QuaternionExpression<QuaternionScalarMinus<T,E> >
+{
+public :
+	typedef T Scalar;
+	constexpr QuaternionScalarMinus(const T c, const E &q) : c_(c), q_(q) {}
+	constexpr Scalar w() const {return c_-q_.w();}
+	constexpr Scalar i() const {return c_-q_.i();}
+	constexpr Scalar j() const {return c_-q_.j();}
+	constexpr Scalar k() const {return c_-q_.k();}
+private:
+	T c_;
+	E q_;
+};
+
+// q - c
+template <typename T, typename E>
+class QuaternionMinusScalar : public QuaternionExpression<QuaternionMinusScalar<T,E> >
+{
+public :
+	typedef T Scalar;
+	constexpr QuaternionMinusScalar(const E &q, const T c) : q_(q), c_(c) {}
+	constexpr Scalar w() const {return q_.w()-c_;}
+	constexpr Scalar i() const {return q_.i()-c_;}
+	constexpr Scalar j() const {return q_.j()-c_;}
+	constexpr Scalar k() const {return q_.k()-c_;}
+private:
+	E q_;
+	T c_;
+};
+
+// c * q (and q * c)
+template <typename T, typename E>
+class QuaternionScalarProduct : public QuaternionExpression<QuaternionScalarProduct<T,E> >
+{
+public :
+	typedef T Scalar;
+	constexpr QuaternionScalarProduct(const T c, const E &q) : c_(c), q_(q) {}
+	constexpr Scalar w() const {return c_*q_.w();}
+	constexpr Scalar i() const {return c_*q_.i();}
+	constexpr Scalar j() const {return c_*q_.j();}
+	constexpr Scalar k() const {return c_*q_.k();}
+private:
+	T c_;
+	E q_;
+};
+
+// q1 * q2 (Hamilton product)
+/* We use the formula for the Hamilton product:
+ * https://en.wikipedia.org/wiki/Quaternion#Hamilton_product
+ * The operands are evaluated once, on construction (see the note at the top)
+ */
+template <typename E1, typename E2>
+class QuaternionHamiltonProduct : public QuaternionExpression<QuaternionHamiltonProduct<E1,E2> >
+{
+public :
+	typedef PromotedScalar<E1,E2> Scalar;
+	constexpr QuaternionHamiltonProduct(const E1 &q1, const E2 &q2) :
+		w1_(q1.w()), i1_(q1.i()), j1_(q1.j()), k1_(q1.k()),
+		w2_(q2.w()), i2_(q2.i()), j2_(q2.j()), k2_(q2.k()) {}
+	constexpr Scalar w() const {return w1_*w2_-i1_*i2_-j1_*j2_-k1_*k2_;}
+	constexpr Scalar i() const {return w1_*i2_+i1_*w2_+j1_*k2_-k1_*j2_;}
+	constexpr Scalar j() const {return w1_*j2_-i1_*k2_+j1_*w2_+k1_*i2_;}
+	constexpr Scalar k() const {return w1_*k2_+i1_*j2_-j1_*i2_+k1_*w2_;}
+private:
+	Scalar w1_, i1_, j1_, k1_;
+	Scalar w2_, i2_, j2_, k2_;
+};
+
+// === Operators ===
+/* Note: all operators take any QuaternionExpression, so they work for
+ * Quaternions as well as for the results of other operators, i.e. they can
+ * be chained arbitrarily, e.g. q1*q2*q3*q4 or (2+q1)*q2+2.25
+ * The scalar versions take any arithmetic type (int, float, double, ...),
+ * which is converted to the promoted scalar type of the result.
+ */
+
+// - Addition and subtraction
+template <typename E1, typename E2>
+constexpr QuaternionSum<E1,E2> operator+(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opAdd);
+	return QuaternionSum<E1,E2>(q1.derived(),q2.derived());
+}
+
+template <typename E1, typename E2>
+constexpr QuaternionDifference<E1,E2> operator-(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opSubtract);
+	return QuaternionDifference<E1,E2>(q1.derived(),q2.derived());
+}
+
+template <typename S, typename E>
+constexpr QuaternionScalarSum<ScalarOperationResult<S,E>,E> operator+(const S c, const QuaternionExpression<E> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opScalarAdd);
+	return QuaternionScalarSum<ScalarOperationResult<S,E>,E>(c,q2.derived());
+}
+
+template <typename S, typename E>
+constexpr QuaternionScalarSum<ScalarOperationResult<S,E>,E> operator+(const QuaternionExpression<E> &q2, const S c)
+{
+	QUATERNION_COUNT_CONSTEXPR(opScalarAdd);
+	return QuaternionScalarSum<ScalarOperationResult<S,E>,E>(c,q2.derived());
+}
+
+template <typename S, typename E>
+constexpr QuaternionScalarMinus<ScalarOperationResult<S,E>,E> operator-(const S c, const QuaternionExpression<E> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opScalarAdd);
+	return QuaternionScalarMinus<ScalarOperationResult<S,E>,E>(c,q2.derived());
+}
+
+template <typename S, typename E>
+constexpr QuaternionMinusScalar<ScalarOperationResult<S,E>,E> operator-(const QuaternionExpression<E> &q2, const S c)
+{
+	QUATERNION_COUNT_CONSTEXPR(opScalarAdd);
+	return QuaternionMinusScalar<ScalarOperationResult<S,E>,E>(q2.derived(),c);
+}
+
+// - Multiplication
+//   == Scalar multiplications
+template <typename S, typename E>
+constexpr QuaternionScalarProduct<ScalarOperationResult<S,E>,E> operator*(const S c, const QuaternionExpression<E> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opScalarMultiply);
+	return QuaternionScalarProduct<ScalarOperationResult<S,E>,E>(c,q2.derived());
+}
+
+template <typename S, typename E>
+constexpr QuaternionScalarProduct<ScalarOperationResult<S,E>,E> operator*(const QuaternionExpression<E> &q2, const S c)
+{
+	QUATERNION_COUNT_CONSTEXPR(opScalarMultiply);
+	return QuaternionScalarProduct<ScalarOperationResult<S,E>,E>(c,q2.derived());
+}
+
+//   == Quaternion-quaternion multiplication
+template <typename E1, typename E2>
+constexpr QuaternionHamiltonProduct<E1,E2> operator*(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	QUATERNION_COUNT_CONSTEXPR(opHamilton);
+	return QuaternionHamiltonProduct<E1,E2>(q1.derived(),q2.derived());
+}
+
+// Comparison operators
+template <typename E1, typename E2>
+constexpr bool operator==(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	return q1.w()==q2.w() && q1.i()==q2.i() && q1.j()==q2.j() && q1.k()==q2.k();
+}
+
+template <typename E1, typename E2>
+constexpr bool operator!=(const QuaternionExpression<E1> &q1, const QuaternionExpression<E2> &q2)
+{
+	return !(q1==q2);
+}
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,259 @@
+/* File QuaternionFile.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the binary quaternion stream files
+ * \author Nikos Kazazakis
+ */
+
+#include "QuaternionFile.h"
+
+// Other includes
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// POSIX headers for the file descriptors and the memory mapping
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Quaternions;
+
+static_assert(sizeof(QuaternionFileHeader)==64,"The file header must be 64 bytes, so that the data stays aligned");
+static_assert(std::is_trivially_copyable<QuaternionFileHeader>::value,"The file header is written with a plain memory copy");
+
+static const char kMagic[8]={'Q','U','A','T','F','I','L','E'};
+
+// Header describing count quaternions of type T
+template <typename T>
+static QuaternionFileHeader makeHeader(std::uint64_t count)
+{
+	QuaternionFileHeader header;
+	std::memset(&header,0,sizeof(header));
+	std::memcpy(header.magic,kMagic,sizeof(kMagic));
+	header.version=kQuaternionFileVersion;
+	header.byteOrder=kQuaternionFileByteOrder;
+	header.scalarSize=sizeof(T);
+	header.count=count;
+	return header;
+}
+
+// Check everything but the precision
+static bool validHeader(const QuaternionFileHeader &header)
+{
+	return std::memcmp(header.magic,kMagic,sizeof(kMagic))==0 &&
+			header.version==kQuaternionFileVersion &&
+			header.byteOrder==kQuaternionFileByteOrder;
+}
+
+bool Quaternions::readQuaternionFileHeader(const std::string &path, QuaternionFileHeader &header)
+{
+	const int file=::open(path.c_str(),O_RDONLY);
+	if (file<0){
+		return false;
+	}
+	const bool read= ::pread(file,&header,sizeof(header),0)==static_cast<ssize_t>(sizeof(header));
+	::close(file);
+	return read && validHeader(header);
+}
+
+// === Writer ===
+template <typename T>
+QuaternionFileWriter<T>::QuaternionFileWriter(const std::string &path, std::size_t bufferSize) :
+	file_(-1), count_(0), good_(false)
+{
+	open(path,bufferSize);
+}
+
+template <typename T>
+QuaternionFileWriter<T>::~QuaternionFileWriter()
+{
+	close();
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::open(const std::string &path, std::size_t bufferSize)
+{
+	close();
+	file_=::open(path.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+	count_=0;
+	bufferSize_= bufferSize>0 ? bufferSize : 1;
+	buffer_.clear();
+	buffer_.reserve(bufferSize_);
+	// The header goes first, with a count of zero until the first flush
+	const QuaternionFileHeader header=makeHeader<T>(0);
+	good_= file_>=0 && writeData(&header,sizeof(header));
+	return good_;
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::append(const BasicQuaternion<T> &q)
+{
+	if (!good_){
+		return false;
+	}
+	buffer_.push_back(q);
+	++count_;
+	if (buffer_.size()>=bufferSize_){
+		good_=writeData(buffer_.data(),buffer_.size()*sizeof(BasicQuaternion<T>));
+		buffer_.clear();
+	}
+	return good_;
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::append(const BasicQuaternion<T> *quaternions, std::size_t n)
+{
+	if (!good_){
+		return false;
+	}
+	if (buffer_.size()+n<=bufferSize_){
+		buffer_.insert(buffer_.end(),quaternions,quaternions+n);
+	}
+	else{
+		// Too big for the buffer: write out what we have, then the block itself,
+		// straight from the caller's memory
+		good_=writeData(buffer_.data(),buffer_.size()*sizeof(BasicQuaternion<T>)) &&
+				writeData(quaternions,n*sizeof(BasicQuaternion<T>));
+		buffer_.clear();
+	}
+	count_+=n;
+	return good_;
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::append(const BasicQuaternionBatch<T> &batch)
+{
+	// SoA -> AoS, one buffer at a time
+	for (std::size_t n=0;n<batch.size() && good_;++n){
+		append(batch.get(n));
+	}
+	return good_;
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::flush()
+{
+	if (!good_){
+		return false;
+	}
+	good_=writeData(buffer_.data(),buffer_.size()*sizeof(BasicQuaternion<T>));
+	buffer_.clear();
+	// Rewrite the header with the new count. pwrite doesn't move the file offset
+	const QuaternionFileHeader header=makeHeader<T>(count_);
+	good_=good_ && ::pwrite(file_,&header,sizeof(header),0)==static_cast<ssize_t>(sizeof(header));
+	return good_;
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::close()
+{
+	if (file_<0){
+		return false;
+	}
+	const bool flushed=flush();
+	const bool closed= ::close(file_)==0;
+	file_=-1;
+	good_=false;
+	return flushed && closed;
+}
+
+template <typename T>
+bool QuaternionFileWriter<T>::writeData(const void *data, std::size_t n)
+{
+	// write() may write less than asked for (e.g. when interrupted by a signal), so loop
+	const char *bytes=static_cast<const char*>(data);
+	while (n>0){
+		const ssize_t written=::write(file_,bytes,n);
+		if (written<0){
+			if (errno==EINTR){
+				continue;
+			}
+			return false;
+		}
+		bytes+=written;
+		n-=static_cast<std::size_t>(written);
+	}
+	return true;
+}
+
+// === Memory-mapped reader ===
+template <typename T>
+MappedQuaternionFile<T>::MappedQuaternionFile(MappedQuaternionFile &&file) noexcept :
+	mapping_(file.mapping_), mappingSize_(file.mappingSize_), quaternions_(file.quaternions_)
+{
+	file.mapping_=nullptr;
+	file.mappingSize_=0;
+	file.quaternions_=QuaternionSpan<T>();
+}
+
+template <typename T>
+MappedQuaternionFile<T> &MappedQuaternionFile<T>::operator=(MappedQuaternionFile &&file) noexcept
+{
+	if (this!=&file){
+		close();
+		std::swap(mapping_,file.mapping_);
+		std::swap(mappingSize_,file.mappingSize_);
+		std::swap(quaternions_,file.quaternions_);
+	}
+	return *this;
+}
+
+template <typename T>
+bool MappedQuaternionFile<T>::open(const std::string &path)
+{
+	close();
+	const int file=::open(path.c_str(),O_RDONLY);
+	if (file<0){
+		return false;
+	}
+	struct stat status;
+	if (::fstat(file,&status)!=0 || static_cast<std::size_t>(status.st_size)<sizeof(QuaternionFileHeader)){
+		::close(file);
+		return false;
+	}
+	const std::size_t size=static_cast<std::size_t>(status.st_size);
+	void *mapping=::mmap(nullptr,size,PROT_READ,MAP_SHARED,file,0);
+	::close(file); // The mapping keeps the file open
+	if (mapping==MAP_FAILED){
+		return false;
+	}
+
+	// Check the header, and that the file really holds that many quaternions
+	const QuaternionFileHeader *header=static_cast<const QuaternionFileHeader*>(mapping);
+	const std::size_t available=(size-sizeof(QuaternionFileHeader))/sizeof(BasicQuaternion<T>);
+	if (!validHeader(*header) || header->scalarSize!=sizeof(T) || header->count>available){
+		::munmap(mapping,size);
+		return false;
+	}
+
+	// Replaying is usually sequential: ask the kernel to read ahead aggressively
+	::madvise(mapping,size,MADV_SEQUENTIAL);
+
+	mapping_=mapping;
+	mappingSize_=size;
+	const BasicQuaternion<T> *data=reinterpret_cast<const BasicQuaternion<T>*>(static_cast<const char*>(mapping)+sizeof(QuaternionFileHeader));
+	quaternions_=QuaternionSpan<T>(data,static_cast<std::size_t>(header->count));
+	return true;
+}
+
+template <typename T>
+void MappedQuaternionFile<T>::close()
+{
+	if (mapping_){
+		::munmap(mapping_,mappingSize_);
+	}
+	mapping_=nullptr;
+	mappingSize_=0;
+	quaternions_=QuaternionSpan<T>();
+}
+
+// Explicit instantiations for the two supported precisions
+template class Quaternions::QuaternionFileWriter<float>;
+template class Quaternions::QuaternionFileWriter<double>;
+template class Quaternions::MappedQuaternionFile<float>;
+template class Quaternions::MappedQuaternionFile<double>;
+
+// End of file
@@ -0,0 +1,201 @@
+/* File QuaternionFile.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Binary quaternion stream files: buffered writer and zero-copy memory-mapped reader
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_FILE_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_FILE_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+
+// Include STL headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Note: the file layout is
+ *
+ *     [64 byte header][q0][q1][q2]...
+ *
+ * where every quaternion is stored exactly as it is in memory (w, i, j, k,
+ * 16 bytes for float and 32 for double). Since the file is mapped at a page
+ * boundary and the header is 64 bytes, the quaternions in a mapped file are
+ * correctly aligned, so the reader hands out pointers straight into the
+ * mapping: no parsing, no copies, and the operating system only reads the
+ * pages that are actually touched.
+ *
+ * The price is portability: the components are in the byte order of the
+ * machine that wrote them. The header records it, and a reader on a machine
+ * with the other byte order refuses the file instead of returning garbage.
+ * Long double has no portable layout, so only float and double are supported.
+ */
+
+namespace Quaternions{
+
+// Current version of the file format
+const std::uint32_t kQuaternionFileVersion=1;
+
+// Written as a native integer, so it reads back differently on a machine with the other byte order
+const std::uint32_t kQuaternionFileByteOrder=0x01020304;
+
+// The file header. Exactly 64 bytes, so the data that follows stays aligned
+struct QuaternionFileHeader
+{
+	char magic[8];              // "QUATFILE"
+	std::uint32_t version;      // kQuaternionFileVersion
+	std::uint32_t byteOrder;    // kQuaternionFileByteOrder
+	std::uint32_t scalarSize;   // Precision: sizeof(float) or sizeof(double)
+	std::uint32_t reserved0;
+	std::uint64_t count;        // Number of quaternions that follow
+	std::uint8_t reserved[32];  // Zero, for future versions
+};
+
+// Read the header of a file, e.g. to find out its precision before opening it.
+// Returns false if the file can't be read or is not a quaternion file
+bool readQuaternionFileHeader(const std::string &path, QuaternionFileHeader &header);
+
+/**
+ * QuaternionSpan is a read-only view of contiguous quaternions that it does
+ * not own (in the spirit of C++20's std::span). It is two words long, so pass
+ * it by value. The quaternions must outlive the span.
+ */
+template <typename T>
+class QuaternionSpan
+{
+public :
+	typedef const BasicQuaternion<T> *iterator;
+
+	QuaternionSpan() : data_(nullptr), size_(0) {}
+	QuaternionSpan(const BasicQuaternion<T> *data, std::size_t size) : data_(data), size_(size) {}
+
+	const BasicQuaternion<T> *data() const {return data_;}
+	std::size_t size() const {return size_;}
+	bool empty() const {return size_==0;}
+
+	const BasicQuaternion<T> &operator[](std::size_t n) const {return data_[n];}
+	iterator begin() const {return data_;}
+	iterator end() const {return data_+size_;}
+
+	// The count quaternions starting at offset
+	QuaternionSpan subspan(std::size_t offset, std::size_t count) const {return QuaternionSpan(data_+offset,count);}
+
+private:
+	const BasicQuaternion<T> *data_;
+	std::size_t size_;
+};
+
+/**
+ * QuaternionFileWriter appends quaternions to a binary stream file.
+ * Appends go to an in-memory buffer, which is written to the file with one
+ * system call whenever it fills up, so appending one quaternion at a time is
+ * as cheap as appending large blocks.
+ *
+ * Errors are reported like the standard streams do: the functions return
+ * false and good() stays false from then on.
+ *
+ * The count in the header is updated by flush() and close() (the destructor
+ * closes the file). If the program dies in between, a reader still sees the
+ * quaternions up to the last flush.
+ */
+template <typename T>
+class QuaternionFileWriter
+{
+public :
+	// Buffer size, in quaternions (128KB for double)
+	static const std::size_t kDefaultBufferSize=4096;
+
+	QuaternionFileWriter() : file_(-1), count_(0), good_(false) {}
+
+	// Create (or truncate) the file at path
+	explicit QuaternionFileWriter(const std::string &path, std::size_t bufferSize=kDefaultBufferSize);
+
+	~QuaternionFileWriter();
+
+	// A writer owns its file, so it can't be copied
+	QuaternionFileWriter(const QuaternionFileWriter &)=delete;
+	QuaternionFileWriter &operator=(const QuaternionFileWriter &)=delete;
+
+	// Create (or truncate) the file at path, closing the current one
+	bool open(const std::string &path, std::size_t bufferSize=kDefaultBufferSize);
+
+	// Append quaternions
+	bool append(const BasicQuaternion<T> &q);
+	bool append(const BasicQuaternion<T> *quaternions, std::size_t n);
+	bool append(QuaternionSpan<T> quaternions) {return append(quaternions.data(),quaternions.size());}
+	bool append(const BasicQuaternionBatch<T> &batch);
+
+	// Write the buffer and the header to the file
+	bool flush();
+
+	// Flush and close the file
+	bool close();
+
+	bool isOpen() const {return file_>=0;}
+	bool good() const {return good_;}
+
+	// Number of quaternions appended so far
+	std::uint64_t size() const {return count_;}
+
+private:
+
+	// Write n bytes to the end of the file
+	bool writeData(const void *data, std::size_t n);
+
+	int file_;                                  // POSIX file descriptor, -1 if closed
+	std::uint64_t count_;                       // Quaternions appended, including the buffered ones
+	bool good_;
+	std::vector<BasicQuaternion<T> > buffer_;   // Appended, not yet written
+	std::size_t bufferSize_=0;
+
+}; // End of QuaternionFileWriter class
+
+/**
+ * MappedQuaternionFile opens a binary stream file read-only and maps it
+ * into memory. quaternions() is then a view straight into the file.
+ *
+ * open() returns false if the file can't be mapped, is not a quaternion file,
+ * was written with a different precision or byte order, or is shorter than
+ * its header says.
+ * The mapping is released by close() or the destructor, which invalidates all
+ * the spans taken from it.
+ */
+template <typename T>
+class MappedQuaternionFile
+{
+public :
+	MappedQuaternionFile() : mapping_(nullptr), mappingSize_(0) {}
+	explicit MappedQuaternionFile(const std::string &path) : mapping_(nullptr), mappingSize_(0) {open(path);}
+	~MappedQuaternionFile() {close();}
+
+	// A mapping can be moved (e.g. returned from a function), but not copied
+	MappedQuaternionFile(const MappedQuaternionFile &)=delete;
+	MappedQuaternionFile &operator=(const MappedQuaternionFile &)=delete;
+	MappedQuaternionFile(MappedQuaternionFile &&file) noexcept;
+	MappedQuaternionFile &operator=(MappedQuaternionFile &&file) noexcept;
+
+	bool open(const std::string &path);
+	void close();
+	bool isOpen() const {return mapping_!=nullptr;}
+
+	// The quaternions in the file
+	QuaternionSpan<T> quaternions() const {return quaternions_;}
+	std::size_t size() const {return quaternions_.size();}
+	const BasicQuaternion<T> &operator[](std::size_t n) const {return quaternions_[n];}
+	typename QuaternionSpan<T>::iterator begin() const {return quaternions_.begin();}
+	typename QuaternionSpan<T>::iterator end() const {return quaternions_.end();}
+
+private:
+	void *mapping_;
+	std::size_t mappingSize_;
+	QuaternionSpan<T> quaternions_;
+
+}; // End of MappedQuaternionFile class
+
+} // End namespace Quaternions
+
+#endif
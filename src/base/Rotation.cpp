@@ -0,0 +1,45 @@
+/* File Rotation.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the batch vector rotation kernels
+ * \author Nikos Kazazakis
+ */
+
+#include "Rotation.h"
+#include "Dispatch.h"
+
+// Other includes
+#include <cassert>
+
+using namespace Quaternions;
+
+/* Note: the kernels themselves are in Dispatch.cpp, compiled once per
+ * instruction set. Each one splits the points in contiguous chunks, one per
+ * thread (as schedule(static) would, so every thread streams its own part of
+ * the arrays), then vectorizes each chunk. Each iteration only touches its
+ * own index, so in-place use is safe.
+ */
+
+// Rotate every point by the same quaternion
+void Quaternions::rotate(const Quaternion &q, const PointCloud &in, PointCloud &out)
+{
+	out.resize(in.size());
+	DispatchDetail::rotationKernels().rotate(q,in,out);
+}
+
+// Rotate every point by the same matrix
+void Quaternions::rotate(const Matrix3 &M, const PointCloud &in, PointCloud &out)
+{
+	out.resize(in.size());
+	DispatchDetail::rotationKernels().rotateByMatrix(M,in,out);
+}
+
+// Rotate point n by quaternion n
+void Quaternions::rotate(const QuaternionBatch &q, const PointCloud &in, PointCloud &out)
+{
+	assert(q.size()==in.size() && "Batch sizes must match");
+	out.resize(in.size());
+	DispatchDetail::rotationKernels().rotateBatch(q,in,out);
+}
+
+// End of file
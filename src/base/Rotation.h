@@ -0,0 +1,121 @@
+/* File Rotation.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Fast rotation of 3D vectors by quaternions, single and OpenMP-parallel batch versions
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_ROTATION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_ROTATION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+#include "AlignedAllocator.h"
+#include "Conversion.h"
+
+// Include STL headers
+#include <cstddef>
+
+namespace Quaternions{
+
+// A plain 3D vector. Trivially copyable, so arrays of them can be memcpy'd
+struct Vector3
+{
+	double x;
+	double y;
+	double z;
+};
+
+inline bool operator==(const Vector3 &v1, const Vector3 &v2){return v1.x==v2.x && v1.y==v2.y && v1.z==v2.z;}
+inline bool operator!=(const Vector3 &v1, const Vector3 &v2){return !(v1==v2);}
+
+/**
+ * PointCloud stores many 3D points as a structure of arrays (all x's, then
+ * all y's, then all z's), for the same reason QuaternionBatch does: the batch
+ * rotation kernels then vectorize without shuffles.
+ */
+class PointCloud
+{
+public :
+	PointCloud() {}
+	explicit PointCloud(std::size_t n) {resize(n);}
+
+	std::size_t size() const {return x_.size();}
+	void resize(std::size_t n) {x_.resize(n,0.0); y_.resize(n,0.0); z_.resize(n,0.0);}
+
+	// Gather/scatter a single point
+	Vector3 get(std::size_t n) const {return Vector3{x_[n],y_[n],z_[n]};}
+	void set(std::size_t n, const Vector3 &p) {x_[n]=p.x; y_[n]=p.y; z_[n]=p.z;}
+
+	// Raw access to the coordinate arrays
+	double *x() {return x_.data();}
+	double *y() {return y_.data();}
+	double *z() {return z_.data();}
+	const double *x() const {return x_.data();}
+	const double *y() const {return y_.data();}
+	const double *z() const {return z_.data();}
+
+private:
+	AlignedVector<double> x_;
+	AlignedVector<double> y_;
+	AlignedVector<double> z_;
+
+}; // End of PointCloud class
+
+// Rotate p by the UNIT quaternion q, i.e. p'=q*p*q^{-1}
+/* Note: we don't compute the two Hamilton products. Writing q=(w,v) and
+ * expanding q*(0,p)*conj(q) gives
+ *     t  = 2 * (v x p)
+ *     p' = p + w*t + v x t
+ * which is 15 multiplications and 15 additions instead of 56 flops, and
+ * never builds the intermediate quaternion.
+ * CAUTION: q must have unit norm. For a non-unit q the result is scaled
+ * by |q|^2 (the formula uses conj(q) in place of q^{-1}).
+ */
+inline Vector3 rotate(const Quaternion &q, const Vector3 &p)
+{
+	const double w=q.w(), x=q.i(), y=q.j(), z=q.k();
+	// t = 2 (v x p)
+	const double tx=2.0*(y*p.z-z*p.y);
+	const double ty=2.0*(z*p.x-x*p.z);
+	const double tz=2.0*(x*p.y-y*p.x);
+	// p' = p + w t + v x t
+	return Vector3{
+		p.x+w*tx+(y*tz-z*ty),
+		p.y+w*ty+(z*tx-x*tz),
+		p.z+w*tz+(x*ty-y*tx) };
+}
+
+// Rotate p by the rotation matrix M, p'=M*p
+/* Note: 9 multiplications and 6 additions. Convert the quaternion once with
+ * toMatrix (Conversion.h) when it rotates many points
+ */
+inline Vector3 rotate(const Matrix3 &M, const Vector3 &p)
+{
+	return Vector3{
+		M.m[0][0]*p.x+M.m[0][1]*p.y+M.m[0][2]*p.z,
+		M.m[1][0]*p.x+M.m[1][1]*p.y+M.m[1][2]*p.z,
+		M.m[2][0]*p.x+M.m[2][1]*p.y+M.m[2][2]*p.z };
+}
+
+// === Batch rotations ===
+/* Note: these split the points across all OpenMP threads (set the thread
+ * count with omp_set_num_threads or the OMP_NUM_THREADS environment variable)
+ * and vectorize within each thread. The output is resized to match the input,
+ * and may be the same object as the input (in-place rotation).
+ */
+
+// Rotate every point by the same unit quaternion
+void rotate(const Quaternion &q, const PointCloud &in, PointCloud &out);
+
+// Rotate every point by the same matrix. The fastest way to rotate many points
+// by one quaternion q is rotate(toMatrix(q),in,out)
+void rotate(const Matrix3 &M, const PointCloud &in, PointCloud &out);
+
+// Rotate point n by quaternion n. Sizes must match
+void rotate(const QuaternionBatch &q, const PointCloud &in, PointCloud &out);
+
+} // End namespace Quaternions
+
+#endif
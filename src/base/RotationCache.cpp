@@ -0,0 +1,330 @@
+/* File RotationCache.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the rotation matrix cache
+ * \author Nikos Kazazakis
+ */
+
+#include "RotationCache.h"
+#include "AlignedAllocator.h"
+
+// Other includes
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+
+using namespace Quaternions;
+
+const std::size_t RotationCache::kWays;
+const std::size_t RotationCache::kLocks;
+
+/* Note: the entries are read and written with relaxed atomic loads and
+ * stores. On x86-64 these are plain moves, but they make the seqlock legal
+ * C++: a reader may copy an entry while a writer changes it (it then sees
+ * the sequence number change and tries again), which with plain doubles
+ * would be a data race. The fences order the copy between the two reads of
+ * the sequence number (Boehm, "Can seqlocks get along with programming
+ * language memory models?", 2012).
+ *
+ * The fingerprints of a set are kept together, in one cache line, so a
+ * lookup scans them with one memory access and then copies only the entry
+ * that matched (which holds the whole key, to rule out collisions).
+ */
+
+namespace{
+
+typedef std::atomic<std::uint64_t> Word;
+
+// Fingerprints are odd, so this one is never used
+const std::uint64_t kEmpty=0;
+
+// Shards of the hit/miss counters: a thread always uses the same one, and
+// threads that share one still get correct counts (just slower)
+const std::size_t kShards=16;
+
+inline std::uint32_t floatBits(float x)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits,&x,sizeof(float));
+	return bits;
+}
+
+inline std::uint64_t toWord(double x)
+{
+	std::uint64_t bits;
+	std::memcpy(&bits,&x,sizeof(double));
+	return bits;
+}
+
+inline double fromWord(std::uint64_t bits)
+{
+	double x;
+	std::memcpy(&x,&bits,sizeof(double));
+	return x;
+}
+
+inline void increment(std::atomic<std::uint64_t> &counter)
+{
+	counter.fetch_add(1,std::memory_order_relaxed);
+}
+
+} // End anonymous namespace
+
+struct RotationCache::Set
+{
+	struct Entry
+	{
+		std::atomic<std::uint32_t> sequence; // Odd while a writer changes the entry
+		std::atomic<std::uint32_t> referenced; // The CLOCK flag
+		Word low, high; // The key
+		Word elements[9];
+	};
+
+	alignas(64) Word fingerprints[kWays]; // Hashes of the entry keys, for the scan
+	Entry entries[kWays];
+	std::size_t hand; // The CLOCK hand, only used under the lock of the set
+};
+
+struct RotationCache::Shard
+{
+	alignas(64) std::atomic<std::uint64_t> hits;
+	std::atomic<std::uint64_t> misses;
+};
+
+RotationCache::RotationCache(std::size_t capacity) : size_(0), insertions_(0), evictions_(0)
+{
+	setCount_=1;
+	while (setCount_*kWays<capacity){
+		setCount_*=2;
+	}
+	// Note: new[] only aligns to 16 bytes before C++17
+	sets_=AlignedAllocator<Set>().allocate(setCount_);
+	shards_=AlignedAllocator<Shard>().allocate(kShards);
+	locks_.reset(new std::mutex[kLocks]);
+	for (std::size_t n=0;n<kShards;++n){
+		new (shards_+n) Shard;
+	}
+	for (std::size_t n=0;n<setCount_;++n){
+		Set &set=*new (sets_+n) Set;
+		for (std::size_t way=0;way<kWays;++way){
+			set.fingerprints[way].store(kEmpty,std::memory_order_relaxed);
+			set.entries[way].sequence.store(0,std::memory_order_relaxed);
+			set.entries[way].referenced.store(0,std::memory_order_relaxed);
+			set.entries[way].low.store(0,std::memory_order_relaxed);
+			set.entries[way].high.store(0,std::memory_order_relaxed);
+		}
+		set.hand=0;
+	}
+	resetStats();
+}
+
+RotationCache::~RotationCache()
+{
+	// Sets and shards are only atomics and integers: nothing to destroy
+	AlignedAllocator<Set>().deallocate(sets_,setCount_);
+	AlignedAllocator<Shard>().deallocate(shards_,kShards);
+}
+
+bool RotationCache::key(const Quaternion &q, Key &key)
+{
+	// Far from unit length the floats would overflow, or lose the precision of
+	// the smaller components (and then different rotations would collide)
+	const double norm=dot(q,q);
+	if (!(norm>1e-30 && norm<1e30)){
+		return false;
+	}
+	// q and -q are the same rotation: make the largest component positive (the first, on ties)
+	const double w=q.w(), i=q.i(), j=q.j(), k=q.k();
+	double largest=w;
+	largest=std::abs(i)>std::abs(largest) ? i : largest;
+	largest=std::abs(j)>std::abs(largest) ? j : largest;
+	largest=std::abs(k)>std::abs(largest) ? k : largest;
+	const double sign=largest<0.0 ? -1.0 : 1.0;
+	// Note: adding +0 turns -0 into +0, so that both give the same key
+	const std::uint32_t bits[4]={floatBits(float(sign*w)+0.0f),floatBits(float(sign*i)+0.0f),
+			floatBits(float(sign*j)+0.0f),floatBits(float(sign*k)+0.0f)};
+	key.low=bits[0] | std::uint64_t(bits[1])<<32;
+	key.high=bits[2] | std::uint64_t(bits[3])<<32;
+	// One multiply is enough to spread the float bits over the high half, and
+	// folding that back reaches the bits that pick the set
+	const std::uint64_t hash=(key.low^(key.high*0x9E3779B97F4A7C15ull))*0xBF58476D1CE4E5B9ull;
+	key.fingerprint=(hash^(hash>>32)) | 1;
+	return true;
+}
+
+RotationCache::Set &RotationCache::setOf(const Key &key) const
+{
+	return sets_[(key.fingerprint>>1)&(setCount_-1)];
+}
+
+RotationCache::Shard &RotationCache::shard() const
+{
+	// A constant initializer: no guard to check on every call
+	static std::atomic<std::size_t> threads(0);
+	static thread_local std::size_t index=kShards;
+	if (index==kShards){
+		index=threads.fetch_add(1,std::memory_order_relaxed)%kShards;
+	}
+	return shards_[index];
+}
+
+bool RotationCache::lookup(const Key &key, Matrix3 &M) const
+{
+	Set &set=setOf(key);
+	for (std::size_t way=0;way<kWays;++way){
+		if (set.fingerprints[way].load(std::memory_order_relaxed)!=key.fingerprint){
+			continue;
+		}
+		Set::Entry &entry=set.entries[way];
+		// Copy the entry, until no writer changed it while we did
+		for (;;){
+			const std::uint32_t before=entry.sequence.load(std::memory_order_acquire);
+			const std::uint64_t low=entry.low.load(std::memory_order_relaxed);
+			const std::uint64_t high=entry.high.load(std::memory_order_relaxed);
+			for (int row=0;row<3;++row){
+				M.m[row][0]=fromWord(entry.elements[3*row].load(std::memory_order_relaxed));
+				M.m[row][1]=fromWord(entry.elements[3*row+1].load(std::memory_order_relaxed));
+				M.m[row][2]=fromWord(entry.elements[3*row+2].load(std::memory_order_relaxed));
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (before%2==0 && entry.sequence.load(std::memory_order_relaxed)==before){
+				if (low!=key.low || high!=key.high){
+					break; // A different key with the same fingerprint, or replaced since the scan
+				}
+				// Only write the flag if it changes: a store on every hit
+				// would bounce the cache line between the reading threads
+				if (!entry.referenced.load(std::memory_order_relaxed)){
+					entry.referenced.store(1,std::memory_order_relaxed);
+				}
+				increment(shard().hits);
+				return true;
+			}
+		}
+	}
+	increment(shard().misses);
+	return false;
+}
+
+bool RotationCache::find(const Quaternion &q, Matrix3 &M) const
+{
+	Key k;
+	if (key(q,k)){
+		return lookup(k,M);
+	}
+	increment(shard().misses);
+	return false;
+}
+
+Matrix3 RotationCache::matrix(const Quaternion &q)
+{
+	Key k;
+	if (!key(q,k)){
+		increment(shard().misses);
+		return toMatrix(q);
+	}
+	Matrix3 M;
+	if (!lookup(k,M)){
+		M=toMatrix(q);
+		insert(k,M);
+	}
+	return M;
+}
+
+void RotationCache::insert(const Key &key, const Matrix3 &M)
+{
+	Set &set=setOf(key);
+	std::lock_guard<std::mutex> lock(locks_[(&set-sets_)%kLocks]);
+
+	// Another thread may have inserted it since we missed; else take an empty entry
+	std::size_t way=kWays;
+	for (std::size_t n=0;n<kWays;++n){
+		const std::uint64_t current=set.fingerprints[n].load(std::memory_order_relaxed);
+		if (current==key.fingerprint && set.entries[n].low.load(std::memory_order_relaxed)==key.low
+				&& set.entries[n].high.load(std::memory_order_relaxed)==key.high){
+			return;
+		}
+		if (current==kEmpty && way==kWays){
+			way=n;
+		}
+	}
+	if (way==kWays){
+		// CLOCK: skip (and clear) the referenced entries. At most one full
+		// sweep clears them all, so this ends within kWays+1 steps
+		while (set.entries[set.hand].referenced.load(std::memory_order_relaxed)){
+			set.entries[set.hand].referenced.store(0,std::memory_order_relaxed);
+			set.hand=(set.hand+1)%kWays;
+		}
+		way=set.hand;
+		set.hand=(set.hand+1)%kWays;
+		increment(evictions_);
+	}
+	else{
+		size_.fetch_add(1,std::memory_order_relaxed);
+	}
+	increment(insertions_);
+
+	Set::Entry &entry=set.entries[way];
+	const std::uint32_t sequence=entry.sequence.load(std::memory_order_relaxed);
+	entry.sequence.store(sequence+1,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	entry.low.store(key.low,std::memory_order_relaxed);
+	entry.high.store(key.high,std::memory_order_relaxed);
+	for (int row=0;row<3;++row){
+		for (int column=0;column<3;++column){
+			entry.elements[3*row+column].store(toWord(M.m[row][column]),std::memory_order_relaxed);
+		}
+	}
+	entry.referenced.store(0,std::memory_order_relaxed);
+	entry.sequence.store(sequence+2,std::memory_order_release);
+	set.fingerprints[way].store(key.fingerprint,std::memory_order_release);
+}
+
+void RotationCache::clear()
+{
+	for (std::size_t n=0;n<setCount_;++n){
+		Set &set=sets_[n];
+		std::lock_guard<std::mutex> lock(locks_[n%kLocks]);
+		for (std::size_t way=0;way<kWays;++way){
+			if (set.fingerprints[way].load(std::memory_order_relaxed)==kEmpty){
+				continue;
+			}
+			// Readers check the key inside the seqlock, so changing it is
+			// enough (no quaternion has a zero key: it has a positive component)
+			Set::Entry &entry=set.entries[way];
+			const std::uint32_t sequence=entry.sequence.load(std::memory_order_relaxed);
+			entry.sequence.store(sequence+1,std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			entry.low.store(0,std::memory_order_relaxed);
+			entry.high.store(0,std::memory_order_relaxed);
+			entry.referenced.store(0,std::memory_order_relaxed);
+			entry.sequence.store(sequence+2,std::memory_order_release);
+			set.fingerprints[way].store(kEmpty,std::memory_order_relaxed);
+			size_.fetch_sub(1,std::memory_order_relaxed);
+		}
+	}
+}
+
+RotationCacheStats RotationCache::stats() const
+{
+	RotationCacheStats stats;
+	for (std::size_t n=0;n<kShards;++n){
+		stats.hits+=shards_[n].hits.load(std::memory_order_relaxed);
+		stats.misses+=shards_[n].misses.load(std::memory_order_relaxed);
+	}
+	stats.insertions=insertions_.load(std::memory_order_relaxed);
+	stats.evictions=evictions_.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void RotationCache::resetStats()
+{
+	for (std::size_t n=0;n<kShards;++n){
+		shards_[n].hits.store(0,std::memory_order_relaxed);
+		shards_[n].misses.store(0,std::memory_order_relaxed);
+	}
+	insertions_.store(0,std::memory_order_relaxed);
+	evictions_.store(0,std::memory_order_relaxed);
+}
+
+// End of file
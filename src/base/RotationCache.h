@@ -0,0 +1,143 @@
+/* File RotationCache.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief A bounded, thread-safe cache of rotation matrices keyed on quantized quaternions
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_ROTATION_CACHE_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_ROTATION_CACHE_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "Conversion.h"
+#include "Rotation.h"
+
+// Include STL headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/* Note: when the same few orientations come back again and again (headings
+ * on a grid, camera presets, ...), their rotation matrices can be kept
+ * instead of being rebuilt every time. RotationCache maps quaternions to
+ * their matrices (toMatrix in Conversion.h):
+ *
+ *     RotationCache cache(1024);
+ *     Vector3 p2=rotate(cache.matrix(q),p);  // Builds the matrix the first time
+ *
+ * The key is q with its components rounded to floats, after making its
+ * largest component positive: q and -q (the same rotation) share it, and so
+ * do rotations whose components round to the same floats, which for unit
+ * quaternions are within 2.4e-7 rad of each other. Such a rotation gets the
+ * matrix of the first one that was cached. Keys aren't normalized, so 2*q is
+ * a different key from q (but gets the same matrix: toMatrix doesn't need a
+ * unit quaternion); normalize the same way everywhere to share entries. The
+ * zero quaternion, quaternions with NaN or infinite components, and those
+ * far from unit length (|q|^2 outside 1e-30 to 1e30) are never cached.
+ *
+ * The cache has a fixed capacity. Every key belongs to one set of 8 entries
+ * (by its hash), and when a set is full the entry to replace is picked with
+ * the CLOCK algorithm: every entry has a "referenced" flag, set by every hit;
+ * a hand sweeps the set, clearing flags, and evicts the first entry whose
+ * flag was already clear. This approximates "least recently used" without
+ * keeping an order, which would need a lock on every hit. New entries start
+ * with the flag clear, so a rotation that is never looked up again is the
+ * first to go, and a burst of new rotations can't push out the ones in use.
+ *
+ * Any number of threads may use a cache at once. Lookups take no locks: each
+ * entry has a sequence number (a "seqlock") that writers make odd while they
+ * change the entry, and readers copy the entry and check that the number
+ * didn't change while they did. Misses build the matrix without any lock,
+ * then insert it under one of 64 locks (picked by the set).
+ *
+ * What a hit saves: rotating a point through the cache takes about 35ns on
+ * a 3GHz Xeon, with any number of threads, and q*p*q.conjugate() with
+ * SparseQuaternion about 1100ns. But toMatrix itself only takes a few ns, so
+ * for a dense Quaternion rotate(toMatrix(q),p) is faster (14ns) than any
+ * lookup: cache the matrices when building them costs more than that. See
+ * the quaternionBench RecurringRotations benchmarks.
+ */
+
+namespace Quaternions{
+
+// Counters of a RotationCache
+struct RotationCacheStats
+{
+	std::uint64_t hits=0;
+	std::uint64_t misses=0;     // Including the lookups of quaternions that can't be cached
+	std::uint64_t insertions=0;
+	std::uint64_t evictions=0;  // Insertions that replaced another entry
+
+	// Fraction of the lookups that were hits (0 before any lookup)
+	double hitRate() const {return hits+misses ? double(hits)/double(hits+misses) : 0.0;}
+};
+
+/**
+ * RotationCache stores the rotation matrices of up to capacity() rotations.
+ * It is thread-safe: any member may be called from any number of threads at
+ * once.
+ */
+class RotationCache
+{
+public :
+	static const std::size_t kWays=8; // Entries per set
+
+	// Room for at least capacity matrices (rounded up to a power of 2 number of sets)
+	explicit RotationCache(std::size_t capacity);
+	~RotationCache();
+
+	RotationCache(const RotationCache &)=delete;
+	RotationCache &operator=(const RotationCache &)=delete;
+
+	// The rotation matrix of q, from the cache, or built and cached
+	Matrix3 matrix(const Quaternion &q);
+
+	// Look q up without inserting it: true (and its matrix in M) on a hit
+	bool find(const Quaternion &q, Matrix3 &M) const;
+
+	// Rotate p by q, with the cached matrix
+	Vector3 rotate(const Quaternion &q, const Vector3 &p) {return Quaternions::rotate(matrix(q),p);}
+
+	// Maximum and current number of cached matrices
+	std::size_t capacity() const {return setCount_*kWays;}
+	std::size_t size() const {return size_.load(std::memory_order_relaxed);}
+
+	// Counters since construction (or the last resetStats)
+	RotationCacheStats stats() const;
+	void resetStats();
+
+	// Remove every entry (the counters are kept)
+	void clear();
+
+private:
+	struct Set;
+	struct Shard;
+	static const std::size_t kLocks=64;
+
+	// The components of q as floats (the sign made canonical), and their hash
+	struct Key
+	{
+		std::uint64_t low, high, fingerprint;
+	};
+
+	// The key of q, false if q can't be cached
+	static bool key(const Quaternion &q, Key &key);
+	Set &setOf(const Key &key) const;
+	bool lookup(const Key &key, Matrix3 &M) const;
+	void insert(const Key &key, const Matrix3 &M);
+	Shard &shard() const;
+
+	Set *sets_;       // Cache line aligned (see AlignedAllocator.h)
+	Shard *shards_;   // Hit and miss counters, spread over threads
+	std::size_t setCount_;
+	std::atomic<std::size_t> size_;
+	std::unique_ptr<std::mutex[]> locks_;
+	std::atomic<std::uint64_t> insertions_, evictions_;
+}; // End of RotationCache class
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,313 @@
+/* File RotationExecutor.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the asynchronous rotation service
+ * \author Nikos Kazazakis
+ */
+
+#include "RotationExecutor.h"
+
+// Other includes
+#include <cmath>
+#include <cstring>
+#include <omp.h>
+
+using namespace Quaternions;
+
+/* Note: every worker counts into its own counters, which only it writes, so
+ * it updates them with a plain load and store instead of an atomic
+ * read-modify-write; stats() adds them up (as the instrumentation does, see
+ * Instrumentation.h).
+ *
+ * Waking the workers up: a worker that finds the queue empty registers as
+ * sleeping, then checks the queue once more before it waits; a producer
+ * pushes, then checks whether anyone is sleeping. The two seq_cst fences make
+ * sure that at least one of them sees the other, so a job is never left in
+ * the queue with every worker asleep. The producer then notifies under the
+ * mutex, so the notification can't slip in between the worker's last check
+ * and its wait.
+ */
+
+struct RotationExecutor::Job
+{
+	Quaternion q;
+	PointCloud points;
+	std::promise<PointCloud> promise; // Used if there is no callback
+	Callback callback;
+	std::chrono::steady_clock::time_point submitted;
+};
+
+namespace{
+
+typedef std::atomic<std::uint64_t> Counter;
+
+// Only for counters that a single thread writes
+inline void increase(Counter &counter, std::uint64_t value)
+{
+	counter.store(counter.load(std::memory_order_relaxed)+value,std::memory_order_relaxed);
+}
+
+} // End anonymous namespace
+
+struct RotationExecutor::Worker
+{
+	std::thread thread;
+
+	// The batch being built, kept between batches so that its memory is reused
+	std::vector<Job *> jobs;
+	QuaternionBatch quaternions;
+	PointCloud cloud;
+
+	Counter completed, points, batches, maxQueueDepth;
+	Counter latency[kExecutorLatencyBuckets];
+};
+
+// == Latency histograms
+
+std::uint64_t Quaternions::latencyBucketStart(std::size_t bucket)
+{
+	if (bucket<8){
+		return bucket;
+	}
+	// 8 buckets per power of 2: the power, and the top 3 bits below the leading one
+	const std::size_t power=bucket/8+2, step=bucket%8;
+	return std::uint64_t(8+step)<<(power-3);
+}
+
+std::size_t Quaternions::executorLatencyBucket(std::uint64_t nanoseconds)
+{
+	if (nanoseconds<8){
+		return nanoseconds;
+	}
+	std::size_t power=0;
+	while (power<63 && nanoseconds>>(power+1)){
+		++power;
+	}
+	const std::size_t bucket=(power-2)*8+((nanoseconds>>(power-3))&7);
+	return std::min(bucket,kExecutorLatencyBuckets-1);
+}
+
+std::uint64_t RotationExecutorStats::latencyPercentile(double fraction) const
+{
+	std::uint64_t total=0;
+	for (std::size_t bucket=0;bucket<kExecutorLatencyBuckets;++bucket){
+		total+=latency[bucket];
+	}
+	if (total==0){
+		return 0;
+	}
+	// The rank of the job, counting from 1
+	std::uint64_t rank=static_cast<std::uint64_t>(std::ceil(fraction*double(total)));
+	rank=std::max<std::uint64_t>(1,std::min(rank,total));
+	std::uint64_t seen=0;
+	for (std::size_t bucket=0;bucket<kExecutorLatencyBuckets;++bucket){
+		seen+=latency[bucket];
+		if (seen>=rank){
+			return latencyBucketStart(bucket+1);
+		}
+	}
+	return latencyBucketStart(kExecutorLatencyBuckets);
+}
+
+// == Executor
+
+RotationExecutor::RotationExecutor(const RotationExecutorOptions &options) :
+	options_(options), queue_(options.queueCapacity), sleeping_(0), stopping_(false)
+{
+	assert(options.workers>0 && "An executor needs at least one worker");
+	assert(options.maxBatchJobs>0 && "A batch needs room for at least one job");
+	for (std::size_t n=0;n<options_.workers;++n){
+		workers_.emplace_back(new Worker);
+	}
+	resetStats();
+	// Start the threads last: run() uses the members above
+	for (auto &worker : workers_){
+		Worker &w=*worker;
+		w.thread=std::thread([this,&w]{run(w);});
+	}
+}
+
+RotationExecutor::~RotationExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_=true;
+	}
+	wakeUp_.notify_all();
+	for (auto &worker : workers_){
+		worker->thread.join();
+	}
+}
+
+std::future<PointCloud> RotationExecutor::submit(const Quaternion &q, PointCloud points)
+{
+	std::unique_ptr<Job> job(new Job);
+	job->q=q;
+	job->points=std::move(points);
+	std::future<PointCloud> result=job->promise.get_future();
+	enqueue(std::move(job));
+	return result;
+}
+
+void RotationExecutor::submit(const Quaternion &q, PointCloud points, Callback callback)
+{
+	assert(callback && "The callback must be callable");
+	std::unique_ptr<Job> job(new Job);
+	job->q=q;
+	job->points=std::move(points);
+	job->callback=std::move(callback);
+	enqueue(std::move(job));
+}
+
+void RotationExecutor::enqueue(std::unique_ptr<Job> job)
+{
+	job->submitted=std::chrono::steady_clock::now();
+	Job *pointer=job.release();
+	// Full: back off until a worker takes a job
+	while (!queue_.tryPush(std::move(pointer))){
+		std::this_thread::yield();
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping_.load(std::memory_order_relaxed)>0){
+		std::lock_guard<std::mutex> lock(mutex_);
+		wakeUp_.notify_one();
+	}
+}
+
+bool RotationExecutor::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	sleeping_.fetch_add(1,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (queue_.size()==0 && !stopping_){
+		wakeUp_.wait(lock);
+	}
+	sleeping_.fetch_sub(1,std::memory_order_relaxed);
+	return queue_.size()>0;
+}
+
+void RotationExecutor::run(Worker &worker)
+{
+	// The pool is the parallelism: one OpenMP thread per kernel call (this
+	// only changes the setting of this thread)
+	omp_set_num_threads(1);
+
+	const bool window=options_.batchWindow.count()>0;
+	for (;;){
+		Job *job;
+		if (!queue_.tryPop(job)){
+			if (!wait()){
+				return; // Stopping, and nothing left to do
+			}
+			continue;
+		}
+		const std::size_t depth=queue_.size()+1;
+		if (depth>worker.maxQueueDepth.load(std::memory_order_relaxed)){
+			worker.maxQueueDepth.store(depth,std::memory_order_relaxed);
+		}
+
+		// Grow the batch until it is full, or the queue is empty (and the window is over)
+		worker.jobs.assign(1,job);
+		std::size_t points=job->points.size();
+		const auto deadline=job->submitted+options_.batchWindow;
+		while (worker.jobs.size()<options_.maxBatchJobs && points<options_.maxBatchPoints){
+			if (queue_.tryPop(job)){
+				worker.jobs.push_back(job);
+				points+=job->points.size();
+			}
+			else if (window && std::chrono::steady_clock::now()<deadline){
+				std::this_thread::yield();
+			}
+			else{
+				break;
+			}
+		}
+		process(worker);
+	}
+}
+
+void RotationExecutor::process(Worker &worker)
+{
+	// Gather the jobs into one batch, one quaternion per point
+	std::size_t size=0;
+	for (const Job *job : worker.jobs){
+		size+=job->points.size();
+	}
+	worker.quaternions.resize(size);
+	worker.cloud.resize(size);
+	std::size_t offset=0;
+	for (const Job *job : worker.jobs){
+		const std::size_t n=job->points.size();
+		std::fill_n(worker.quaternions.w()+offset,n,job->q.w());
+		std::fill_n(worker.quaternions.i()+offset,n,job->q.i());
+		std::fill_n(worker.quaternions.j()+offset,n,job->q.j());
+		std::fill_n(worker.quaternions.k()+offset,n,job->q.k());
+		if (n>0){
+			std::memcpy(worker.cloud.x()+offset,job->points.x(),n*sizeof(double));
+			std::memcpy(worker.cloud.y()+offset,job->points.y(),n*sizeof(double));
+			std::memcpy(worker.cloud.z()+offset,job->points.z(),n*sizeof(double));
+		}
+		offset+=n;
+	}
+
+	rotate(worker.quaternions,worker.cloud,worker.cloud);
+
+	// Count before completing the jobs, so that whoever waits for them sees the counts
+	increase(worker.batches,1);
+
+	// Scatter the results back into the jobs (their clouds already have the right size)
+	offset=0;
+	for (Job *job : worker.jobs){
+		const std::size_t n=job->points.size();
+		if (n>0){
+			std::memcpy(job->points.x(),worker.cloud.x()+offset,n*sizeof(double));
+			std::memcpy(job->points.y(),worker.cloud.y()+offset,n*sizeof(double));
+			std::memcpy(job->points.z(),worker.cloud.z()+offset,n*sizeof(double));
+		}
+		offset+=n;
+
+		const auto now=std::chrono::steady_clock::now();
+		const std::uint64_t latency=std::chrono::duration_cast<std::chrono::nanoseconds>(now-job->submitted).count();
+		increase(worker.latency[executorLatencyBucket(latency)],1);
+		increase(worker.completed,1);
+		increase(worker.points,n);
+		if (job->callback){
+			job->callback(job->points);
+		}
+		else{
+			job->promise.set_value(std::move(job->points));
+		}
+		delete job;
+	}
+}
+
+RotationExecutorStats RotationExecutor::stats() const
+{
+	RotationExecutorStats stats;
+	for (const auto &worker : workers_){
+		stats.completed+=worker->completed.load(std::memory_order_relaxed);
+		stats.points+=worker->points.load(std::memory_order_relaxed);
+		stats.batches+=worker->batches.load(std::memory_order_relaxed);
+		stats.maxQueueDepth=std::max<std::size_t>(stats.maxQueueDepth,worker->maxQueueDepth.load(std::memory_order_relaxed));
+		for (std::size_t bucket=0;bucket<kExecutorLatencyBuckets;++bucket){
+			stats.latency[bucket]+=worker->latency[bucket].load(std::memory_order_relaxed);
+		}
+	}
+	stats.queueDepth=queue_.size();
+	return stats;
+}
+
+void RotationExecutor::resetStats()
+{
+	for (auto &worker : workers_){
+		worker->completed.store(0,std::memory_order_relaxed);
+		worker->points.store(0,std::memory_order_relaxed);
+		worker->batches.store(0,std::memory_order_relaxed);
+		worker->maxQueueDepth.store(0,std::memory_order_relaxed);
+		for (auto &bucket : worker->latency){
+			bucket.store(0,std::memory_order_relaxed);
+		}
+	}
+}
+
+// End of file
@@ -0,0 +1,270 @@
+/* File RotationExecutor.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief An asynchronous rotation service: a lock-free job queue, batching and a pool of worker threads
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_ROTATION_EXECUTOR_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_ROTATION_EXECUTOR_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+#include "Rotation.h"
+
+// Include STL headers
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* Note: the batch kernels of Rotation.h pay off from a few thousand points
+ * up, and split every call across all OpenMP threads. A service where many
+ * threads each rotate a few hundred points can't use them directly: every
+ * call would start a parallel region for almost no work. RotationExecutor
+ * takes such small jobs from any number of threads instead,
+ *
+ *     RotationExecutor executor;
+ *     std::future<PointCloud> rotated=executor.submit(q,std::move(points));
+ *
+ * and its worker threads each take as many jobs as are waiting (up to the
+ * batch limits), copy them into one structure-of-arrays batch (one
+ * quaternion per point, see QuaternionBatch.h), rotate the whole batch with
+ * one call of the vectorized kernel, and complete the jobs: a future, or a
+ * callback that runs on the worker thread. The results are bit for bit those
+ * of rotate(q,points,out).
+ *
+ * The jobs wait in a bounded lock-free queue (MPMCQueue below). When it is
+ * full, submit waits for a free slot, which slows the producers down to the
+ * rate of the workers instead of letting the backlog (and the latency) grow
+ * without bound. Idle workers sleep on a condition variable, and producers
+ * only take its lock when a worker is asleep.
+ *
+ * Batching trades latency for throughput: the bigger the batch, the less
+ * the queue, the wake ups and the kernel call cost per point, but the longer
+ * the first job of a batch waits for the last. A worker stops growing a batch
+ * once it has maxBatchJobs jobs or maxBatchPoints points, or when the queue is
+ * empty, unless a batchWindow is set: then it keeps waiting for more jobs
+ * until the first job of the batch has waited that long.
+ * A batch takes 56 bytes per point (the point and its quaternion), so the
+ * default limit of 8192 points keeps it within a typical L2 cache.
+ * The workers run their kernels on one OpenMP thread each: the pool already
+ * keeps the cores busy.
+ */
+
+namespace Quaternions{
+
+// === Lock-free queue ===
+/**
+ * MPMCQueue is a bounded queue that any number of threads may push to and
+ * pop from at once, without locks (Vyukov's bounded MPMC queue). Every cell
+ * has a sequence number that says whose turn it is: a producer claims a cell
+ * by moving the enqueue position forward with a compare-and-swap, writes the
+ * value, then hands the cell to the consumers by bumping its sequence
+ * number (and the other way around for consumers). Producers and consumers
+ * only contend on their own position, in its own cache line.
+ */
+template <typename T>
+class MPMCQueue
+{
+public :
+	// Room for capacity values (rounded up to a power of 2, at least 2)
+	explicit MPMCQueue(std::size_t capacity)
+	{
+		std::size_t size=2;
+		while (size<capacity){
+			size*=2;
+		}
+		mask_=size-1;
+		cells_.reset(new Cell[size]);
+		for (std::size_t n=0;n<size;++n){
+			cells_[n].sequence.store(n,std::memory_order_relaxed);
+		}
+		enqueuePosition_.store(0,std::memory_order_relaxed);
+		dequeuePosition_.store(0,std::memory_order_relaxed);
+	}
+
+	MPMCQueue(const MPMCQueue &)=delete;
+	MPMCQueue &operator=(const MPMCQueue &)=delete;
+
+	// Add value to the back. Returns false (and leaves value alone) if the queue is full
+	bool tryPush(T &&value)
+	{
+		std::size_t position=enqueuePosition_.load(std::memory_order_relaxed);
+		for (;;){
+			Cell &cell=cells_[position&mask_];
+			const std::size_t sequence=cell.sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t difference=std::ptrdiff_t(sequence)-std::ptrdiff_t(position);
+			if (difference==0){
+				// The cell is free: claim it (on failure, position is reloaded)
+				if (enqueuePosition_.compare_exchange_weak(position,position+1,std::memory_order_relaxed)){
+					cell.value=std::move(value);
+					cell.sequence.store(position+1,std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference<0){
+				return false; // The consumers haven't freed this cell yet: full
+			}
+			else{
+				position=enqueuePosition_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Take the value at the front. Returns false if the queue is empty
+	bool tryPop(T &value)
+	{
+		std::size_t position=dequeuePosition_.load(std::memory_order_relaxed);
+		for (;;){
+			Cell &cell=cells_[position&mask_];
+			const std::size_t sequence=cell.sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t difference=std::ptrdiff_t(sequence)-std::ptrdiff_t(position+1);
+			if (difference==0){
+				if (dequeuePosition_.compare_exchange_weak(position,position+1,std::memory_order_relaxed)){
+					value=std::move(cell.value);
+					cell.sequence.store(position+mask_+1,std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference<0){
+				return false; // No producer has filled this cell yet: empty
+			}
+			else{
+				position=dequeuePosition_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	std::size_t capacity() const {return mask_+1;}
+
+	// Number of values in the queue, including those still being pushed.
+	// Only a snapshot when other threads use the queue
+	std::size_t size() const
+	{
+		const std::size_t popped=dequeuePosition_.load(std::memory_order_seq_cst);
+		const std::size_t pushed=enqueuePosition_.load(std::memory_order_seq_cst);
+		return pushed>popped ? pushed-popped : 0;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> cells_;
+	std::size_t mask_;
+	// Each position in its own cache line (the class is then 64 byte aligned,
+	// which new supports with -faligned-new)
+	alignas(64) std::atomic<std::size_t> enqueuePosition_;
+	alignas(64) std::atomic<std::size_t> dequeuePosition_;
+
+}; // End of MPMCQueue class
+
+// === Rotation executor ===
+
+// Latency histograms have 8 buckets per power of 2 (so a bucket is at most
+// 12.5% wide) from 8ns up to 2^40ns (18 minutes), and one per ns below 8ns
+const std::size_t kExecutorLatencyBuckets=304;
+
+struct RotationExecutorOptions
+{
+	std::size_t workers=std::max(1u,std::thread::hardware_concurrency());
+	std::size_t queueCapacity=4096;          // Jobs waiting, at most (rounded up to a power of 2)
+	std::size_t maxBatchJobs=256;            // Jobs in one batch, at most
+	std::size_t maxBatchPoints=8192;         // A batch stops growing at this many points (see below)
+	std::chrono::microseconds batchWindow{0};// How long a worker waits for more jobs to fill a batch
+};
+
+// Counters of a RotationExecutor, added up over its workers
+struct RotationExecutorStats
+{
+	std::uint64_t completed=0;   // Jobs
+	std::uint64_t points=0;      // Points of the completed jobs
+	std::uint64_t batches=0;
+	std::size_t queueDepth=0;    // Jobs waiting right now
+	std::size_t maxQueueDepth=0; // Most jobs waiting when a worker started a batch
+	// Time from submit to completion: latency[b] jobs took between
+	// latencyBucketStart(b) and latencyBucketStart(b+1) nanoseconds
+	std::uint64_t latency[kExecutorLatencyBuckets]={};
+
+	// Average jobs per batch (0 before any batch)
+	double meanBatchJobs() const {return batches ? double(completed)/double(batches) : 0.0;}
+
+	// An upper bound of the latency that a fraction (e.g. 0.99) of the jobs
+	// didn't exceed, in nanoseconds: the end of the bucket of that job. 0 if
+	// no job completed
+	std::uint64_t latencyPercentile(double fraction) const;
+};
+
+// First latency (in ns) of a histogram bucket, and the bucket of a latency
+std::uint64_t latencyBucketStart(std::size_t bucket);
+std::size_t executorLatencyBucket(std::uint64_t nanoseconds);
+
+/**
+ * RotationExecutor rotates point clouds on a fixed pool of worker threads.
+ * submit may be called from any number of threads at once. Destroying the
+ * executor completes the jobs already submitted, then stops the workers; no
+ * thread may submit while (or after) it is destroyed.
+ */
+class RotationExecutor
+{
+public :
+	// Called on a worker thread with the rotated points, which it may move
+	// away. It must not throw (that would end the program)
+	typedef std::function<void(PointCloud &rotated)> Callback;
+
+	explicit RotationExecutor(const RotationExecutorOptions &options=RotationExecutorOptions());
+	~RotationExecutor();
+
+	RotationExecutor(const RotationExecutor &)=delete;
+	RotationExecutor &operator=(const RotationExecutor &)=delete;
+
+	// Rotate points by the UNIT quaternion q (as rotate(q,points,out) would)
+	std::future<PointCloud> submit(const Quaternion &q, PointCloud points);
+	void submit(const Quaternion &q, PointCloud points, Callback callback);
+
+	const RotationExecutorOptions &options() const {return options_;}
+
+	// Counters since construction (or the last resetStats). Jobs that
+	// complete while the counters are reset may be counted or not
+	RotationExecutorStats stats() const;
+	void resetStats();
+
+private:
+	struct Job;
+	struct Worker;
+
+	void enqueue(std::unique_ptr<Job> job);
+	void run(Worker &worker);
+	// Sleep until there is a job, false once the executor stops and the queue is empty
+	bool wait();
+	void process(Worker &worker);
+
+	RotationExecutorOptions options_;
+	MPMCQueue<Job *> queue_;
+	std::vector<std::unique_ptr<Worker> > workers_;
+
+	// Sleeping workers, and what wakes them
+	std::mutex mutex_;
+	std::condition_variable wakeUp_;
+	std::atomic<std::size_t> sleeping_;
+	bool stopping_; // Guarded by mutex_
+}; // End of RotationExecutor class
+
+} // End namespace Quaternions
+
+#endif
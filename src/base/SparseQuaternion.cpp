@@ -0,0 +1,466 @@
+/* File SparseQuaternion.cpp
+ * 
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the map-backed SparseQuaternion class
+ * \author Nikos Kazazakis
+ */
+
+/* Include the header file of the class. Note that this carries over 
+ * any includes we made in the header */
+#include "SparseQuaternion.h"
+
+// Other includes
+#include <cassert>
+#include <utility>
+
+// Define our namespace. This conveniently allows us to use all our
+// definitions without the Quaternions:: prefix
+using namespace Quaternions;
+
+// Default constructor: create a zero quaternion
+/* Note: missing elements are zero, so zero is the quaternion with no elements
+ * at all. Storing four explicit zeros would cost four allocations, and would
+ * keep products with it off the sparse paths
+ */
+SparseQuaternion::SparseQuaternion()
+{
+	QUATERNION_COUNT(opSparseConstruct);
+}
+
+// Consrtuct a quaternion by defining all its elements
+SparseQuaternion::SparseQuaternion(double w, double i, double j, double k)
+{
+	QUATERNION_COUNT(opSparseConstruct);
+	// Assign quaternion values
+	// - Real part
+	if (w!=0){(*this)[qw]=w;} // The quaternion is sparse; we only assign a value if it's non-zero
+	// - Vector part
+	if (i!=0){(*this)[qi]=i;}
+	if (j!=0){(*this)[qj]=j;}
+	if (k!=0){(*this)[qk]=k;}
+}
+
+// Convert from a dense quaternion. Delegating to the 4-part constructor keeps the
+// "only store non-zero values" rule in one place
+SparseQuaternion::SparseQuaternion(const Quaternion &q) :
+	SparseQuaternion(q.w(),q.i(),q.j(),q.k())
+{
+}
+
+// Default destructor. All data in an object is (usually) stored in its private members
+// so when the object is destroyed we must deallocate that memory.
+// An exception is when using shared pointers, where the destructor will simply
+// decrease the reference count by 1.
+// It is good practice to write code for the destruction of an object here when you 
+// first create it, to avoid memory leaks
+SparseQuaternion::~SparseQuaternion()
+{
+	 // Techincally not necessary because it's an STL object, but good practice to 
+	//  get in the habid of destroying the private members
+	elements_.clear();
+}
+
+// ===Begin member operator overloading===
+// Copy constructor
+/* Note: the map copy constructor asks the allocator which arena to use
+ * (select_on_container_copy_construction), so copies follow the current scope
+ */
+SparseQuaternion::SparseQuaternion(const SparseQuaternion &q) :
+	elements_(q.elements_),
+	occupancy_(q.occupancy_)
+{
+	QUATERNION_COUNT(opSparseConstruct);
+}
+
+// Move constructor. std::map hands its nodes over, so this never allocates
+SparseQuaternion::SparseQuaternion(SparseQuaternion &&q) noexcept :
+	elements_(std::move(q.elements_)),
+	occupancy_(q.occupancy_)
+{
+	q.occupancy_=occupancyNone;
+}
+
+// Copy assignment operator
+SparseQuaternion &SparseQuaternion::operator=(const SparseQuaternion &q)
+{
+	/* Note: we replace the elements instead of merging them, otherwise a
+	 * component that is missing from q (i.e. zero) would keep its old value.
+	 * The map reuses our nodes where it can, and keeps our allocator
+	 */
+	elements_=q.elements_;
+	occupancy_=q.occupancy_;
+	return *this;
+}
+
+// Move assignment operator
+SparseQuaternion &SparseQuaternion::operator=(SparseQuaternion &&q) noexcept
+{
+	/* Note: std::map steals the nodes when the allocators compare equal
+	 * (same arena) and moves element by element into our own nodes when
+	 * they don't. Either way q ends up empty (clear() never throws) */
+	if (this!=&q){
+		elements_=std::move(q.elements_);
+		occupancy_=q.occupancy_;
+		q.elements_.clear();
+		q.occupancy_=occupancyNone;
+	}
+	return *this;
+}
+
+// ====End member operator overloading====
+
+// Return the conjugate of this quaternion. C++11 moves the q stack variable to
+// the return output automatically
+SparseQuaternion SparseQuaternion::conjugate()
+{
+	QUATERNION_COUNT(opConjugate);
+	SparseQuaternion q = SparseQuaternion(w(),-i(),-j(),-k());
+	return q;
+}
+
+// Return the norm of the quaternion
+double SparseQuaternion::norm() const
+{
+	QUATERNION_TIME(opNorm);
+	return std::sqrt(squaredNorm());
+}
+
+// Return the squared norm: only the stored elements contribute
+double SparseQuaternion::squaredNorm() const
+{
+	double lengthSquared=0.0;
+	for (const auto &element : elements_){
+		lengthSquared+=element.second*element.second; // x*x is one instruction, pow(x,2) a library call
+	}
+	return lengthSquared;
+}
+
+// Normalize in place
+SparseQuaternion &SparseQuaternion::normalize()
+{
+	QUATERNION_COUNT(opNormalize);
+	const double length=norm();
+	assert(length>0.0 && "Can't normalize a zero quaternion");
+	const double scale=1.0/length;
+	for (auto &element : elements_){
+		element.second*=scale;
+	}
+	return *this;
+}
+
+// Invert in place: negate the vector part and divide everything by |q|^2
+SparseQuaternion &SparseQuaternion::invert()
+{
+	QUATERNION_COUNT(opInverse);
+	const double lengthSquared=squaredNorm();
+	assert(lengthSquared>0.0 && "Can't invert a zero quaternion");
+	const double scale=1.0/lengthSquared;
+	for (auto &element : elements_){
+		element.second*= element.first==qw ? scale : -scale;
+	}
+	return *this;
+}
+
+SparseQuaternion Quaternions::normalize(const SparseQuaternion &q)
+{
+	SparseQuaternion p(q);
+	p.normalize();
+	return p;
+}
+
+SparseQuaternion Quaternions::inverse(const SparseQuaternion &q)
+{
+	SparseQuaternion p(q);
+	p.invert();
+	return p;
+}
+
+// Convert to the dense representation. Missing elements are zero
+Quaternion SparseQuaternion::dense() const
+{
+	double values[4];
+	gather(values);
+	return Quaternion(values[qw],values[qi],values[qj],values[qk]);
+}
+
+// One pass over the map, rather than a search per element
+void SparseQuaternion::gather(double values[4]) const
+{
+	values[qw]=values[qi]=values[qj]=values[qk]=0.0;
+	for (const auto &element : elements_){
+		values[element.first]=element.second;
+	}
+}
+
+// Return whether the elements_ map size is zero
+bool SparseQuaternion::isEmpty() const
+{
+	if (elements_.empty()){
+		return true;
+	}else{
+		return false;
+	}
+}
+
+// Print output. Prints to cout by default
+void SparseQuaternion::write(std::ostream &out) const
+{
+	for (const auto &element : elements_ ){ // We use a reference to the elements to avoid a copy!
+		if (element.second != 0.0 ){
+			out<<std::showpos<<element.second; // Show the +/- sign if non-zero
+		}else{
+			out<<element.second;
+		}
+		switch (element.first){ // Print the appropriate unit vectors
+		case qw:
+			break;
+		case qi:
+			out<<"i";
+			break;
+		case qj:
+			out<<"j";
+			break;
+		case qk:
+			out<<"k";
+			break;
+		default:
+			// No default behaviour specified, break
+			break;
+		}
+	}
+	out<<std::noshowpos; // Reset the showpos format
+}
+
+double SparseQuaternion::w() const
+{
+	return element(qw);
+}
+
+double SparseQuaternion::i() const
+{
+	return element(qi);
+}
+
+double SparseQuaternion::j() const
+{
+	return element(qj);
+}
+
+double SparseQuaternion::k() const
+{
+	return element(qk);
+}
+// ==== Begin non-member operator overloading ===
+/* Note: an empty quaternion is a valid zero (see the default constructor),
+ * so the operators below accept empty operands
+ */
+// - SparseQuaternion addition
+SparseQuaternion Quaternions::operator+(const SparseQuaternion &q1, const SparseQuaternion &q2)
+{
+	QUATERNION_TIME(opAdd);
+	SparseQuaternion q = SparseQuaternion(
+			q1.w()+q2.w(),
+			q1.i()+q2.i(),
+			q1.j()+q2.j(),
+			q1.k()+q2.k() );
+
+	return q;
+}
+
+SparseQuaternion Quaternions::operator+(const double c, const SparseQuaternion &q2)
+{
+	QUATERNION_TIME(opScalarAdd);
+	SparseQuaternion q = SparseQuaternion(
+			c+q2.w(),
+			c+q2.i(),
+			c+q2.j(),
+			c+q2.k() );
+
+	return q;
+}
+
+SparseQuaternion Quaternions::operator+(const SparseQuaternion &q2, const double c)
+{
+	QUATERNION_TIME(opScalarAdd);
+	SparseQuaternion q = SparseQuaternion(
+			c+q2.w(),
+			c+q2.i(),
+			c+q2.j(),
+			c+q2.k() );
+
+	return q;
+}
+
+// SparseQuaternion subtraction
+SparseQuaternion Quaternions::operator-(const SparseQuaternion &q1, const SparseQuaternion &q2)
+{
+	QUATERNION_TIME(opSubtract);
+	SparseQuaternion q = SparseQuaternion(
+			q1.w()-q2.w(),
+			q1.i()-q2.i(),
+			q1.j()-q2.j(),
+			q1.k()-q2.k() );
+
+	return q;
+}
+
+SparseQuaternion Quaternions::operator-(const double c, const SparseQuaternion &q2)
+{
+	QUATERNION_TIME(opScalarAdd);
+	SparseQuaternion q = SparseQuaternion(
+			c-q2.w(),
+			c-q2.i(),
+			c-q2.j(),
+			c-q2.k() );
+
+	return q;
+}
+
+SparseQuaternion Quaternions::operator-(const SparseQuaternion &q2, const double c)
+{
+	QUATERNION_TIME(opScalarAdd);
+	SparseQuaternion q = SparseQuaternion(
+			q2.w()-c,
+			q2.i()-c,
+			q2.j()-c,
+			q2.k()-c );
+
+	return q;
+}
+
+// - Multiplication
+//   == Scalar multiplication
+SparseQuaternion Quaternions::operator*(const double c, SparseQuaternion &q2) // double
+{
+	QUATERNION_TIME(opScalarMultiply);
+	SparseQuaternion q = SparseQuaternion();
+	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
+		q[(*it).first]=c*(*it).second;
+	}
+	return q;
+}
+
+SparseQuaternion Quaternions::operator*(const int c, SparseQuaternion &q2) // int
+{
+	QUATERNION_TIME(opScalarMultiply);
+	SparseQuaternion q = SparseQuaternion();
+	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
+		q[(*it).first]=(double)(c)*(*it).second;  // Typecast int to double
+	}
+	return q;
+}
+
+SparseQuaternion Quaternions::operator*(SparseQuaternion &q2, const double c) // double
+{
+	QUATERNION_TIME(opScalarMultiply);
+	SparseQuaternion q = SparseQuaternion();
+	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
+		q[(*it).first]=c*(*it).second;
+	}
+	return q;
+}
+
+SparseQuaternion Quaternions::operator*(SparseQuaternion &q2, const int c) // int
+{
+	QUATERNION_TIME(opScalarMultiply);
+	SparseQuaternion q = SparseQuaternion();
+	for (auto &&it=q2.elementsBegin();it!=q2.elementsEnd();++it){ // FIXME: Help compiler unroll this loop
+		q[(*it).first]=(double)(c)*(*it).second;  // Typecast int to double
+	}
+	return q;
+}
+
+// == SparseQuaternion multiplication
+namespace{
+
+// The product of two basis elements: e_a*e_b=kProductSign[a][b]*e_{kProductAxis[a][b]},
+// e.g. i*j=k, j*i=-k and i*i=-1
+const AxisType kProductAxis[4][4]={
+	{qw,qi,qj,qk},
+	{qi,qw,qk,qj},
+	{qj,qk,qw,qi},
+	{qk,qj,qi,qw}
+};
+const double kProductSign[4][4]={
+	{1, 1, 1, 1},
+	{1,-1, 1,-1},
+	{1,-1,-1, 1},
+	{1, 1,-1,-1}
+};
+
+} // End anonymous namespace
+
+SparseQuaternion Quaternions::operator*(const SparseQuaternion &q1, const SparseQuaternion &q2)
+{
+	QUATERNION_TIME(opHamilton);
+	const unsigned mask1=q1.occupancy_, mask2=q2.occupancy_;
+
+	// Read each operand with a single pass over its map
+	double a[4], b[4];
+	q1.gather(a);
+	q2.gather(b);
+
+	// A real quaternion (or zero) only scales the other one. Reals commute
+	if (q1.isReal()){
+		return SparseQuaternion(a[qw]*b[qw],a[qw]*b[qi],a[qw]*b[qj],a[qw]*b[qk]);
+	}
+	if (q2.isReal()){
+		return SparseQuaternion(a[qw]*b[qw],a[qi]*b[qw],a[qj]*b[qw],a[qk]*b[qw]);
+	}
+
+	// Two pure quaternions: p1*p2=(-p1.p2, p1 x p2)
+	if (q1.isPure() && q2.isPure()){
+		return SparseQuaternion(
+			-a[qi]*b[qi]-a[qj]*b[qj]-a[qk]*b[qk],
+			a[qj]*b[qk]-a[qk]*b[qj],
+			a[qk]*b[qi]-a[qi]*b[qk],
+			a[qi]*b[qj]-a[qj]*b[qi]);
+	}
+
+	// Two full quaternions: all 16 products
+	if (mask1==occupancyFull && mask2==occupancyFull){
+		return SparseQuaternion(
+			a[qw]*b[qw]-a[qi]*b[qi]-a[qj]*b[qj]-a[qk]*b[qk],
+			a[qw]*b[qi]+a[qi]*b[qw]+a[qj]*b[qk]-a[qk]*b[qj],
+			a[qw]*b[qj]-a[qi]*b[qk]+a[qj]*b[qw]+a[qk]*b[qi],
+			a[qw]*b[qk]+a[qi]*b[qj]-a[qj]*b[qi]+a[qk]*b[qw]);
+	}
+
+	// Anything else: only the products of stored elements
+	/* Note: visiting the axes in order adds up the terms of every component
+	 * in the same order as the dense formula, so the result is identical
+	 */
+	double result[4]={0.0,0.0,0.0,0.0};
+	for (int axis1=qw;axis1<=qk;++axis1){
+		if (!((mask1>>axis1)&1u)){
+			continue;
+		}
+		for (int axis2=qw;axis2<=qk;++axis2){
+			if ((mask2>>axis2)&1u){
+				result[kProductAxis[axis1][axis2]]+=kProductSign[axis1][axis2]*(a[axis1]*b[axis2]);
+			}
+		}
+	}
+	return SparseQuaternion(result[qw],result[qi],result[qj],result[qk]);
+}
+
+// Comparison operators
+bool Quaternions::operator==(const SparseQuaternion &q1, const SparseQuaternion &q2)
+{
+	bool isEqual=true; // Initialize in case q1.w is empty
+
+	isEqual = (q1.w()==q2.w());
+	if (isEqual){isEqual = (q1.i()==q2.i());}
+	if (isEqual){isEqual = (q1.j()==q2.j());}
+	if (isEqual){isEqual = (q1.k()==q2.k());}
+
+	return isEqual;
+}
+
+bool Quaternions::operator!=(const SparseQuaternion &q1, const SparseQuaternion &q2)
+{
+	return !(q1==q2);
+}
+// ======End non-member operator overloading======
+
+// End of file
@@ -0,0 +1,294 @@
+/* File SparseQuaternion.h
+ * 
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Define the map-backed SparseQuaternion class (opt-in sparse storage)
+ * \author Nikos Kazazakis
+ */
+
+#ifndef SPARSE_QUATERNION_LIB // Define macro headers so that this file is only included once
+#define SPARSE_QUATERNION_LIB
+
+// Include the dense quaternion (AxisType and the conversion target)
+#include "Quaternion.h"
+#include "ArenaAllocator.h"
+
+// Include STL headers
+#include <map>
+
+namespace Quaternions{
+
+// Forward-declare the class to define operators
+class SparseQuaternion;
+
+// Occupancy bitmasks: bit (1<<axis) is set when that element is stored
+/* Note: the bits follow AxisType, so 1<<qw is the real part. Common shapes:
+ * occupancyReal (a scalar), no qw bit (a pure quaternion, e.g. a 3D point),
+ * and qw plus one vector bit (a rotation around a coordinate axis)
+ */
+typedef enum{
+	occupancyNone=0,
+	occupancyReal=1<<qw,
+	occupancyVector=(1<<qi)|(1<<qj)|(1<<qk),
+	occupancyFull=occupancyReal|occupancyVector
+}OccupancyMask;
+
+// === Object versions ===
+// - Addition and subtraction
+SparseQuaternion operator+(const SparseQuaternion &q1, const SparseQuaternion &q2);  // std::map[] can't be const, however map.at is!
+SparseQuaternion operator-(const SparseQuaternion &q1, const SparseQuaternion &q2);
+
+SparseQuaternion operator+(const double c, const SparseQuaternion &q2);
+SparseQuaternion operator+(const SparseQuaternion &q2,const double c);
+
+SparseQuaternion operator-(const double c, const SparseQuaternion &q2);
+SparseQuaternion operator-(const SparseQuaternion &q2, const double c);
+
+// - Multiplication
+//   == Scalar multiplications
+/* Note that we forego passing the quaternions as const so that we
+ * can take advantage of r-value semantics
+ */
+SparseQuaternion operator*(const double c, SparseQuaternion &q2);
+SparseQuaternion operator*(const int c, SparseQuaternion &q2);
+SparseQuaternion operator*(SparseQuaternion &q2, const double c);
+SparseQuaternion operator*(SparseQuaternion &q2, const int c);
+
+//   == Quaternion-quaternion multiplication
+/* We use the formula for the Hamilton product:
+ * https://en.wikipedia.org/wiki/Quaternion#Hamilton_product */
+/* Note: the operands' occupancy masks pick the kernel: a real operand only
+ * scales the other one, two pure quaternions need the dot and cross products
+ * only, and any other sparse pair multiplies just the stored elements (e.g.
+ * 8 products instead of 16 for a single-axis rotation times a full
+ * quaternion). Only two full quaternions take all 16 products. Missing
+ * elements are zero, so for finite values every path gives exactly the
+ * dense result; only the non-zero results are stored.
+ */
+/* Note: Using const here is important! It allows us to chain
+ *       multiplications, i.e., q1*q2*q3*q4. This is only possible
+ *       if the 2nd argument is a CONST reference. For instance,
+ *       q3*q4 returns a temporary object. This cannot bind to the
+ *       second argument of the operator for the calculation
+ *       q2*(q3*q4) unless it's const (otherwise it will be destroyed
+ *       and we will assign a value that's about to disappear!)
+ */
+SparseQuaternion operator*(const SparseQuaternion &q1, const SparseQuaternion &q2);
+
+// Normalized and inverted copies (see the member functions)
+SparseQuaternion normalize(const SparseQuaternion &q);
+SparseQuaternion inverse(const SparseQuaternion &q);
+
+// Comparison operators
+bool operator==(const SparseQuaternion &q1, const SparseQuaternion &q2);
+bool operator!=(const SparseQuaternion &q1, const SparseQuaternion &q2);
+
+
+/**
+ * SparseQuaternion is the original, map-backed quaternion class. Since the
+ * dense Quaternion class became the default storage, this type is strictly
+ * opt-in: use it only when you actually want the std::map behaviour.
+ * A quaternion is a vector with 4 components: q = w + a*i + b*j + c*k,
+ * where w is the "real part" of the quaternion and "a*i + b*j + c*k" is
+ * the "imaginary" or "vector" part.
+ * 
+ * This class uses commutative operator overloading for basic arithmetic operations,
+ * and supports move semantics for efficient calculations.
+ * 
+ * The quaternion elements are stored in an std::map container to support
+ * sparsity and logarithmic lookup complexity (although it's only 4 elements anyway).
+ * CAUTION: every element is a heap node, so each object costs several
+ * allocations. Prefer Quaternion for anything performance-sensitive.
+ * If you must use this class in a hot loop, open an ArenaScope (see
+ * ArenaAllocator.h): quaternions constructed inside it take their nodes
+ * from a thread-local arena instead of the heap.
+ * 
+ * The class implements operations with shared pointers to quaternions
+ * as well as regular operations, for increased functionality.
+ * 
+ * Quaternions are particularly interesting in 3D calculations because they
+ * provide a more efficient representation of 3D rotations, e.g., if we
+ * want to rotate vector p in 3 space, the new vector p' can be acquired
+ * by the operation: p'=qpq^{-1}. Notice how this operation involves less calculations
+ * than a regular rotation matrix rotation.
+ * 
+ * Make sure to report any bugs/design improvements you find! Have fun!
+ */
+
+class SparseQuaternion
+{
+public :
+	// Default constructor, initialize to zero (with no elements stored)
+	SparseQuaternion();
+	
+	// Constructor for all 4 parts
+	// Note: to build a quaternion with a custom number of elements
+	// use the [] operator.
+	SparseQuaternion(double w, double i, double j, double k);
+
+	// Conversion from the dense representation (zero components are skipped)
+	explicit SparseQuaternion(const Quaternion &q);
+	
+	// Destructor
+	~SparseQuaternion();
+
+	// Copy constructor. The copy lives in the current arena (or the heap),
+	// not necessarily in the arena of q
+	SparseQuaternion(const SparseQuaternion &q);
+
+	// Move constructor: takes over the element nodes of q, which is left empty
+	/* Note: noexcept is what lets std::vector move (rather than copy) its
+	 * elements when it grows. The moved quaternion keeps the arena of q
+	 */
+	SparseQuaternion(SparseQuaternion &&q) noexcept;
+
+	// ==========Overload member operators=========
+	/* TRIVIA: The binary operators = (assignment), [] (array subscription),
+	 * -> (member access), as well as the n-ary () (function call) operator,
+	 * must always be implemented as member functions, because the syntax of
+	 * the language requires them to.  */
+
+	// Copy Assignment operator. Replaces all the elements with those of q
+	/* Note: Once we assign a move assignment operator, the default copy
+	 * assignment operator is deleted, so we have to explicitly define it if
+	 * we wish to maintain the functionality.
+	 */
+	/* Note how these functions are not marked as inline.
+	 * This is because the compiler is smart enough (in most cases) to decide 
+	 * on its own what should be inlined when we turn on optimizations
+	 */
+	/* Note: returning a reference allows chaining, i.e., q1=q2=q3 */
+	SparseQuaternion &operator=(const SparseQuaternion &q);
+
+	// Move assignment operator. Activates in instances such as q1=q2*q3
+	/* Note: the operator overloading for q2*q3 returns a temporary. The move
+	 * assignment operator activates if it's used in a temporary
+	 * context, e.g.:
+	 * SparseQuaternion q1;
+	 * q1=q2*q3
+	 * If both quaternions use the same arena (or the heap) the nodes of q
+	 * are taken over, with no allocations. Otherwise the elements are
+	 * copied into this quaternion's own arena, so that it never ends up
+	 * pointing into an arena it wasn't constructed in.
+	 * CAUTION: the copy may allocate; running out of memory there terminates.
+	 */
+	SparseQuaternion &operator=(SparseQuaternion &&q) noexcept;
+
+	// Overload operator to get and assign individual values
+	// Note: this stores the element (as zero) if it was missing
+	double &operator[](AxisType axis)
+	{
+		occupancy_|=1u<<axis;
+		return elements_[axis];
+	}
+	// =========Done overloading operators========
+	
+	/* Get the conjugate of this quaternion */
+	SparseQuaternion conjugate();
+	
+	// Get element iterators
+	/* Note: can't be const because the return value is an std::map
+	 * element
+	 */
+	auto elementsBegin(){return elements_.begin();}
+	auto elementsEnd(){return elements_.end();}
+	
+	// Retrieval function for individual elements
+	auto getAxisValue(AxisType axis){return (*this)[axis];}
+	
+	// Check whether the quaternion is empty
+	/* Note: is the map has not been initilized this will always
+	 * return false
+	 */
+	bool isEmpty() const;
+
+	// The occupancy bitmask (see OccupancyMask), i.e. which elements are stored
+	/* Note: this is kept up to date by every member that adds elements, so
+	 * checking it costs nothing, while asking the map costs a tree search.
+	 * An element assigned zero through operator[] still counts as stored.
+	 */
+	unsigned occupancy() const {return occupancy_;}
+
+	// Classify by occupancy: a real number, a pure quaternion (no real part),
+	// or a rotation around a coordinate axis (the real part and one axis at most)
+	bool isReal() const {return (occupancy_&occupancyVector)==0;}
+	bool isPure() const {return (occupancy_&occupancyReal)==0;}
+	bool isSingleAxis() const
+	{
+		const unsigned vector=occupancy_&occupancyVector;
+		return (vector&(vector-1))==0; // At most one vector bit
+	}
+
+	// Print quaternion
+	/* Note: this function has a default argument, as denoted by the "="
+	 * assignment. If no argument is provided, it will use cout by default
+	 */
+	void write(std::ostream &out=cout) const;
+
+	// Get individual values.
+	double w()const;
+	double i()const;
+	double j()const;
+	double k()const;
+
+	/* Return the norm |q| = sqrt(\sum a_i^2)*/
+	/* Note: Notice that this function is flagged as const. This means that
+	 * it is forbidden to modify any private member, such as elements
+	 * Also note that we don't return a reference. This is because in C++11
+	 * a move operation will be used automatically for all STL objects.
+	 * CAUTION: If the return object is of custom type, the programmer needs
+	 * to code the move semantics for this to work, even if the object is in
+	 * an STL container (e.g. vector<SparseQuaternion> giveMeAQuaternion() const)
+	 * Also note: in this case it's actually more efficient to return by value
+	 * because the size of a double is about as large as a reference, but as
+	 * a primitive it's blitable
+	 */
+	double norm()const;
+
+	// Return the squared norm |q|^2 (no square root)
+	double squaredNorm()const;
+
+	// Scale to unit norm in place, q=q/|q|. q must not be zero
+	/* Note: the existing elements are scaled where they are, so unlike
+	 * q*(1.0/q.norm()) this allocates nothing
+	 */
+	SparseQuaternion &normalize();
+
+	// Replace by the inverse in place, q=conjugate(q)/|q|^2. q must not be zero
+	SparseQuaternion &invert();
+
+	// Convert to the dense representation
+	Quaternion dense()const;
+
+	// The element container. The allocator is picked when the quaternion is
+	// constructed: the current thread's arena if there is one, the heap otherwise
+	typedef std::map<AxisType,double,std::less<AxisType>,ArenaAllocator<std::pair<const AxisType,double> > > ElementMap;
+
+	// The arena the elements live in (nullptr for the heap)
+	QuaternionArena *arena() const {return elements_.get_allocator().arena();}
+
+private:
+
+	// Elements container. Use map for sparse storage and O(log(n)) lookup complexity
+	ElementMap elements_;
+
+	// Which elements are stored (see occupancy())
+	unsigned occupancy_=occupancyNone;
+
+	// The value of one element, zero if it isn't stored. The mask saves the
+	// search for missing elements
+	double element(AxisType axis) const
+	{
+		return (occupancy_>>axis)&1u ? elements_.find(axis)->second : 0.0;
+	}
+
+	// All four values (missing elements are zero) in one pass over the map
+	void gather(double values[4]) const;
+
+	// The Hamilton product reads its operands with gather()
+	friend SparseQuaternion operator*(const SparseQuaternion &q1, const SparseQuaternion &q2);
+
+}; // End of quaternion class
+
+} // End namespace Quaternions
+
+#endif
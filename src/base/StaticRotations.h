@@ -0,0 +1,204 @@
+/* File StaticRotations.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Compile-time (constexpr) rotation quaternions, for precomputed rotation tables
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_STATIC_ROTATIONS_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_STATIC_ROTATIONS_LIB
+
+// Include project headers
+#include "Quaternion.h"
+
+// Include STL headers
+#include <limits>
+
+/* Note: everything in this file is constexpr, so fixed orientations (sensor
+ * mounting offsets, canonical axis rotations) can be computed by the compiler
+ * and stored in read-only data, with no work at program start up, e.g.
+ *
+ *     constexpr Quaternion kImuMount=staticAxisAngle(0,0,1,0.5*kPi)*kRotationX180;
+ *     static constexpr Quaternion kTable[]={kIdentityRotation,kRotationZ90,kRotationZ180};
+ *
+ * They are regular Quaternions, so they can be used with all the runtime
+ * operators and functions as well.
+ */
+
+namespace Quaternions{
+
+// Pi to double precision
+constexpr double kPi=3.14159265358979323846;
+
+// Compile-time versions of the math functions we need. std::sqrt, std::sin
+// and std::cos are not constexpr (until C++26), so we provide our own
+namespace StaticMath{
+
+// Square root by Newton's iteration
+/* Note: starting above the root, Newton's iteration decreases monotonically
+ * until rounding stops it, so we iterate until the value stops decreasing.
+ * The result is within 1 ULP of std::sqrt.
+ */
+constexpr double sqrt(double x)
+{
+	if (!(x>0.0)){
+		return x==0.0 ? x : std::numeric_limits<double>::quiet_NaN(); // sqrt(negative or NaN)=NaN
+	}
+	if (x==std::numeric_limits<double>::infinity()){
+		return x; // Newton's iteration would give inf/inf=NaN, and never stop
+	}
+	double root = x>1.0 ? x : 1.0;
+	while (true){
+		const double next=0.5*(root+x/root);
+		if (next>=root){
+			return root;
+		}
+		root=next;
+	}
+}
+
+// Taylor series of sin(x) and cos(x), accurate for |x|<=pi/4
+/* Note: in nested form, x-x^3/(2*3)(1-x^2/(4*5)(1-...)), which adds the
+ * small terms first, and the largest term last, so that the rounding errors
+ * of the others hardly matter.
+ */
+constexpr double sinSeries(double x)
+{
+	double sum=1.0;
+	for (int n=11;n>1;--n){
+		sum=1.0-x*x/((2*n)*(2*n+1))*sum;
+	}
+	return x-x*(x*x/6.0)*sum;
+}
+
+constexpr double cosSeries(double x)
+{
+	double sum=1.0;
+	for (int n=11;n>1;--n){
+		sum=1.0-x*x/((2*n-1)*(2*n))*sum;
+	}
+	return 1.0-(x*x/2.0)*sum;
+}
+
+// |x| (std::abs is not constexpr either)
+constexpr double abs(double x)
+{
+	return x<0.0 ? -x : x;
+}
+
+// Reduction of x to r=x-quadrant*pi/2, with |r|<=pi/4
+/* Note: as fdlibm does it (Cody-Waite). pi/2 is split into parts of 33 bits,
+ * so that quadrant*part is exact, plus the rest of pi/2 below each one. The
+ * first part is subtracted exactly; if most bits of x cancel (x is close to a
+ * multiple of pi/2), the next parts are subtracted too. A single double pi/2
+ * would be off by quadrant*6e-17, which is millions of ULPs of a sine close
+ * to 0 (e.g. at 4*pi). The parts are exact for |quadrant|<2^20, i.e. for |x|
+ * up to about 1e6.
+ */
+struct Reduction
+{
+	double r;
+	int quadrant; // 0 to 3
+};
+
+constexpr Reduction reduce(double x)
+{
+	const double pio2_1=1.57079632673412561417e+00, pio2_1t=6.07710050650619224932e-11;
+	const double pio2_2=6.07710050630396597660e-11, pio2_2t=2.02226624879595063154e-21;
+	const double pio2_3=2.02226624871116645580e-21, pio2_3t=8.47842766036889956997e-32;
+	const double twoOverPi=0.63661977236758134308;
+	const double n=double((long long)(x*twoOverPi+(x<0.0 ? -0.5 : 0.5))); // Round to nearest
+
+	double r=x-n*pio2_1;
+	double w=n*pio2_1t;
+	double y=r-w;
+	if (abs(y)<abs(x)*1.52587890625e-05){ // More than 16 bits cancelled
+		double t=r;
+		w=n*pio2_2;
+		r=t-w;
+		w=n*pio2_2t-((t-r)-w);
+		y=r-w;
+		if (abs(y)<abs(x)*1.7763568394002505e-15){ // More than 49
+			t=r;
+			w=n*pio2_3;
+			r=t-w;
+			w=n*pio2_3t-((t-r)-w);
+			y=r-w;
+		}
+	}
+	return Reduction{y,int((((long long)n%4)+4)%4)};
+}
+
+// Sine and cosine, by reduction to |x|<=pi/4 plus a Taylor series
+/* Note: within 1 ULP of std::sin/std::cos for |x| up to about 1e6 (see
+ * reduce), which covers the angles that rotation tables use.
+ */
+constexpr double sin(double x)
+{
+	const Reduction reduction=reduce(x);
+	switch (reduction.quadrant){
+	case 0: return sinSeries(reduction.r);
+	case 1: return cosSeries(reduction.r);
+	case 2: return -sinSeries(reduction.r);
+	default: return -cosSeries(reduction.r);
+	}
+}
+
+constexpr double cos(double x)
+{
+	// Not sin(x+pi/2): the sum would round x
+	const Reduction reduction=reduce(x);
+	switch (reduction.quadrant){
+	case 0: return cosSeries(reduction.r);
+	case 1: return -sinSeries(reduction.r);
+	case 2: return -cosSeries(reduction.r);
+	default: return sinSeries(reduction.r);
+	}
+}
+
+} // End namespace StaticMath
+
+// Rotation by angle (radians) around the axis (x,y,z), evaluated at compile time
+/* Note: the axis does not have to be normalized, but must not be zero. It is
+ * divided by its largest component first, so that the squares can't overflow
+ * (or underflow) whatever its length.
+ * At run time prefer the regular (faster) functions; this one exists so that
+ * the result can be a constant.
+ */
+constexpr Quaternion staticAxisAngle(double x, double y, double z, double angle)
+{
+	const double largest=StaticMath::abs(x)>StaticMath::abs(y)
+			? (StaticMath::abs(x)>StaticMath::abs(z) ? StaticMath::abs(x) : StaticMath::abs(z))
+			: (StaticMath::abs(y)>StaticMath::abs(z) ? StaticMath::abs(y) : StaticMath::abs(z));
+	x/=largest;
+	y/=largest;
+	z/=largest;
+	const double length=StaticMath::sqrt(x*x+y*y+z*z);
+	const double s=StaticMath::sin(0.5*angle)/length;
+	return Quaternion(StaticMath::cos(0.5*angle),s*x,s*y,s*z);
+}
+
+// === Canonical rotations ===
+// sqrt(1/2) = sin(45 degrees) = cos(45 degrees)
+constexpr double kSqrtHalf=0.70710678118654752440;
+
+constexpr Quaternion kIdentityRotation(1.0,0.0,0.0,0.0);
+
+// Rotations about the x axis
+constexpr Quaternion kRotationX90(kSqrtHalf,kSqrtHalf,0.0,0.0);
+constexpr Quaternion kRotationX180(0.0,1.0,0.0,0.0);
+constexpr Quaternion kRotationXMinus90(kSqrtHalf,-kSqrtHalf,0.0,0.0);
+
+// Rotations about the y axis
+constexpr Quaternion kRotationY90(kSqrtHalf,0.0,kSqrtHalf,0.0);
+constexpr Quaternion kRotationY180(0.0,0.0,1.0,0.0);
+constexpr Quaternion kRotationYMinus90(kSqrtHalf,0.0,-kSqrtHalf,0.0);
+
+// Rotations about the z axis
+constexpr Quaternion kRotationZ90(kSqrtHalf,0.0,0.0,kSqrtHalf);
+constexpr Quaternion kRotationZ180(0.0,0.0,0.0,1.0);
+constexpr Quaternion kRotationZMinus90(kSqrtHalf,0.0,0.0,-kSqrtHalf);
+
+} // End namespace Quaternions
+
+#endif
@@ -0,0 +1,304 @@
+/* File Statistics.cpp
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Implementation of the rotation averaging and statistics
+ * \author Nikos Kazazakis
+ */
+
+#include "Statistics.h"
+
+// Other includes
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace Quaternions;
+
+namespace{
+
+// Outputs per chunk of the batch sliding average
+const long kSlidingChunk=1024;
+
+// Rotate the symmetric matrix a in the (P,Q) plane so that a[P][Q] becomes 0,
+// and collect the rotation in v. P and Q are template parameters so that
+// the compiler can keep the matrices in registers
+template <int P, int Q>
+inline void jacobiRotation(double (&a)[4][4], double (&v)[4][4], double negligible)
+{
+	if (std::abs(a[P][Q])<=negligible){
+		a[P][Q]=a[Q][P]=0.0;
+		return;
+	}
+	// The rotation by the angle phi (|phi|<=pi/4) with tan(2phi)=2a[P][Q]/(a[Q][Q]-a[P][P])
+	// zeroes a[P][Q]. With r=|(d,b)|: cos(phi)^2=(|d|+r)/(2r), tan(phi)=b/(|d|+r)
+	/* Note: this form has one square root and one division fewer in its
+	 * dependency chain than the textbook one, and the solve is latency bound
+	 */
+	const double d=a[Q][Q]-a[P][P], b=2.0*a[P][Q];
+	const double r=std::sqrt(d*d+b*b), denominator=std::abs(d)+r;
+	const double c=std::sqrt(denominator/(2.0*r));
+	const double s=(d<0.0 ? -b : b)/denominator*c;
+	for (int k=0;k<4;++k){ // Columns
+		const double kp=a[k][P], kq=a[k][Q];
+		a[k][P]=c*kp-s*kq;
+		a[k][Q]=s*kp+c*kq;
+	}
+	for (int k=0;k<4;++k){ // Rows
+		const double pk=a[P][k], qk=a[Q][k];
+		a[P][k]=c*pk-s*qk;
+		a[Q][k]=s*pk+c*qk;
+	}
+	for (int k=0;k<4;++k){
+		const double kp=v[k][P], kq=v[k][Q];
+		v[k][P]=c*kp-s*kq;
+		v[k][Q]=s*kp+c*kq;
+	}
+}
+
+// The largest diagonal element of a
+inline int largestDiagonal(const double (&a)[4][4])
+{
+	int largest=0;
+	for (int n=1;n<4;++n){
+		if (a[n][n]>a[largest][largest]){
+			largest=n;
+		}
+	}
+	return largest;
+}
+
+// The unit eigenvector of the largest eigenvalue of the symmetric matrix with
+// upper triangle sums (ww, wi, wj, wk, ii, ij, ik, jj, jk, kk), with w>=0
+/* Note: cyclic Jacobi: every rotation zeroes one off-diagonal element of a,
+ * and v collects the rotations, so that a=v^T*M*v stays true. The
+ * off-diagonal elements shrink quadratically, and 4x4 matrices converge in
+ * about 3 sweeps. We stop once all off-diagonal elements are negligible
+ * (below epsilon times the diagonal, where they can't change the eigenvectors
+ * in double precision), and skip negligible rotations. It isn't enough that
+ * the row of the largest diagonal element is negligible: a block of a that is
+ * still coupled can hide a larger eigenvalue (e.g. 10 copies of a half turn
+ * about x=y and 6 identities, where the diagonal is 6, 5, 5, 0 but the
+ * eigenvalues are 10, 6, 0, 0).
+ */
+Quaternion principalEigenvector(const double *sums)
+{
+	double a[4][4]={
+		{sums[0],sums[1],sums[2],sums[3]},
+		{sums[1],sums[4],sums[5],sums[6]},
+		{sums[2],sums[5],sums[7],sums[8]},
+		{sums[3],sums[6],sums[8],sums[9]}};
+	double v[4][4]={{1,0,0,0},{0,1,0,0},{0,0,1,0},{0,0,0,1}};
+
+	const double scale=std::abs(sums[0])+std::abs(sums[4])+std::abs(sums[7])+std::abs(sums[9]);
+	if (!(scale>0.0)){
+		return Quaternion(1,0,0,0); // Nothing to average (or NaN)
+	}
+	const double negligible=1e-18*scale;
+	for (int sweep=0;sweep<16;++sweep){
+		const double coupling=std::abs(a[0][1])+std::abs(a[0][2])+std::abs(a[0][3])
+				+std::abs(a[1][2])+std::abs(a[1][3])+std::abs(a[2][3]);
+		if (coupling<=negligible){
+			break;
+		}
+		jacobiRotation<0,1>(a,v,negligible);
+		jacobiRotation<0,2>(a,v,negligible);
+		jacobiRotation<0,3>(a,v,negligible);
+		jacobiRotation<1,2>(a,v,negligible);
+		jacobiRotation<1,3>(a,v,negligible);
+		jacobiRotation<2,3>(a,v,negligible);
+	}
+
+	const int largest=largestDiagonal(a);
+	const double sign= v[0][largest]<0.0 ? -1.0 : 1.0;
+	return normalize(Quaternion(sign*v[0][largest],sign*v[1][largest],sign*v[2][largest],sign*v[3][largest]));
+}
+
+// The angle between the unit quaternion (w,i,j,k) and m (see angularDistance in Comparison.h)
+inline double angleTo(double w, double i, double j, double k, const Quaternion &m)
+{
+	const double dw=w-m.w(), di=i-m.i(), dj=j-m.j(), dk=k-m.k();
+	const double sw=w+m.w(), si=i+m.i(), sj=j+m.j(), sk=k+m.k();
+	const double difference=std::sqrt(dw*dw+di*di+dj*dj+dk*dk), sum=std::sqrt(sw*sw+si*si+sj*sj+sk*sk);
+	return 4.0*std::atan2(std::min(difference,sum),std::max(difference,sum));
+}
+
+// The sums of all of q, with weights if Weighted
+template <bool Weighted, typename T>
+void sumProducts(const BasicQuaternionBatch<T> &q, const T *weights, double *sums, double &total)
+{
+	const long size=static_cast<long>(q.size());
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	double ww=0.0, wi=0.0, wj=0.0, wk=0.0, ii=0.0, ij=0.0, ik=0.0, jj=0.0, jk=0.0, kk=0.0, weight=0.0;
+
+	// Note: schedule(static) gives every thread one contiguous chunk
+	#pragma omp parallel for simd schedule(static) reduction(+:ww,wi,wj,wk,ii,ij,ik,jj,jk,kk,weight)
+	for (long n=0;n<size;++n){
+		const double c= Weighted ? double(weights[n]) : 1.0;
+		const double w=aw[n], i=ai[n], j=aj[n], k=ak[n];
+		const double cw=c*w, ci=c*i, cj=c*j;
+		ww+=cw*w; wi+=cw*i; wj+=cw*j; wk+=cw*k;
+		ii+=ci*i; ij+=ci*j; ik+=ci*k;
+		jj+=cj*j; jk+=cj*k;
+		kk+=c*k*k;
+		weight+=c;
+	}
+	const double results[10]={ww,wi,wj,wk,ii,ij,ik,jj,jk,kk};
+	std::copy(results,results+10,sums);
+	total=weight;
+}
+
+} // End anonymous namespace
+
+// === RotationAccumulator ===
+void RotationAccumulator::addProduct(double w, double i, double j, double k, double weight)
+{
+	const double cw=weight*w, ci=weight*i, cj=weight*j;
+	sums_[0]+=cw*w; sums_[1]+=cw*i; sums_[2]+=cw*j; sums_[3]+=cw*k;
+	sums_[4]+=ci*i; sums_[5]+=ci*j; sums_[6]+=ci*k;
+	sums_[7]+=cj*j; sums_[8]+=cj*k;
+	sums_[9]+=weight*k*k;
+	weight_+=weight;
+}
+
+RotationAccumulator &RotationAccumulator::operator+=(const RotationAccumulator &other)
+{
+	for (int n=0;n<10;++n){
+		sums_[n]+=other.sums_[n];
+	}
+	weight_+=other.weight_;
+	return *this;
+}
+
+Quaternion RotationAccumulator::mean() const
+{
+	return principalEigenvector(sums_);
+}
+
+void RotationAccumulator::clear()
+{
+	std::fill(sums_,sums_+10,0.0);
+	weight_=0.0;
+}
+
+// === SlidingRotationAverage ===
+SlidingRotationAverage::SlidingRotationAverage(std::size_t window) : rotations_(window), weights_(window)
+{
+	assert(window>0 && "The window must hold at least one rotation");
+}
+
+void SlidingRotationAverage::push(const Quaternion &q, double weight)
+{
+	const std::size_t capacity=rotations_.size();
+	if (size_==capacity){
+		accumulator_.remove(rotations_[next_],weights_[next_]);
+	} else {
+		++size_;
+	}
+	rotations_[next_]=q;
+	weights_[next_]=weight;
+	accumulator_.add(q,weight);
+	next_=(next_+1)%capacity;
+
+	if (++sinceRebuild_==capacity){
+		accumulator_.clear();
+		for (std::size_t n=0;n<size_;++n){
+			accumulator_.add(rotations_[n],weights_[n]);
+		}
+		sinceRebuild_=0;
+	}
+}
+
+
+void SlidingRotationAverage::clear()
+{
+	accumulator_.clear();
+	next_=size_=sinceRebuild_=0;
+}
+
+// === Batch versions ===
+template <typename T>
+RotationAccumulator Quaternions::accumulate(const BasicQuaternionBatch<T> &q, const T *weights)
+{
+	RotationAccumulator accumulator;
+	if (weights){
+		sumProducts<true>(q,weights,accumulator.sums_,accumulator.weight_);
+	} else {
+		sumProducts<false>(q,weights,accumulator.sums_,accumulator.weight_);
+	}
+	return accumulator;
+}
+
+template <typename T>
+BasicQuaternion<T> Quaternions::averageRotation(const BasicQuaternionBatch<T> &q, const T *weights)
+{
+	const Quaternion mean=accumulate(q,weights).mean();
+	return BasicQuaternion<T>(T(mean.w()),T(mean.i()),T(mean.j()),T(mean.k()));
+}
+
+template <typename T>
+RotationStatistics Quaternions::rotationStatistics(const BasicQuaternionBatch<T> &q, const T *weights)
+{
+	const RotationAccumulator accumulator=accumulate(q,weights);
+	RotationStatistics statistics;
+	statistics.mean=accumulator.mean();
+	if (!(accumulator.weight()>0.0)){
+		return statistics;
+	}
+
+	const long size=static_cast<long>(q.size());
+	const T *aw=q.w(), *ai=q.i(), *aj=q.j(), *ak=q.k();
+	const Quaternion mean=statistics.mean;
+	double squares=0.0, maximum=0.0;
+	#pragma omp parallel for simd schedule(static) reduction(+:squares) reduction(max:maximum)
+	for (long n=0;n<size;++n){
+		const double weight= weights ? double(weights[n]) : 1.0;
+		const double angle=angleTo(aw[n],ai[n],aj[n],ak[n],mean);
+		squares+=weight*angle*angle;
+		maximum=std::max(maximum,weight>0.0 ? angle : 0.0);
+	}
+	statistics.variance=squares/accumulator.weight();
+	statistics.deviation=std::sqrt(statistics.variance);
+	statistics.maximum=maximum;
+	return statistics;
+}
+
+template <typename T>
+void Quaternions::slidingAverage(const BasicQuaternionBatch<T> &q, std::size_t window, BasicQuaternionBatch<T> &out)
+{
+	assert(window>0 && "The window must hold at least one rotation");
+	assert(&q!=&out && "The sliding average can't be computed in place");
+	const long size=static_cast<long>(q.size()), length=static_cast<long>(window);
+	out.resize(q.size());
+	const long chunks=(size+kSlidingChunk-1)/kSlidingChunk;
+
+	#pragma omp parallel for schedule(static)
+	for (long chunk=0;chunk<chunks;++chunk){
+		const long first=chunk*kSlidingChunk, last=std::min(size,first+kSlidingChunk);
+		// The window before the first output of the chunk (the first add and
+		// remove below slide it onto that output)
+		RotationAccumulator accumulator;
+		for (long n=std::max(0L,first-length);n<first;++n){
+			accumulator.add(q.get(n));
+		}
+		for (long n=first;n<last;++n){
+			accumulator.add(q.get(n));
+			if (n>=length){
+				accumulator.remove(q.get(n-length));
+			}
+			const Quaternion mean=accumulator.mean();
+			out.set(n,BasicQuaternion<T>(T(mean.w()),T(mean.i()),T(mean.j()),T(mean.k())));
+		}
+	}
+}
+
+// Explicit instantiations: compile the batch versions for float and double
+#define QUATERNION_INSTANTIATE_STATISTICS(T) \
+	template RotationAccumulator Quaternions::accumulate(const BasicQuaternionBatch<T> &, const T *); \
+	template BasicQuaternion<T> Quaternions::averageRotation(const BasicQuaternionBatch<T> &, const T *); \
+	template RotationStatistics Quaternions::rotationStatistics(const BasicQuaternionBatch<T> &, const T *); \
+	template void Quaternions::slidingAverage(const BasicQuaternionBatch<T> &, std::size_t, BasicQuaternionBatch<T> &);
+
+QUATERNION_INSTANTIATE_STATISTICS(float)
+QUATERNION_INSTANTIATE_STATISTICS(double)
+
+// End of file
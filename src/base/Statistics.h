@@ -0,0 +1,159 @@
+/* File Statistics.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Rotation averaging (Markley's eigenvector mean), weighted and sliding-window averages, and the angular spread
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_STATISTICS_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_STATISTICS_LIB
+
+// Include project headers
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+
+// Include STL headers
+#include <cstddef>
+#include <vector>
+
+/* Note: the mean of some rotations is NOT their normalized sum. q and -q are
+ * the same rotation, so a sum can cancel out completely: q+(-q)=0. Markley's
+ * mean ("Averaging Quaternions", Markley et al. 2007) avoids this: it is the
+ * unit quaternion m that maximizes
+ *     sum_n weight[n]*dot(q[n],m)^2
+ * which doesn't change when any q[n] changes sign. That is the eigenvector
+ * of the largest eigenvalue of the 4x4 symmetric matrix
+ *     M = sum_n weight[n]*q[n]*q[n]^T
+ * so averaging is two steps: accumulate M (10 distinct sums, which can be
+ * added and subtracted in any order: parallel and sliding windows are easy),
+ * then solve a 4x4 eigenproblem, which costs the same however many rotations
+ * went in. We solve it with Jacobi rotations, which are accurate even when
+ * the eigenvalues are close.
+ *
+ * The inputs should be unit quaternions: a non-unit q weighs |q|^2 times more.
+ * The mean is returned with w>=0 (the sign is arbitrary: compare means with
+ * approxEqual(...,compareRotations) from Comparison.h). With no rotations (or
+ * zero total weight) the mean is the identity.
+ *
+ * The spread of the rotations around their mean is measured by the angles
+ * (see angularDistance in Comparison.h) from each rotation to the mean: the
+ * angular variance is the weighted mean of the squared angles (radians^2).
+ *
+ * The sums are accumulated in double (also for float batches), per thread,
+ * so the last bits of the results may differ between thread counts.
+ */
+
+namespace Quaternions{
+
+class RotationAccumulator;
+
+// The sums of all the rotations in the batch (see the batch versions below)
+template <typename T>
+RotationAccumulator accumulate(const BasicQuaternionBatch<T> &q, const T *weights=nullptr);
+
+// The sums of the weighted outer products q*q^T, from which the mean follows
+class RotationAccumulator
+{
+public:
+	RotationAccumulator() {clear();}
+
+	// Add or remove a rotation. Removing a rotation that was added gives the
+	// sums without it, up to the rounding of the additions in between
+	template <typename E>
+	void add(const QuaternionExpression<E> &q, double weight=1.0)
+	{
+		addProduct(double(q.w()),double(q.i()),double(q.j()),double(q.k()),weight);
+	}
+
+	template <typename E>
+	void remove(const QuaternionExpression<E> &q, double weight=1.0)
+	{
+		addProduct(double(q.w()),double(q.i()),double(q.j()),double(q.k()),-weight);
+	}
+
+	// Add all the rotations of another accumulator
+	RotationAccumulator &operator+=(const RotationAccumulator &other);
+
+	// Markley's mean of the rotations added so far
+	Quaternion mean() const;
+
+	// The total weight (the number of rotations, without weights)
+	double weight() const {return weight_;}
+
+	void clear();
+
+private:
+	void addProduct(double w, double i, double j, double k, double weight);
+
+	// The upper triangle of M: ww, wi, wj, wk, ii, ij, ik, jj, jk, kk
+	double sums_[10];
+	double weight_;
+
+	template <typename T>
+	friend RotationAccumulator accumulate(const BasicQuaternionBatch<T> &, const T *);
+};
+
+// The mean of a stream of rotations over the last window rotations
+/* Note: every push adds the new rotation to the sums and removes the oldest
+ * one, so a mean costs the same however long the window is. Subtracting
+ * leaves rounding errors behind, so the sums are recomputed from the window
+ * once every window pushes, which keeps them within a few epsilon.
+ */
+class SlidingRotationAverage
+{
+public:
+	explicit SlidingRotationAverage(std::size_t window);
+
+	void push(const Quaternion &q, double weight=1.0);
+
+	// The mean of the last window rotations (fewer at the start)
+	Quaternion mean() const {return accumulator_.mean();}
+
+	// The number of rotations in the window
+	std::size_t size() const {return size_;}
+	std::size_t window() const {return rotations_.size();}
+
+	void clear();
+
+private:
+	std::vector<Quaternion> rotations_; // Ring buffer
+	std::vector<double> weights_;
+	std::size_t next_=0, size_=0, sinceRebuild_=0;
+	RotationAccumulator accumulator_;
+};
+
+// Summary of a set of rotations
+struct RotationStatistics
+{
+	Quaternion mean;
+	double variance=0.0;  // Weighted mean of the squared angles from the mean (radians^2)
+	double deviation=0.0; // The square root of the variance (radians)
+	double maximum=0.0;   // The largest angle from the mean (radians)
+};
+
+// === Batch versions ===
+/* Note: these are compiled (explicitly instantiated) in Statistics.cpp for
+ * float and double. The rotations are cut into one contiguous chunk per
+ * OpenMP thread. Without weights (nullptr) every rotation weighs 1; with
+ * weights, weights[n] is the (non-negative) weight of q[n].
+ */
+
+// Markley's mean of all the rotations in the batch
+template <typename T>
+BasicQuaternion<T> averageRotation(const BasicQuaternionBatch<T> &q, const T *weights=nullptr);
+
+// The mean of the rotations and their spread around it
+template <typename T>
+RotationStatistics rotationStatistics(const BasicQuaternionBatch<T> &q, const T *weights=nullptr);
+
+// out[n] is the mean of q[n-window+1..n] (of q[0..n] for the first window-1)
+/* Note: the threads take chunks of the output; each chunk sums the window
+ * before its first output and then slides, so the work is the same as one
+ * serial pass plus one window per chunk.
+ */
+template <typename T>
+void slidingAverage(const BasicQuaternionBatch<T> &q, std::size_t window, BasicQuaternionBatch<T> &out);
+
+} // End namespace Quaternions
+
+#endif
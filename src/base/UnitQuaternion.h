@@ -0,0 +1,190 @@
+/* File UnitQuaternion.h
+ *
+ * Copyright (c) Nikos Kazazakis 2016
+ * \brief Unit quaternions (rotations) and fast normalization
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_UNIT_QUATERNION_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_UNIT_QUATERNION_LIB
+
+// Include project headers
+#include "Quaternion.h"
+
+// Include STL headers
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace Quaternions{
+
+// === Fast normalization ===
+/* Note: normalizing costs a square root and a division, the two slowest
+ * floating point instructions (a multiplication costs a fraction of either).
+ * fastInverseSqrt computes 1/sqrt(x) with multiplications only: it reads the
+ * bits of x as an integer, whose top bits are (roughly) the exponent, so
+ * magic-(bits>>1) roughly halves and negates the exponent, which is a first
+ * guess good to about 3%. Each Newton step y=y*(1.5-0.5*x*y*y) then squares
+ * the relative error: 3e-2, 2e-3, 5e-6, 3e-11, 3e-16...
+ * We take as many steps as needed to reach full precision: 3 for float and
+ * 4 for double, which leaves a relative error below 2 epsilon (measured over
+ * [1e-3,1e3]; the unit tests check it). Unlike the hardware rsqrt estimate
+ * it works for double, in every instruction set, and without -ffast-math,
+ * because it is plain C++ that vectorizes.
+ * Whether it pays off depends on the CPU. Vectorized over a batch it
+ * replaces the divider, which older CPUs only run a few lanes at a time;
+ * on recent ones (with wide, pipelined dividers) it is about 25% faster for
+ * double and no faster for float. For a single quaternion the Newton steps
+ * form one long dependency chain and it is SLOWER than normalize(). Run the
+ * quaternionBench Normalize benchmarks on the target machine to decide.
+ * CAUTION: x must be positive and normal (not zero, denormal, inf or NaN).
+ */
+
+// The integer type with the bits of T, the magic constant and the number of Newton steps
+template <typename T>
+struct FastInverseSqrtTraits;
+
+template <>
+struct FastInverseSqrtTraits<float>
+{
+	typedef std::uint32_t Bits;
+	static constexpr Bits kMagic=0x5f375a86u;
+	static constexpr int kNewtonSteps=3;
+};
+
+template <>
+struct FastInverseSqrtTraits<double>
+{
+	typedef std::uint64_t Bits;
+	static constexpr Bits kMagic=0x5fe6eb50c7b537a9ull;
+	static constexpr int kNewtonSteps=4;
+};
+
+// 1/sqrt(x) to within 2 epsilon, for float and double. x must be positive and normal
+template <typename T>
+inline T fastInverseSqrt(T x)
+{
+	typedef FastInverseSqrtTraits<T> Traits;
+	// Note: memcpy is the well-defined way to reinterpret bits; it compiles to nothing
+	typename Traits::Bits bits;
+	std::memcpy(&bits,&x,sizeof(T));
+	bits=Traits::kMagic-(bits>>1);
+	T y;
+	std::memcpy(&y,&bits,sizeof(T));
+	const T halfX=T(0.5)*x;
+	for (int step=0;step<Traits::kNewtonSteps;++step){
+		y=y*(T(1.5)-halfX*y*y);
+	}
+	return y;
+}
+
+// The unit quaternion q/|q| through fastInverseSqrt. q must not be zero
+template <typename E>
+BasicQuaternion<typename E::Scalar> fastNormalize(const QuaternionExpression<E> &q)
+{
+	typedef typename E::Scalar T;
+	const BasicQuaternion<T> p(q);
+	const T lengthSquared=p.squaredNorm();
+	assert(lengthSquared>T(0) && "Can't normalize a zero quaternion");
+	return fastInverseSqrt(lengthSquared)*p;
+}
+
+/**
+ * BasicUnitQuaternion is a quaternion that is known to have unit norm, i.e.
+ * a rotation. It can only be built by normalizing, so the type itself
+ * guarantees the norm, and the operations that need it take shortcuts:
+ * - inverse() is the conjugate: no division, and exact;
+ * - the product of two unit quaternions is a unit quaternion again;
+ * - rotate() (Rotation.h) and the conversions (Conversion.h) take it as it
+ *   is, as they assume unit norm anyway (it converts to BasicQuaternion).
+ * It is also an expression (see QuaternionExpression.h), so it mixes freely
+ * with ordinary quaternions, e.g. Quaternion p=u*q*u.conjugate();
+ * Like BasicQuaternion it is trivially copyable and costs 4 components.
+ *
+ * Rounding: every product is a unit quaternion only to within about an
+ * epsilon, so after many compositions the norm drifts. Call renormalize()
+ * every now and then (e.g. every few thousand products) to reset it.
+ */
+template <typename T>
+class BasicUnitQuaternion : public QuaternionExpression<BasicUnitQuaternion<T> >
+{
+public :
+	typedef T Scalar;
+
+	// The identity rotation
+	constexpr BasicUnitQuaternion() : q_(T(1),T(0),T(0),T(0)) {}
+
+	// Normalize q. q must not be zero
+	template <typename E>
+	explicit BasicUnitQuaternion(const QuaternionExpression<E> &q) : q_(normalize(BasicQuaternion<T>(q))) {}
+
+	// Normalize (w,i,j,k). They must not all be zero
+	BasicUnitQuaternion(T w, T i, T j, T k) : q_(normalize(BasicQuaternion<T>(w,i,j,k))) {}
+
+	// Wrap a quaternion the caller knows is normalized, without normalizing it again
+	/* Note: debug builds check the norm, to within sqrt(epsilon) */
+	static BasicUnitQuaternion fromNormalized(const BasicQuaternion<T> &q)
+	{
+		assert(std::abs(q.squaredNorm()-T(1))<=std::sqrt(std::numeric_limits<T>::epsilon()) && "Quaternion is not normalized");
+		return BasicUnitQuaternion(q,Trusted());
+	}
+
+	// Get individual values
+	constexpr T w()const {return q_.w();}
+	constexpr T i()const {return q_.i();}
+	constexpr T j()const {return q_.j();}
+	constexpr T k()const {return q_.k();}
+
+	// The underlying quaternion
+	constexpr const BasicQuaternion<T> &quaternion()const {return q_;}
+
+	// The norm is 1 by construction, so these are free
+	constexpr T norm()const {return T(1);}
+	constexpr T squaredNorm()const {return T(1);}
+
+	// The conjugate, which for a unit quaternion is also the inverse (the opposite rotation)
+	constexpr BasicUnitQuaternion conjugate()const {return BasicUnitQuaternion(q_.conjugate(),Trusted());}
+	constexpr BasicUnitQuaternion inverse()const {return conjugate();}
+
+	// Normalize again, to undo the rounding drift of long products
+	BasicUnitQuaternion &renormalize()
+	{
+		q_.normalize();
+		return *this;
+	}
+
+	// Composition of rotations: q1*q2 rotates by q2, then by q1
+	friend constexpr BasicUnitQuaternion operator*(const BasicUnitQuaternion &q1, const BasicUnitQuaternion &q2)
+	{
+		return BasicUnitQuaternion(BasicQuaternion<T>(q1.q_*q2.q_),Trusted());
+	}
+
+private:
+	// Tag for the constructor that doesn't normalize
+	struct Trusted{};
+	constexpr BasicUnitQuaternion(const BasicQuaternion<T> &q, Trusted) : q_(q) {}
+
+	BasicQuaternion<T> q_;
+
+}; // End of unit quaternion class
+
+// The unit quaternion types
+typedef BasicUnitQuaternion<float> UnitQuaternionF;
+typedef BasicUnitQuaternion<double> UnitQuaternion;
+typedef BasicUnitQuaternion<long double> UnitQuaternionL;
+
+// The inverse of a unit quaternion is its conjugate
+/* Note: this overload is picked over the general inverse(q) in Quaternion.h,
+ * which would divide by |q|^2=1 for nothing
+ */
+template <typename T>
+constexpr BasicUnitQuaternion<T> inverse(const BasicUnitQuaternion<T> &q)
+{
+	return q.conjugate();
+}
+
+} // End namespace Quaternions
+
+#endif
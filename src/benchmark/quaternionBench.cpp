@@ -0,0 +1,974 @@
+/*
+ * quaternionBench.cpp
+ *
+ * \brief Microbenchmarks for the quaternion library (Google Benchmark)
+ * \author Nikos Kazazakis
+ */
+
+// Program description:
+// Measures the cost of every operator in Quaternion.cpp, and of the bulk
+// kernels for batch sizes from L1-resident (256 quaternions = 8KB) up to
+// DRAM-resident (4M quaternions = 128MB).
+//
+// Usage: quaternionBench [Google Benchmark flags], e.g.
+//   quaternionBench --benchmark_filter=Hamilton
+//   quaternionBench --benchmark_out=results.json --benchmark_out_format=json
+// or run "make benchmark", which writes quaternionBench.json to the build folder.
+
+#include "Quaternion.h"
+#include "SparseQuaternion.h"
+#include "QuaternionBatch.h"
+#include "Interpolation.h"
+#include "QuaternionFile.h"
+#include "Composition.h"
+#include "Conversion.h"
+#include "Rotation.h"
+#include "Dispatch.h"
+#include "UnitQuaternion.h"
+#include "Integration.h"
+#include "DualQuaternion.h"
+#include "Comparison.h"
+#include "Statistics.h"
+#include "Compression.h"
+#include "RotationCache.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+using namespace Quaternions;
+
+// Batch sizes: 256 (8KB, L1) to 4M (128MB, DRAM) quaternions
+static const long kMinBatch=1<<8;
+static const long kMaxBatch=1<<22;
+
+// Random test data. Always the same seed, so that runs are comparable
+static std::vector<Quaternion> randomQuaternions(std::size_t n)
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	std::vector<Quaternion> quaternions(n);
+	for (auto &q : quaternions){
+		q=Quaternion(distribution(generator),distribution(generator),distribution(generator),distribution(generator));
+	}
+	return quaternions;
+}
+
+/* Note: benchmark::DoNotOptimize makes the compiler believe the value is read
+ * and modified, so it can neither fold the operation at compile time nor hoist
+ * it out of the loop. We apply it to the operands on every iteration and to
+ * the result.
+ */
+
+// === Construction and assignment ===
+static void BM_ConstructDefault(benchmark::State &state)
+{
+	for (auto _ : state){
+		Quaternion q;
+		benchmark::DoNotOptimize(q);
+	}
+}
+BENCHMARK(BM_ConstructDefault);
+
+static void BM_ConstructElements(benchmark::State &state)
+{
+	double w=1.0, i=2.0, j=3.0, k=4.0;
+	for (auto _ : state){
+		benchmark::DoNotOptimize(w);
+		Quaternion q(w,i,j,k);
+		benchmark::DoNotOptimize(q);
+	}
+}
+BENCHMARK(BM_ConstructElements);
+
+static void BM_CopyAssign(benchmark::State &state)
+{
+	Quaternion q1(1,2,3,4), q2;
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q1);
+		q2=q1;
+		benchmark::DoNotOptimize(q2);
+	}
+}
+BENCHMARK(BM_CopyAssign);
+
+static void BM_MoveAssign(benchmark::State &state)
+{
+	Quaternion q1(1,2,3,4), q2;
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q1);
+		q2=std::move(q1);
+		benchmark::DoNotOptimize(q2);
+	}
+}
+BENCHMARK(BM_MoveAssign);
+
+// === Operators ===
+// Quaternion (op) quaternion
+template <typename Operation>
+static void BM_Binary(benchmark::State &state, Operation operation)
+{
+	Quaternion q1(0.5,-0.25,0.75,1.0), q2(1.0,0.5,-0.5,0.25);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q1);
+		benchmark::DoNotOptimize(q2);
+		auto result=operation(q1,q2); // Quaternion (evaluated) or bool
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK_CAPTURE(BM_Binary, Add, [](const Quaternion &q1, const Quaternion &q2)->Quaternion{return q1+q2;});
+BENCHMARK_CAPTURE(BM_Binary, Subtract, [](const Quaternion &q1, const Quaternion &q2)->Quaternion{return q1-q2;});
+BENCHMARK_CAPTURE(BM_Binary, Hamilton, [](const Quaternion &q1, const Quaternion &q2)->Quaternion{return q1*q2;});
+BENCHMARK_CAPTURE(BM_Binary, Equal, [](const Quaternion &q1, const Quaternion &q2){return q1==q2;});
+BENCHMARK_CAPTURE(BM_Binary, NotEqual, [](const Quaternion &q1, const Quaternion &q2){return q1!=q2;});
+
+// Quaternion (op) scalar, in both orders
+template <typename Scalar, typename Operation>
+static void BM_Scalar(benchmark::State &state, Scalar c, Operation operation)
+{
+	Quaternion q(0.5,-0.25,0.75,1.0);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q);
+		benchmark::DoNotOptimize(c);
+		Quaternion result=operation(c,q);
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK_CAPTURE(BM_Scalar, AddDoubleLeft, 2.0, [](double c, const Quaternion &q){return c+q;});
+BENCHMARK_CAPTURE(BM_Scalar, AddDoubleRight, 2.0, [](double c, const Quaternion &q){return q+c;});
+BENCHMARK_CAPTURE(BM_Scalar, SubtractDoubleLeft, 2.0, [](double c, const Quaternion &q){return c-q;});
+BENCHMARK_CAPTURE(BM_Scalar, SubtractDoubleRight, 2.0, [](double c, const Quaternion &q){return q-c;});
+BENCHMARK_CAPTURE(BM_Scalar, MultiplyDoubleLeft, 2.0, [](double c, const Quaternion &q){return c*q;});
+BENCHMARK_CAPTURE(BM_Scalar, MultiplyDoubleRight, 2.0, [](double c, const Quaternion &q){return q*c;});
+BENCHMARK_CAPTURE(BM_Scalar, MultiplyIntLeft, 2, [](int c, const Quaternion &q){return c*q;});
+BENCHMARK_CAPTURE(BM_Scalar, MultiplyIntRight, 2, [](int c, const Quaternion &q){return q*c;});
+
+// A chained expression, evaluated in one fused pass
+static void BM_Chain(benchmark::State &state)
+{
+	Quaternion q1(0.5,-0.25,0.75,1.0), q2(1.0,0.5,-0.5,0.25);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q1);
+		benchmark::DoNotOptimize(q2);
+		Quaternion result=(2+q1)*q2+2.25;
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK(BM_Chain);
+
+// Member functions
+static void BM_Conjugate(benchmark::State &state)
+{
+	Quaternion q(0.5,-0.25,0.75,1.0);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q);
+		Quaternion result=q.conjugate();
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK(BM_Conjugate);
+
+static void BM_Norm(benchmark::State &state)
+{
+	Quaternion q(0.5,-0.25,0.75,1.0);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q);
+		double result=q.norm();
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK(BM_Norm);
+
+// Normalization and inversion: exact, fast (no sqrt or division) and for unit quaternions
+template <typename Operation>
+static void BM_Unary(benchmark::State &state, Operation operation)
+{
+	Quaternion q(0.5,-0.25,0.75,1.0);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q);
+		auto result=operation(q);
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK_CAPTURE(BM_Unary, Normalize, [](const Quaternion &q){return normalize(q);});
+BENCHMARK_CAPTURE(BM_Unary, FastNormalize, [](const Quaternion &q){return fastNormalize(q);});
+BENCHMARK_CAPTURE(BM_Unary, Inverse, [](const Quaternion &q){return inverse(q);});
+BENCHMARK_CAPTURE(BM_Unary, UnitInverse, [](const Quaternion &q){return inverse(UnitQuaternion::fromNormalized(q));});
+
+// The map-backed quaternion, for comparison, with operands of different shapes
+/* Note: Full*Full takes the dense path (all 16 products, 4 result nodes);
+ * the others take the sparse paths picked by the occupancy masks, which
+ * skip the missing elements and allocate only the non-zero results. The
+ * allocs/op counter shows the nodes per product
+ */
+static void BM_SparseHamilton(benchmark::State &state, SparseQuaternion q1, SparseQuaternion q2)
+{
+	resetAllocationCounters();
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q1);
+		benchmark::DoNotOptimize(q2);
+		SparseQuaternion result=q1*q2;
+		benchmark::DoNotOptimize(result);
+	}
+	state.counters["allocs/op"]=double(allocationCounters().allocations)/state.iterations();
+}
+BENCHMARK_CAPTURE(BM_SparseHamilton, Full_Full, SparseQuaternion(0.5,-0.25,0.75,1.0), SparseQuaternion(1.0,0.5,-0.5,0.25));
+BENCHMARK_CAPTURE(BM_SparseHamilton, Real_Full, SparseQuaternion(2.0,0,0,0), SparseQuaternion(1.0,0.5,-0.5,0.25));
+BENCHMARK_CAPTURE(BM_SparseHamilton, Point_Point, SparseQuaternion(0,-0.25,0.75,1.0), SparseQuaternion(0,0.5,-0.5,0.25));
+BENCHMARK_CAPTURE(BM_SparseHamilton, AxisRotation_Full, SparseQuaternion(0.5,0,0,0.75), SparseQuaternion(1.0,0.5,-0.5,0.25));
+BENCHMARK_CAPTURE(BM_SparseHamilton, AxisRotation_Point, SparseQuaternion(0.5,0,0,0.75), SparseQuaternion(0,0.5,-0.5,0.25));
+BENCHMARK_CAPTURE(BM_SparseHamilton, AxisRotation_SameAxis, SparseQuaternion(0.5,0,0,0.75), SparseQuaternion(0.25,0,0,-1.0));
+
+// Normalizing a sparse quaternion: the old way (two temporaries) and in place
+static void BM_SparseNormalize(benchmark::State &state, bool inPlace)
+{
+	const SparseQuaternion q(0.5,-0.25,0.75,1.0);
+	SparseQuaternion result;
+	for (auto _ : state){
+		if (inPlace){
+			result=q; // The copy reuses the nodes of result
+			result.normalize();
+		}else{
+			SparseQuaternion copy(q);
+			result=copy*(1.0/q.norm());
+		}
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK_CAPTURE(BM_SparseNormalize, ScalarProduct, false);
+BENCHMARK_CAPTURE(BM_SparseNormalize, InPlace, true);
+
+// Sparse arithmetic temporaries from every thread at once, on the heap or in
+// a per-thread arena that is reset after every expression
+/* Note: allocs/op counts the map nodes per expression (q1*q2+q1*q3 builds 3
+ * quaternions of 4 nodes each), heap/op those that still go through malloc
+ */
+static void BM_SparseExpression(benchmark::State &state, bool useArena)
+{
+	SparseQuaternion q1(0.5,-0.25,0.75,1.0), q2(1.0,0.5,-0.5,0.25), q3(0.25,1.0,0.5,-0.75);
+	QuaternionArena arena;
+	resetAllocationCounters();
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q1);
+		if (useArena){
+			ArenaScope scope(arena);
+			SparseQuaternion result=q1*q2+q1*q3;
+			benchmark::DoNotOptimize(result);
+		}else{
+			SparseQuaternion result=q1*q2+q1*q3;
+			benchmark::DoNotOptimize(result);
+		}
+		arena.reset();
+	}
+	const AllocationCounters &counters=allocationCounters();
+	state.counters["allocs/op"]=benchmark::Counter(double(counters.allocations)/state.iterations(),benchmark::Counter::kAvgThreads);
+	state.counters["heap/op"]=benchmark::Counter(double(counters.allocations-counters.arenaAllocations)/state.iterations(),benchmark::Counter::kAvgThreads);
+}
+BENCHMARK_CAPTURE(BM_SparseExpression, Heap, false)->ThreadRange(1,8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_SparseExpression, Arena, true)->ThreadRange(1,8)->UseRealTime();
+
+// Container throughput: growing a vector without reserve() (every reallocation
+// moves all the elements) and sorting it (moves and swaps)
+/* Note: compare the sparse and dense versions; a sparse quaternion moves by
+ * handing over its map nodes, a dense one by copying 32 bytes
+ */
+template <typename QuaternionType>
+static void BM_VectorPushBack(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	const std::vector<Quaternion> quaternions=randomQuaternions(size);
+	for (auto _ : state){
+		std::vector<QuaternionType> container;
+		for (const auto &q : quaternions){
+			container.push_back(QuaternionType(q));
+		}
+		benchmark::DoNotOptimize(container.data());
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK_TEMPLATE(BM_VectorPushBack, Quaternion)->RangeMultiplier(16)->Range(kMinBatch,kMinBatch<<8);
+BENCHMARK_TEMPLATE(BM_VectorPushBack, SparseQuaternion)->RangeMultiplier(16)->Range(kMinBatch,kMinBatch<<8);
+
+template <typename QuaternionType>
+static void BM_VectorSort(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	std::vector<QuaternionType> quaternions;
+	for (const auto &q : randomQuaternions(size)){
+		quaternions.push_back(QuaternionType(q));
+	}
+	for (auto _ : state){
+		state.PauseTiming();
+		std::vector<QuaternionType> container(quaternions);
+		state.ResumeTiming();
+		std::sort(container.begin(),container.end(),
+			[](const QuaternionType &q1, const QuaternionType &q2){return q1.w()<q2.w();});
+		benchmark::DoNotOptimize(container.data());
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK_TEMPLATE(BM_VectorSort, Quaternion)->RangeMultiplier(16)->Range(kMinBatch,kMinBatch<<8);
+BENCHMARK_TEMPLATE(BM_VectorSort, SparseQuaternion)->RangeMultiplier(16)->Range(kMinBatch,kMinBatch<<8);
+
+// === Arrays ===
+/* Note: items_per_second is quaternions/second, bytes_per_second counts the
+ * bytes read and written, so it can be compared to the memory bandwidth
+ */
+
+// Hamilton product of two arrays of quaternions, one operator* call per element
+static void BM_ArrayHamilton(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	std::vector<Quaternion> q1=randomQuaternions(size), q2=randomQuaternions(size), out(size);
+	for (auto _ : state){
+		for (std::size_t n=0;n<size;++n){
+			out[n]=q1[n]*q2[n];
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*3*sizeof(Quaternion));
+}
+BENCHMARK(BM_ArrayHamilton)->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+// Bulk kernels on a QuaternionBatch
+template <typename Kernel>
+static void BM_Batch(benchmark::State &state, Kernel kernel)
+{
+	const std::size_t size=state.range(0);
+	QuaternionBatch q1(randomQuaternions(size)), q2(randomQuaternions(size)), out(size);
+	for (auto _ : state){
+		kernel(q1,q2,out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*3*sizeof(Quaternion));
+}
+BENCHMARK_CAPTURE(BM_Batch, Hamilton, [](const QuaternionBatch &q1, const QuaternionBatch &q2, QuaternionBatch &out){multiply(q1,q2,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_Batch, Add, [](const QuaternionBatch &q1, const QuaternionBatch &q2, QuaternionBatch &out){add(q1,q2,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_Batch, Subtract, [](const QuaternionBatch &q1, const QuaternionBatch &q2, QuaternionBatch &out){subtract(q1,q2,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_Batch, Scale, [](const QuaternionBatch &q1, const QuaternionBatch &, QuaternionBatch &out){scale(q1,2.0,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_Batch, Conjugate, [](const QuaternionBatch &q1, const QuaternionBatch &, QuaternionBatch &out){conjugate(q1,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+// Single precision batches move half the bytes and fit twice as many
+// quaternions per vector register
+static void BM_BatchHamiltonF(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	std::vector<QuaternionF> quaternions;
+	for (const auto &q : randomQuaternions(size)){
+		quaternions.push_back(QuaternionF(q));
+	}
+	QuaternionBatchF q1(quaternions), q2(quaternions), out(size);
+	for (auto _ : state){
+		multiply(q1,q2,out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*3*sizeof(QuaternionF));
+}
+BENCHMARK(BM_BatchHamiltonF)->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+static void BM_BatchNorm(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	QuaternionBatch q(randomQuaternions(size));
+	std::vector<double> out(size);
+	for (auto _ : state){
+		norm(q,out.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*(sizeof(Quaternion)+sizeof(double)));
+}
+BENCHMARK(BM_BatchNorm)->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+// Renormalizing a batch of rotations. Only the type of the second argument matters
+template <typename T>
+static void BM_BatchNormalize(benchmark::State &state, T, bool fast)
+{
+	const std::size_t size=state.range(0);
+	std::vector<BasicQuaternion<T> > quaternions(size);
+	const std::vector<Quaternion> source=randomQuaternions(size);
+	for (std::size_t n=0;n<size;++n){
+		quaternions[n]=BasicQuaternion<T>(source[n]);
+	}
+	const BasicQuaternionBatch<T> q(quaternions);
+	BasicQuaternionBatch<T> out(size);
+	for (auto _ : state){
+		if (fast){
+			fastNormalize(q,out);
+		}else{
+			normalize(q,out);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*2*sizeof(BasicQuaternion<T>));
+}
+BENCHMARK_CAPTURE(BM_BatchNormalize, Exact, 0.0, false)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_BatchNormalize, Fast, 0.0, true)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_BatchNormalize, ExactF, 0.0f, false)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_BatchNormalize, FastF, 0.0f, true)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+
+// === Interpolation ===
+/* Note: compare these with the error table in Interpolation.h to pick the
+ * right speed/accuracy tradeoff
+ */
+template <typename Operation>
+static void BM_Interpolate(benchmark::State &state, Operation operation)
+{
+	std::vector<Quaternion> quaternions=randomQuaternions(2);
+	Quaternion q0=(1.0/quaternions[0].norm())*quaternions[0], q1=(1.0/quaternions[1].norm())*quaternions[1];
+	double t=0.3;
+	for (auto _ : state){
+		benchmark::DoNotOptimize(q0);
+		benchmark::DoNotOptimize(q1);
+		benchmark::DoNotOptimize(t);
+		Quaternion result=operation(q0,q1,t);
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK_CAPTURE(BM_Interpolate, Slerp, [](const Quaternion &q0, const Quaternion &q1, double t){return slerp(q0,q1,t);});
+BENCHMARK_CAPTURE(BM_Interpolate, FastSlerp, [](const Quaternion &q0, const Quaternion &q1, double t){return fastSlerp(q0,q1,t);});
+BENCHMARK_CAPTURE(BM_Interpolate, Nlerp, [](const Quaternion &q0, const Quaternion &q1, double t){return nlerp(q0,q1,t);});
+BENCHMARK_CAPTURE(BM_Interpolate, Squad, [](const Quaternion &q0, const Quaternion &q1, double t){return squad(q0,q1,q1,q0,t);});
+
+// Batch interpolation of (q0,q1,t) triples
+template <typename Kernel>
+static void BM_BatchInterpolate(benchmark::State &state, Kernel kernel)
+{
+	const std::size_t size=state.range(0);
+	std::vector<Quaternion> quaternions=randomQuaternions(2*size);
+	for (auto &q : quaternions){
+		q=(1.0/q.norm())*q;
+	}
+	QuaternionBatch q0(std::vector<Quaternion>(quaternions.begin(),quaternions.begin()+size));
+	QuaternionBatch q1(std::vector<Quaternion>(quaternions.begin()+size,quaternions.end()));
+	QuaternionBatch out(size);
+	std::vector<double> t(size);
+	for (std::size_t n=0;n<size;++n){
+		t[n]=double(n)/size;
+	}
+	for (auto _ : state){
+		kernel(q0,q1,t.data(),out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*(3*sizeof(Quaternion)+sizeof(double)));
+}
+BENCHMARK_CAPTURE(BM_BatchInterpolate, Slerp, [](const QuaternionBatch &q0, const QuaternionBatch &q1, const double *t, QuaternionBatch &out){slerp(q0,q1,t,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_BatchInterpolate, FastSlerp, [](const QuaternionBatch &q0, const QuaternionBatch &q1, const double *t, QuaternionBatch &out){fastSlerp(q0,q1,t,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_BatchInterpolate, Nlerp, [](const QuaternionBatch &q0, const QuaternionBatch &q1, const double *t, QuaternionBatch &out){nlerp(q0,q1,t,out);})
+	->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+// === Composition ===
+// Rotation sequences for the composition benchmarks: unit quaternions, so the
+// products stay bounded however long the chain is
+static std::vector<Quaternion> randomRotations(std::size_t n)
+{
+	std::vector<Quaternion> quaternions=randomQuaternions(n);
+	for (auto &q : quaternions){
+		q=(1.0/q.norm())*q;
+	}
+	return quaternions;
+}
+
+// The naive serial chain, the baseline for compose()
+static void BM_ComposeSerialChain(benchmark::State &state)
+{
+	const std::vector<Quaternion> quaternions=randomRotations(state.range(0));
+	for (auto _ : state){
+		Quaternion product=quaternions[0];
+		for (std::size_t n=1;n<quaternions.size();++n){
+			product=product*quaternions[n];
+		}
+		benchmark::DoNotOptimize(product);
+	}
+	state.SetItemsProcessed(state.iterations()*quaternions.size());
+}
+BENCHMARK(BM_ComposeSerialChain)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch);
+
+static void BM_Compose(benchmark::State &state)
+{
+	const std::vector<Quaternion> quaternions=randomRotations(state.range(0));
+	for (auto _ : state){
+		Quaternion product=compose(quaternions);
+		benchmark::DoNotOptimize(product);
+	}
+	state.SetItemsProcessed(state.iterations()*quaternions.size());
+}
+BENCHMARK(BM_Compose)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch)->UseRealTime();
+
+static void BM_ComposeRenormalized(benchmark::State &state)
+{
+	const std::vector<Quaternion> quaternions=randomRotations(state.range(0));
+	for (auto _ : state){
+		Quaternion product=compose(quaternions,64);
+		benchmark::DoNotOptimize(product);
+	}
+	state.SetItemsProcessed(state.iterations()*quaternions.size());
+}
+BENCHMARK(BM_ComposeRenormalized)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch)->UseRealTime();
+
+// The serial prefix products, the baseline for composeScan()
+static void BM_ComposeSerialScan(benchmark::State &state)
+{
+	const std::vector<Quaternion> quaternions=randomRotations(state.range(0));
+	std::vector<Quaternion> out(quaternions.size());
+	for (auto _ : state){
+		Quaternion product=quaternions[0];
+		out[0]=product;
+		for (std::size_t n=1;n<quaternions.size();++n){
+			product=product*quaternions[n];
+			out[n]=product;
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*quaternions.size());
+}
+BENCHMARK(BM_ComposeSerialScan)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch);
+
+static void BM_ComposeScan(benchmark::State &state)
+{
+	const std::vector<Quaternion> quaternions=randomRotations(state.range(0));
+	std::vector<Quaternion> out(quaternions.size());
+	for (auto _ : state){
+		composeScan(quaternions.data(),quaternions.size(),out.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*quaternions.size());
+}
+BENCHMARK(BM_ComposeScan)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch)->UseRealTime();
+
+// === Conversions ===
+// Rotate a point cloud by one quaternion: two full Hamilton products per point
+static void BM_RotateHamilton(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	const Quaternion q=randomRotations(1)[0];
+	std::vector<Quaternion> points=randomQuaternions(size), out(size);
+	for (auto &p : points){
+		p=Quaternion(0,p.i(),p.j(),p.k());
+	}
+	for (auto _ : state){
+		for (std::size_t n=0;n<size;++n){
+			out[n]=q*points[n]*q.conjugate();
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK(BM_RotateHamilton)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+
+// The same, through the vector rotation formula and through the rotation matrix
+/* Note: the matrix costs 9 multiplications per point against 15 for the
+ * vector formula. The conversion is timed too, once per cloud
+ */
+template <typename Rotation>
+static void BM_RotateCloud(benchmark::State &state, Rotation rotation)
+{
+	const std::size_t size=state.range(0);
+	const Quaternion q=randomRotations(1)[0];
+	PointCloud points(size), out(size);
+	const std::vector<Quaternion> coordinates=randomQuaternions(size);
+	for (std::size_t n=0;n<size;++n){
+		points.set(n,Vector3{coordinates[n].i(),coordinates[n].j(),coordinates[n].k()});
+	}
+	for (auto _ : state){
+		rotation(q,points,out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*6*sizeof(double));
+}
+BENCHMARK_CAPTURE(BM_RotateCloud, Quaternion, [](const Quaternion &q, const PointCloud &in, PointCloud &out){rotate(q,in,out);})
+	->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+BENCHMARK_CAPTURE(BM_RotateCloud, Matrix, [](const Quaternion &q, const PointCloud &in, PointCloud &out){rotate(toMatrix(q),in,out);})
+	->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch);
+
+// Bulk conversions
+static void BM_BatchToMatrix(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	QuaternionBatch q(randomRotations(size));
+	Matrix3Batch out(size);
+	for (auto _ : state){
+		toMatrix(q,out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*13*sizeof(double));
+}
+BENCHMARK(BM_BatchToMatrix)->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+static void BM_BatchFromMatrix(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	Matrix3Batch matrices;
+	toMatrix(QuaternionBatch(randomRotations(size)),matrices);
+	QuaternionBatch out(size);
+	for (auto _ : state){
+		fromMatrix(matrices,out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*13*sizeof(double));
+}
+BENCHMARK(BM_BatchFromMatrix)->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+static void BM_BatchToEuler(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	QuaternionBatch q(randomRotations(size));
+	std::vector<double> a1(size), a2(size), a3(size);
+	for (auto _ : state){
+		toEuler(q,ZYX,a1.data(),a2.data(),a3.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK(BM_BatchToEuler)->RangeMultiplier(4)->Range(kMinBatch,kMaxBatch);
+
+// === Instruction set dispatch ===
+// The dispatched kernels with each instruction set forced in turn (see Dispatch.h)
+template <typename Kernel>
+static void BM_Dispatch(benchmark::State &state, InstructionSet isa, Kernel kernel)
+{
+	const InstructionSet active=activeInstructionSet();
+	if (!setInstructionSet(isa)){
+		state.SkipWithError("Instruction set not supported by this CPU");
+		return;
+	}
+	const std::size_t size=state.range(0);
+	const QuaternionBatch q1(randomRotations(size)), q2(randomQuaternions(size));
+	const std::vector<Quaternion> coordinates=randomQuaternions(size);
+	PointCloud points(size), rotated(size);
+	for (std::size_t n=0;n<size;++n){
+		points.set(n,Vector3{coordinates[n].i(),coordinates[n].j(),coordinates[n].k()});
+	}
+	QuaternionBatch out(size);
+	for (auto _ : state){
+		kernel(q1,q2,points,out,rotated);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	setInstructionSet(active);
+}
+#define QUATERNION_DISPATCH_BENCHMARKS(ISA) \
+	BENCHMARK_CAPTURE(BM_Dispatch, Hamilton_##ISA, ISA, \
+		[](const QuaternionBatch &q1, const QuaternionBatch &q2, const PointCloud &, QuaternionBatch &out, PointCloud &){multiply(q1,q2,out);}) \
+		->Arg(1<<12)->Arg(kMaxBatch); \
+	BENCHMARK_CAPTURE(BM_Dispatch, Normalize_##ISA, ISA, \
+		[](const QuaternionBatch &, const QuaternionBatch &q2, const PointCloud &, QuaternionBatch &out, PointCloud &){normalize(q2,out);}) \
+		->Arg(1<<12)->Arg(kMaxBatch); \
+	BENCHMARK_CAPTURE(BM_Dispatch, RotateBatch_##ISA, ISA, \
+		[](const QuaternionBatch &q1, const QuaternionBatch &, const PointCloud &points, QuaternionBatch &, PointCloud &rotated){rotate(q1,points,rotated);}) \
+		->Arg(1<<12)->Arg(kMaxBatch);
+QUATERNION_DISPATCH_BENCHMARKS(isaScalar)
+QUATERNION_DISPATCH_BENCHMARKS(isaSSE2)
+QUATERNION_DISPATCH_BENCHMARKS(isaAVX2)
+QUATERNION_DISPATCH_BENCHMARKS(isaAVX512)
+
+// === Gyroscope integration ===
+// Integrate 100 samples of many sensors with each scheme. One item is one
+// sensor stepped once
+static void BM_Integrate(benchmark::State &state, IntegrationScheme scheme)
+{
+	const std::size_t sensors=state.range(0), samples=100;
+	GyroSamples rates(sensors,samples);
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-5.0,5.0);
+	for (std::size_t sample=0;sample<samples;++sample){
+		for (std::size_t sensor=0;sensor<sensors;++sensor){
+			rates.set(sample,sensor,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+		}
+	}
+	const QuaternionBatch initial(randomRotations(sensors));
+	QuaternionBatch orientations(sensors);
+	for (auto _ : state){
+		orientations=initial;
+		integrate(rates,0.01,scheme,orientations);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*sensors*(samples-1));
+}
+BENCHMARK_CAPTURE(BM_Integrate, FirstOrder, integrateFirstOrder)->RangeMultiplier(16)->Range(kMinBatch,1<<16)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Integrate, Magnus, integrateMagnus)->RangeMultiplier(16)->Range(kMinBatch,1<<16)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Integrate, RK4, integrateRK4)->RangeMultiplier(16)->Range(kMinBatch,1<<16)->UseRealTime();
+
+// === Dual quaternions ===
+// Compose two rigid transforms: one dual quaternion product (3 Hamilton products)
+static void BM_DualCompose(benchmark::State &state)
+{
+	const std::vector<Quaternion> rotations=randomRotations(2);
+	DualQuaternion dq1=DualQuaternion::fromRotationTranslation(rotations[0],Vector3{1,2,3});
+	DualQuaternion dq2=DualQuaternion::fromRotationTranslation(rotations[1],Vector3{-3,0.5,2});
+	for (auto _ : state){
+		benchmark::DoNotOptimize(dq1);
+		benchmark::DoNotOptimize(dq2);
+		DualQuaternion composed=dq2*dq1;
+		benchmark::DoNotOptimize(composed);
+	}
+}
+BENCHMARK(BM_DualCompose);
+
+static void BM_Sclerp(benchmark::State &state)
+{
+	const std::vector<Quaternion> rotations=randomRotations(2);
+	DualQuaternion dq0=DualQuaternion::fromRotationTranslation(rotations[0],Vector3{1,2,3});
+	DualQuaternion dq1=DualQuaternion::fromRotationTranslation(rotations[1],Vector3{-3,0.5,2});
+	double t=0.3;
+	for (auto _ : state){
+		benchmark::DoNotOptimize(dq0);
+		benchmark::DoNotOptimize(t);
+		DualQuaternion blended=sclerp(dq0,dq1,t);
+		benchmark::DoNotOptimize(blended);
+	}
+}
+BENCHMARK(BM_Sclerp);
+
+// Skin a mesh with 64 joints and 4 influences per vertex. One item is one vertex
+static void BM_Skinning(benchmark::State &state)
+{
+	const std::size_t size=state.range(0), influences=4;
+	const std::vector<Quaternion> rotations=randomRotations(64), coordinates=randomQuaternions(size);
+	std::vector<DualQuaternion> joints(rotations.size());
+	for (std::size_t n=0;n<joints.size();++n){
+		joints[n]=DualQuaternion::fromRotationTranslation(rotations[n],Vector3{double(n),1.0,-0.5*n});
+	}
+	PointCloud rest(size), skinned(size);
+	SkinningWeights weights(size,influences);
+	for (std::size_t n=0;n<size;++n){
+		rest.set(n,Vector3{coordinates[n].i(),coordinates[n].j(),coordinates[n].k()});
+		for (std::size_t slot=0;slot<influences;++slot){
+			weights.set(n,slot,std::uint32_t((n/16+slot)%joints.size()),0.25); // Neighbouring vertices share joints, as in a mesh
+		}
+	}
+	for (auto _ : state){
+		skin(joints,weights,rest,skinned);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK(BM_Skinning)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch)->UseRealTime();
+
+// === Validation ===
+// Compare two batches that mostly agree, e.g. a replay against its recording
+static void BM_Compare(benchmark::State &state, ToleranceType type, ComparisonMode mode, double tolerance)
+{
+	const std::size_t size=state.range(0);
+	std::vector<Quaternion> quaternions=randomRotations(size);
+	const QuaternionBatch q1(quaternions);
+	for (std::size_t n=0;n<size;n+=97){
+		quaternions[n]=-1.0*quaternions[n];
+	}
+	const QuaternionBatch q2(quaternions);
+	std::vector<std::uint8_t> equal(size);
+	for (auto _ : state){
+		benchmark::DoNotOptimize(compare(q1,q2,tolerance,type,mode,equal.data()));
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK_CAPTURE(BM_Compare, Absolute, toleranceAbsolute, compareQuaternions, 1e-12)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Compare, Ulps, toleranceUlps, compareQuaternions, 4.0)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Compare, RelativeRotations, toleranceRelative, compareRotations, 1e-12)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+
+static void BM_AngularDistance(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	const QuaternionBatch q1(randomRotations(size)), q2(randomRotations(size));
+	std::vector<double> distances(size);
+	for (auto _ : state){
+		angularDistance(q1,q2,distances.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK(BM_AngularDistance)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+
+// === Statistics ===
+// Markley's mean of a batch: one pass of 10 sums, then one 4x4 eigenproblem
+static void BM_AverageRotation(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	const QuaternionBatch q(randomRotations(size));
+	for (auto _ : state){
+		Quaternion mean=averageRotation(q);
+		benchmark::DoNotOptimize(mean);
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK(BM_AverageRotation)->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+
+// The mean over a sliding window of 256 rotations at every position, of a
+// slowly turning orientation with noise (as from a sensor)
+static void BM_SlidingAverage(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	const std::vector<Quaternion> noise=randomQuaternions(size);
+	QuaternionBatch q(size), out(size);
+	for (std::size_t n=0;n<size;++n){
+		const double angle=1e-3*n;
+		const Quaternion jitter(1.0,0.01*noise[n].i(),0.01*noise[n].j(),0.01*noise[n].k());
+		q.set(n,normalize(Quaternion(std::cos(angle),0.0,0.0,std::sin(angle))*jitter));
+	}
+	for (auto _ : state){
+		slidingAverage(q,256,out);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+}
+BENCHMARK(BM_SlidingAverage)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch>>4)->UseRealTime();
+
+// === Compression ===
+// Encode rotations into a compact format (the bytes written are the packed ones)
+template <typename Format>
+static void BM_Encode(benchmark::State &state, Format)
+{
+	const std::size_t size=state.range(0);
+	const std::vector<Quaternion> q=randomRotations(size);
+	std::vector<Format> packed(size);
+	for (auto _ : state){
+		encode(q.data(),size,packed.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*sizeof(Format));
+}
+BENCHMARK_CAPTURE(BM_Encode, SmallestThree32, SmallestThree32())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Encode, SmallestThree48, SmallestThree48())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Encode, SmallestThree64, SmallestThree64())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Encode, Half, HalfQuaternion())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+
+// Decode them back
+template <typename Format>
+static void BM_Decode(benchmark::State &state, Format)
+{
+	const std::size_t size=state.range(0);
+	std::vector<Format> packed(size);
+	encode(randomRotations(size).data(),size,packed.data());
+	std::vector<Quaternion> q(size);
+	for (auto _ : state){
+		decode(packed.data(),size,q.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*sizeof(Format));
+}
+BENCHMARK_CAPTURE(BM_Decode, SmallestThree32, SmallestThree32())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Decode, SmallestThree48, SmallestThree48())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Decode, SmallestThree64, SmallestThree64())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Decode, Half, HalfQuaternion())->RangeMultiplier(16)->Range(kMinBatch,kMaxBatch)->UseRealTime();
+
+// === Rotation cache ===
+// Rotate a point by one of 64 recurring orientations (headings 1 degree apart):
+// through the cache, by building the matrix every time, and with sparse
+// Hamilton products. The threads share one cache
+template <typename Rotation>
+static void BM_RecurringRotations(benchmark::State &state, Rotation rotation)
+{
+	const int presets=64;
+	std::vector<Quaternion> headings(presets);
+	for (int n=0;n<presets;++n){
+		const double angle=n*std::acos(-1.0)/180;
+		headings[n]=Quaternion(std::cos(angle/2),0.0,0.0,std::sin(angle/2));
+	}
+	const Vector3 p{1.0,2.0,3.0};
+	std::size_t next=state.thread_index()*7;
+	for (auto _ : state){
+		Vector3 rotated=rotation(headings[next%presets],p);
+		benchmark::DoNotOptimize(rotated);
+		next+=13;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+static RotationCache &benchmarkCache()
+{
+	static RotationCache cache(1024);
+	return cache;
+}
+BENCHMARK_CAPTURE(BM_RecurringRotations, Cached, [](const Quaternion &q, const Vector3 &p){return benchmarkCache().rotate(q,p);})
+	->ThreadRange(1,8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_RecurringRotations, ToMatrix, [](const Quaternion &q, const Vector3 &p){return rotate(toMatrix(q),p);})
+	->ThreadRange(1,8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_RecurringRotations, Sparse, [](const Quaternion &q, const Vector3 &p){
+	SparseQuaternion rotation(q.w(),q.i(),q.j(),q.k()); // conjugate() is not const
+	const SparseQuaternion rotated=rotation*SparseQuaternion(0.0,p.x,p.y,p.z)*rotation.conjugate();
+	return Vector3{rotated.i(),rotated.j(),rotated.k()};
+})->ThreadRange(1,8)->UseRealTime();
+
+// === Input/output ===
+// Append quaternions one at a time to a binary stream file
+static void BM_FileAppend(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	const std::vector<Quaternion> quaternions=randomQuaternions(size);
+	for (auto _ : state){
+		QuaternionFileWriter<double> writer("quaternionBench.quaternions");
+		for (const auto &q : quaternions){
+			writer.append(q);
+		}
+		writer.close();
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*sizeof(Quaternion));
+	std::remove("quaternionBench.quaternions");
+}
+BENCHMARK(BM_FileAppend)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch);
+
+// Map a file and sum its quaternions (the file is in the page cache, so this is the replay overhead)
+static void BM_FileReplay(benchmark::State &state)
+{
+	const std::size_t size=state.range(0);
+	{
+		QuaternionFileWriter<double> writer("quaternionBench.quaternions");
+		const std::vector<Quaternion> quaternions=randomQuaternions(size);
+		writer.append(quaternions.data(),size);
+	}
+	for (auto _ : state){
+		MappedQuaternionFile<double> file("quaternionBench.quaternions");
+		Quaternion sum;
+		for (const auto &q : file){
+			sum=sum+q;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations()*size);
+	state.SetBytesProcessed(state.iterations()*size*sizeof(Quaternion));
+	std::remove("quaternionBench.quaternions");
+}
+BENCHMARK(BM_FileReplay)->RangeMultiplier(16)->Range(kMinBatch<<4,kMaxBatch);
+
+// Format and parse the text notation
+static void BM_TextRoundTrip(benchmark::State &state)
+{
+	const std::vector<Quaternion> quaternions=randomQuaternions(1024);
+	for (auto _ : state){
+		std::stringstream stream;
+		for (const auto &q : quaternions){
+			stream<<q<<'\n';
+		}
+		Quaternion q;
+		while (stream>>q){
+			benchmark::DoNotOptimize(q);
+		}
+	}
+	state.SetItemsProcessed(state.iterations()*quaternions.size());
+}
+BENCHMARK(BM_TextRoundTrip);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,859 @@
+/*
+ * accuracyTester.cpp
+ *
+ * \brief Differential accuracy tests: every operator and fast kernel against a long double reference
+ * \author Nikos Kazazakis
+ */
+
+// Program description:
+// Runs every quaternion operator (in double and in float), the fast paths
+// (fastNormalize, the rotation formula, toMatrix, fastSlerp, the polynomial
+// steps of the batch gyroscope integration) and the batch kernels of every
+// instruction set on random and adversarial inputs, computes the same
+// results in long double with code of its own (the definitions, not the
+// library's formulas), and prints the largest and mean error of each one in
+// units in the last place (ULPs), or in radians for the approximations. Each
+// operator has an accuracy budget: the test fails if a change makes it less
+// accurate than that. This is a separate CTest target
+// (accuracyTester), so accuracy can gate performance work on its own.
+
+#define CATCH_CONFIG_MAIN
+#include "Quaternion.h"
+#include "QuaternionBatch.h"
+#include "UnitQuaternion.h"
+#include "Rotation.h"
+#include "Conversion.h"
+#include "Dispatch.h"
+#include "Interpolation.h"
+#include "Integration.h"
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace Quaternions;
+
+/* Note: how the error is measured. An error of n ULPs means the result is n
+ * steps of double away from the reference, where a step is the spacing of
+ * doubles at the SCALE of the result, not at each component: e.g. for a
+ * Hamilton product the scale is |q1||q2| (the norm of the product), so a
+ * component that cancels to almost 0 is allowed an error of a few ULPs of
+ * the whole product, which is what the rounding of its terms gives. Each
+ * operator says what its scale is. Componentwise ULPs would blame the
+ * rounding of the inputs on the operator.
+ *
+ * The approximations (fastSlerp, nlerp, the integration) are measured in
+ * radians instead: as the angle of the rotation between the result and the
+ * reference, which is what their documentation states. Their error comes
+ * from the approximation, not from rounding, so ULPs would mean nothing.
+ * The float instantiations are measured in ULPs of float.
+ *
+ * The budgets are the worst case bounds of the rounding errors where these
+ * are simple (half an ULP for operations rounded once, 4 ULPs for sums of
+ * four products), and otherwise a little above the largest error measured
+ * when the harness was written, so that a change that loses accuracy fails.
+ *
+ * The reference is long double, which on x86-64 has 64 bits of mantissa, 11
+ * more than double: its own error is below 1/1000 ULP. Where long double is
+ * no more precise than double (e.g. MSVC), the tests are skipped.
+ *
+ * Supported range: the operators compute |q|^2 without rescaling, so they
+ * only work while |q|^2 neither overflows nor underflows into the subnormals
+ * (where it loses precision), i.e. for norms from about 1e-150 to 1e150
+ * (and products and quotients whose norms are within that). log also needs
+ * the norm of the vector part within that range (or 0). The adversarial
+ * inputs go to the edges of that range, and include subnormal components
+ * (next to normal ones), antipodal and nearly antipodal pairs, nearly
+ * inverse pairs (whose product cancels to almost the identity) and
+ * rotations by tiny angles.
+ */
+
+namespace{
+
+typedef long double Real;
+
+bool referenceIsPrecise()
+{
+	return std::numeric_limits<Real>::digits>=std::numeric_limits<double>::digits+8;
+}
+
+// === The reference ===
+// A quaternion in long double, with only the operations the tests need
+struct Exact
+{
+	Real w, i, j, k;
+};
+
+template <typename T>
+Exact exact(const BasicQuaternion<T> &q) {return Exact{q.w(),q.i(),q.j(),q.k()};}
+
+Exact operator+(const Exact &a, const Exact &b) {return Exact{a.w+b.w,a.i+b.i,a.j+b.j,a.k+b.k};}
+Exact operator-(const Exact &a, const Exact &b) {return Exact{a.w-b.w,a.i-b.i,a.j-b.j,a.k-b.k};}
+Exact operator*(Real c, const Exact &a) {return Exact{c*a.w,c*a.i,c*a.j,c*a.k};}
+
+// The Hamilton product, from the multiplication table of i, j and k
+Exact operator*(const Exact &a, const Exact &b)
+{
+	return Exact{
+		a.w*b.w-a.i*b.i-a.j*b.j-a.k*b.k,
+		a.w*b.i+a.i*b.w+a.j*b.k-a.k*b.j,
+		a.w*b.j-a.i*b.k+a.j*b.w+a.k*b.i,
+		a.w*b.k+a.i*b.j-a.j*b.i+a.k*b.w };
+}
+
+Exact conjugate(const Exact &a) {return Exact{a.w,-a.i,-a.j,-a.k};}
+Real dot(const Exact &a, const Exact &b) {return a.w*b.w+a.i*b.i+a.j*b.j+a.k*b.k;}
+Real norm(const Exact &a) {return std::sqrt(dot(a,a));}
+Real largest(const Exact &a) {return std::max(std::max(std::abs(a.w),std::abs(a.i)),std::max(std::abs(a.j),std::abs(a.k)));}
+
+// exp(w+v)=e^w (cos|v| + v/|v| sin|v|)
+Exact exp(const Exact &a)
+{
+	const Real length=std::sqrt(a.i*a.i+a.j*a.j+a.k*a.k);
+	// sin(x)/x: the series is exact to long double below 1e-5
+	const Real sinc= length<1e-5L ? 1-length*length/6+length*length*length*length/120 : std::sin(length)/length;
+	const Real scale=std::exp(a.w);
+	return Exact{scale*std::cos(length),scale*sinc*a.i,scale*sinc*a.j,scale*sinc*a.k};
+}
+
+// log(q)=ln|q| + v/|v| angle, with angle the one between q and the real axis
+Exact log(const Exact &a)
+{
+	const Real length=std::sqrt(a.i*a.i+a.j*a.j+a.k*a.k);
+	const Real real=std::log(norm(a));
+	if (length==0){
+		return Exact{real,0,0,0};
+	}
+	const Real scale=std::atan2(length,a.w)/length;
+	return Exact{real,scale*a.i,scale*a.j,scale*a.k};
+}
+
+// The angle of the rotation between the unit quaternions a and b (q and -q
+// are the same rotation), from the half chords as angularDistance does
+Real rotationAngle(const Exact &a, const Exact &b)
+{
+	const Real difference=norm(a-b), sum=norm(a+b);
+	return 4*std::atan2(std::min(difference,sum),std::max(difference,sum));
+}
+
+Exact normalize(const Exact &a) {return (1/norm(a))*a;}
+
+// Spherical interpolation along the shortest arc, from the definition
+Exact slerp(const Exact &q0, Exact q1, Real t)
+{
+	if (dot(q0,q1)<0){
+		q1=Real(-1)*q1;
+	}
+	const Real angle=2*std::atan2(norm(q1-q0),norm(q1+q0)); // Between the 4D vectors
+	if (angle<1e-9L){
+		return normalize(q0+t*(q1-q0)); // Exact to long double there
+	}
+	return (1/std::sin(angle))*(std::sin((1-t)*angle)*q0+std::sin(t*angle)*q1);
+}
+
+// === Error statistics ===
+
+// What an error is measured in
+typedef enum{
+	unitDouble, // ULPs of double
+	unitFloat,  // ULPs of float
+	unitRadian  // Radians (the error is given, there is no scale)
+}ErrorUnit;
+
+// The spacing of doubles (or floats) at x (the smallest subnormal at 0)
+template <typename T>
+Real ulp(Real x)
+{
+	const T magnitude=std::abs(static_cast<T>(x));
+	if (magnitude<std::numeric_limits<T>::min()){
+		return std::numeric_limits<T>::denorm_min();
+	}
+	return std::nextafter(magnitude,std::numeric_limits<T>::infinity())-magnitude;
+}
+
+// Largest and mean error of one operator, in ULPs of its scale (or in radians)
+class ErrorStats
+{
+public :
+	ErrorStats(const std::string &name, const char *scale, double budget, ErrorUnit unit=unitDouble) :
+		name_(name), scale_(scale), budget_(budget), unit_(unit), max_(0), sum_(0), samples_(0) {}
+
+	void add(Real computed, Real reference, Real scale)
+	{
+		const Real spacing= unit_==unitFloat ? ulp<float>(scale) : ulp<double>(scale);
+		addError(std::abs(computed-reference)/spacing);
+	}
+
+	template <typename E>
+	void add(const QuaternionExpression<E> &expression, const Exact &reference, Real scale)
+	{
+		const auto computed=expression.eval();
+		add(computed.w(),reference.w,scale);
+		add(computed.i(),reference.i,scale);
+		add(computed.j(),reference.j,scale);
+		add(computed.k(),reference.k,scale);
+	}
+
+	// An error already in the unit, e.g. an angle
+	void addError(Real error)
+	{
+		if (!(error==error)){
+			error=std::numeric_limits<Real>::infinity(); // NaN results count as infinitely wrong
+		}
+		max_=std::max(max_,error);
+		sum_+=error;
+		++samples_;
+	}
+
+	// Print one line of the report, and check the budget
+	void report()
+	{
+		const char *units[]={"ULP","float ULP","rad"};
+		std::printf("%-30s %-18s %-9s %8zu %10.3Lg %10.3Lg %8.3g\n",name_.c_str(),scale_,units[unit_],samples_,max_,
+				samples_ ? sum_/samples_ : Real(0),budget_);
+		INFO(name_<<": "<<max_<<" "<<units[unit_]<<", over the budget of "<<budget_);
+		CHECK(samples_>0);
+		CHECK(max_<=budget_);
+	}
+
+private:
+	std::string name_;
+	const char *scale_;
+	double budget_;
+	ErrorUnit unit_;
+	Real max_, sum_;
+	std::size_t samples_;
+};
+
+void printHeader(const char *title)
+{
+	std::printf("\n%s\n%-30s %-18s %-9s %8s %10s %10s %8s\n",title,"operator","scale","unit","samples","max","mean","budget");
+}
+
+// === Inputs ===
+
+// Random quaternions: random directions, norms from 2^-30 to 2^30
+std::vector<Quaternion> randomQuaternions(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::normal_distribution<double> component;
+	std::uniform_real_distribution<double> exponent(-30.0,30.0);
+	std::vector<Quaternion> quaternions(n);
+	for (auto &q : quaternions){
+		const double scale=std::exp2(exponent(generator));
+		q=scale*Quaternion(component(generator),component(generator),component(generator),component(generator));
+	}
+	return quaternions;
+}
+
+// The edge cases, within the supported range
+std::vector<Quaternion> adversarialQuaternions()
+{
+	const double subnormal=std::numeric_limits<double>::denorm_min(), tiny=1e-150, huge=1e150;
+	std::vector<Quaternion> quaternions={
+		Quaternion(1,0,0,0), Quaternion(-1,0,0,0), Quaternion(0,0,0,1), Quaternion(-0.0,0.0,-0.0,1e-150),
+		Quaternion(1,subnormal,-subnormal,0), Quaternion(1,1e-310,-3e-320,2.2250738585072014e-308),
+		Quaternion(subnormal,1,0,-subnormal), Quaternion(tiny,-tiny,tiny,tiny), Quaternion(tiny,0,0,subnormal),
+		Quaternion(huge,huge,-huge,huge), Quaternion(huge,1,0,1e-300), Quaternion(-tiny,0,0,0),
+		Quaternion(0,huge,0,0), Quaternion(1,1e-17,1e-17,1e-17), Quaternion(1,1e-9,0,0),
+		Quaternion(1,1.4901161193847656e-8,0,0), Quaternion(1,1.5e-8,0,0), Quaternion(1e-17,1,-1,1),
+		Quaternion(0.5,0.5,0.5,0.5), Quaternion(1,1,1,1), Quaternion(3,-1e-8,4,1e8), Quaternion(1e8,1e-8,-1e-8,1) };
+	// Nearly real and nearly pure, at many scales
+	for (int power=-150;power<=150;power+=25){
+		const double scale=std::pow(10.0,power);
+		quaternions.push_back(scale*Quaternion(1,1e-12,-1e-13,1e-14));
+		quaternions.push_back(scale*Quaternion(1e-15,1,2,-3));
+	}
+	return quaternions;
+}
+
+std::vector<Quaternion> allQuaternions(unsigned seed)
+{
+	std::vector<Quaternion> quaternions=randomQuaternions(20000,seed);
+	const std::vector<Quaternion> edges=adversarialQuaternions();
+	quaternions.insert(quaternions.end(),edges.begin(),edges.end());
+	return quaternions;
+}
+
+// Pairs of operands: random, every pair of edge cases, and pairs that cancel
+std::vector<std::pair<Quaternion,Quaternion> > quaternionPairs(unsigned seed)
+{
+	std::vector<std::pair<Quaternion,Quaternion> > pairs;
+	const std::vector<Quaternion> first=randomQuaternions(20000,seed), second=randomQuaternions(20000,seed+1);
+	for (std::size_t n=0;n<first.size();++n){
+		pairs.emplace_back(first[n],second[n]);
+	}
+	const std::vector<Quaternion> edges=adversarialQuaternions();
+	for (const Quaternion &q1 : edges){
+		for (const Quaternion &q2 : edges){
+			// Keep the products within the range
+			const double scale=std::sqrt(q1.squaredNorm()*q2.squaredNorm());
+			if (scale>1e-150 && scale<1e150){
+				pairs.emplace_back(q1,q2);
+			}
+		}
+	}
+	std::mt19937 generator(seed+2);
+	std::uniform_real_distribution<double> perturbation(-1e-12,1e-12);
+	for (std::size_t n=0;n<1000;++n){
+		const Quaternion q=first[n];
+		const double scale=q.norm();
+		const Quaternion noise=scale*Quaternion(perturbation(generator),perturbation(generator),perturbation(generator),perturbation(generator));
+		pairs.emplace_back(q,-1.0*q);           // Antipodal
+		pairs.emplace_back(q,-1.0*q+noise);     // Nearly antipodal
+		pairs.emplace_back(q,inverse(q)+(1.0/(scale*scale))*noise); // Nearly inverse
+	}
+	return pairs;
+}
+
+std::vector<Vector3> randomPoints(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> coordinate(-100.0,100.0);
+	std::vector<Vector3> points(n);
+	for (auto &p : points){
+		p=Vector3{coordinate(generator),coordinate(generator),coordinate(generator)};
+	}
+	// Points that are almost on the axis of rotation, and tiny and huge ones
+	points.push_back(Vector3{0,0,1});
+	points.push_back(Vector3{1e-300,0,-1e-300});
+	points.push_back(Vector3{1e150,-1e150,1});
+	return points;
+}
+
+// Unit quaternions, normalized in long double (so they are as unit as doubles can be)
+std::vector<Quaternion> randomRotations(std::size_t n, unsigned seed)
+{
+	std::vector<Quaternion> rotations;
+	std::vector<Quaternion> sources=randomQuaternions(n,seed);
+	const std::vector<Quaternion> edges=adversarialQuaternions();
+	sources.insert(sources.end(),edges.begin(),edges.end());
+	for (const Quaternion &q : sources){
+		const Exact e=exact(q);
+		const Real length=norm(e);
+		rotations.push_back(Quaternion(double(e.w/length),double(e.i/length),double(e.j/length),double(e.k/length)));
+	}
+	return rotations;
+}
+
+// The rotation of p by the unit quaternion q, q*(0,p)*conj(q), with the exact q of the doubles
+/* Note: the doubles of q are unit only to within an epsilon, and the
+ * library formulas assume |q|=1, so the reference divides by |q|^2: what is
+ * measured is the rotation, not how unit the input was
+ */
+Exact exactRotation(const Quaternion &q, const Vector3 &p)
+{
+	const Exact e=exact(q);
+	return (Real(1)/dot(e,e))*(e*Exact{0,p.x,p.y,p.z}*conjugate(e));
+}
+
+// Float quaternions: random directions with norms from 2^-20 to 2^20, and the
+// edge cases within the range of float (norms from about 1e-15 to 1e15,
+// where |q|^2 stays normal)
+std::vector<QuaternionF> floatQuaternions(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::normal_distribution<float> component;
+	std::uniform_real_distribution<float> exponent(-20.0f,20.0f);
+	std::vector<QuaternionF> quaternions(n);
+	for (auto &q : quaternions){
+		const float scale=std::exp2(exponent(generator));
+		q=scale*QuaternionF(component(generator),component(generator),component(generator),component(generator));
+	}
+	const float subnormal=std::numeric_limits<float>::denorm_min();
+	const QuaternionF edges[]={
+		QuaternionF(1,0,0,0), QuaternionF(-1,0,0,0), QuaternionF(0,0,0,1), QuaternionF(1,subnormal,-subnormal,0),
+		QuaternionF(subnormal,1,0,-subnormal), QuaternionF(1e-15f,-1e-15f,1e-15f,1e-15f), QuaternionF(1e15f,1e15f,-1e15f,1e15f),
+		QuaternionF(1,1e-8f,1e-8f,1e-8f), QuaternionF(1,3e-4f,0,0), QuaternionF(0.5f,0.5f,0.5f,0.5f), QuaternionF(3,-1e-4f,4,1e4f) };
+	quaternions.insert(quaternions.end(),std::begin(edges),std::end(edges));
+	for (int power=-15;power<=15;power+=5){
+		const float scale=std::pow(10.0f,float(power));
+		quaternions.push_back(scale*QuaternionF(1,1e-5f,-1e-6f,1e-7f));
+		quaternions.push_back(scale*QuaternionF(1e-7f,1,2,-3));
+	}
+	return quaternions;
+}
+
+// Pairs of unit quaternions to interpolate between: random, close together,
+// nearly the same, and about 180 degrees apart (dot products around 0, where
+// the shortest arc flips)
+std::vector<std::pair<Quaternion,Quaternion> > interpolationPairs(unsigned seed)
+{
+	std::vector<std::pair<Quaternion,Quaternion> > pairs;
+	const std::vector<Quaternion> first=randomRotations(4000,seed), second=randomRotations(4000,seed+1);
+	std::mt19937 generator(seed+2);
+	std::uniform_real_distribution<double> exponent(-8.0,0.0), offset(-1e-3,1e-3);
+	std::normal_distribution<double> direction;
+	for (std::size_t n=0;n<first.size();++n){
+		const Quaternion &q0=first[n];
+		pairs.emplace_back(q0,second[n]);
+		// A rotation by a small angle, and by about 180 degrees, away from q0
+		const Quaternion axis=normalize(Quaternion(0,direction(generator),direction(generator),direction(generator)));
+		const double small=std::pow(10.0,exponent(generator)), halfTurn=0.5*(3.14159265358979+offset(generator));
+		pairs.emplace_back(q0,normalize(q0*Quaternion(std::cos(0.5*small),std::sin(0.5*small)*axis.i(),
+				std::sin(0.5*small)*axis.j(),std::sin(0.5*small)*axis.k())));
+		pairs.emplace_back(q0,normalize(q0*Quaternion(std::cos(halfTurn),std::sin(halfTurn)*axis.i(),
+				std::sin(halfTurn)*axis.j(),std::sin(halfTurn)*axis.k())));
+		pairs.emplace_back(q0,-1.0*q0);
+	}
+	return pairs;
+}
+
+} // End anonymous namespace
+
+// === Dense operators (Quaternion.h, Quaternion.cpp) ===
+TEST_CASE("Accuracy of the quaternion operators"){
+	if (!referenceIsPrecise()){
+		WARN("long double is not more precise than double here: skipping the accuracy tests");
+		return;
+	}
+	printHeader("Quaternion operators (Quaternion.h)");
+
+	const std::vector<std::pair<Quaternion,Quaternion> > pairs=quaternionPairs(1);
+	ErrorStats add("q1+q2","|q1+q2|",0.5), subtract("q1-q2","|q1-q2|",0.5), hamilton("q1*q2","|q1||q2|",4.0),
+			dotProduct("dot(q1,q2)","|q1||q2|",4.0), scalarProduct("c*q","|c*q|",0.5), scalarSum("c+q","|c+q|",0.5),
+			scalarDifference("c-q","|c-q|",0.5);
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<double> factor(-4.0,4.0);
+	for (const auto &pair : pairs){
+		const Quaternion &q1=pair.first, &q2=pair.second;
+		const Exact e1=exact(q1), e2=exact(q2);
+		const Real scale=norm(e1)*norm(e2);
+		const Exact sum=e1+e2, difference=e1-e2;
+		add.add(q1+q2,sum,largest(sum));
+		subtract.add(q1-q2,difference,largest(difference));
+		hamilton.add(q1*q2,e1*e2,scale);
+		dotProduct.add(dot(q1,q2),dot(e1,e2),scale);
+		const double c=factor(generator);
+		const Exact product=Real(c)*e1;
+		scalarProduct.add(c*q1,product,largest(product));
+		// Note: c+q adds c to every component (see QuaternionExpression.h)
+		const Exact shifted=Exact{c+e1.w,c+e1.i,c+e1.j,c+e1.k}, negated=Exact{c-e1.w,c-e1.i,c-e1.j,c-e1.k};
+		scalarSum.add(c+q1,shifted,largest(shifted));
+		scalarDifference.add(c-q1,negated,largest(negated));
+	}
+	add.report();
+	subtract.report();
+	hamilton.report();
+	dotProduct.report();
+	scalarProduct.report();
+	scalarSum.report();
+	scalarDifference.report();
+
+	const std::vector<Quaternion> quaternions=allQuaternions(2);
+	ErrorStats conjugation("conjugate","|q|",0.0), squaredNorm("squaredNorm","|q|^2",4.0), length("norm","|q|",3.0),
+			normalization("normalize","1",2.0), inversion("inverse","1/|q|",4.0), fast("fastNormalize","1",2.0);
+	for (const Quaternion &q : quaternions){
+		const Exact e=exact(q);
+		const Real size=norm(e);
+		conjugation.add(q.conjugate(),conjugate(e),size);
+		squaredNorm.add(q.squaredNorm(),dot(e,e),dot(e,e));
+		length.add(q.norm(),size,size);
+		normalization.add(normalize(q),(1/size)*e,1);
+		inversion.add(inverse(q),(1/dot(e,e))*conjugate(e),1/size);
+		fast.add(fastNormalize(q),(1/size)*e,1);
+	}
+	conjugation.report();
+	squaredNorm.report();
+	length.report();
+	normalization.report();
+	inversion.report();
+	fast.report();
+}
+
+TEST_CASE("Accuracy of exp and log"){
+	if (!referenceIsPrecise()){
+		return;
+	}
+	printHeader("Exponential and logarithm (Quaternion.h)");
+
+	// exp: real parts where e^w is well within range, and vector parts from
+	// nothing (and around the cut-off of the series) to many turns
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<double> real(-20.0,20.0), exponent(-12.0,1.5);
+	std::normal_distribution<double> direction;
+	std::vector<Quaternion> arguments;
+	for (int n=0;n<20000;++n){
+		const double length=std::pow(10.0,exponent(generator));
+		const Quaternion axis=normalize(Quaternion(0,direction(generator),direction(generator),direction(generator)));
+		arguments.push_back(Quaternion(real(generator),length*axis.i(),length*axis.j(),length*axis.k()));
+	}
+	for (double length : {0.0,1e-300,1e-17,1.4901161193847656e-8,1.49011611938476e-8,1.5e-8,1e-4,3.14159265358979,6.28318530717959,30.0}){
+		arguments.push_back(Quaternion(0.5,length,0,0));
+		arguments.push_back(Quaternion(-1,0,-length,length));
+	}
+	// The scale is |exp q| max(|v|,1): |v| is rounded before its sine and
+	// cosine are taken, which moves them by up to |v| ULPs
+	ErrorStats exponential("exp","|exp q|max(|v|,1)",3.0);
+	for (const Quaternion &q : arguments){
+		const Exact reference=exp(exact(q));
+		const Real length=std::sqrt(Real(q.i())*q.i()+Real(q.j())*q.j()+Real(q.k())*q.k());
+		exponential.add(exp(q),reference,norm(reference)*std::max(length,Real(1)));
+	}
+	exponential.report();
+
+	// log: the scale is |log q|, but at least 1 (ln|q| of |q| near 1 cancels,
+	// which costs an ULP of 1, not of the tiny result)
+	ErrorStats logarithm("log","max(|log q|,1)",3.0);
+	for (const Quaternion &q : allQuaternions(4)){
+		const Real length=std::sqrt(Real(q.i())*q.i()+Real(q.j())*q.j()+Real(q.k())*q.k());
+		if (length>0 && length<1e-150){
+			continue; // Outside the range: |v|^2 underflows
+		}
+		const Exact reference=log(exact(q));
+		logarithm.add(log(q),reference,std::max(norm(reference),Real(1)));
+	}
+	logarithm.report();
+}
+
+// === Rotations and conversions (Rotation.h, Conversion.h) ===
+TEST_CASE("Accuracy of rotations and conversions"){
+	if (!referenceIsPrecise()){
+		return;
+	}
+	printHeader("Rotations and conversions (Rotation.h, Conversion.h)");
+
+	const std::vector<Quaternion> rotations=randomRotations(2000,5);
+	const std::vector<Vector3> points=randomPoints(20,6);
+	ErrorStats formula("rotate(q,p)","|p|",6.0), matrix("rotate(toMatrix(q),p)","|p|",8.0), conversion("toMatrix(q)","1",4.0);
+	for (const Quaternion &q : rotations){
+		const Matrix3 M=toMatrix(q);
+		// Column c of the matrix is the rotation of the unit vector c
+		for (int column=0;column<3;++column){
+			const Vector3 axis{double(column==0),double(column==1),double(column==2)};
+			const Exact reference=exactRotation(q,axis);
+			conversion.add(M.m[0][column],reference.i,1);
+			conversion.add(M.m[1][column],reference.j,1);
+			conversion.add(M.m[2][column],reference.k,1);
+		}
+		for (const Vector3 &p : points){
+			const Exact reference=exactRotation(q,p);
+			const Real length=std::sqrt(Real(p.x)*p.x+Real(p.y)*p.y+Real(p.z)*p.z);
+			const Vector3 r1=rotate(q,p), r2=rotate(M,p);
+			formula.add(Quaternion(0,r1.x,r1.y,r1.z),reference,length);
+			matrix.add(Quaternion(0,r2.x,r2.y,r2.z),reference,length);
+		}
+	}
+	formula.report();
+	matrix.report();
+	conversion.report();
+}
+
+// === The float instantiations (QuaternionF) ===
+TEST_CASE("Accuracy of the float operators"){
+	if (!referenceIsPrecise()){
+		return;
+	}
+	printHeader("Float operators (QuaternionF)");
+
+	const std::vector<QuaternionF> quaternions=floatQuaternions(20000,12), others=floatQuaternions(20000,13);
+	ErrorStats hamilton("q1*q2","|q1||q2|",4.0,unitFloat), dotProduct("dot(q1,q2)","|q1||q2|",4.0,unitFloat),
+			squaredNorm("squaredNorm","|q|^2",4.0,unitFloat), length("norm","|q|",3.0,unitFloat),
+			normalization("normalize","1",2.0,unitFloat), inversion("inverse","1/|q|",4.0,unitFloat),
+			fast("fastNormalize","1",2.0,unitFloat), conversion("toMatrix(q)","1",4.0,unitFloat);
+	for (std::size_t n=0;n<quaternions.size();++n){
+		const QuaternionF &q1=quaternions[n], &q2=others[n];
+		const Exact e1=exact(q1), e2=exact(q2);
+		const Real size=norm(e1), scale=size*norm(e2);
+		// Keep the products within the range
+		if (scale>1e-30L && scale<1e30L){
+			hamilton.add(q1*q2,e1*e2,scale);
+			dotProduct.add(dot(q1,q2),dot(e1,e2),scale);
+		}
+		squaredNorm.add(q1.squaredNorm(),dot(e1,e1),dot(e1,e1));
+		length.add(q1.norm(),size,size);
+		normalization.add(normalize(q1),(1/size)*e1,1);
+		inversion.add(inverse(q1),(1/dot(e1,e1))*conjugate(e1),1/size);
+		fast.add(fastNormalize(q1),(1/size)*e1,1);
+
+		// Column c of the matrix is the rotation of the unit vector c
+		const QuaternionF unit=normalize(q1);
+		const Exact u=exact(unit);
+		const BasicMatrix3<float> M=toMatrix(unit);
+		for (int column=0;column<3;++column){
+			const Exact axis{0,Real(column==0),Real(column==1),Real(column==2)};
+			const Exact reference=(Real(1)/dot(u,u))*(u*axis*conjugate(u));
+			conversion.add(M.m[0][column],reference.i,1);
+			conversion.add(M.m[1][column],reference.j,1);
+			conversion.add(M.m[2][column],reference.k,1);
+		}
+	}
+	hamilton.report();
+	dotProduct.report();
+	squaredNorm.report();
+	length.report();
+	normalization.report();
+	inversion.report();
+	fast.report();
+	conversion.report();
+
+	// exp and log, with the scales of the double versions (see above)
+	std::mt19937 generator(14);
+	std::uniform_real_distribution<float> real(-10.0f,10.0f), exponent(-6.0f,1.5f);
+	std::normal_distribution<float> direction;
+	ErrorStats exponential("exp","|exp q|max(|v|,1)",3.0,unitFloat), logarithm("log","max(|log q|,1)",3.0,unitFloat);
+	for (int n=0;n<20000;++n){
+		const float size=std::pow(10.0f,exponent(generator));
+		const QuaternionF axis=normalize(QuaternionF(0,direction(generator),direction(generator),direction(generator)));
+		const QuaternionF q(real(generator),size*axis.i(),size*axis.j(),size*axis.k());
+		const Exact reference=exp(exact(q));
+		const Real vector=std::sqrt(Real(q.i())*q.i()+Real(q.j())*q.j()+Real(q.k())*q.k());
+		exponential.add(exp(q),reference,norm(reference)*std::max(vector,Real(1)));
+	}
+	for (const QuaternionF &q : quaternions){
+		const Real vector=std::sqrt(Real(q.i())*q.i()+Real(q.j())*q.j()+Real(q.k())*q.k());
+		if (vector>0 && vector<1e-15L){
+			continue; // Outside the range: |v|^2 underflows
+		}
+		const Exact reference=log(exact(q));
+		logarithm.add(log(q),reference,std::max(norm(reference),Real(1)));
+	}
+	exponential.report();
+	logarithm.report();
+}
+
+// === Interpolation (Interpolation.h) ===
+TEST_CASE("Accuracy of the interpolations"){
+	if (!referenceIsPrecise()){
+		return;
+	}
+	printHeader("Interpolation (Interpolation.h), as the angle to the exact slerp");
+
+	const std::vector<std::pair<Quaternion,Quaternion> > pairs=interpolationPairs(15);
+	std::mt19937 generator(16);
+	std::uniform_real_distribution<double> parameter(0.0,1.0);
+	std::vector<double> t(pairs.size());
+	for (std::size_t n=0;n<t.size();++n){
+		t[n]= n%8==0 ? 0.0 : n%8==1 ? 0.5 : n%8==2 ? 1.0 : parameter(generator);
+	}
+	std::vector<Quaternion> first, second;
+	for (const auto &pair : pairs){
+		first.push_back(pair.first);
+		second.push_back(pair.second);
+	}
+
+	// Note: the budgets of fastSlerp and nlerp are those in Interpolation.h
+	// (whose 0.14 rad for nlerp is rounded down from 0.1422), and the same in
+	// float: their error comes from the approximation
+	ErrorStats exact64("slerp","angle",1e-15,unitRadian), fast64("fastSlerp","angle",8e-4,unitRadian),
+			linear64("nlerp","angle",0.143,unitRadian), batch64("fastSlerp batch","angle",8e-4,unitRadian),
+			exact32("slerp float","angle",5e-7,unitRadian), fast32("fastSlerp float","angle",8e-4,unitRadian),
+			batch32("fastSlerp batch float","angle",8e-4,unitRadian);
+	QuaternionBatch batch;
+	fastSlerp(QuaternionBatch(first),QuaternionBatch(second),t.data(),batch);
+	std::vector<QuaternionF> firstF, secondF;
+	std::vector<float> tF;
+	for (std::size_t n=0;n<pairs.size();++n){
+		const Quaternion &q0=first[n], &q1=second[n];
+		const Exact reference=slerp(normalize(exact(q0)),normalize(exact(q1)),Real(t[n]));
+		exact64.addError(rotationAngle(normalize(exact(slerp(q0,q1,t[n]))),reference));
+		fast64.addError(rotationAngle(normalize(exact(fastSlerp(q0,q1,t[n]))),reference));
+		linear64.addError(rotationAngle(normalize(exact(nlerp(q0,q1,t[n]))),reference));
+		batch64.addError(rotationAngle(normalize(exact(batch.get(n))),reference));
+
+		firstF.push_back(QuaternionF(q0));
+		secondF.push_back(QuaternionF(q1));
+		tF.push_back(float(t[n]));
+	}
+	QuaternionBatchF batchF;
+	fastSlerp(QuaternionBatchF(firstF),QuaternionBatchF(secondF),tF.data(),batchF);
+	for (std::size_t n=0;n<pairs.size();++n){
+		const QuaternionF &q0=firstF[n], &q1=secondF[n];
+		const Exact reference=slerp(normalize(exact(q0)),normalize(exact(q1)),Real(tF[n]));
+		exact32.addError(rotationAngle(normalize(exact(slerp(q0,q1,tF[n]))),reference));
+		fast32.addError(rotationAngle(normalize(exact(fastSlerp(q0,q1,tF[n]))),reference));
+		batch32.addError(rotationAngle(normalize(exact(batchF.get(n))),reference));
+	}
+	exact64.report();
+	fast64.report();
+	linear64.report();
+	batch64.report();
+	exact32.report();
+	fast32.report();
+	batch32.report();
+}
+
+// === Gyroscope integration (Integration.h) ===
+TEST_CASE("Accuracy of the gyroscope integration"){
+	if (!referenceIsPrecise()){
+		return;
+	}
+	printHeader("Gyroscope integration (Integration.h), as the angle to the same scheme in long double");
+
+	// Rates from nothing to over the range of the polynomial steps of the
+	// batch version (half angles up to 0.5 rad per sample), which then fall
+	// back to exp, changing a little from sample to sample
+	const std::size_t sensors=300, samples=200;
+	const double dt=0.01;
+	std::mt19937 generator(17);
+	std::uniform_real_distribution<double> exponent(-3.0,2.05), wobble(-0.05,0.05);
+	std::normal_distribution<double> direction;
+	GyroSamples rates(sensors,samples);
+	for (std::size_t sensor=0;sensor<sensors;++sensor){
+		const double speed=std::pow(10.0,exponent(generator));
+		const Quaternion axis=normalize(Quaternion(0,direction(generator),direction(generator),direction(generator)));
+		for (std::size_t sample=0;sample<samples;++sample){
+			const double scale=speed*(1.0+wobble(generator));
+			rates.set(sample,sensor,Vector3{scale*axis.i(),scale*axis.j(),scale*axis.k()});
+		}
+	}
+	std::vector<Quaternion> starts=randomRotations(sensors,18);
+	starts.resize(sensors); // Without the edge cases that randomRotations adds
+
+	for (IntegrationScheme scheme : {integrateFirstOrder,integrateMagnus}){
+		const std::string name= scheme==integrateFirstOrder ? "first order" : "Magnus";
+		// Every step rounds a little, so the budgets allow an epsilon per step
+		const double budget=(samples-1)*std::numeric_limits<double>::epsilon();
+		ErrorStats single("integrate "+name,"angle",budget,unitRadian), batch("integrate batch "+name,"angle",budget,unitRadian);
+		QuaternionBatch orientations(starts);
+		integrate(rates,dt,scheme,orientations);
+		for (std::size_t sensor=0;sensor<sensors;++sensor){
+			std::vector<Vector3> sensorRates(samples);
+			Exact reference=exact(starts[sensor]);
+			for (std::size_t sample=0;sample<samples;++sample){
+				sensorRates[sample]=rates.get(sample,sensor);
+			}
+			for (std::size_t step=0;step+1<samples;++step){
+				const Vector3 &a=sensorRates[step], &b=sensorRates[step+1];
+				Real px, py, pz;
+				if (scheme==integrateFirstOrder){
+					px=Real(a.x)*dt; py=Real(a.y)*dt; pz=Real(a.z)*dt;
+				}else{
+					// Average rate plus the coning correction (a x b)*dt^2/12
+					const Real coning=Real(dt)*dt/12;
+					px=Real(dt)/2*(Real(a.x)+b.x)+coning*(Real(a.y)*b.z-Real(a.z)*b.y);
+					py=Real(dt)/2*(Real(a.y)+b.y)+coning*(Real(a.z)*b.x-Real(a.x)*b.z);
+					pz=Real(dt)/2*(Real(a.z)+b.z)+coning*(Real(a.x)*b.y-Real(a.y)*b.x);
+				}
+				reference=normalize(reference*exp(Exact{0,px/2,py/2,pz/2}));
+			}
+			const Quaternion computed=integrate(starts[sensor],sensorRates.data(),samples,dt,scheme);
+			single.addError(rotationAngle(normalize(exact(computed)),reference));
+			batch.addError(rotationAngle(normalize(exact(orientations.get(sensor))),reference));
+		}
+		single.report();
+		batch.report();
+	}
+}
+
+// === Batch kernels, in every instruction set (QuaternionBatch.h, Rotation.h, Dispatch.h) ===
+TEST_CASE("Accuracy of the batch kernels"){
+	if (!referenceIsPrecise()){
+		return;
+	}
+	const InstructionSet original=activeInstructionSet();
+
+	const std::vector<Quaternion> quaternions=allQuaternions(8);
+	const std::vector<std::pair<Quaternion,Quaternion> > pairs=quaternionPairs(9);
+	std::vector<Quaternion> left, right;
+	for (const auto &pair : pairs){
+		left.push_back(pair.first);
+		right.push_back(pair.second);
+	}
+	const std::vector<QuaternionF> quaternionsF=floatQuaternions(20000,19), othersF=floatQuaternions(20000,20);
+	const std::vector<Quaternion> rotations=randomRotations(5000,10);
+	const std::vector<Vector3> points=randomPoints(rotations.size()-3,11); // randomPoints adds 3
+	PointCloud cloud(points.size());
+	for (std::size_t n=0;n<points.size();++n){
+		cloud.set(n,points[n]);
+	}
+
+	for (int isa=0;isa<isaCount;++isa){
+		if (!setInstructionSet(InstructionSet(isa))){
+			continue;
+		}
+		const std::string suffix=std::string(" [")+instructionSetName(InstructionSet(isa))+"]";
+		printHeader(("Batch kernels"+suffix).c_str());
+
+		ErrorStats product("multiply"+suffix,"|q1||q2|",4.0), length("norm"+suffix,"|q|",3.0),
+				normalization("normalize"+suffix,"1",2.0), fast("fastNormalize"+suffix,"1",2.0),
+				rotation("rotate(q,cloud)"+suffix,"|p|",6.0), matrix("rotate(M,cloud)"+suffix,"|p|",8.0),
+				batchRotation("rotate(batch,cloud)"+suffix,"|p|",6.0),
+				productF("multiply float"+suffix,"|q1||q2|",4.0,unitFloat), lengthF("norm float"+suffix,"|q|",3.0,unitFloat),
+				normalizationF("normalize float"+suffix,"1",2.0,unitFloat), fastF("fastNormalize float"+suffix,"1",2.0,unitFloat);
+
+		const QuaternionBatch q1(left), q2(right), single(quaternions);
+		QuaternionBatch out;
+		multiply(q1,q2,out);
+		for (std::size_t n=0;n<pairs.size();++n){
+			const Exact e1=exact(left[n]), e2=exact(right[n]);
+			product.add(out.get(n),e1*e2,norm(e1)*norm(e2));
+		}
+		std::vector<double> norms(single.size());
+		norm(single,norms.data());
+		normalize(single,out);
+		QuaternionBatch fastOut;
+		fastNormalize(single,fastOut);
+		for (std::size_t n=0;n<quaternions.size();++n){
+			const Exact e=exact(quaternions[n]);
+			const Real size=norm(e);
+			length.add(norms[n],size,size);
+			normalization.add(out.get(n),(1/size)*e,1);
+			fast.add(fastOut.get(n),(1/size)*e,1);
+		}
+
+		// One rotation for the whole cloud, then one per point
+		PointCloud rotated;
+		for (std::size_t r=0;r<rotations.size();r+=500){
+			const Quaternion &q=rotations[r];
+			rotate(q,cloud,rotated);
+			for (std::size_t n=0;n<points.size();++n){
+				const Vector3 &p=points[n], o=rotated.get(n);
+				rotation.add(Quaternion(0,o.x,o.y,o.z),exactRotation(q,p),std::sqrt(Real(p.x)*p.x+Real(p.y)*p.y+Real(p.z)*p.z));
+			}
+			rotate(toMatrix(q),cloud,rotated);
+			for (std::size_t n=0;n<points.size();++n){
+				const Vector3 &p=points[n], o=rotated.get(n);
+				matrix.add(Quaternion(0,o.x,o.y,o.z),exactRotation(q,p),std::sqrt(Real(p.x)*p.x+Real(p.y)*p.y+Real(p.z)*p.z));
+			}
+		}
+		const QuaternionBatch perPoint(std::vector<Quaternion>(rotations.begin(),rotations.begin()+points.size()));
+		rotate(perPoint,cloud,rotated);
+		for (std::size_t n=0;n<points.size();++n){
+			const Vector3 &p=points[n], o=rotated.get(n);
+			batchRotation.add(Quaternion(0,o.x,o.y,o.z),exactRotation(rotations[n],p),std::sqrt(Real(p.x)*p.x+Real(p.y)*p.y+Real(p.z)*p.z));
+		}
+
+		// The float kernels (products out of the range of float are left out)
+		const QuaternionBatchF f1(quaternionsF), f2(othersF);
+		QuaternionBatchF outF, fastOutF;
+		multiply(f1,f2,outF);
+		std::vector<float> normsF(f1.size());
+		norm(f1,normsF.data());
+		for (std::size_t n=0;n<quaternionsF.size();++n){
+			const Exact e1=exact(quaternionsF[n]), e2=exact(othersF[n]);
+			const Real size=norm(e1);
+			if (size*norm(e2)>1e-30L && size*norm(e2)<1e30L){
+				productF.add(outF.get(n),e1*e2,size*norm(e2));
+			}
+			lengthF.add(normsF[n],size,size);
+		}
+		normalize(f1,outF);
+		fastNormalize(f1,fastOutF);
+		for (std::size_t n=0;n<quaternionsF.size();++n){
+			const Exact e=exact(quaternionsF[n]);
+			const Real size=norm(e);
+			normalizationF.add(outF.get(n),(1/size)*e,1);
+			fastF.add(fastOutF.get(n),(1/size)*e,1);
+		}
+
+		product.report();
+		length.report();
+		normalization.report();
+		fast.report();
+		productF.report();
+		lengthF.report();
+		normalizationF.report();
+		fastF.report();
+		rotation.report();
+		matrix.report();
+		batchRotation.report();
+	}
+	setInstructionSet(original);
+}
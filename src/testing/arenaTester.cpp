@@ -0,0 +1,111 @@
+/*
+ * arenaTester.cpp
+ *
+ * \brief Unit tests for the thread-local arenas and the arena-backed SparseQuaternion
+ * \author Nikos Kazazakis
+ */
+
+#include "ArenaAllocator.h"
+#include "SparseQuaternion.h"
+#include <catch.hpp>
+
+#include <omp.h>
+#include <vector>
+
+using namespace Quaternions;
+
+TEST_CASE("Test arena allocation"){
+	QuaternionArena arena(1024);
+	REQUIRE(arena.blockCount()==0);
+
+	// Every allocation is aligned as requested
+	for (std::size_t alignment : {1,2,8,16,64}){
+		void *memory=arena.allocate(3,alignment);
+		REQUIRE(reinterpret_cast<std::uintptr_t>(memory)%alignment==0);
+	}
+	REQUIRE(arena.blockCount()==1);
+
+	// Fill the first block: the arena moves on to a second one
+	char *first=static_cast<char*>(arena.allocate(1000,1));
+	REQUIRE(arena.blockCount()==2);
+
+	// Requests larger than a block get a block of their own
+	arena.allocate(4096,8);
+	REQUIRE(arena.blockCount()==3);
+	REQUIRE(arena.bytesUsed()==5*3+1000+4096);
+
+	// Reset releases everything but keeps the blocks
+	arena.reset();
+	REQUIRE(arena.bytesUsed()==0);
+	REQUIRE(arena.blockCount()==3);
+	arena.allocate(900,1);
+	REQUIRE(static_cast<char*>(arena.allocate(1000,1))==first); // The second block is reused
+	REQUIRE(arena.blockCount()==3);
+}
+
+TEST_CASE("Test arena scopes"){
+	REQUIRE(currentArena()==nullptr);
+	QuaternionArena outer, inner;
+	{
+		ArenaScope outerScope(outer);
+		REQUIRE(currentArena()==&outer);
+		{
+			ArenaScope innerScope(inner);
+			REQUIRE(currentArena()==&inner);
+		}
+		REQUIRE(currentArena()==&outer);
+
+		// Every thread has its own current arena
+		std::vector<int> usesArena(4,-1);
+		#pragma omp parallel num_threads(4)
+		{
+			if (omp_get_thread_num()>0){
+				usesArena[omp_get_thread_num()]=(currentArena()!=nullptr);
+			}
+		}
+		for (std::size_t thread=1;thread<usesArena.size();++thread){
+			REQUIRE(usesArena[thread]!=1);
+		}
+	}
+	REQUIRE(currentArena()==nullptr);
+}
+
+TEST_CASE("Test arena-backed sparse quaternions"){
+	const SparseQuaternion q1 = SparseQuaternion(1,0,1,0);
+	const SparseQuaternion q2 = SparseQuaternion(1,0.5,0.5,0.75);
+	REQUIRE(q1.arena()==nullptr);
+
+	// On the heap: the product allocates its 4 elements, and frees them
+	const SparseQuaternion expected = SparseQuaternion(0.5, 1.25, 1.5, 0.25);
+	resetAllocationCounters();
+	{
+		SparseQuaternion q = q1*q2;
+		REQUIRE(q==expected);
+	}
+	REQUIRE(allocationCounters().allocations==4);
+	REQUIRE(allocationCounters().arenaAllocations==0);
+	REQUIRE(allocationCounters().deallocations==4);
+
+	// In an arena: the same results, with no heap allocations
+	QuaternionArena arena;
+	resetAllocationCounters();
+	{
+		ArenaScope scope(arena);
+		SparseQuaternion q = q1*q2+q1;
+		REQUIRE(q.arena()==&arena);
+		REQUIRE(q==SparseQuaternion(1.5, 1.25, 2.5, 0.25));
+	}
+	REQUIRE(allocationCounters().allocations==allocationCounters().arenaAllocations);
+	REQUIRE(allocationCounters().deallocations==0);
+	REQUIRE(arena.bytesUsed()>0);
+
+	// Quaternions constructed outside the scope keep using the heap
+	SparseQuaternion result;
+	{
+		ArenaScope scope(arena);
+		result=q1*q2;
+	}
+	arena.reset();
+	REQUIRE(result.arena()==nullptr);
+	REQUIRE(result==expected);
+}
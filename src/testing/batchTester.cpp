@@ -0,0 +1,72 @@
+/*
+ * batchTester.cpp
+ *
+ * \brief Unit tests for the structure-of-arrays QuaternionBatch kernels
+ * \author Nikos Kazazakis
+ */
+
+#include "QuaternionBatch.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <cstdint>
+
+using namespace Quaternions;
+
+TEST_CASE("Test quaternion batch conversion"){
+	std::vector<Quaternion> quaternions=randomQuaternions(37,1);
+	QuaternionBatch batch(quaternions);
+
+	REQUIRE(batch.size()==37);
+	REQUIRE(batch.get(5)==quaternions[5]);
+	REQUIRE(batch.toVector()==quaternions);
+	// Component arrays are aligned for vector loads
+	REQUIRE(reinterpret_cast<std::uintptr_t>(batch.k())%kBatchAlignment==0);
+
+	batch.set(3,Quaternion(1,2,3,4));
+	REQUIRE(batch.i()[3]==2.0);
+}
+
+TEST_CASE("Test quaternion batch kernels match the scalar operators"){
+	const std::size_t size=1001;
+	std::vector<Quaternion> a=randomQuaternions(size,2);
+	std::vector<Quaternion> b=randomQuaternions(size,3);
+	QuaternionBatch q1(a), q2(b), out;
+	std::vector<double> norms(size);
+
+	multiply(q1,q2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==a[n]*b[n]);}
+	add(q1,q2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==a[n]+b[n]);}
+	subtract(q1,q2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==a[n]-b[n]);}
+	scale(q1,2.5,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==2.5*a[n]);}
+	conjugate(q1,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==a[n].conjugate());}
+	norm(q1,norms.data());
+	for (std::size_t n=0;n<size;++n){REQUIRE(norms[n]==a[n].norm());}
+
+	// In-place use
+	multiply(q1,q2,q1);
+	for (std::size_t n=0;n<size;++n){REQUIRE(q1.get(n)==a[n]*b[n]);}
+}
+
+TEST_CASE("Test single precision quaternion batch kernels"){
+	const std::size_t size=257;
+	std::vector<QuaternionF> a(size), b(size);
+	std::vector<Quaternion> reference=randomQuaternions(2*size,4);
+	for (std::size_t n=0;n<size;++n){
+		a[n]=QuaternionF(reference[n]);
+		b[n]=QuaternionF(reference[size+n]);
+	}
+	QuaternionBatchF q1(a), q2(b), out;
+	std::vector<float> norms(size);
+
+	multiply(q1,q2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==QuaternionF(a[n]*b[n]));}
+	scale(q1,2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==2*a[n]);}
+	norm(q1,norms.data());
+	for (std::size_t n=0;n<size;++n){REQUIRE(norms[n]==a[n].norm());}
+}
@@ -0,0 +1,198 @@
+/*
+ * comparisonTester.cpp
+ *
+ * \brief Unit tests for approximate comparisons and angular distances
+ * \author Nikos Kazazakis
+ */
+
+#include "Comparison.h"
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace Quaternions;
+
+// Rotations about z
+static Quaternion rotationZ(double angle)
+{
+	return Quaternion(std::cos(angle/2),0,0,std::sin(angle/2));
+}
+
+TEST_CASE("Test approximate equality"){
+	const Quaternion q(0.5,-0.5,0.5,0.5);
+	const Quaternion close(0.5+1e-13,-0.5,0.5,0.5-1e-13);
+	REQUIRE(!(q==close));
+	REQUIRE(approxEqual(q,close,1e-12));
+	REQUIRE(!approxEqual(q,close,1e-14));
+	REQUIRE(approxEqual(q,q,0.0));
+	// Expressions
+	REQUIRE(approxEqual(q*close,q*q,1e-12));
+
+	SECTION("Relative tolerances scale with the norm"){
+		const Quaternion large=1e6*q, largeClose=1e6*close;
+		REQUIRE(!approxEqual(large,largeClose,1e-12));
+		REQUIRE(approxEqual(large,largeClose,1e-12,toleranceRelative));
+		REQUIRE(!approxEqual(large,largeClose,1e-14,toleranceRelative));
+		// Zero components compare against the norm, not themselves
+		REQUIRE(approxEqual(Quaternion(1,0,0,0),Quaternion(1,1e-17,0,0),1e-16,toleranceRelative));
+	}
+
+	SECTION("Ulp tolerances count floating point values"){
+		Quaternion next=q;
+		next[qw]=std::nextafter(q.w(),2.0);
+		next[qk]=std::nextafter(std::nextafter(q.k(),0.0),0.0);
+		REQUIRE(approxEqual(q,next,2.0,toleranceUlps));
+		REQUIRE(!approxEqual(q,next,1.0,toleranceUlps));
+		// Across zero
+		REQUIRE(approxEqual(Quaternion(0.0,0,0,0),Quaternion(-0.0,0,0,0),0.0,toleranceUlps));
+		const double tiny=std::numeric_limits<double>::denorm_min();
+		REQUIRE(approxEqual(Quaternion(tiny,0,0,0),Quaternion(-tiny,0,0,0),2.0,toleranceUlps));
+		REQUIRE(!approxEqual(Quaternion(tiny,0,0,0),Quaternion(-tiny,0,0,0),1.0,toleranceUlps));
+		// Float and long double
+		const QuaternionF f(0.5f,0.5f,0.5f,0.5f);
+		REQUIRE(approxEqual(f,QuaternionF(std::nextafter(0.5f,1.0f),0.5f,0.5f,0.5f),1.0f,toleranceUlps));
+		const QuaternionL l(0.5L,0.5L,0.5L,0.5L);
+		const QuaternionL lNext(std::nextafter(0.5L,1.0L),0.5L,0.5L,0.5L);
+		REQUIRE(approxEqual(l,lNext,1.0L,toleranceUlps));
+		REQUIRE(!approxEqual(l,QuaternionL(std::nextafter(lNext.w(),1.0L),0.5L,0.5L,0.5L),1.0L,toleranceUlps));
+	}
+
+	SECTION("Rotations: q and -q are equal"){
+		const Quaternion negated=-1.0*close;
+		REQUIRE(!approxEqual(q,negated,1e-12));
+		REQUIRE(approxEqual(q,negated,1e-12,toleranceAbsolute,compareRotations));
+		REQUIRE(approxEqual(q,negated,1e-12,toleranceRelative,compareRotations));
+		REQUIRE(approxEqual(q,-1.0*q,0.0,toleranceUlps,compareRotations));
+		REQUIRE(!approxEqual(q,q.conjugate(),1e-12,toleranceAbsolute,compareRotations));
+	}
+
+	SECTION("NaN is never equal"){
+		const double nan=std::numeric_limits<double>::quiet_NaN();
+		const Quaternion broken(nan,0,0,0);
+		REQUIRE(!approxEqual(broken,broken,1.0));
+		REQUIRE(!approxEqual(broken,broken,1.0,toleranceRelative));
+		REQUIRE(!approxEqual(broken,broken,1e18,toleranceUlps,compareRotations));
+	}
+}
+
+TEST_CASE("Test angular distance"){
+	REQUIRE(angularDistance(rotationZ(0.3),rotationZ(1.0))==Approx(0.7).epsilon(1e-14));
+	REQUIRE(angularDistance(rotationZ(1.0),rotationZ(0.3))==Approx(0.7).epsilon(1e-14));
+	// The same rotation, with the opposite sign
+	REQUIRE(angularDistance(rotationZ(0.3),-1.0*rotationZ(0.3))==0.0);
+	REQUIRE(angularDistance(rotationZ(0.3),rotationZ(0.3+2*std::acos(-1.0)))<1e-15);
+	// Rotating by more than a half turn is rotating the other way, by less
+	REQUIRE(angularDistance(rotationZ(-2.0),rotationZ(2.0))==Approx(2*std::acos(-1.0)-4.0).epsilon(1e-14));
+	REQUIRE(angularDistance(Quaternion(1,0,0,0),Quaternion(0,1,0,0))==Approx(std::acos(-1.0)).epsilon(1e-15));
+	// Tiny angles keep their precision
+	for (double angle : {1e-6,1e-9,1e-12}){
+		REQUIRE(angularDistance(rotationZ(0.4),rotationZ(0.4+angle))==Approx(angle).epsilon(1e-3));
+	}
+	REQUIRE(angularDistance(rotationZ(0.4),Quaternion(rotationZ(0.4)))==0.0);
+}
+
+template <typename T>
+static void testBatchComparisons()
+{
+	typedef BasicQuaternion<T> Q;
+	const std::size_t size=1003;
+	std::mt19937 generator(8);
+	std::uniform_real_distribution<T> distribution(-1,1);
+	std::uniform_int_distribution<int> kind(0,5);
+	const T epsilon=std::numeric_limits<T>::epsilon();
+
+	// Pairs that are exactly equal, a few ulps apart, slightly apart, negated, far apart or NaN
+	std::vector<Q> first(size), second(size);
+	for (std::size_t n=0;n<size;++n){
+		const Q q=normalize(Q(distribution(generator),distribution(generator),distribution(generator),distribution(generator)));
+		first[n]=q;
+		Q other=q;
+		switch (kind(generator)){
+		case 1:
+			other[qi]=std::nextafter(std::nextafter(q.i(),T(2)),T(2));
+			break;
+		case 2:
+			other[qj]+=T(50)*epsilon;
+			break;
+		case 3:
+			other=T(-1)*Q(q.w(),q.i(),q.j()+T(20)*epsilon,q.k());
+			break;
+		case 4:
+			other[qk]+=T(0.1);
+			break;
+		case 5:
+			if (n%7==0){
+				other[qw]=std::numeric_limits<T>::quiet_NaN();
+			}
+			break;
+		}
+		second[n]=other;
+	}
+	const BasicQuaternionBatch<T> q1(first), q2(second);
+
+	struct Tolerance{ T value; ToleranceType type; };
+	const Tolerance tolerances[]={{T(30)*epsilon,toleranceAbsolute},{T(30)*epsilon,toleranceRelative},{T(4),toleranceUlps},{T(1e6),toleranceUlps}};
+	for (const Tolerance &tolerance : tolerances){
+		for (ComparisonMode mode : {compareQuaternions,compareRotations}){
+			std::vector<std::uint8_t> equal(size,2);
+			const std::size_t mismatches=compare(q1,q2,tolerance.value,tolerance.type,mode,equal.data());
+			std::vector<std::size_t> expected;
+			for (std::size_t n=0;n<size;++n){
+				const bool same=approxEqual(first[n],second[n],tolerance.value,tolerance.type,mode);
+				REQUIRE(equal[n]==(same ? 1 : 0));
+				if (!same){
+					expected.push_back(n);
+				}
+			}
+			REQUIRE(mismatches==expected.size());
+			REQUIRE(findMismatches(q1,q2,tolerance.value,tolerance.type,mode)==expected);
+			// Every kind of pair shows up, so neither answer is trivial
+			REQUIRE(mismatches>0);
+			REQUIRE(mismatches<size);
+		}
+	}
+
+	// Angular distances
+	std::vector<T> distances(size);
+	angularDistance(q1,q2,distances.data());
+	double maximum=0.0, sum=0.0, squares=0.0;
+	std::size_t worst=0;
+	for (std::size_t n=0;n<size;++n){
+		const T expected=angularDistance(first[n],second[n]);
+		if (expected!=expected){
+			REQUIRE(distances[n]!=distances[n]); // NaN in, NaN out
+			continue;
+		}
+		REQUIRE(distances[n]==expected);
+		sum+=distances[n];
+		squares+=double(distances[n])*distances[n];
+		if (distances[n]>maximum){
+			maximum=distances[n];
+			worst=n;
+		}
+	}
+
+	// Stats over the pairs without NaN
+	std::vector<Q> firstValid, secondValid;
+	for (std::size_t n=0;n<size;++n){
+		if (second[n].w()==second[n].w()){
+			firstValid.push_back(first[n]);
+			secondValid.push_back(second[n]);
+		}
+	}
+	const AngularDistanceStats stats=angularDistanceStats(BasicQuaternionBatch<T>(firstValid),BasicQuaternionBatch<T>(secondValid));
+	REQUIRE(stats.maximum==Approx(maximum).epsilon(1e-12));
+	REQUIRE(secondValid[stats.worst]==second[worst]);
+	REQUIRE(stats.mean==Approx(sum/firstValid.size()).epsilon(1e-12));
+	REQUIRE(stats.rms==Approx(std::sqrt(squares/firstValid.size())).epsilon(1e-12));
+
+	const AngularDistanceStats empty=angularDistanceStats(BasicQuaternionBatch<T>(),BasicQuaternionBatch<T>());
+	REQUIRE(empty.maximum==0.0);
+	REQUIRE(empty.mean==0.0);
+}
+
+TEST_CASE("Test batch comparisons match the scalar comparisons"){
+	testBatchComparisons<double>();
+	testBatchComparisons<float>();
+}
@@ -0,0 +1,110 @@
+/*
+ * compositionTester.cpp
+ *
+ * \brief Unit tests for the parallel rotation composition
+ * \author Nikos Kazazakis
+ */
+
+#include "Composition.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <omp.h>
+#include <vector>
+
+using namespace Quaternions;
+
+// The naive serial chain q[0]*q[1]*...
+static std::vector<Quaternion> serialScan(const std::vector<Quaternion> &quaternions)
+{
+	std::vector<Quaternion> out(quaternions.size());
+	Quaternion product = Quaternion(1,0,0,0);
+	for (std::size_t n=0;n<quaternions.size();++n){
+		product=product*quaternions[n];
+		out[n]=product;
+	}
+	return out;
+}
+
+TEST_CASE("Test serial composition"){
+	REQUIRE(compose(std::vector<Quaternion>())==Quaternion(1,0,0,0));
+	REQUIRE(compose(std::vector<Quaternion>{Quaternion(1,2,3,4)})==Quaternion(1,2,3,4));
+
+	// Short sequences are exactly the chain
+	const std::vector<Quaternion> quaternions=randomRotations(1000,1);
+	const std::vector<Quaternion> reference=serialScan(quaternions);
+	REQUIRE(compose(quaternions)==reference.back());
+	REQUIRE(composeScan(quaternions)==reference);
+
+	// The product is not commutative: the order must be kept
+	const Quaternion q1 = Quaternion(0,1,0,0), q2 = Quaternion(0,0,1,0);
+	REQUIRE(compose(std::vector<Quaternion>{q1,q2})==q1*q2);
+	REQUIRE(compose(std::vector<Quaternion>{q2,q1})==q2*q1);
+}
+
+TEST_CASE("Test parallel composition"){
+	const int threads=omp_get_max_threads();
+	omp_set_num_threads(4); // Exercise the chunking even on machines with fewer cores
+
+	const std::size_t size=100003; // Not a multiple of the thread count
+	const std::vector<Quaternion> quaternions=randomRotations(size,2);
+	const std::vector<Quaternion> reference=serialScan(quaternions);
+
+	// Reassociation only changes the rounding
+	REQUIRE(Quaternion(compose(quaternions)-reference.back()).norm()<1e-11);
+
+	std::vector<Quaternion> scan=composeScan(quaternions);
+	for (std::size_t n=0;n<size;++n){
+		REQUIRE(Quaternion(scan[n]-reference[n]).norm()<1e-11);
+	}
+
+	// In place
+	std::vector<Quaternion> inPlace=quaternions;
+	composeScan(inPlace.data(),size,inPlace.data());
+	REQUIRE(inPlace==scan);
+
+	// Single and extended precision
+	std::vector<QuaternionF> single(size);
+	std::vector<QuaternionL> extended(size);
+	for (std::size_t n=0;n<size;++n){
+		single[n]=QuaternionF(quaternions[n]);
+		extended[n]=quaternions[n];
+	}
+	REQUIRE(Quaternion(compose(single)-reference.back()).norm()<1e-2);
+	REQUIRE(Quaternion(QuaternionL(compose(extended)-reference.back())).norm()<1e-11);
+
+	omp_set_num_threads(threads);
+}
+
+TEST_CASE("Test renormalized composition"){
+	const int threads=omp_get_max_threads();
+	omp_set_num_threads(4);
+
+	// Slightly too long quaternions, as produced by a drifting integrator
+	const std::size_t size=100000;
+	std::vector<Quaternion> quaternions=randomRotations(size,3);
+	for (auto &q : quaternions){
+		q=(1.0+1e-7)*q;
+	}
+
+	// Without renormalization the norm grows as (1+1e-7)^n
+	const Quaternion drifted=compose(quaternions);
+	REQUIRE(std::abs(drifted.norm()-std::pow(1.0+1e-7,double(size)))<1e-9);
+
+	// With renormalization the result is the unit quaternion of the same product
+	for (std::size_t every : {std::size_t(1),std::size_t(64),size}){
+		const Quaternion q=compose(quaternions,every);
+		REQUIRE(std::abs(q.norm()-1.0)<1e-15);
+		REQUIRE(Quaternion(q-(1.0/drifted.norm())*drifted).norm()<1e-11);
+
+		// The drift of the prefix products is bounded by that of "every" products
+		const std::vector<Quaternion> scan=composeScan(quaternions,every);
+		const double maxDrift=std::pow(1.0+1e-7,double(every))-1.0+1e-13;
+		for (std::size_t n=0;n<size;++n){
+			REQUIRE(std::abs(scan[n].norm()-1.0)<maxDrift);
+		}
+		REQUIRE(Quaternion((1.0/scan.back().norm())*scan.back()-q).norm()<1e-11);
+	}
+
+	omp_set_num_threads(threads);
+}
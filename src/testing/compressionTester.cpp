@@ -0,0 +1,174 @@
+/*
+ * compressionTester.cpp
+ *
+ * \brief Unit tests for the compact quaternion encodings
+ * \author Nikos Kazazakis
+ */
+
+#include "Compression.h"
+#include "Comparison.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace Quaternions;
+
+// Bit for bit equality (so that NaN and -0 count)
+static bool sameBits(const Quaternion &q1, const Quaternion &q2)
+{
+	return std::memcmp(&q1,&q2,sizeof(Quaternion))==0;
+}
+
+// Checks one smallest-three format: the single and bulk versions agree bit
+// for bit, every decoded value is a unit quaternion, and the angular error is
+// within the documented bound
+template <typename Format, typename Encode>
+static void testSmallestThree(Encode encodeOne, double bound)
+{
+	// Random rotations, plus the ones on the edges: axes and ties
+	std::vector<Quaternion> rotations=randomRotations(20000,11);
+	const double half=std::sqrt(0.5);
+	for (const Quaternion &q : {Quaternion(1,0,0,0),Quaternion(0,-1,0,0),Quaternion(0,0,0,1),Quaternion(half,0,-half,0),
+			Quaternion(0.5,0.5,-0.5,0.5),Quaternion(-0.5,-0.5,-0.5,-0.5),normalize(Quaternion(0.1,0.2,0.3,0.4))}){
+		rotations.push_back(q);
+	}
+	const std::vector<Format> packed=encode<Format>(rotations);
+	const std::vector<Quaternion> decoded=decode(packed);
+	REQUIRE(decoded.size()==rotations.size());
+
+	for (std::size_t n=0;n<rotations.size();++n){
+		const Format single=encodeOne(rotations[n]);
+		REQUIRE(std::memcmp(&single,&packed[n],sizeof(Format))==0);
+		REQUIRE(sameBits(decode(single),decoded[n]));
+		const Quaternion &q=decoded[n];
+		REQUIRE(std::abs(q.norm()-1.0)<1e-15);
+		// The sign is that of the input with its largest component (the first, on ties) made positive
+		const Quaternion &input=rotations[n];
+		AxisType largest=qw;
+		for (AxisType axis : {qi,qj,qk}){
+			if (std::abs(input[axis])>std::abs(input[largest])){
+				largest=axis;
+			}
+		}
+		REQUIRE(dot(input,q)*input[largest]>0.0);
+		REQUIRE(angularDistance(rotations[n],q)<=bound);
+	}
+	// Exact rotations about an axis stay exact
+	REQUIRE(decoded[20000]==Quaternion(1,0,0,0));
+	REQUIRE(decoded[20001]==Quaternion(0,1,0,0));
+
+	// Encoding normalizes, and doesn't care about the sign
+	const Quaternion q=rotations[7];
+	const Format scaled=encodeOne(3.0*q), negated=encodeOne(-1.0*q);
+	REQUIRE(std::memcmp(&scaled,&packed[7],sizeof(Format))==0);
+	REQUIRE(std::memcmp(&negated,&packed[7],sizeof(Format))==0);
+
+	// The zero quaternion and NaN decode to the identity
+	REQUIRE(decode(encodeOne(Quaternion(0,0,0,0)))==Quaternion(1,0,0,0));
+	const double nan=std::numeric_limits<double>::quiet_NaN();
+	REQUIRE(decode(encodeOne(Quaternion(nan,nan,nan,nan)))==Quaternion(1,0,0,0));
+}
+
+TEST_CASE("Test smallest-three encodings"){
+	SECTION("32 bits"){
+		testSmallestThree<SmallestThree32>([](const Quaternion &q){return encode32(q);},4.8e-3);
+		// The layout: the index of the largest component in the top 2 bits
+		REQUIRE(encode32(Quaternion(0,0,1,0)).bits>>30==2);
+		REQUIRE(encode32(Quaternion(1,0,0,0)).bits==((511u<<20) | (511u<<10) | 511u));
+	}
+	SECTION("48 bits"){
+		testSmallestThree<SmallestThree48>([](const Quaternion &q){return encode48(q);},1.5e-4);
+		const SmallestThree48 packed=encode48(Quaternion(0,0,0,-1));
+		REQUIRE(packed.bits[2]>>13==3);
+		REQUIRE(packed.bits[0]==(16383 | (1<<15)));
+	}
+	SECTION("64 bits"){
+		testSmallestThree<SmallestThree64>([](const Quaternion &q){return encode64(q);},4.7e-6);
+		REQUIRE(encode64(Quaternion(0,-1,0,0)).bits>>60==1);
+	}
+	SECTION("More bits are more accurate"){
+		for (const Quaternion &q : randomRotations(100,12)){
+			const double error32=angularDistance(q,decode(encode32(q)));
+			const double error64=angularDistance(q,decode(encode64(q)));
+			REQUIRE(error64<=error32);
+		}
+	}
+}
+
+TEST_CASE("Test half-float encoding"){
+	using CompressionDetail::toHalf;
+	using CompressionDetail::fromHalf;
+
+	SECTION("Known values"){
+		REQUIRE(toHalf(1.0)==0x3C00);
+		REQUIRE(toHalf(-2.0)==0xC000);
+		REQUIRE(toHalf(0.5)==0x3800);
+		REQUIRE(toHalf(65504.0)==0x7BFF);
+		REQUIRE(toHalf(0.0)==0x0000);
+		REQUIRE(toHalf(-0.0)==0x8000);
+		REQUIRE(toHalf(1.0/3.0)==0x3555);
+		REQUIRE(fromHalf(0x3555)==0.333251953125);
+		REQUIRE(fromHalf(0x7BFF)==65504.0);
+		REQUIRE(fromHalf(0xC000)==-2.0);
+	}
+
+	SECTION("Rounding to nearest, ties to even"){
+		const double ulp=1.0/1024; // Of halves in [1,2)
+		REQUIRE(toHalf(1.0+ulp/2)==0x3C00);
+		REQUIRE(toHalf(1.0+ulp/2+1e-12)==0x3C01);
+		REQUIRE(toHalf(1.0+1.5*ulp)==0x3C02);
+		REQUIRE(toHalf(2.0-ulp/4)==0x4000); // Carries into the exponent
+		REQUIRE(toHalf(65519.0)==0x7BFF);
+		REQUIRE(toHalf(65520.0)==0x7C00);
+	}
+
+	SECTION("Subnormals, infinities and NaN"){
+		const double smallest=5.9604644775390625e-08; // 2^-24
+		REQUIRE(toHalf(smallest)==0x0001);
+		REQUIRE(toHalf(-3*smallest)==0x8003);
+		REQUIRE(toHalf(smallest/2)==0x0000);
+		REQUIRE(toHalf(smallest*0.75)==0x0001);
+		REQUIRE(toHalf(6.103515625e-05-smallest)==0x03FF);
+		REQUIRE(toHalf(6.103515625e-05)==0x0400);
+		REQUIRE(fromHalf(0x0001)==smallest);
+		REQUIRE(fromHalf(0x83FF)==-1023*smallest);
+		REQUIRE(toHalf(std::numeric_limits<double>::infinity())==0x7C00);
+		REQUIRE(toHalf(-1e300)==0xFC00);
+		REQUIRE(fromHalf(0xFC00)==-std::numeric_limits<double>::infinity());
+		REQUIRE((toHalf(std::numeric_limits<double>::quiet_NaN())&0x7FFF)==0x7E00);
+		const double nan=fromHalf(0x7E00);
+		REQUIRE(nan!=nan);
+	}
+
+	SECTION("Every half decodes and encodes back to itself"){
+		for (std::uint32_t bits=0;bits<=0xFFFF;++bits){
+			const std::uint16_t half=static_cast<std::uint16_t>(bits);
+			const double value=fromHalf(half);
+			if (value==value){
+				REQUIRE(toHalf(value)==half);
+			}
+		}
+	}
+
+	SECTION("Bulk and single agree, and rotations stay within the bound"){
+		std::vector<Quaternion> quaternions=randomRotations(20000,13);
+		quaternions.push_back(Quaternion(70000.0,-1e-6,1e-9,0.0));
+		const std::vector<HalfQuaternion> packed=encode<HalfQuaternion>(quaternions);
+		const std::vector<Quaternion> decoded=decode(packed);
+		for (std::size_t n=0;n<quaternions.size();++n){
+			const HalfQuaternion single=encodeHalf(quaternions[n]);
+			REQUIRE(std::memcmp(&single,&packed[n],sizeof(HalfQuaternion))==0);
+			REQUIRE(sameBits(decode(single),decoded[n]));
+			if (n<20000){
+				REQUIRE(angularDistance(quaternions[n],decoded[n])<=9.8e-4);
+				REQUIRE(std::abs(decoded[n].norm()-1.0)<=4.9e-4);
+			}
+		}
+		REQUIRE(decoded.back().w()==std::numeric_limits<double>::infinity());
+		REQUIRE(decoded.back().i()==-17*5.9604644775390625e-08);
+		REQUIRE(decoded.back().j()==0.0);
+	}
+}
@@ -0,0 +1,188 @@
+/*
+ * conversionTester.cpp
+ *
+ * \brief Unit tests for the rotation matrix, axis-angle and Euler angle conversions
+ * \author Nikos Kazazakis
+ */
+
+#include "Conversion.h"
+#include "Rotation.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace Quaternions;
+
+static const double pi=std::acos(-1.0);
+
+// q and -q are the same rotation
+template <typename T>
+static bool sameRotation(const BasicQuaternion<T> &q1, const BasicQuaternion<T> &q2, T tolerance)
+{
+	const BasicQuaternion<T> difference(q1-q2), sum(q1+q2);
+	return std::min(difference.norm(),sum.norm())<tolerance;
+}
+
+TEST_CASE("Test rotation matrix conversion"){
+	// 90 degrees around z
+	const Matrix3 M=toMatrix(Quaternion(std::cos(pi/4),0,0,std::sin(pi/4)));
+	const double expected[3][3]={{0,-1,0},{1,0,0},{0,0,1}};
+	for (int row=0;row<3;++row){
+		for (int column=0;column<3;++column){
+			REQUIRE(std::abs(M(row,column)-expected[row][column])<1e-15);
+		}
+	}
+
+	// Non-unit quaternions give the matrix of their unit quaternion
+	const Matrix3 scaled=toMatrix(Quaternion(3*std::cos(pi/4),0,0,3*std::sin(pi/4)));
+	for (int row=0;row<3;++row){
+		for (int column=0;column<3;++column){
+			REQUIRE(std::abs(scaled(row,column)-M(row,column))<1e-15);
+		}
+	}
+
+	// Round trip
+	for (const Quaternion &q : randomRotations<double>(1000,1)){
+		REQUIRE(sameRotation(fromMatrix(toMatrix(q)),q,1e-14));
+	}
+
+	// Rotations by 180 degrees have a zero trace, where the trace-only formula breaks down
+	const Quaternion halfTurns[]={Quaternion(0,1,0,0),Quaternion(0,0,1,0),Quaternion(0,0,0,1),
+		Quaternion(0,std::sqrt(0.5),std::sqrt(0.5),0),Quaternion(0,0,-std::sqrt(0.5),std::sqrt(0.5))};
+	for (const Quaternion &q : halfTurns){
+		REQUIRE(sameRotation(fromMatrix(toMatrix(q)),q,1e-15));
+	}
+}
+
+TEST_CASE("Test matrix rotation matches quaternion rotation"){
+	std::mt19937 generator(2);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	const std::size_t size=257;
+	const Quaternion q=randomRotations<double>(1,3)[0];
+	const Matrix3 M=toMatrix(q);
+
+	PointCloud points(size), byQuaternion, byMatrix;
+	for (std::size_t n=0;n<size;++n){
+		points.set(n,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+	}
+	rotate(q,points,byQuaternion);
+	rotate(M,points,byMatrix);
+	for (std::size_t n=0;n<size;++n){
+		const Vector3 r=byMatrix.get(n), e=byQuaternion.get(n), single=rotate(M,points.get(n));
+		REQUIRE(std::abs(r.x-e.x)<1e-14);
+		REQUIRE(std::abs(r.y-e.y)<1e-14);
+		REQUIRE(std::abs(r.z-e.z)<1e-14);
+		REQUIRE(single==r);
+	}
+}
+
+TEST_CASE("Test axis-angle conversion"){
+	// 90 degrees around z
+	REQUIRE(sameRotation(fromAxisAngle(0.0,0.0,1.0,pi/2),Quaternion(std::cos(pi/4),0,0,std::sin(pi/4)),1e-15));
+
+	// Any axis length works, also where its squares overflow or underflow
+	REQUIRE(sameRotation(fromAxisAngle(0.0,0.0,1e200,pi/2),Quaternion(std::cos(pi/4),0,0,std::sin(pi/4)),1e-15));
+	REQUIRE(sameRotation(fromAxisAngle(0.0,-1e-200,0.0,pi/2),Quaternion(std::cos(pi/4),0,-std::sin(pi/4),0),1e-15));
+	REQUIRE(sameRotation(fromAxisAngle(3e20f,4e20f,0.0f,float(pi)),QuaternionF(0,0.6f,0.8f,0),1e-6f));
+
+	// The identity has no axis: we return x
+	const AxisAngle identity=toAxisAngle(Quaternion(1,0,0,0));
+	REQUIRE(identity.angle==0.0);
+	REQUIRE(identity.x==1.0);
+
+	// Angles are in [0,pi]: -q gives the same axis and angle as q
+	for (const Quaternion &q : randomRotations<double>(1000,4)){
+		const AxisAngle rotation=toAxisAngle(q), negated=toAxisAngle(Quaternion(-1.0*q));
+		REQUIRE(rotation.angle>=0.0);
+		REQUIRE(rotation.angle<=pi);
+		REQUIRE(std::abs(rotation.x*rotation.x+rotation.y*rotation.y+rotation.z*rotation.z-1.0)<1e-15);
+		REQUIRE(std::abs(rotation.angle-negated.angle)<1e-15);
+		REQUIRE(sameRotation(fromAxisAngle(rotation),q,1e-15));
+	}
+}
+
+TEST_CASE("Test Euler angle conversion"){
+	const EulerOrder orders[]={XYZ,XZY,YXZ,YZX,ZXY,ZYX,XYX,XZX,YXY,YZY,ZXZ,ZYZ};
+
+	// Intrinsic sequences: ZYX is qz*qy*qx
+	const Quaternion yaw=fromAxisAngle(0.0,0.0,1.0,0.3), pitch=fromAxisAngle(0.0,1.0,0.0,0.2), roll=fromAxisAngle(1.0,0.0,0.0,0.1);
+	REQUIRE(sameRotation(fromEuler(0.3,0.2,0.1,ZYX),Quaternion(yaw*pitch*roll),1e-15));
+
+	for (EulerOrder order : orders){
+		// Round trip from random rotations
+		for (const Quaternion &q : randomRotations<double>(500,5)){
+			REQUIRE(sameRotation(fromEuler(toEuler(q,order),order),q,1e-14));
+		}
+
+		// Gimbal lock: the middle angle is 0 or pi (proper) or +-pi/2 (Tait-Bryan)
+		const bool proper=order>=XYX;
+		const double locks[]={proper ? 0.0 : pi/2, proper ? pi : -pi/2};
+		for (double lock : locks){
+			for (double angle : {-2.0,-0.5,0.0,0.7,3.0}){
+				const Quaternion q=fromEuler(angle,lock,0.4,order);
+				const EulerAngles angles=toEuler(q,order);
+				REQUIRE(sameRotation(fromEuler(angles,order),q,1e-14));
+			}
+		}
+	}
+}
+
+template <typename T>
+static void testBatchConversions()
+{
+	const std::size_t size=1001;
+	const std::vector<BasicQuaternion<T> > quaternions=randomRotations<T>(size,6);
+	const BasicQuaternionBatch<T> batch(quaternions);
+
+	// Matrices
+	BasicMatrix3Batch<T> matrices;
+	toMatrix(batch,matrices);
+	BasicQuaternionBatch<T> fromMatrices;
+	fromMatrix(matrices,fromMatrices);
+	REQUIRE(matrices.size()==size);
+	for (std::size_t n=0;n<size;++n){
+		const BasicMatrix3<T> M=toMatrix(quaternions[n]), batched=matrices.get(n);
+		for (int row=0;row<3;++row){
+			for (int column=0;column<3;++column){
+				REQUIRE(batched(row,column)==M(row,column));
+			}
+		}
+		REQUIRE(fromMatrices.get(n)==fromMatrix(M));
+	}
+
+	// Axis-angle
+	std::vector<T> x(size), y(size), z(size), angle(size);
+	toAxisAngle(batch,x.data(),y.data(),z.data(),angle.data());
+	BasicQuaternionBatch<T> fromAxes;
+	fromAxisAngle(x.data(),y.data(),z.data(),angle.data(),size,fromAxes);
+	for (std::size_t n=0;n<size;++n){
+		const BasicAxisAngle<T> rotation=toAxisAngle(quaternions[n]);
+		REQUIRE(x[n]==rotation.x);
+		REQUIRE(y[n]==rotation.y);
+		REQUIRE(z[n]==rotation.z);
+		REQUIRE(angle[n]==rotation.angle);
+		REQUIRE(fromAxes.get(n)==fromAxisAngle(rotation));
+	}
+
+	// Euler angles
+	for (EulerOrder order : {XYZ,ZYX,ZXZ}){
+		std::vector<T> a1(size), a2(size), a3(size);
+		toEuler(batch,order,a1.data(),a2.data(),a3.data());
+		BasicQuaternionBatch<T> fromAngles;
+		fromEuler(a1.data(),a2.data(),a3.data(),size,order,fromAngles);
+		for (std::size_t n=0;n<size;++n){
+			const BasicEulerAngles<T> angles=toEuler(quaternions[n],order);
+			REQUIRE(a1[n]==angles.a1);
+			REQUIRE(a2[n]==angles.a2);
+			REQUIRE(a3[n]==angles.a3);
+			REQUIRE(fromAngles.get(n)==fromEuler(angles,order));
+		}
+	}
+}
+
+TEST_CASE("Test batch conversions match the scalar conversions"){
+	testBatchConversions<double>();
+	testBatchConversions<float>();
+}
@@ -0,0 +1,115 @@
+/*
+ * dispatchTester.cpp
+ *
+ * \brief Unit tests for the runtime instruction set dispatch
+ * \author Nikos Kazazakis
+ */
+
+#include "Dispatch.h"
+#include "Conversion.h"
+#include "UnitQuaternion.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace Quaternions;
+
+// Every variant must match the scalar operators bit for bit
+template <typename T>
+static void testBatchKernels()
+{
+	const std::size_t size=1003;
+	const std::vector<BasicQuaternion<T> > a=randomQuaternions<T>(size,11), b=randomQuaternions<T>(size,12);
+	const BasicQuaternionBatch<T> q1(a), q2(b);
+	BasicQuaternionBatch<T> out;
+	std::vector<T> norms(size);
+
+	multiply(q1,q2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==a[n]*b[n]);}
+	norm(q1,norms.data());
+	for (std::size_t n=0;n<size;++n){REQUIRE(norms[n]==a[n].norm());}
+	normalize(q1,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==(T(1)/a[n].norm())*a[n]);}
+	fastNormalize(q1,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==fastNormalize(a[n]));}
+
+	// In place
+	out=q1;
+	multiply(out,q2,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==a[n]*b[n]);}
+}
+
+static void testRotationKernels()
+{
+	const std::size_t size=1003;
+	const std::vector<Quaternion> coordinates=randomQuaternions<double>(size,13);
+	std::vector<Quaternion> rotations=randomQuaternions<double>(size,14);
+	for (auto &q : rotations){
+		q=(1.0/q.norm())*q;
+	}
+	PointCloud points(size), out;
+	for (std::size_t n=0;n<size;++n){
+		points.set(n,Vector3{coordinates[n].i(),coordinates[n].j(),coordinates[n].k()});
+	}
+	const Quaternion &q=rotations[0];
+	const Matrix3 M=toMatrix(q);
+
+	rotate(q,points,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==rotate(q,points.get(n)));}
+	rotate(M,points,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==rotate(M,points.get(n)));}
+	rotate(QuaternionBatch(rotations),points,out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==rotate(rotations[n],points.get(n)));}
+}
+
+TEST_CASE("Test instruction set selection"){
+	InstructionSet isa=isaAVX512;
+	REQUIRE(parseInstructionSet("scalar",isa));
+	REQUIRE(isa==isaScalar);
+	REQUIRE(parseInstructionSet("avx2",isa));
+	REQUIRE(isa==isaAVX2);
+	REQUIRE(!parseInstructionSet("AVX3",isa));
+	REQUIRE(isa==isaAVX2);
+	for (int candidate=isaScalar;candidate<isaCount;++candidate){
+		REQUIRE(parseInstructionSet(instructionSetName(InstructionSet(candidate)),isa));
+		REQUIRE(isa==candidate);
+	}
+
+	// The reference and baseline paths always exist
+	REQUIRE(instructionSetSupported(isaScalar));
+	REQUIRE(instructionSetSupported(isaSSE2));
+	REQUIRE(instructionSetSupported(defaultInstructionSet()));
+
+	// QUATERNION_ISA is honoured when the CPU supports it
+	const char *requested=std::getenv("QUATERNION_ISA");
+	if (requested && parseInstructionSet(requested,isa) && instructionSetSupported(isa)){
+		REQUIRE(defaultInstructionSet()==isa);
+	}
+
+	// Switching fails, and changes nothing, for instruction sets this CPU lacks
+	const InstructionSet active=activeInstructionSet();
+	for (int candidate=isaScalar;candidate<isaCount;++candidate){
+		if (!instructionSetSupported(InstructionSet(candidate))){
+			REQUIRE(!setInstructionSet(InstructionSet(candidate)));
+			REQUIRE(activeInstructionSet()==active);
+		}
+	}
+}
+
+TEST_CASE("Test every instruction set matches the scalar operators"){
+	const InstructionSet active=activeInstructionSet();
+	for (int candidate=isaScalar;candidate<isaCount;++candidate){
+		const InstructionSet isa=InstructionSet(candidate);
+		if (!setInstructionSet(isa)){
+			continue;
+		}
+		INFO("Instruction set "<<instructionSetName(isa));
+		REQUIRE(activeInstructionSet()==isa);
+		testBatchKernels<float>();
+		testBatchKernels<double>();
+		testRotationKernels();
+	}
+	REQUIRE(setInstructionSet(active));
+}
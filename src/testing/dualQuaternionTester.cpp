@@ -0,0 +1,183 @@
+/*
+ * dualQuaternionTester.cpp
+ *
+ * \brief Unit tests for dual quaternions, screw interpolation, blending and skinning
+ * \author Nikos Kazazakis
+ */
+
+#include "DualQuaternion.h"
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace Quaternions;
+
+static bool near(const Vector3 &v1, const Vector3 &v2, double tolerance)
+{
+	return std::abs(v1.x-v2.x)<tolerance && std::abs(v1.y-v2.y)<tolerance && std::abs(v1.z-v2.z)<tolerance;
+}
+
+static bool near(const Quaternion &q1, const Quaternion &q2, double tolerance)
+{
+	return (q1-q2).norm()<tolerance;
+}
+
+// dq and -dq are the same transform
+static bool near(const DualQuaternion &dq1, const DualQuaternion &dq2, double tolerance)
+{
+	const double sign= dot(dq1.real(),dq2.real())<0.0 ? -1.0 : 1.0;
+	return (dq1.real()-sign*dq2.real()).norm()<tolerance && (dq1.dual()-sign*dq2.dual()).norm()<tolerance;
+}
+
+// Random rigid transforms
+static std::vector<DualQuaternion> randomTransforms(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	std::vector<DualQuaternion> transforms(n);
+	for (auto &dq : transforms){
+		const Quaternion q=normalize(Quaternion(distribution(generator),distribution(generator),distribution(generator),distribution(generator)));
+		const Vector3 t{5*distribution(generator),5*distribution(generator),5*distribution(generator)};
+		dq=DualQuaternion::fromRotationTranslation(q,t);
+	}
+	return transforms;
+}
+
+TEST_CASE("Test dual quaternion transforms"){
+	const double halfAngle=std::acos(-1.0)/4.0;
+	const Quaternion q(std::cos(halfAngle),0,0,std::sin(halfAngle)); // 90 degrees around z
+	const Vector3 t{1,2,3}, p{1,0,0};
+	const DualQuaternion dq=DualQuaternion::fromRotationTranslation(q,t);
+
+	REQUIRE(dq.rotation()==q);
+	REQUIRE(near(dq.translation(),t,1e-15));
+	REQUIRE(near(transform(dq,p),Vector3{1,3,3},1e-15));
+	REQUIRE(near(transform(DualQuaternion::fromTranslation(t),p),Vector3{2,2,3},1e-15));
+	REQUIRE(near(transform(DualQuaternion::fromRotation(q),p),Vector3{0,1,0},1e-15));
+	REQUIRE(transform(DualQuaternion(),p)==p);
+
+	// Composition applies the right transform first, the conjugate undoes it
+	const std::vector<DualQuaternion> transforms=randomTransforms(100,1);
+	for (std::size_t n=0;n+1<transforms.size();++n){
+		const DualQuaternion &a=transforms[n], &b=transforms[n+1];
+		REQUIRE(near(transform(a*b,p),transform(a,transform(b,p)),1e-13));
+		REQUIRE(near(transform(a.conjugate(),transform(a,p)),p,1e-13));
+		REQUIRE(near(a*a.conjugate(),DualQuaternion(),1e-14));
+		// The general inverse agrees with the conjugate for unit dual quaternions,
+		// and inverts non-unit ones too
+		REQUIRE(near(inverse(a),a.conjugate(),1e-14));
+		const DualQuaternion scaled=3.0*a;
+		REQUIRE(near(scaled*inverse(scaled),DualQuaternion(),1e-14));
+	}
+}
+
+TEST_CASE("Test dual quaternion normalization"){
+	const std::vector<DualQuaternion> transforms=randomTransforms(100,2);
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<double> distribution(-0.01,0.01);
+	for (const DualQuaternion &dq : transforms){
+		// Scale, and push the dual part off the orthogonal plane
+		const DualQuaternion perturbed(2.5*dq.real(),2.5*dq.dual()+distribution(generator)*dq.real());
+		const DualQuaternion unit=normalize(perturbed);
+		REQUIRE(std::abs(unit.real().norm()-1.0)<1e-15);
+		REQUIRE(std::abs(dot(unit.real(),unit.dual()))<1e-14);
+		REQUIRE(near(unit,dq,1e-14));
+	}
+}
+
+TEST_CASE("Test screw interpolation"){
+	const std::vector<DualQuaternion> transforms=randomTransforms(100,4);
+	const Vector3 p{0.5,-1,2};
+	for (std::size_t n=0;n+1<transforms.size();++n){
+		const DualQuaternion &a=transforms[n], &b=transforms[n+1];
+		REQUIRE(near(sclerp(a,b,0.0),a,1e-13));
+		REQUIRE(near(sclerp(a,b,1.0),b,1e-13));
+		// The path is a screw motion: equal steps compose
+		const DualQuaternion half=sclerp(a,b,0.5);
+		REQUIRE(near(half*a.conjugate()*half,b,1e-12));
+		REQUIRE(std::abs(sclerp(a,b,0.3).real().norm()-1.0)<1e-14);
+		// The sign of the target doesn't matter
+		REQUIRE(near(sclerp(a,-1.0*b,0.3),sclerp(a,b,0.3),1e-13));
+	}
+
+	// A screw about z: the angle and the translation along the axis both go linearly
+	const double angle=2.0;
+	const DualQuaternion screw=DualQuaternion::fromRotationTranslation(Quaternion(std::cos(angle/2),0,0,std::sin(angle/2)),Vector3{0,0,4});
+	const DualQuaternion quarter=sclerp(DualQuaternion(),screw,0.25);
+	REQUIRE(near(quarter.rotation(),Quaternion(std::cos(angle/8),0,0,std::sin(angle/8)),1e-15));
+	REQUIRE(near(quarter.translation(),Vector3{0,0,1},1e-15));
+
+	// Pure translations interpolate linearly
+	const DualQuaternion step=sclerp(DualQuaternion::fromTranslation(Vector3{1,0,0}),DualQuaternion::fromTranslation(Vector3{3,2,0}),0.5);
+	REQUIRE(near(transform(step,p),Vector3{2.5,0,2},1e-15));
+}
+
+TEST_CASE("Test dual quaternion blending"){
+	const std::vector<DualQuaternion> transforms=randomTransforms(3,5);
+	const std::vector<double> weights={0.5,0.3,0.2};
+	REQUIRE(near(dlb(transforms.data(),weights.data(),1),transforms[0],1e-15));
+
+	// Flipping the sign of an input changes nothing
+	std::vector<DualQuaternion> flipped=transforms;
+	flipped[1]=-1.0*flipped[1];
+	const DualQuaternion blended=dlb(transforms,weights);
+	REQUIRE(near(dlb(flipped,weights),blended,1e-15));
+	REQUIRE(std::abs(blended.real().norm()-1.0)<1e-15);
+
+	// Two transforms with equal weights give the screw midpoint when they
+	// rotate about the same axis
+	const DualQuaternion a=DualQuaternion::fromRotationTranslation(Quaternion(1,0,0,0),Vector3{0,0,0});
+	const DualQuaternion b=DualQuaternion::fromRotationTranslation(Quaternion(std::cos(0.5),0,0,std::sin(0.5)),Vector3{0,0,2});
+	const std::vector<DualQuaternion> pair={a,b};
+	REQUIRE(near(dlb(pair,std::vector<double>{0.5,0.5}),sclerp(a,b,0.5),1e-14));
+}
+
+TEST_CASE("Test batch skinning"){
+	const std::size_t vertices=1003, influences=4;
+	std::vector<DualQuaternion> joints=randomTransforms(20,6);
+	joints[3]=-1.0*joints[3]; // Skinning must pick the signs itself
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	std::uniform_int_distribution<std::uint32_t> joint(0,joints.size()-1);
+
+	PointCloud rest(vertices), skinned;
+	SkinningWeights weights(vertices,influences);
+	for (std::size_t n=0;n<vertices;++n){
+		rest.set(n,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+		// 1 to 4 influences, with weights adding up to 1
+		const std::size_t used=1+n%influences;
+		double total=0.0;
+		std::vector<double> w(used);
+		for (auto &value : w){
+			value=0.1+std::abs(distribution(generator));
+			total+=value;
+		}
+		for (std::size_t slot=0;slot<used;++slot){
+			weights.set(n,slot,joint(generator),w[slot]/total);
+		}
+	}
+
+	skin(joints,weights,rest,skinned);
+	REQUIRE(skinned.size()==vertices);
+	for (std::size_t n=0;n<vertices;++n){
+		std::vector<DualQuaternion> influencing(influences);
+		std::vector<double> w(influences);
+		for (std::size_t slot=0;slot<influences;++slot){
+			influencing[slot]=joints[weights.joint(n,slot)];
+			w[slot]=weights.weight(n,slot);
+		}
+		REQUIRE(near(skinned.get(n),transform(dlb(influencing,w),rest.get(n)),1e-12));
+	}
+
+	// A single full influence is the joint transform
+	SkinningWeights rigid(vertices,1);
+	for (std::size_t n=0;n<vertices;++n){
+		rigid.set(n,0,std::uint32_t(n%joints.size()),1.0);
+	}
+	PointCloud moved=rest;
+	skin(joints,rigid,moved,moved); // In place
+	for (std::size_t n=0;n<vertices;++n){
+		REQUIRE(near(moved.get(n),transform(joints[n%joints.size()],rest.get(n)),1e-13));
+	}
+}
@@ -0,0 +1,205 @@
+/*
+ * fileTester.cpp
+ *
+ * \brief Unit tests for the text and binary quaternion input/output
+ * \author Nikos Kazazakis
+ */
+
+#include "QuaternionFile.h"
+#include "SparseQuaternion.h"
+#include <catch.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h> // truncate, getpid
+
+using namespace Quaternions;
+
+// Random quaternions with components of very different magnitudes
+template <typename T>
+static std::vector<BasicQuaternion<T> > wideRangeQuaternions(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> mantissa(-1.0,1.0);
+	std::uniform_int_distribution<int> exponent(-20,20);
+	std::vector<BasicQuaternion<T> > quaternions(n);
+	for (auto &q : quaternions){
+		for (int axis=qw;axis<=qk;++axis){
+			q[static_cast<AxisType>(axis)]=T(std::ldexp(mantissa(generator),exponent(generator)));
+		}
+	}
+	return quaternions;
+}
+
+// Exact text round trip at full precision
+template <typename T>
+static void requireTextRoundTrip(unsigned seed)
+{
+	std::stringstream stream;
+	stream<<std::setprecision(std::numeric_limits<T>::max_digits10);
+	std::vector<BasicQuaternion<T> > quaternions=wideRangeQuaternions<T>(200,seed);
+	// And the non-finite components, on every axis
+	const T inf=std::numeric_limits<T>::infinity(), nan=std::numeric_limits<T>::quiet_NaN();
+	quaternions.push_back(BasicQuaternion<T>(inf,1,0,0));
+	quaternions.push_back(BasicQuaternion<T>(-inf,inf,-inf,inf));
+	quaternions.push_back(BasicQuaternion<T>(nan,0,-nan,2));
+	quaternions.push_back(BasicQuaternion<T>(0,nan,inf,-nan));
+	for (const auto &q : quaternions){
+		stream<<q<<"\n";
+	}
+	for (const auto &q : quaternions){
+		BasicQuaternion<T> p;
+		REQUIRE(stream>>p);
+		// NaN never equals itself, so compare the components (including the sign of NaN)
+		for (int axis=qw;axis<=qk;++axis){
+			const T expected=q[static_cast<AxisType>(axis)], read=p[static_cast<AxisType>(axis)];
+			REQUIRE(std::signbit(read)==std::signbit(expected));
+			REQUIRE((read==expected || (std::isnan(read) && std::isnan(expected))));
+		}
+	}
+}
+
+TEST_CASE("Test quaternion text input/output"){
+	// operator<< prints the write() notation, also for expressions
+	std::ostringstream out;
+	out<<Quaternion(1,0,2,0)<<" "<<Quaternion(1,0,1,0)*Quaternion(1,0.5,0.5,0.75)<<" "<<Quaternion();
+	REQUIRE(out.str()=="+1+2j +0.5+1.25i+1.5j+0.25k 0");
+
+	// And operator>> reads it back
+	std::istringstream in(out.str());
+	Quaternion q1, q2, q3 = Quaternion(1,1,1,1);
+	REQUIRE(in>>q1>>q2>>q3);
+	REQUIRE(q1==Quaternion(1,0,2,0));
+	REQUIRE(q2==Quaternion(0.5,1.25,1.5,0.25));
+	REQUIRE(q3==Quaternion());
+
+	// Hand-written input: any order, exponents, unsigned first term
+	std::istringstream handWritten("  -0.5i+3k 2.5e-3-1e+2j+1k+1k");
+	REQUIRE(handWritten>>q1>>q2);
+	REQUIRE(q1==Quaternion(0,-0.5,0,3));
+	REQUIRE(q2==Quaternion(2.5e-3,0,-100,2));
+
+	// Reading stops at the first character that isn't part of the quaternion
+	std::istringstream trailing("+1-2i, next");
+	std::string rest;
+	REQUIRE(trailing>>q1>>rest);
+	REQUIRE(q1==Quaternion(1,-2,0,0));
+	REQUIRE(rest==",");
+
+	// Malformed input sets the failbit and leaves the quaternion unchanged
+	for (const char *bad : {"", "x", "+i", "+in", "+1+", "1.2.3j"}){
+		std::istringstream malformed(bad);
+		Quaternion q = Quaternion(1,2,3,4);
+		REQUIRE(!(malformed>>q));
+		REQUIRE(q==Quaternion(1,2,3,4));
+	}
+
+	// Full precision round trips for every type
+	requireTextRoundTrip<float>(1);
+	requireTextRoundTrip<double>(2);
+	requireTextRoundTrip<long double>(3);
+
+	// The sparse quaternion prints to the stream it is given (it used to print to cout)
+	std::ostringstream sparse;
+	SparseQuaternion(1,0,2,0).write(sparse);
+	REQUIRE(!sparse.str().empty());
+	std::istringstream sparseIn(sparse.str());
+	REQUIRE(sparseIn>>q1);
+	REQUIRE(q1==Quaternion(1,0,2,0));
+}
+
+TEST_CASE("Test binary quaternion files"){
+	// One file per process: ctest -j runs unitTester and unitTesterScalar at once, in the same folder
+	const std::string path="fileTester."+std::to_string(::getpid())+".quaternions";
+	const std::vector<Quaternion> quaternions=wideRangeQuaternions<double>(10000,4);
+
+	// Write with every kind of append, with a small buffer so that it fills up many times
+	{
+		QuaternionFileWriter<double> writer(path,100);
+		REQUIRE(writer.good());
+		for (std::size_t n=0;n<1000;++n){
+			REQUIRE(writer.append(quaternions[n]));
+		}
+		REQUIRE(writer.append(quaternions.data()+1000,50));    // Fits in the buffer
+		REQUIRE(writer.append(quaternions.data()+1050,4950));  // Bypasses the buffer
+		REQUIRE(writer.append(QuaternionBatch(std::vector<Quaternion>(quaternions.begin()+6000,quaternions.end()))));
+		REQUIRE(writer.size()==10000);
+
+		// Flushed quaternions are visible while the file is still being written
+		REQUIRE(writer.flush());
+		MappedQuaternionFile<double> partial(path);
+		REQUIRE(partial.size()==10000);
+		REQUIRE(writer.append(quaternions[0]));
+	} // The destructor closes the file
+
+	QuaternionFileHeader header;
+	REQUIRE(readQuaternionFileHeader(path,header));
+	REQUIRE(header.version==kQuaternionFileVersion);
+	REQUIRE(header.scalarSize==sizeof(double));
+	REQUIRE(header.count==10001);
+
+	// The mapped file is the data, bit for bit, and correctly aligned
+	MappedQuaternionFile<double> file(path);
+	REQUIRE(file.isOpen());
+	REQUIRE(file.size()==10001);
+	REQUIRE(reinterpret_cast<std::uintptr_t>(file.quaternions().data())%alignof(Quaternion)==0);
+	for (std::size_t n=0;n<quaternions.size();++n){
+		REQUIRE(file[n]==quaternions[n]);
+	}
+	REQUIRE(file[10000]==quaternions[0]);
+	QuaternionSpan<double> middle=file.quaternions().subspan(5000,10);
+	REQUIRE(middle.size()==10);
+	REQUIRE(middle[3]==quaternions[5003]);
+	std::size_t count=0;
+	for (const auto &q : file){
+		count+= q==quaternions[count%10000];
+	}
+	REQUIRE(count==10001);
+
+	// The mapping can be moved
+	MappedQuaternionFile<double> moved(std::move(file));
+	REQUIRE(!file.isOpen());
+	REQUIRE(moved.size()==10001);
+	REQUIRE(moved[42]==quaternions[42]);
+
+	// The wrong precision is refused
+	MappedQuaternionFile<float> wrongPrecision;
+	REQUIRE(!wrongPrecision.open(path));
+	moved.close();
+
+	// Single precision files work the same way
+	{
+		QuaternionFileWriter<float> writer(path);
+		writer.append(QuaternionF(1,2,3,4));
+		REQUIRE(writer.close());
+	}
+	MappedQuaternionFile<float> single(path);
+	REQUIRE(single.size()==1);
+	REQUIRE(single[0]==QuaternionF(1,2,3,4));
+	single.close();
+
+	// Truncated files and files that aren't quaternion files are refused
+	{
+		QuaternionFileWriter<double> writer(path);
+		writer.append(quaternions.data(),10);
+	}
+	REQUIRE(::truncate(path.c_str(),sizeof(QuaternionFileHeader)+9*sizeof(Quaternion))==0);
+	REQUIRE(!file.open(path));
+	std::FILE *text=std::fopen(path.c_str(),"w");
+	std::fputs("This is not a quaternion file, although it is long enough to hold a header",text);
+	std::fclose(text);
+	REQUIRE(!file.open(path));
+	REQUIRE(!readQuaternionFileHeader(path,header));
+	REQUIRE(!file.open("does/not/exist"));
+	REQUIRE(!QuaternionFileWriter<double>("does/not/exist").good());
+
+	std::remove(path.c_str());
+}
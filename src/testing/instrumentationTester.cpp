@@ -0,0 +1,95 @@
+/*
+ * instrumentationTester.cpp
+ *
+ * \brief Unit tests for the operator counters and latency histograms
+ * \author Nikos Kazazakis
+ */
+
+#include "Instrumentation.h"
+#include "Quaternion.h"
+#include "SparseQuaternion.h"
+#include "StaticRotations.h"
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace Quaternions;
+
+TEST_CASE("Test instrumentation snapshots"){
+	resetInstrumentation();
+	InstrumentationSnapshot snapshot=instrumentationSnapshot();
+	for (std::size_t operation=0;operation<opCount;++operation){
+		REQUIRE(snapshot.calls[operation]==0);
+		REQUIRE(snapshot.samples(InstrumentedOperation(operation))==0);
+	}
+
+	// Record directly, so that this works whether or not the operators are instrumented
+	InstrumentationDetail::recordCall(opHamilton);
+	InstrumentationDetail::recordLatency(opHamilton,0);
+	InstrumentationDetail::recordLatency(opHamilton,3);
+	InstrumentationDetail::recordLatency(opHamilton,1000);
+
+	// Counters of threads that have exited are kept
+	std::thread worker([]{
+		for (int n=0;n<10;++n){
+			InstrumentationDetail::recordCall(opHamilton);
+		}
+	});
+	worker.join();
+
+	snapshot=instrumentationSnapshot();
+	REQUIRE(snapshot.calls[opHamilton]==11);
+	REQUIRE(snapshot.samples(opHamilton)==3);
+	REQUIRE(snapshot.latency[opHamilton][0]==1); // 0 ns
+	REQUIRE(snapshot.latency[opHamilton][1]==1); // [2,4) ns
+	REQUIRE(snapshot.latency[opHamilton][9]==1); // [512,1024) ns
+
+	// Only the operations that were called are written out
+	std::ostringstream json;
+	writeInstrumentationJson(json,snapshot);
+	const std::string expected=std::string("{\"enabled\":")+(instrumentationEnabled() ? "true" : "false")+
+		",\"operations\":{\"hamilton\":{\"calls\":11,\"latencySamples\":3,\"latencyHistogramNs\":[1,1,0,0,0,0,0,0,0,1";
+	REQUIRE(json.str().compare(0,expected.size(),expected)==0);
+	REQUIRE(json.str().find("norm")==std::string::npos);
+
+	resetInstrumentation();
+	REQUIRE(instrumentationSnapshot().calls[opHamilton]==0);
+}
+
+TEST_CASE("Test operator instrumentation"){
+	setLatencySamplingPeriod(1);
+	resetInstrumentation();
+
+	const Quaternion q1(1,2,3,4), q2(5,6,7,8);
+	const Quaternion product=q1*q2+q1;
+	const double length=product.norm();
+	const SparseQuaternion sparse=SparseQuaternion(1,0,1,0)*SparseQuaternion(0,1,0,0);
+
+	// Compile-time evaluation is never counted
+	constexpr Quaternion mount=kRotationZ90*kRotationX180;
+
+	const InstrumentationSnapshot snapshot=instrumentationSnapshot();
+	if (instrumentationEnabled()){
+		REQUIRE(snapshot.calls[opConstruct]==2);
+		REQUIRE(snapshot.calls[opEvaluate]==1);
+		REQUIRE(snapshot.calls[opAdd]==1);
+		REQUIRE(snapshot.calls[opHamilton]==2); // One dense, one sparse
+		REQUIRE(snapshot.calls[opNorm]==1);
+		REQUIRE(snapshot.samples(opNorm)==1);
+		REQUIRE(snapshot.samples(opHamilton)==1); // Only the sparse product is timed
+		REQUIRE(snapshot.calls[opSparseConstruct]==3);
+		REQUIRE(snapshot.calls[opAllocation]==2+1+2); // Only the non-zero elements of the operands and of (1+j)*i=i-k
+	}else{
+		for (std::size_t operation=0;operation<opCount;++operation){
+			REQUIRE(snapshot.calls[operation]==0);
+		}
+	}
+	REQUIRE(length>0.0);
+	REQUIRE(sparse.w()==0.0);
+	REQUIRE(mount==kRotationZ90*kRotationX180);
+
+	setLatencySamplingPeriod(64);
+	resetInstrumentation();
+}
@@ -0,0 +1,146 @@
+/*
+ * integrationTester.cpp
+ *
+ * \brief Unit tests for the gyroscope integration
+ * \author Nikos Kazazakis
+ */
+
+#include "Integration.h"
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace Quaternions;
+
+// Distance between two orientations (q and -q are the same rotation)
+static double distance(const Quaternion &p, const Quaternion &q)
+{
+	return std::min((p-q).norm(),(p+q).norm());
+}
+
+/* Note: the reference trajectory is a rotation around z at rate a, followed
+ * (in the body frame) by a rotation around x at rate b:
+ *     q(t)=exp((0,0,0,a*t)/2)*exp((0,b*t,0,0)/2)
+ * Differentiating, dq/dt=q*(0,w(t))/2 with the body rate
+ *     w(t)=(b,0,0)+q2(t)^{-1}*(0,0,a)*q2(t),  q2(t)=exp((0,b*t,0,0)/2)
+ * which changes direction all the time (coning), so it exercises every term
+ * of the schemes.
+ */
+static const double kRateA=1.3, kRateB=0.7;
+
+static Quaternion referenceOrientation(double t)
+{
+	return exp(Quaternion(0,0,0,0.5*kRateA*t))*exp(Quaternion(0,0.5*kRateB*t,0,0));
+}
+
+static Vector3 referenceRate(double t)
+{
+	const Vector3 spin=rotate(exp(Quaternion(0,0.5*kRateB*t,0,0)).conjugate(),Vector3{0,0,kRateA});
+	return Vector3{kRateB+spin.x,spin.y,spin.z};
+}
+
+// Error after integrating the reference trajectory over [0,1] with n steps
+static double referenceError(std::size_t steps, IntegrationScheme scheme)
+{
+	const double dt=1.0/steps;
+	std::vector<Vector3> rates(steps+1);
+	for (std::size_t s=0;s<=steps;++s){
+		rates[s]=referenceRate(s*dt);
+	}
+	return distance(integrate(Quaternion(1,0,0,0),rates.data(),rates.size(),dt,scheme),referenceOrientation(1.0));
+}
+
+TEST_CASE("Test integration of a constant rate"){
+	// 2 rad/s around z for 1 second: a rotation of 2 rad, exactly
+	const std::size_t samples=101;
+	const std::vector<Vector3> rates(samples,Vector3{0,0,2.0});
+	const Quaternion expected(std::cos(1.0),0,0,std::sin(1.0));
+	REQUIRE(distance(integrate(Quaternion(1,0,0,0),rates.data(),samples,0.01,integrateFirstOrder),expected)<1e-14);
+	REQUIRE(distance(integrate(Quaternion(1,0,0,0),rates.data(),samples,0.01,integrateMagnus),expected)<1e-14);
+	REQUIRE(distance(integrate(Quaternion(1,0,0,0),rates.data(),samples,0.01,integrateRK4),expected)<1e-10);
+
+	// Fewer than two samples: nothing to integrate
+	const Quaternion q0(0.5,0.5,0.5,0.5);
+	REQUIRE(integrate(q0,rates.data(),1,0.01,integrateMagnus)==q0);
+	REQUIRE(integrate(q0,rates.data(),0,0.01,integrateRK4)==q0);
+}
+
+TEST_CASE("Test integration convergence order"){
+	// Halving the step halves the first order error and quarters the others
+	const double firstOrder=referenceError(200,integrateFirstOrder)/referenceError(400,integrateFirstOrder);
+	REQUIRE(firstOrder>1.8);
+	REQUIRE(firstOrder<2.2);
+	for (IntegrationScheme scheme : {integrateMagnus,integrateRK4}){
+		const double ratio=referenceError(200,scheme)/referenceError(400,scheme);
+		REQUIRE(ratio>3.6);
+		REQUIRE(ratio<4.4);
+	}
+
+	// And the higher order schemes are far more accurate at the same step
+	REQUIRE(referenceError(200,integrateMagnus)<referenceError(200,integrateFirstOrder)/100);
+	REQUIRE(referenceError(200,integrateRK4)<referenceError(200,integrateFirstOrder)/100);
+}
+
+TEST_CASE("Test batch integration matches the single sensor version"){
+	// Not a multiple of kIntegrationChunk, so several chunks and a partial one
+	const std::size_t sensors=2*kIntegrationChunk+37, samples=200;
+	const double dt=0.01;
+	std::mt19937 generator(17);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+
+	// Smooth random rates: every sensor spins around a random axis at a
+	// random rate, with a sinusoidal wobble. Some sensors spin fast enough
+	// (over 1 rad per sample) to need the fallback path
+	GyroSamples rates(sensors,samples);
+	std::vector<Quaternion> initial(sensors);
+	for (std::size_t sensor=0;sensor<sensors;++sensor){
+		const double scale= sensor%50==0 ? 150.0 : 5.0;
+		const Vector3 axis{distribution(generator),distribution(generator),distribution(generator)};
+		const Vector3 wobble{distribution(generator),distribution(generator),distribution(generator)};
+		for (std::size_t sample=0;sample<samples;++sample){
+			const double phase=std::sin(0.05*sample);
+			rates.set(sample,sensor,Vector3{scale*(axis.x+phase*wobble.x),scale*(axis.y+phase*wobble.y),scale*(axis.z+phase*wobble.z)});
+		}
+		initial[sensor]=normalize(Quaternion(distribution(generator),distribution(generator),distribution(generator),distribution(generator)));
+	}
+
+	for (IntegrationScheme scheme : {integrateFirstOrder,integrateMagnus,integrateRK4}){
+		for (std::size_t renormalizeEvery : {std::size_t(0),std::size_t(1),std::size_t(7)}){
+			QuaternionBatch orientations(initial);
+			integrate(rates,dt,scheme,orientations,renormalizeEvery);
+			std::vector<Vector3> sensorRates(samples);
+			for (std::size_t sensor=0;sensor<sensors;++sensor){
+				for (std::size_t sample=0;sample<samples;++sample){
+					sensorRates[sample]=rates.get(sample,sensor);
+				}
+				const Quaternion expected=integrate(initial[sensor],sensorRates.data(),samples,dt,scheme,renormalizeEvery);
+				REQUIRE((orientations.get(sensor)-expected).norm()<1e-12);
+			}
+		}
+	}
+}
+
+TEST_CASE("Test integration renormalization"){
+	// Without renormalization RK4 drifts off the unit sphere (it is not an
+	// exact rotation), with it the norm stays at 1
+	const std::size_t samples=10001;
+	const std::vector<Vector3> rates(samples,Vector3{3.0,-2.0,1.0});
+	const Quaternion drifting=integrate(Quaternion(1,0,0,0),rates.data(),samples,0.01,integrateRK4,0);
+	const Quaternion renormalized=integrate(Quaternion(1,0,0,0),rates.data(),samples,0.01,integrateRK4);
+	REQUIRE(std::abs(drifting.norm()-1.0)>1e-9);
+	REQUIRE(std::abs(renormalized.norm()-1.0)<4*std::numeric_limits<double>::epsilon());
+
+	// The batch version too
+	GyroSamples batchRates(3,samples);
+	for (std::size_t sample=0;sample<samples;++sample){
+		for (std::size_t sensor=0;sensor<3;++sensor){
+			batchRates.set(sample,sensor,rates[sample]);
+		}
+	}
+	QuaternionBatch orientations(std::vector<Quaternion>(3,Quaternion(1,0,0,0)));
+	integrate(batchRates,0.01,integrateRK4,orientations);
+	for (std::size_t sensor=0;sensor<3;++sensor){
+		REQUIRE(std::abs(orientations.get(sensor).norm()-1.0)<4*std::numeric_limits<double>::epsilon());
+	}
+}
@@ -0,0 +1,166 @@
+/*
+ * interpolationTester.cpp
+ *
+ * \brief Unit tests for exp/log and the interpolation functions
+ * \author Nikos Kazazakis
+ */
+
+#include "Interpolation.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <vector>
+
+using namespace Quaternions;
+
+// Angle of the rotation between two unit quaternions (q and -q are the same rotation)
+static double rotationDistance(const Quaternion &q1, const Quaternion &q2)
+{
+	const Quaternion q=dot(q1,q2)<0.0 ? Quaternion(-1*q2) : q2;
+	return 4.0*std::atan2(Quaternion(q1-q).norm(),Quaternion(q1+q).norm());
+}
+
+// Rotation by angle around the unit axis (x,y,z)
+static Quaternion axisAngle(double x, double y, double z, double angle)
+{
+	const double s=std::sin(0.5*angle);
+	return Quaternion(std::cos(0.5*angle),s*x,s*y,s*z);
+}
+
+TEST_CASE("Test dot, exp and log"){
+	Quaternion q1 = Quaternion(1,2,3,4);
+	Quaternion q2 = Quaternion(0.5,-1,2,0);
+	REQUIRE(dot(q1,q2)==4.5);
+	REQUIRE(dot(q1,q1)==30.0);
+	REQUIRE(dot(q1+q2,q1)==34.5); // Works on expressions too
+
+	// exp of a pure quaternion (0, axis*angle/2) is the rotation by angle
+	const double angle=1.2;
+	Quaternion r = exp(Quaternion(0,0,0.5*angle,0));
+	REQUIRE(rotationDistance(r,axisAngle(0,1,0,angle))<1e-15);
+
+	// Real quaternions behave like real numbers
+	REQUIRE(exp(Quaternion(0,0,0,0))==Quaternion(1,0,0,0));
+	REQUIRE(log(Quaternion(1,0,0,0))==Quaternion(0,0,0,0));
+	REQUIRE(std::abs(log(Quaternion(std::exp(2.0),0,0,0)).w()-2.0)<1e-15);
+
+	// log and exp are inverses, also for tiny angles
+	for (const auto &q : randomRotations(100,1)){
+		Quaternion p = exp(log(q));
+		REQUIRE(Quaternion(p-q).norm()<1e-15);
+	}
+	Quaternion tiny = Quaternion(1,1e-10,0,0);
+	REQUIRE(std::abs(log(tiny).i()-1e-10)<1e-25);
+	REQUIRE(std::abs(exp(log(tiny)).i()-1e-10)<1e-25);
+}
+
+TEST_CASE("Test slerp"){
+	Quaternion q0 = axisAngle(0,0,1,0.0);
+	Quaternion q1 = axisAngle(0,0,1,2.0);
+
+	// End points
+	REQUIRE(rotationDistance(slerp(q0,q1,0.0),q0)<1e-15);
+	REQUIRE(rotationDistance(slerp(q0,q1,1.0),q1)<1e-15);
+
+	// Constant angular velocity around a fixed axis
+	for (int n=0;n<=10;++n){
+		const double t=0.1*n;
+		REQUIRE(rotationDistance(slerp(q0,q1,t),axisAngle(0,0,1,2.0*t))<1e-15);
+	}
+
+	// Shortest path: -q1 is the same rotation, so we must get the same result
+	REQUIRE(rotationDistance(slerp(q0,Quaternion(-1*q1),0.3),slerp(q0,q1,0.3))<1e-15);
+	REQUIRE(dot(slerp(q0,Quaternion(-1*q1),0.3),q0)>0.0);
+
+	// Small-angle fallback: no NaNs for identical or nearly identical inputs
+	REQUIRE(rotationDistance(slerp(q1,q1,0.3),q1)<1e-15);
+	Quaternion q2 = axisAngle(1,0,0,1e-12);
+	Quaternion half = slerp(q0,q2,0.5);
+	REQUIRE(std::abs(half.i()-0.25e-12)<1e-27);
+	REQUIRE(std::abs(half.norm()-1.0)<1e-15);
+
+	// Results have unit norm
+	std::vector<Quaternion> a=randomRotations(1000,2), b=randomRotations(1000,3);
+	for (std::size_t n=0;n<a.size();++n){
+		REQUIRE(std::abs(slerp(a[n],b[n],0.37).norm()-1.0)<1e-15);
+	}
+
+	// Float
+	QuaternionF qf = slerp(QuaternionF(q0),QuaternionF(q1),0.5);
+	REQUIRE(rotationDistance(qf,axisAngle(0,0,1,1.0))<1e-6);
+}
+
+TEST_CASE("Test approximate interpolation"){
+	std::vector<Quaternion> a=randomRotations(1000,4), b=randomRotations(1000,5);
+	for (std::size_t n=0;n<a.size();++n){
+		for (int m=0;m<=8;++m){
+			const double t=0.125*m;
+			const Quaternion reference=slerp(a[n],b[n],t);
+			// Error bounds documented in Interpolation.h
+			REQUIRE(rotationDistance(nlerp(a[n],b[n],t),reference)<0.15);
+			REQUIRE(rotationDistance(fastSlerp(a[n],b[n],t),reference)<1e-3);
+			REQUIRE(std::abs(nlerp(a[n],b[n],t).norm()-1.0)<1e-15);
+			REQUIRE(std::abs(fastSlerp(a[n],b[n],t).norm()-1.0)<1e-15);
+		}
+		// nlerp is exact at the end points and the midpoint
+		REQUIRE(rotationDistance(nlerp(a[n],b[n],0.5),slerp(a[n],b[n],0.5))<1e-15);
+		REQUIRE(rotationDistance(fastSlerp(a[n],b[n],0.5),slerp(a[n],b[n],0.5))<1e-15);
+	}
+}
+
+TEST_CASE("Test squad"){
+	std::vector<Quaternion> keys={axisAngle(0,0,1,0.0),axisAngle(0,0,1,0.5),axisAngle(1,0,0,0.5)*axisAngle(0,0,1,0.5),axisAngle(0,1,0,1.0)};
+	std::vector<Quaternion> controls(keys.size());
+	controls.front()=keys.front();
+	controls.back()=keys.back();
+	for (std::size_t n=1;n+1<keys.size();++n){
+		controls[n]=squadControlPoint(keys[n-1],keys[n],keys[n+1]);
+	}
+
+	for (std::size_t n=0;n+1<keys.size();++n){
+		// Passes through the keyframes
+		REQUIRE(rotationDistance(squad(keys[n],keys[n+1],controls[n],controls[n+1],0.0),keys[n])<1e-15);
+		REQUIRE(rotationDistance(squad(keys[n],keys[n+1],controls[n],controls[n+1],1.0),keys[n+1])<1e-15);
+		REQUIRE(std::abs(squad(keys[n],keys[n+1],controls[n],controls[n+1],0.4).norm()-1.0)<1e-15);
+	}
+
+	// Smooth: the angular velocity is (nearly) the same on both sides of a keyframe
+	const double h=1e-5;
+	const double before=rotationDistance(squad(keys[0],keys[1],controls[0],controls[1],1.0-h),keys[1])/h;
+	const double after=rotationDistance(squad(keys[1],keys[2],controls[1],controls[2],h),keys[1])/h;
+	REQUIRE(std::abs(before-after)<1e-3*before);
+
+	// With the keyframes as their own control points, squad is slerp
+	REQUIRE(rotationDistance(squad(keys[0],keys[1],keys[0],keys[1],0.3),slerp(keys[0],keys[1],0.3))<1e-15);
+}
+
+TEST_CASE("Test batch interpolation matches the scalar functions"){
+	const std::size_t size=1001;
+	std::vector<Quaternion> a=randomRotations(size,6), b=randomRotations(size,7), c=randomRotations(size,8), d=randomRotations(size,9);
+	std::vector<double> t(size);
+	for (std::size_t n=0;n<size;++n){
+		t[n]=double(n)/(size-1);
+	}
+	QuaternionBatch q0(a), q1(b), s0(c), s1(d), out;
+
+	slerp(q0,q1,t.data(),out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==slerp(a[n],b[n],t[n]));}
+	nlerp(q0,q1,t.data(),out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==nlerp(a[n],b[n],t[n]));}
+	fastSlerp(q0,q1,t.data(),out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==fastSlerp(a[n],b[n],t[n]));}
+	squad(q0,q1,s0,s1,t.data(),out);
+	for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==squad(a[n],b[n],c[n],d[n],t[n]));}
+
+	// In place, single precision
+	std::vector<QuaternionF> af(size), bf(size);
+	std::vector<float> tf(size);
+	for (std::size_t n=0;n<size;++n){
+		af[n]=QuaternionF(a[n]);
+		bf[n]=QuaternionF(b[n]);
+		tf[n]=float(t[n]);
+	}
+	QuaternionBatchF qf0(af), qf1(bf);
+	slerp(qf0,qf1,tf.data(),qf0);
+	for (std::size_t n=0;n<size;++n){REQUIRE(qf0.get(n)==slerp(af[n],bf[n],tf[n]));}
+}
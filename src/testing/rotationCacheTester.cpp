@@ -0,0 +1,157 @@
+/*
+ * rotationCacheTester.cpp
+ *
+ * \brief Unit tests for the rotation matrix cache
+ * \author Nikos Kazazakis
+ */
+
+#include "RotationCache.h"
+#include <catch.hpp>
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace Quaternions;
+
+// Rotations about z, spaced far apart
+static Quaternion heading(int n)
+{
+	const double angle=0.01*n;
+	return Quaternion(std::cos(angle/2),0,0,std::sin(angle/2));
+}
+
+static bool sameBits(const Matrix3 &M1, const Matrix3 &M2)
+{
+	return std::memcmp(&M1,&M2,sizeof(Matrix3))==0;
+}
+
+TEST_CASE("Test rotation cache lookups"){
+	RotationCache cache(100);
+	REQUIRE(cache.capacity()==128);
+	REQUIRE(cache.size()==0);
+	const Quaternion q=normalize(Quaternion(0.3,-0.5,0.7,0.1));
+	Matrix3 M;
+	REQUIRE(!cache.find(q,M));
+	REQUIRE(cache.size()==0);
+
+	// The first call builds the matrix, the next ones find it
+	REQUIRE(sameBits(cache.matrix(q),toMatrix(q)));
+	REQUIRE(cache.size()==1);
+	REQUIRE(cache.find(q,M));
+	REQUIRE(sameBits(M,toMatrix(q)));
+	REQUIRE(sameBits(cache.matrix(q),toMatrix(q)));
+
+	// -q is the same key, and so are rotations with the same components as
+	// floats (a 2.5 times longer q is not: keys aren't normalized)
+	REQUIRE(cache.find(-1.0*q,M));
+	const Quaternion rounded(float(q.w()),float(q.i()),float(q.j()),float(q.k()));
+	REQUIRE(cache.find(rounded,M));
+	REQUIRE(cache.find(rounded+Quaternion(0,1e-12,0,0),M));
+	REQUIRE(sameBits(M,toMatrix(q)));
+	REQUIRE(!cache.find(2.5*q,M));
+	REQUIRE(!cache.find(normalize(q+Quaternion(1e-4,0,0,0)),M));
+
+	const Vector3 p{1.0,2.0,3.0};
+	const Vector3 rotated=cache.rotate(q,p);
+	REQUIRE(rotated==rotate(toMatrix(q),p));
+
+	RotationCacheStats stats=cache.stats();
+	REQUIRE(stats.hits==6);
+	REQUIRE(stats.misses==4);
+	REQUIRE(stats.insertions==1);
+	REQUIRE(stats.evictions==0);
+	REQUIRE(stats.hitRate()==Approx(0.6));
+
+	SECTION("Zero, NaN and quaternions far from unit length are never cached"){
+		const double nan=std::numeric_limits<double>::quiet_NaN();
+		const Matrix3 broken=cache.matrix(Quaternion(nan,0,0,0));
+		REQUIRE(broken.m[0][0]!=broken.m[0][0]);
+		cache.matrix(Quaternion(0,0,0,0));
+		// As floats, these components would be 0 and infinity
+		cache.matrix(Quaternion(1e-50,2e-50,0,0));
+		cache.matrix(Quaternion(1e50,0,0,0));
+		REQUIRE(cache.size()==1);
+		// -0 and +0 are the same key
+		cache.matrix(Quaternion(0,-1,0,0));
+		REQUIRE(cache.find(Quaternion(-0.0,1,0,0),M));
+		REQUIRE(cache.stats().misses==9);
+	}
+
+	SECTION("Statistics and entries are cleared separately"){
+		cache.resetStats();
+		REQUIRE(cache.stats().hits==0);
+		REQUIRE(cache.stats().hitRate()==0.0);
+		REQUIRE(cache.size()==1);
+		cache.clear();
+		REQUIRE(cache.size()==0);
+		REQUIRE(!cache.find(q,M));
+		cache.matrix(q);
+		REQUIRE(cache.find(q,M));
+	}
+}
+
+TEST_CASE("Test rotation cache eviction"){
+	SECTION("The size never exceeds the capacity"){
+		RotationCache cache(64);
+		for (int n=0;n<1000;++n){
+			cache.matrix(heading(n));
+			REQUIRE(cache.size()<=cache.capacity());
+		}
+		const RotationCacheStats stats=cache.stats();
+		REQUIRE(stats.insertions==1000);
+		REQUIRE(stats.evictions==stats.insertions-cache.size());
+		// Whatever is still cached has the right matrix
+		Matrix3 M;
+		std::size_t found=0;
+		for (int n=0;n<1000;++n){
+			if (cache.find(heading(n),M)){
+				REQUIRE(sameBits(M,toMatrix(heading(n))));
+				++found;
+			}
+		}
+		REQUIRE(found==cache.size());
+	}
+
+	SECTION("Rotations in use survive a stream of new ones"){
+		// One set: every rotation competes for the same 8 entries
+		RotationCache cache(RotationCache::kWays);
+		REQUIRE(cache.capacity()==RotationCache::kWays);
+		const Quaternion hot=heading(-1);
+		Matrix3 M;
+		cache.matrix(hot);
+		for (int n=0;n<200;++n){
+			REQUIRE(cache.find(hot,M));
+			cache.matrix(heading(n));
+		}
+		REQUIRE(cache.size()==RotationCache::kWays);
+		REQUIRE(cache.stats().evictions==200+1-RotationCache::kWays);
+	}
+}
+
+TEST_CASE("Test concurrent rotation cache access"){
+	// More orientations than entries, so threads insert, evict and read the same entries at once
+	const int orientations=96;
+	RotationCache cache(32);
+	std::vector<Matrix3> expected(orientations);
+	for (int n=0;n<orientations;++n){
+		expected[n]=toMatrix(heading(n));
+	}
+	const long lookups=200000;
+	long wrong=0;
+	#pragma omp parallel for num_threads(4) reduction(+:wrong) schedule(static,64)
+	for (long n=0;n<lookups;++n){
+		// Skewed: most lookups go to the first few orientations
+		const int orientation=int((n*n)%7==0 ? n%orientations : n%8);
+		if (!sameBits(cache.matrix(heading(orientation)),expected[orientation])){
+			++wrong;
+		}
+	}
+	REQUIRE(wrong==0);
+	const RotationCacheStats stats=cache.stats();
+	REQUIRE(stats.hits+stats.misses==std::uint64_t(lookups));
+	REQUIRE(stats.hits>stats.misses);
+	REQUIRE(cache.size()<=cache.capacity());
+	REQUIRE(stats.evictions==stats.insertions-cache.size());
+}
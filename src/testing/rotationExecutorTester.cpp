@@ -0,0 +1,248 @@
+/*
+ * rotationExecutorTester.cpp
+ *
+ * \brief Unit tests for the lock-free queue and the asynchronous rotation executor
+ * \author Nikos Kazazakis
+ */
+
+#include "RotationExecutor.h"
+#include "testGenerators.h"
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace Quaternions;
+
+// A random cloud of n points
+static PointCloud randomCloud(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	PointCloud points(n);
+	for (std::size_t p=0;p<n;++p){
+		points.set(p,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+	}
+	return points;
+}
+
+// Bit for bit equality of two clouds
+static bool sameBits(const PointCloud &p1, const PointCloud &p2)
+{
+	if (p1.size()!=p2.size()){
+		return false;
+	}
+	const std::size_t bytes=p1.size()*sizeof(double);
+	return std::memcmp(p1.x(),p2.x(),bytes)==0 && std::memcmp(p1.y(),p2.y(),bytes)==0 && std::memcmp(p1.z(),p2.z(),bytes)==0;
+}
+
+TEST_CASE("Test lock-free queue"){
+	SECTION("One thread"){
+		MPMCQueue<int> queue(5);
+		REQUIRE(queue.capacity()==8);
+		int value;
+		REQUIRE(!queue.tryPop(value));
+		for (int n=0;n<8;++n){
+			REQUIRE(queue.tryPush(int(n)));
+		}
+		REQUIRE(queue.size()==8);
+		REQUIRE(!queue.tryPush(8));
+		// First in, first out, also after the positions wrap around
+		for (int round=0;round<3;++round){
+			for (int n=0;n<8;++n){
+				REQUIRE(queue.tryPop(value));
+				REQUIRE(value==8*round+n);
+				REQUIRE(queue.tryPush(8*(round+1)+n));
+			}
+		}
+		REQUIRE(queue.size()==8);
+	}
+
+	SECTION("A full queue leaves the value alone"){
+		MPMCQueue<std::unique_ptr<int> > queue(2);
+		REQUIRE(queue.tryPush(std::unique_ptr<int>(new int(1))));
+		REQUIRE(queue.tryPush(std::unique_ptr<int>(new int(2))));
+		std::unique_ptr<int> extra(new int(3));
+		REQUIRE(!queue.tryPush(std::move(extra)));
+		REQUIRE(extra);
+		REQUIRE(*extra==3);
+	}
+
+	SECTION("Many producers and consumers"){
+		// Every value comes out exactly once
+		const int producers=4, consumers=4, perProducer=50000;
+		MPMCQueue<int> queue(64);
+		std::vector<std::atomic<int> > seen(producers*perProducer);
+		for (auto &count : seen){
+			count.store(0);
+		}
+		std::atomic<int> popped(0);
+		std::vector<std::thread> threads;
+		for (int p=0;p<producers;++p){
+			threads.emplace_back([&,p]{
+				for (int n=0;n<perProducer;++n){
+					while (!queue.tryPush(p*perProducer+n)){
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (int c=0;c<consumers;++c){
+			threads.emplace_back([&]{
+				int value;
+				while (popped.load()<producers*perProducer){
+					if (queue.tryPop(value)){
+						seen[value].fetch_add(1);
+						popped.fetch_add(1);
+					}
+					else{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (auto &thread : threads){
+			thread.join();
+		}
+		int wrong=0;
+		for (auto &count : seen){
+			wrong+=count.load()!=1;
+		}
+		REQUIRE(wrong==0);
+		REQUIRE(queue.size()==0);
+	}
+}
+
+TEST_CASE("Test latency histogram buckets"){
+	for (std::size_t bucket=0;bucket<kExecutorLatencyBuckets;++bucket){
+		const std::uint64_t start=latencyBucketStart(bucket), end=latencyBucketStart(bucket+1);
+		REQUIRE(start<end);
+		REQUIRE(executorLatencyBucket(start)==bucket);
+		REQUIRE(executorLatencyBucket(end-1)==bucket);
+		// At most 12.5% wide
+		REQUIRE(end-start<=std::max<std::uint64_t>(1,start/8));
+	}
+	REQUIRE(executorLatencyBucket(~std::uint64_t(0))==kExecutorLatencyBuckets-1);
+
+	RotationExecutorStats stats;
+	REQUIRE(stats.latencyPercentile(0.99)==0);
+	stats.latency[executorLatencyBucket(1000)]=99;
+	stats.latency[executorLatencyBucket(1000000)]=1;
+	REQUIRE(stats.latencyPercentile(0.5)>=1000);
+	REQUIRE(stats.latencyPercentile(0.5)<=1125);
+	REQUIRE(stats.latencyPercentile(0.99)<=1125);
+	REQUIRE(stats.latencyPercentile(1.0)>=1000000);
+}
+
+TEST_CASE("Test rotation executor"){
+	SECTION("Futures give the results of the batch rotation"){
+		RotationExecutorOptions options;
+		options.workers=2;
+		RotationExecutor executor(options);
+		const std::vector<Quaternion> rotations=randomRotations(50,21);
+		std::vector<PointCloud> clouds;
+		std::vector<std::future<PointCloud> > results;
+		for (std::size_t n=0;n<50;++n){
+			clouds.push_back(randomCloud(n*37%300,unsigned(n))); // Including an empty one
+			results.push_back(executor.submit(rotations[n],clouds[n]));
+		}
+		for (std::size_t n=0;n<results.size();++n){
+			PointCloud expected;
+			rotate(rotations[n],clouds[n],expected);
+			REQUIRE(sameBits(results[n].get(),expected));
+		}
+		const RotationExecutorStats stats=executor.stats();
+		REQUIRE(stats.completed==50);
+		std::uint64_t points=0, latencies=0;
+		for (const PointCloud &cloud : clouds){
+			points+=cloud.size();
+		}
+		for (std::uint64_t count : stats.latency){
+			latencies+=count;
+		}
+		REQUIRE(stats.points==points);
+		REQUIRE(latencies==50);
+		REQUIRE(stats.batches>=1);
+		REQUIRE(stats.batches<=50);
+		REQUIRE(stats.queueDepth==0);
+		REQUIRE(stats.maxQueueDepth>=1);
+		REQUIRE(stats.latencyPercentile(0.5)<=stats.latencyPercentile(0.99));
+
+		executor.resetStats();
+		REQUIRE(executor.stats().completed==0);
+	}
+
+	SECTION("Callbacks from many producers"){
+		const int producers=4, perProducer=500;
+		std::atomic<int> wrong(0), done(0);
+		{
+			RotationExecutorOptions options;
+			options.workers=3;
+			options.queueCapacity=16; // So that producers have to wait for room
+			RotationExecutor executor(options);
+			std::vector<std::thread> threads;
+			for (int p=0;p<producers;++p){
+				threads.emplace_back([&,p]{
+					const std::vector<Quaternion> rotations=randomRotations(perProducer,100+p);
+					for (int n=0;n<perProducer;++n){
+						const Quaternion &q=rotations[n];
+						const PointCloud points=randomCloud(1+n%64,unsigned(p*perProducer+n));
+						PointCloud expected;
+						rotate(q,points,expected);
+						executor.submit(q,points,[&wrong,&done,expected](PointCloud &rotated){
+							if (!sameBits(rotated,expected)){
+								++wrong;
+							}
+							++done;
+						});
+					}
+				});
+			}
+			for (auto &thread : threads){
+				thread.join();
+			}
+			// The destructor completes whatever is still queued
+		}
+		REQUIRE(done==producers*perProducer);
+		REQUIRE(wrong==0);
+	}
+
+	SECTION("Batches respect the limits"){
+		RotationExecutorOptions options;
+		options.workers=1;
+		options.maxBatchJobs=4;
+		options.batchWindow=std::chrono::microseconds(100000); // Plenty of time to fill every batch
+		RotationExecutor executor(options);
+		std::vector<std::future<PointCloud> > results;
+		for (int n=0;n<40;++n){
+			results.push_back(executor.submit(Quaternion(1,0,0,0),randomCloud(10,unsigned(n))));
+		}
+		for (auto &result : results){
+			result.get();
+		}
+		const RotationExecutorStats stats=executor.stats();
+		// Not batches==10: a loaded machine may not fill every batch within the window
+		REQUIRE(stats.completed==40);
+		REQUIRE(stats.batches>=10);
+		REQUIRE(stats.meanBatchJobs()<=4.0);
+	}
+
+	SECTION("Big jobs end a batch"){
+		RotationExecutorOptions options;
+		options.workers=1;
+		options.maxBatchPoints=100;
+		options.batchWindow=std::chrono::microseconds(100000);
+		RotationExecutor executor(options);
+		std::vector<std::future<PointCloud> > results;
+		for (int n=0;n<10;++n){
+			results.push_back(executor.submit(Quaternion(1,0,0,0),randomCloud(100,unsigned(n))));
+		}
+		for (auto &result : results){
+			result.get();
+		}
+		REQUIRE(executor.stats().batches==10);
+	}
+}
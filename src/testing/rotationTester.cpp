@@ -0,0 +1,67 @@
+/*
+ * rotationTester.cpp
+ *
+ * \brief Unit tests for the vector rotation functions
+ * \author Nikos Kazazakis
+ */
+
+#include "Rotation.h"
+#include <catch.hpp>
+
+#include <random>
+
+using namespace Quaternions;
+
+// Rotation through p'=q*p*q^{-1} with full Hamilton products, as a reference
+static Vector3 referenceRotate(const Quaternion &q, const Vector3 &p)
+{
+	Quaternion r = q*Quaternion(0,p.x,p.y,p.z)*q.conjugate();
+	return Vector3{r.i(),r.j(),r.k()};
+}
+
+TEST_CASE("Test single vector rotation"){
+	// 90 degrees around z maps x onto y
+	const double halfAngle=std::acos(-1.0)/4.0;
+	Quaternion q = Quaternion(std::cos(halfAngle),0,0,std::sin(halfAngle));
+	Vector3 p=rotate(q,Vector3{1,0,0});
+	REQUIRE(std::abs(p.x)<1e-15);
+	REQUIRE(std::abs(p.y-1.0)<1e-15);
+	REQUIRE(p.z==0.0);
+
+	// Identity leaves the vector unchanged
+	REQUIRE(rotate(Quaternion(1,0,0,0),Vector3{1,2,3})==(Vector3{1,2,3}));
+}
+
+TEST_CASE("Test batch rotation matches the Hamilton product form"){
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	const std::size_t size=513;
+
+	PointCloud points(size), rotated;
+	std::vector<Quaternion> quaternions(size);
+	for (std::size_t n=0;n<size;++n){
+		points.set(n,Vector3{distribution(generator),distribution(generator),distribution(generator)});
+		Quaternion q = Quaternion(distribution(generator),distribution(generator),distribution(generator),distribution(generator));
+		quaternions[n]=q*(1.0/q.norm());
+	}
+
+	// Same quaternion for all points
+	rotate(quaternions[0],points,rotated);
+	for (std::size_t n=0;n<size;++n){
+		const Vector3 r=rotated.get(n), e=referenceRotate(quaternions[0],points.get(n));
+		REQUIRE(std::abs(r.x-e.x)<1e-14);
+		REQUIRE(std::abs(r.y-e.y)<1e-14);
+		REQUIRE(std::abs(r.z-e.z)<1e-14);
+	}
+
+	// One quaternion per point, in place
+	rotated=points;
+	rotate(QuaternionBatch(quaternions),rotated,rotated);
+	for (std::size_t n=0;n<size;++n){
+		const Vector3 r=rotated.get(n), e=referenceRotate(quaternions[n],points.get(n));
+		REQUIRE(r==rotate(quaternions[n],points.get(n)));
+		REQUIRE(std::abs(r.x-e.x)<1e-14);
+		REQUIRE(std::abs(r.y-e.y)<1e-14);
+		REQUIRE(std::abs(r.z-e.z)<1e-14);
+	}
+}
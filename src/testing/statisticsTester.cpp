@@ -0,0 +1,217 @@
+/*
+ * statisticsTester.cpp
+ *
+ * \brief Unit tests for rotation averaging and statistics
+ * \author Nikos Kazazakis
+ */
+
+#include "Statistics.h"
+#include "Comparison.h"
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace Quaternions;
+
+// The rotation by angle around the unit axis (x,y,z)
+static Quaternion axisAngle(double x, double y, double z, double angle)
+{
+	const double s=std::sin(angle/2);
+	return Quaternion(std::cos(angle/2),s*x,s*y,s*z);
+}
+
+// Random rotations within maxAngle of center, with random signs
+static std::vector<Quaternion> scatter(const Quaternion &center, std::size_t n, double maxAngle, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> distribution(-1.0,1.0);
+	std::vector<Quaternion> rotations(n);
+	for (auto &q : rotations){
+		const Quaternion axis=normalize(Quaternion(0,distribution(generator),distribution(generator),distribution(generator)));
+		q=center*axisAngle(axis.i(),axis.j(),axis.k(),maxAngle*std::abs(distribution(generator)));
+		if (distribution(generator)<0.0){
+			q=-1.0*q;
+		}
+	}
+	return rotations;
+}
+
+TEST_CASE("Test rotation averaging"){
+	const Quaternion center=normalize(Quaternion(0.3,-0.2,0.8,0.4));
+
+	SECTION("The mean of one rotation is that rotation"){
+		RotationAccumulator accumulator;
+		REQUIRE(accumulator.mean()==Quaternion(1,0,0,0));
+		accumulator.add(-1.0*center);
+		REQUIRE(approxEqual(accumulator.mean(),center,1e-15));
+		REQUIRE(accumulator.weight()==1.0);
+		// q and -q sum to zero, but they are the same rotation
+		accumulator.add(center);
+		REQUIRE(approxEqual(accumulator.mean(),center,1e-15));
+	}
+
+	SECTION("Symmetric pairs average to their center, whatever their signs"){
+		RotationAccumulator accumulator;
+		for (const Quaternion &q : scatter(Quaternion(1,0,0,0),100,0.5,1)){
+			accumulator.add(center*q);
+			accumulator.add(-1.0*(center*q.conjugate()));
+		}
+		REQUIRE(approxEqual(accumulator.mean(),center,1e-14,toleranceAbsolute,compareRotations));
+		REQUIRE(accumulator.weight()==200.0);
+	}
+
+	SECTION("The mean maximizes the weighted sum of squared dot products"){
+		const std::vector<Quaternion> rotations=scatter(center,50,1.2,2);
+		RotationAccumulator accumulator;
+		for (std::size_t n=0;n<rotations.size();++n){
+			accumulator.add(rotations[n],1.0+n%3);
+		}
+		const Quaternion mean=accumulator.mean();
+		REQUIRE(std::abs(mean.norm()-1.0)<1e-15);
+		REQUIRE(mean.w()>=0.0);
+		auto objective=[&](const Quaternion &m){
+			double sum=0.0;
+			for (std::size_t n=0;n<rotations.size();++n){
+				sum+=(1.0+n%3)*dot(rotations[n],m)*dot(rotations[n],m);
+			}
+			return sum;
+		};
+		std::mt19937 generator(3);
+		std::uniform_real_distribution<double> distribution(-1e-3,1e-3);
+		for (int trial=0;trial<100;++trial){
+			const Quaternion nearby=normalize(mean+Quaternion(distribution(generator),distribution(generator),distribution(generator),distribution(generator)));
+			REQUIRE(objective(nearby)<=objective(mean)*(1.0+1e-15));
+		}
+	}
+
+	SECTION("The largest eigenvalue may be in a block that the largest diagonal element isn't coupled to"){
+		// Half turns about x=y: their sums only couple i and j, and are below ww on the diagonal
+		const double s=std::sqrt(0.5);
+		const Quaternion halfTurn(0,s,s,0);
+		std::vector<Quaternion> rotations(10,halfTurn);
+		rotations.resize(16,Quaternion(1,0,0,0));
+		REQUIRE(approxEqual(averageRotation(QuaternionBatch(rotations)),halfTurn,1e-15,toleranceAbsolute,compareRotations));
+
+		RotationAccumulator accumulator;
+		accumulator.add(Quaternion(1,0,0,0),1.0);
+		accumulator.add(halfTurn,1.4);
+		accumulator.add(Quaternion(0,s,-s,0),0.4);
+		const Quaternion mean=accumulator.mean();
+		REQUIRE(approxEqual(mean,halfTurn,1e-15,toleranceAbsolute,compareRotations));
+		const double objective=1.0*mean.w()*mean.w()+1.4*dot(halfTurn,mean)*dot(halfTurn,mean)
+				+0.4*dot(Quaternion(0,s,-s,0),mean)*dot(Quaternion(0,s,-s,0),mean);
+		REQUIRE(std::abs(objective-1.4)<1e-14);
+	}
+
+	SECTION("Accumulators add, remove and merge"){
+		const std::vector<Quaternion> rotations=scatter(center,60,0.8,4);
+		RotationAccumulator all, first, second;
+		for (std::size_t n=0;n<rotations.size();++n){
+			all.add(rotations[n]);
+			(n<30 ? first : second).add(rotations[n]);
+		}
+		first+=second;
+		REQUIRE(approxEqual(first.mean(),all.mean(),1e-14));
+		for (std::size_t n=30;n<rotations.size();++n){
+			all.remove(rotations[n]);
+		}
+		REQUIRE(approxEqual(all.mean(),averageRotation(QuaternionBatch(std::vector<Quaternion>(rotations.begin(),rotations.begin()+30))),1e-14));
+	}
+}
+
+TEST_CASE("Test batch rotation averaging"){
+	const Quaternion center=normalize(Quaternion(-0.5,0.1,0.3,0.7));
+	const std::vector<Quaternion> rotations=scatter(center,10007,0.6,5);
+	const QuaternionBatch batch(rotations);
+	std::vector<double> weights(rotations.size());
+	RotationAccumulator serial, weighted;
+	for (std::size_t n=0;n<rotations.size();++n){
+		weights[n]=(n%5)*0.5;
+		serial.add(rotations[n]);
+		weighted.add(rotations[n],weights[n]);
+	}
+
+	REQUIRE(accumulate(batch).weight()==rotations.size());
+	REQUIRE(approxEqual(averageRotation(batch),serial.mean(),1e-14));
+	REQUIRE(approxEqual(averageRotation(batch,weights.data()),weighted.mean(),1e-14));
+	REQUIRE(approxEqual(averageRotation(batch),center,0.02,toleranceAbsolute,compareRotations));
+
+	// Float batches accumulate in double
+	const BasicQuaternionBatch<float> batchF(std::vector<QuaternionF>(rotations.begin(),rotations.end()));
+	REQUIRE(approxEqual(Quaternion(averageRotation(batchF)),serial.mean(),1e-6));
+
+	// Integer weights are repeated rotations
+	const std::vector<Quaternion> few(rotations.begin(),rotations.begin()+4);
+	const std::vector<double> counts={1,3,0,2};
+	std::vector<Quaternion> repeated;
+	for (std::size_t n=0;n<few.size();++n){
+		repeated.insert(repeated.end(),std::size_t(counts[n]),few[n]);
+	}
+	REQUIRE(approxEqual(averageRotation(QuaternionBatch(few),counts.data()),averageRotation(QuaternionBatch(repeated)),1e-14));
+
+	REQUIRE(averageRotation(QuaternionBatch())==Quaternion(1,0,0,0));
+}
+
+TEST_CASE("Test rotation statistics"){
+	// Rotations about z by +-angle around the center: every one is angle away from the mean
+	const Quaternion center=normalize(Quaternion(0.2,0.9,-0.3,0.1));
+	const double angle=0.25;
+	std::vector<Quaternion> rotations;
+	for (int n=0;n<100;++n){
+		rotations.push_back(center*axisAngle(0,0,1,n%2 ? angle : -angle));
+		if (n%3==0){
+			rotations.back()=-1.0*rotations.back();
+		}
+	}
+	const RotationStatistics statistics=rotationStatistics(QuaternionBatch(rotations));
+	REQUIRE(approxEqual(statistics.mean,center,1e-14,toleranceAbsolute,compareRotations));
+	REQUIRE(statistics.variance==Approx(angle*angle).epsilon(1e-12));
+	REQUIRE(statistics.deviation==Approx(angle).epsilon(1e-12));
+	REQUIRE(statistics.maximum==Approx(angle).epsilon(1e-12));
+
+	// Zero weights don't count, neither in the variance nor the maximum
+	rotations.push_back(center*axisAngle(1,0,0,2.0));
+	std::vector<double> weights(rotations.size(),1.0);
+	weights.back()=0.0;
+	const RotationStatistics weighted=rotationStatistics(QuaternionBatch(rotations),weights.data());
+	REQUIRE(weighted.variance==Approx(angle*angle).epsilon(1e-12));
+	REQUIRE(weighted.maximum==Approx(angle).epsilon(1e-12));
+	REQUIRE(rotationStatistics(QuaternionBatch(rotations)).maximum>1.9);
+
+	const RotationStatistics none=rotationStatistics(QuaternionBatch());
+	REQUIRE(none.variance==0.0);
+	REQUIRE(none.maximum==0.0);
+}
+
+TEST_CASE("Test sliding rotation averages"){
+	const std::size_t window=37;
+	// A slowly turning orientation, with noise
+	std::vector<Quaternion> rotations;
+	std::mt19937 generator(6);
+	std::uniform_real_distribution<double> noise(-0.02,0.02);
+	for (int n=0;n<3001;++n){
+		const Quaternion jitter=normalize(Quaternion(1.0,noise(generator),noise(generator),noise(generator)));
+		rotations.push_back((n%2 ? 1.0 : -1.0)*(axisAngle(0,0.6,0.8,0.01*n)*jitter));
+	}
+	const QuaternionBatch batch(rotations);
+	QuaternionBatch averages;
+	slidingAverage(batch,window,averages);
+	REQUIRE(averages.size()==rotations.size());
+
+	SlidingRotationAverage sliding(window);
+	REQUIRE(sliding.window()==window);
+	for (std::size_t n=0;n<rotations.size();++n){
+		sliding.push(rotations[n]);
+		REQUIRE(sliding.size()==std::min(n+1,window));
+		const std::size_t first= n+1>window ? n+1-window : 0;
+		const Quaternion direct=averageRotation(QuaternionBatch(std::vector<Quaternion>(rotations.begin()+first,rotations.begin()+n+1)));
+		REQUIRE(approxEqual(sliding.mean(),direct,1e-13));
+		REQUIRE(approxEqual(averages.get(n),direct,1e-13));
+	}
+
+	sliding.clear();
+	REQUIRE(sliding.size()==0);
+	sliding.push(rotations[5]);
+	REQUIRE(approxEqual(sliding.mean(),rotations[5],1e-15,toleranceAbsolute,compareRotations));
+}
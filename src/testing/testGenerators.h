@@ -0,0 +1,49 @@
+/*
+ * testGenerators.h
+ *
+ * \brief Random inputs shared by the unit tests
+ * \author Nikos Kazazakis
+ */
+
+#ifndef QUATERNION_TEST_GENERATORS_LIB // Define macro headers so that this file is only included once
+#define QUATERNION_TEST_GENERATORS_LIB
+
+#include "Quaternion.h"
+
+#include <random>
+#include <vector>
+
+/* Note: every tester calls these with a fixed seed of its own, so that
+ * failures can be reproduced. Testers that need inputs of a particular shape
+ * (e.g. norms over many orders of magnitude) keep their own generators.
+ */
+
+// Random quaternions with components in [-10,10). Pick sizes that aren't a
+// multiple of any vector width, so that the kernels' remainder loops are tested too
+template <typename T=double>
+std::vector<Quaternions::BasicQuaternion<T> > randomQuaternions(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<T> distribution(T(-10),T(10));
+	std::vector<Quaternions::BasicQuaternion<T> > quaternions(n);
+	for (auto &q : quaternions){
+		q=Quaternions::BasicQuaternion<T>(distribution(generator),distribution(generator),distribution(generator),distribution(generator));
+	}
+	return quaternions;
+}
+
+// Random unit quaternions, uniformly distributed over the rotations (and both signs)
+template <typename T=double>
+std::vector<Quaternions::BasicQuaternion<T> > randomRotations(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::normal_distribution<T> distribution(T(0),T(1));
+	std::vector<Quaternions::BasicQuaternion<T> > quaternions(n);
+	for (auto &q : quaternions){
+		q=Quaternions::BasicQuaternion<T>(distribution(generator),distribution(generator),distribution(generator),distribution(generator));
+		q=(T(1)/q.norm())*q;
+	}
+	return quaternions;
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * unitQuaternionTester.cpp
+ *
+ * \brief Unit tests for normalize, inverse, fast normalization and UnitQuaternion
+ * \author Nikos Kazazakis
+ */
+
+#include "UnitQuaternion.h"
+#include "SparseQuaternion.h"
+#include "QuaternionBatch.h"
+#include "Rotation.h"
+#include <catch.hpp>
+
+#include <random>
+#include <type_traits>
+#include <vector>
+
+using namespace Quaternions;
+
+// Random quaternions with norms from about 1e-3 to 1e3
+template <typename T>
+static std::vector<BasicQuaternion<T> > scaledQuaternions(std::size_t n, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<T> distribution(T(-1),T(1));
+	std::uniform_real_distribution<T> exponent(T(-3),T(3));
+	std::vector<BasicQuaternion<T> > quaternions(n);
+	for (auto &q : quaternions){
+		const T scale=std::pow(T(10),exponent(generator));
+		q=scale*BasicQuaternion<T>(distribution(generator),distribution(generator),distribution(generator),distribution(generator));
+	}
+	return quaternions;
+}
+
+TEST_CASE("Test normalize, inverse and squared norm"){
+	Quaternion q(1,2,3,4);
+	REQUIRE(q.squaredNorm()==30.0);
+	REQUIRE((q*q).squaredNorm()==900.0); // Also on expressions
+	REQUIRE(std::abs(normalize(q).norm()-1.0)<1e-15);
+	REQUIRE(normalize(q)==(1.0/q.norm())*q);
+
+	// q*q^{-1}=q^{-1}*q=1
+	const Quaternion qInverse=inverse(q);
+	REQUIRE(qInverse==(1.0/30.0)*q.conjugate());
+	for (const Quaternion &product : {Quaternion(q*qInverse),Quaternion(qInverse*q)}){
+		REQUIRE(std::abs(product.w()-1.0)<1e-15);
+		REQUIRE(std::abs(product.i())<1e-15);
+		REQUIRE(std::abs(product.j())<1e-15);
+		REQUIRE(std::abs(product.k())<1e-15);
+	}
+
+	// In place versions
+	Quaternion p=q;
+	REQUIRE(&p.normalize()==&p);
+	REQUIRE(p==normalize(q));
+	p=q;
+	p.invert().invert();
+	REQUIRE(std::abs(p.w()-1.0)<1e-15);
+	REQUIRE(std::abs(p.k()-4.0)<1e-14);
+
+	// Sparse quaternions give the same results, without allocating
+	SparseQuaternion sparse(1,2,3,4);
+	REQUIRE(sparse.squaredNorm()==30.0);
+	REQUIRE(normalize(sparse).dense()==normalize(q));
+	REQUIRE(inverse(sparse).dense()==qInverse);
+	resetAllocationCounters();
+	sparse.normalize();
+	REQUIRE(allocationCounters().allocations==0);
+	REQUIRE(sparse.dense()==normalize(q));
+
+	// Missing sparse elements stay missing
+	SparseQuaternion pure;
+	pure[qj]=2.0;
+	pure.invert();
+	REQUIRE(pure.dense()==Quaternion(0,0,-0.5,0));
+}
+
+TEST_CASE("Test fast inverse square root accuracy"){
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<double> exponent(-3.0,3.0);
+	for (int n=0;n<100000;++n){
+		const double x=std::pow(10.0,exponent(generator));
+		const long double exactDouble=1.0L/std::sqrt(static_cast<long double>(x));
+		REQUIRE(std::abs((fastInverseSqrt(x)-exactDouble)/exactDouble)<2*std::numeric_limits<double>::epsilon());
+		const float xf=static_cast<float>(x);
+		const long double exactFloat=1.0L/std::sqrt(static_cast<long double>(xf));
+		REQUIRE(std::abs((fastInverseSqrt(xf)-exactFloat)/exactFloat)<2*std::numeric_limits<float>::epsilon());
+	}
+
+	const std::vector<Quaternion> quaternions=scaledQuaternions<double>(1000,4);
+	for (const Quaternion &q : quaternions){
+		REQUIRE(std::abs(fastNormalize(q).norm()-1.0)<4*std::numeric_limits<double>::epsilon());
+	}
+}
+
+TEST_CASE("Test unit quaternions"){
+	// Trivially copyable, the same size as a quaternion
+	static_assert(std::is_trivially_copyable<UnitQuaternion>::value,"UnitQuaternion must be trivially copyable");
+	static_assert(sizeof(UnitQuaternion)==sizeof(Quaternion),"UnitQuaternion must not add any storage");
+
+	REQUIRE(Quaternion(UnitQuaternion())==Quaternion(1,0,0,0));
+	const UnitQuaternion u(1,2,3,4), v(Quaternion(-1,0.5,0,2));
+	REQUIRE(u.quaternion()==normalize(Quaternion(1,2,3,4)));
+	REQUIRE(u.norm()==1.0);
+
+	// The inverse is the conjugate, exactly
+	REQUIRE(Quaternion(inverse(u))==u.quaternion().conjugate());
+	REQUIRE(Quaternion(u.inverse())==u.quaternion().conjugate());
+
+	// Products of unit quaternions are unit quaternions
+	const UnitQuaternion uv=u*v;
+	REQUIRE(Quaternion(uv)==Quaternion(u.quaternion()*v.quaternion()));
+	REQUIRE(std::abs(uv.quaternion().norm()-1.0)<1e-15);
+
+	// Mixed expressions with ordinary quaternions, and rotations
+	const Vector3 p{1,-2,3};
+	const Quaternion rotated=u*Quaternion(0,p.x,p.y,p.z)*u.conjugate();
+	const Vector3 r=rotate(u,p);
+	REQUIRE(std::abs(r.x-rotated.i())<1e-14);
+	REQUIRE(std::abs(r.y-rotated.j())<1e-14);
+	REQUIRE(std::abs(r.z-rotated.k())<1e-14);
+
+	// Long products drift, renormalize() resets them
+	UnitQuaternion product;
+	for (int n=0;n<100000;++n){
+		product=product*u;
+	}
+	product.renormalize();
+	REQUIRE(std::abs(product.quaternion().norm()-1.0)<=std::numeric_limits<double>::epsilon());
+
+	REQUIRE(Quaternion(UnitQuaternion::fromNormalized(u.quaternion()))==u.quaternion());
+}
+
+TEST_CASE("Test batch normalization and inverse"){
+	const std::size_t size=1001;
+	for (unsigned seed=5;seed<7;++seed){
+		const std::vector<Quaternion> quaternions=scaledQuaternions<double>(size,seed);
+		const QuaternionBatch q(quaternions);
+		QuaternionBatch out;
+		std::vector<double> squaredNorms(size);
+
+		squaredNorm(q,squaredNorms.data());
+		for (std::size_t n=0;n<size;++n){REQUIRE(squaredNorms[n]==quaternions[n].squaredNorm());}
+		normalize(q,out);
+		for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==normalize(quaternions[n]));}
+		fastNormalize(q,out);
+		for (std::size_t n=0;n<size;++n){REQUIRE(std::abs(out.get(n).norm()-1.0)<4*std::numeric_limits<double>::epsilon());}
+		inverse(q,out);
+		for (std::size_t n=0;n<size;++n){REQUIRE(out.get(n)==inverse(quaternions[n]));}
+	}
+
+	const std::vector<QuaternionF> quaternions=scaledQuaternions<float>(size,7);
+	QuaternionBatchF q(quaternions), out;
+	fastNormalize(q,q); // In place
+	for (std::size_t n=0;n<size;++n){REQUIRE(std::abs(q.get(n).norm()-1.0f)<4*std::numeric_limits<float>::epsilon());}
+}
@@ -7,8 +7,18 @@
 
 #define CATCH_CONFIG_MAIN
 #include "Quaternion.h"
+#include "SparseQuaternion.h"
+#include "StaticRotations.h"
 #include <catch.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 using namespace Quaternions;
 TEST_CASE("Test quaternion comparison operators"){
 
@@ -85,3 +95,284 @@ TEST_CASE("Test quaternion math chaining"){
 	REQUIRE( 2.25+(q+2)*q1 == Quaternion(2.75, 3.5, 3.75, 2.5));
 
 }
+
+TEST_CASE("Test quaternion expression templates"){
+	Quaternion q = Quaternion(-1,-2,-1,-2);
+	Quaternion q1 = Quaternion(1,0.5,0.5,0.75);
+
+	// Operators return lazy expressions, which evaluate on assignment
+	auto expression = (2+q)*q1+2.25;
+	REQUIRE(!std::is_same<decltype(expression),Quaternion>::value);
+	Quaternion result = expression;
+	REQUIRE(result==Quaternion(2.75, 3.5, 3.75, 2.5));
+
+	// Expressions hold their operands by value, so they don't dangle
+	auto sum = Quaternion(1,2,3,4)+Quaternion(1,1,1,1);
+	REQUIRE(sum==Quaternion(2,3,4,5));
+
+	// The target may appear in the expression being assigned to it
+	result = q1*result - result;
+	REQUIRE(result==Quaternion(1,0.5,0.5,0.75)*Quaternion(2.75, 3.5, 3.75, 2.5)-Quaternion(2.75, 3.5, 3.75, 2.5));
+
+	// Chained assignment and member functions on expressions
+	Quaternion q2, q3;
+	q3 = q2 = q1*2;
+	REQUIRE(q3==Quaternion(2, 1, 1, 1.5));
+	REQUIRE((q1*2).norm()==q3.norm());
+	REQUIRE((q1+q).conjugate()==Quaternion(0,1.5,0.5,1.25));
+	REQUIRE((q1+q)[qi]==-1.5);
+}
+
+TEST_CASE("Test compile-time quaternions"){
+	// All of these are evaluated by the compiler
+	constexpr Quaternion q = Quaternion(1,0.5,0.5,0.75);
+	constexpr Quaternion product = (2+Quaternion(-1,-2,-1,-2))*q+2.25;
+	static_assert(product==Quaternion(2.75, 3.5, 3.75, 2.5),"constexpr arithmetic");
+	static_assert(q.conjugate()==Quaternion(1,-0.5,-0.5,-0.75),"constexpr conjugate");
+	static_assert(kRotationX180*kRotationX180==Quaternion(-1,0,0,0),"180+180 degrees is -identity");
+	static_assert(kRotationY180*kRotationZ180==kRotationX180,"j*k=i");
+	static_assert(kIdentityRotation*kRotationZ90==kRotationZ90,"identity");
+
+	// Compile-time math matches the run-time library
+	constexpr double root=StaticMath::sqrt(2.0);
+	REQUIRE(std::abs(root-std::sqrt(2.0))<=std::numeric_limits<double>::epsilon()*std::sqrt(2.0)); // 1 ULP
+	// Sine and cosine within 1 ULP, also next to the multiples of pi/2, where most bits of the angle cancel
+	auto ulp=[](double x){return std::nextafter(std::abs(x),std::numeric_limits<double>::infinity())-std::abs(x);};
+	std::vector<double> angles;
+	for (double angle=-4*kPi;angle<=4*kPi;angle+=0.01){
+		angles.push_back(angle);
+	}
+	for (int quadrant=-8;quadrant<=8;++quadrant){
+		const double angle=quadrant*(0.5*kPi);
+		angles.insert(angles.end(),{angle,std::nextafter(angle,-10.0),std::nextafter(angle,10.0)});
+	}
+	angles.push_back(1.5707963);
+	for (double angle : angles){
+		REQUIRE(std::abs(StaticMath::sin(angle)-std::sin(angle))<=ulp(std::sin(angle)));
+		REQUIRE(std::abs(StaticMath::cos(angle)-std::cos(angle))<=ulp(std::cos(angle)));
+	}
+
+	// Compile-time axis-angle rotation matches the canonical constants
+	constexpr Quaternion mount = staticAxisAngle(0,0,2,0.5*kPi);
+	REQUIRE(std::abs(mount.w()-kRotationZ90.w())<2.5e-16); // 2 ULP
+	REQUIRE(std::abs(mount.k()-kRotationZ90.k())<2.5e-16);
+	REQUIRE(mount.i()==0.0);
+
+	// Any axis length works, including those whose squares overflow or underflow
+	static_assert(StaticMath::sqrt(std::numeric_limits<double>::infinity())==std::numeric_limits<double>::infinity(),"sqrt(inf)");
+	constexpr Quaternion huge = staticAxisAngle(1e200,0,0,1.0), tiny = staticAxisAngle(1e-200,0,0,1.0);
+	static_assert(huge==staticAxisAngle(1,0,0,1.0) && tiny==staticAxisAngle(1,0,0,1.0),"scaled axis");
+	REQUIRE(std::abs(huge.i()-std::sin(0.5))<2.5e-16);
+
+	// Constants interoperate with run-time quaternions
+	static constexpr Quaternion table[] = {kIdentityRotation,kRotationZ90,kRotationZ180};
+	Quaternion runtime = Quaternion(0,1,0,0);
+	REQUIRE(table[2]*runtime*table[2].conjugate()==Quaternion(0,-1,0,0));
+}
+
+TEST_CASE("Test quaternion precisions"){
+	QuaternionF qf = QuaternionF(1,0.5f,0.5f,0.75f);
+	QuaternionL ql = QuaternionL(1,0,1,0);
+	Quaternion q = Quaternion(1,0,1,0);
+
+	// Storage matches the component type
+	REQUIRE(sizeof(QuaternionF)==4*sizeof(float));
+	REQUIRE(sizeof(QuaternionL)==4*sizeof(long double));
+
+	// Scalars follow the C++ promotion rules: ints keep the quaternion's type...
+	REQUIRE(std::is_same<decltype((2*qf).w()),float>::value);
+	REQUIRE(std::is_same<decltype((qf+2).w()),float>::value);
+	REQUIRE((2*qf)==QuaternionF(2,1,1,1.5f));
+	// ...while wider types promote the whole expression
+	REQUIRE(std::is_same<decltype((2.0*qf).w()),double>::value);
+	REQUIRE(std::is_same<decltype((q*qf).w()),double>::value);
+	REQUIRE(std::is_same<decltype((q*ql).w()),long double>::value);
+
+	// Mixed precision arithmetic gives the same result as double precision
+	REQUIRE(q*qf==Quaternion(0.5, 1.25, 1.5, 0.25));
+	REQUIRE(ql*qf==QuaternionL(0.5, 1.25, 1.5, 0.25));
+
+	// Widening conversions are implicit, narrowing ones are explicit
+	Quaternion widened = qf*qf;
+	QuaternionF narrowed = QuaternionF(q*q);
+	REQUIRE(widened==qf*qf);
+	REQUIRE(narrowed==QuaternionF(0,0,2,0));
+	REQUIRE(std::is_convertible<QuaternionF,Quaternion>::value);
+	REQUIRE(!std::is_convertible<Quaternion,QuaternionF>::value);
+
+	// Out-of-line members are instantiated for every type
+	REQUIRE(QuaternionF(1,2,2,1).norm()==std::sqrt(10.0f));
+	REQUIRE(QuaternionL(1,2,2,1).norm()==std::sqrt(10.0L));
+}
+
+TEST_CASE("Test dense quaternion storage"){
+	Quaternion q = Quaternion(1,2,3,4);
+
+	// Layout guarantees
+	REQUIRE(std::is_trivially_copyable<Quaternion>::value);
+	REQUIRE(sizeof(Quaternion)==4*sizeof(double));
+	REQUIRE(q.data()[0]==1);
+	REQUIRE(q.data()[3]==4);
+
+	// Copies are independent of the original
+	Quaternion q1 = q;
+	q1[qi]=5.0;
+	REQUIRE(q[qi]==2.0);
+	REQUIRE(q1==Quaternion(1,5,3,4));
+
+	// Element iteration visits all axes in order
+	double sum=0.0;
+	int axis=qw;
+	for (auto it=q.elementsBegin();it!=q.elementsEnd();++it){
+		REQUIRE(it->first==axis++);
+		sum+=(*it).second;
+	}
+	REQUIRE(sum==10.0);
+	for (auto it=q1.elementsBegin();it!=q1.elementsEnd();++it){
+		(*it).second*=2.0;
+	}
+	REQUIRE(q1==Quaternion(2,10,6,8));
+
+	// Printing only shows the non-zero elements
+	std::ostringstream out;
+	Quaternion(1,0,2,0).write(out);
+	REQUIRE(out.str()=="+1+2j");
+}
+
+TEST_CASE("Test sparse quaternion opt-in"){
+	SparseQuaternion q = SparseQuaternion(1,0,1,0);
+	SparseQuaternion q1 = SparseQuaternion(1,0.5,0.5,0.75);
+
+	REQUIRE(q*q1==SparseQuaternion(0.5, 1.25, 1.5, 0.25));
+	REQUIRE(q+q1==SparseQuaternion(2, 0.5, 1.5, 0.75));
+	REQUIRE(q.norm()==std::sqrt(2.0));
+
+	// Conversion to and from the dense representation
+	REQUIRE((q*q1).dense()==Quaternion(1,0,1,0)*Quaternion(1,0.5,0.5,0.75));
+	SparseQuaternion qSparse = SparseQuaternion(Quaternion(0,0,3,0));
+	REQUIRE(qSparse.j()==3.0);
+	REQUIRE(qSparse.w()==0.0);
+}
+
+TEST_CASE("Test sparse quaternion occupancy"){
+	// Zero stores nothing
+	SparseQuaternion zero;
+	REQUIRE(zero.isEmpty());
+	REQUIRE(zero.occupancy()==occupancyNone);
+	REQUIRE(zero.dense()==Quaternion(0,0,0,0));
+	REQUIRE((zero+zero).isEmpty());
+
+	// The mask follows the stored elements
+	const SparseQuaternion point(0,1,2,3), rotation(0.5,0,0,-0.5), real(2,0,0,0);
+	REQUIRE(point.occupancy()==occupancyVector);
+	REQUIRE(rotation.occupancy()==((1u<<qw)|(1u<<qk)));
+	REQUIRE(real.occupancy()==occupancyReal);
+	REQUIRE(SparseQuaternion(1,2,3,4).occupancy()==occupancyFull);
+	REQUIRE((point.isPure() && !point.isReal() && !point.isSingleAxis()));
+	REQUIRE((rotation.isSingleAxis() && !rotation.isPure()));
+	REQUIRE((real.isReal() && real.isSingleAxis()));
+	SparseQuaternion q;
+	q[qj]=0.0; // Stored, even though it's zero
+	REQUIRE(q.occupancy()==(1u<<qj));
+	REQUIRE(q.getAxisValue(qi)==0.0);
+	REQUIRE(q.occupancy()==((1u<<qi)|(1u<<qj)));
+
+	// Copies and moves carry the mask
+	SparseQuaternion copy(point);
+	REQUIRE(copy.occupancy()==occupancyVector);
+	SparseQuaternion moved(std::move(copy));
+	REQUIRE(moved.occupancy()==occupancyVector);
+	REQUIRE(copy.occupancy()==occupancyNone);
+	copy=std::move(moved);
+	REQUIRE(copy.occupancy()==occupancyVector);
+	REQUIRE(moved.occupancy()==occupancyNone);
+	REQUIRE(moved.isEmpty());
+}
+
+TEST_CASE("Test sparse Hamilton product fast paths"){
+	// Every pair of occupancy masks gives exactly the dense product
+	const double values1[4]={0.5,-1.25,2.0,0.75}, values2[4]={-1.5,0.25,1.0,-3.0};
+	for (unsigned mask1=0;mask1<16;++mask1){
+		for (unsigned mask2=0;mask2<16;++mask2){
+			SparseQuaternion q1, q2;
+			Quaternion p1(0,0,0,0), p2(0,0,0,0);
+			for (int axis=qw;axis<=qk;++axis){
+				if ((mask1>>axis)&1u){q1[AxisType(axis)]=values1[axis]; p1[AxisType(axis)]=values1[axis];}
+				if ((mask2>>axis)&1u){q2[AxisType(axis)]=values2[axis]; p2[AxisType(axis)]=values2[axis];}
+			}
+			INFO("Masks "<<mask1<<" and "<<mask2);
+			const SparseQuaternion product=q1*q2;
+			const Quaternion expected=p1*p2;
+			REQUIRE(product.dense()==expected);
+			// Only the non-zero results are stored
+			for (int axis=qw;axis<=qk;++axis){
+				REQUIRE(((product.occupancy()>>axis)&1u)==(expected[AxisType(axis)]!=0.0));
+			}
+		}
+	}
+
+	// The sparse results allocate only what they store
+	const SparseQuaternion point(0,1,2,3), rotation(0.5,0,0,-0.5), real(2,0,0,0);
+	resetAllocationCounters();
+	const SparseQuaternion scaled=real*point;
+	REQUIRE(allocationCounters().allocations==3);
+	REQUIRE(scaled==SparseQuaternion(0,2,4,6));
+	resetAllocationCounters();
+	const SparseQuaternion composed=rotation*rotation; // Around the same axis: stays single-axis
+	REQUIRE(allocationCounters().allocations==1);
+	REQUIRE(composed==SparseQuaternion(0,0,0,-0.5));
+}
+
+TEST_CASE("Test sparse quaternion copy and move"){
+	// Vectors only move their elements when they grow if the move constructor is noexcept
+	static_assert(std::is_nothrow_move_constructible<SparseQuaternion>::value,"SparseQuaternion must be nothrow-movable");
+	static_assert(std::is_nothrow_move_assignable<SparseQuaternion>::value,"SparseQuaternion must be nothrow-move-assignable");
+
+	// Copies are independent
+	SparseQuaternion q = SparseQuaternion(1,2,3,4);
+	SparseQuaternion copy(q);
+	copy[qw]=5;
+	REQUIRE(q==SparseQuaternion(1,2,3,4));
+	REQUIRE(copy==SparseQuaternion(5,2,3,4));
+
+	// Assignment replaces all the elements (a missing element is zero) and chains
+	SparseQuaternion q1, q2;
+	q1=q2=SparseQuaternion(0,0,3,0);
+	REQUIRE(q1==SparseQuaternion(0,0,3,0));
+	REQUIRE(q2==SparseQuaternion(0,0,3,0));
+	q=q1;
+	REQUIRE(q==SparseQuaternion(0,0,3,0));
+
+	// Moves take over the elements
+	SparseQuaternion moved(std::move(copy));
+	REQUIRE(moved==SparseQuaternion(5,2,3,4));
+	REQUIRE(copy.isEmpty());
+	q=std::move(moved);
+	REQUIRE(q==SparseQuaternion(5,2,3,4));
+
+	// Standard containers and algorithms
+	std::vector<SparseQuaternion> quaternions;
+	for (int n=0;n<100;++n){
+		quaternions.push_back(SparseQuaternion(double((37*n)%100),1,0,0));
+	}
+	std::sort(quaternions.begin(),quaternions.end(),
+		[](const SparseQuaternion &q1, const SparseQuaternion &q2){return q1.w()<q2.w();});
+	for (int n=0;n<100;++n){
+		REQUIRE(quaternions[n]==SparseQuaternion(n,1,0,0));
+	}
+
+	// Copies made in an arena scope use the arena, moves keep the arena they came from
+	QuaternionArena arena;
+	SparseQuaternion onHeap;
+	{
+		ArenaScope scope(arena);
+		SparseQuaternion inArena(q);
+		REQUIRE(inArena.arena()==&arena);
+		SparseQuaternion stolen(std::move(inArena));
+		REQUIRE(stolen.arena()==&arena);
+		onHeap=std::move(stolen); // Different arenas: the elements are copied
+	}
+	arena.reset();
+	REQUIRE(onHeap.arena()==nullptr);
+	REQUIRE(onHeap==q);
+}